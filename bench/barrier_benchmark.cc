@@ -0,0 +1,93 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Measures the latency of fdtd1d::ThreadBarrier as a function of the number of
+// threads and the synchronization mode. Thread counts larger than the number
+// of hardware threads measure the behavior under oversubscription.
+//
+// usage: ./barrier_benchmark [MAX_NUMBER_OF_THREADS]
+// output: one line per (mode, threads) pair in the form
+//   mode, threads, hardware_threads, barriers, ns_per_barrier
+
+#include <chrono>       // chrono::steady_clock, chrono::duration
+#include <iostream>     // std::cout
+#include <string>       // std::stoi
+#include <thread>       // std::thread
+#include <vector>       // std::vector
+#include <atomic>       // std::atomic
+
+#include "thread_barrier.h"
+
+namespace {
+
+// each measurement stops after this many barriers or after kTimeBudget
+// seconds, whichever comes first
+constexpr long kMaxNumBarriers = 200000;
+constexpr double kTimeBudget = 0.5;
+
+double MeasureBarrierLatency(const fdtd1d::BarrierMode mode,
+                             const int num_threads, long* num_barriers) {
+  fdtd1d::ThreadBarrier barrier;
+  barrier.Reset(num_threads, mode);
+  std::atomic<bool> stop(false);
+  long rounds = 0;
+
+  auto t_start = std::chrono::steady_clock::now();
+  auto worker = [&](const int thread_index) {
+    for (long i = 0; ; ++i) {
+      // the last thread arriving decides whether to stop, so that all the
+      // threads leave the loop after the same barrier
+      barrier.Wait(thread_index, [&] {
+        rounds = i + 1;
+        std::chrono::duration<double> elapsed(
+            std::chrono::steady_clock::now() - t_start);
+        if (rounds >= kMaxNumBarriers || elapsed.count() > kTimeBudget) {
+          stop = true;
+        }
+      });
+      if (stop) {
+        break;
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> time_span(
+      std::chrono::steady_clock::now() - t_start);
+
+  *num_barriers = rounds;
+  return time_span.count() * 1.0e9 / rounds;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int num_hardware_threads = std::thread::hardware_concurrency();
+  if (num_hardware_threads < 1) {
+    num_hardware_threads = 1;
+  }
+  int max_num_threads = 2 * num_hardware_threads;
+  if (argc == 2) {
+    max_num_threads = std::stoi(argv[1]);
+  }
+
+  std::cout << "mode, threads, hardware_threads, barriers, ns_per_barrier"
+            << std::endl;
+  for (auto mode : {fdtd1d::BarrierMode::kSpin, fdtd1d::BarrierMode::kHybrid}) {
+    for (int num_threads = 1; num_threads <= max_num_threads;
+         num_threads *= 2) {
+      long num_barriers = 0;
+      double latency = MeasureBarrierLatency(mode, num_threads, &num_barriers);
+      std::cout << fdtd1d::GetBarrierModeName(mode) << ", " << num_threads
+                << ", " << num_hardware_threads << ", " << num_barriers << ", "
+                << latency << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,362 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Compares the second order (Yee) and the fourth order (FDTD(2,4)) spatial
+// stencils of FDTD1D (see FDTD1D::SetSpatialOrder): the phase velocity error
+// of a propagating wave against its cost.
+//
+// usage: ./dispersion_benchmark [--option=value ...]
+// options:
+//   --orders=LIST         subset of 2,4 (default both)
+//   --epsilon=LIST        relative permittivities of the medium filling the
+//                         grid (default 1,4,16)
+//   --cells-per-wavelength=LIST
+//                         resolutions of the wave in the medium, at least 4
+//                         (default 5,10,20,40)
+//   --stability-factor=X  stability factor of the time step (default 0.99),
+//                         the fraction of the largest stable time step of
+//                         each order
+//   --wavelengths=N       propagation distance over which the phase is
+//                         measured (default 20 wavelengths)
+//   --throughput-nodes=N  grid of the throughput runs (default 2^20 nodes)
+//   --throughput-steps=N  time steps of the throughput runs (default 200)
+//   --threads=N           threads of the throughput runs (default 1)
+//   --output=FILE         writes the results to FILE instead of the standard
+//                         output
+//
+// The phase velocity is measured with a DFT monitor: a modulated Gaussian
+// pulse at the frequency f of the wave crosses the monitored nodes, and the
+// slope of the phase of E(x, f) along x is the numerical wavenumber. The
+// grid is long enough for the reflections of the walls to arrive after the
+// pulse has left the monitored nodes. The measurement is checked against the
+// dispersion relation of each stencil,
+//
+//   sin(w*dt/2)/(v*dt) = sin(k*dx/2)/dx                          (order 2)
+//   sin(w*dt/2)/(v*dt) = (9/8*sin(k*dx/2) - 1/24*sin(3*k*dx/2))/dx (order 4)
+//
+// where v is the speed of light in the medium. The cost is measured by the
+// throughput runs in vacuum, with the active region tracking off. The output
+// has one CSV line per run:
+//   order, epsilon_r, cells_per_wavelength, courant_number,
+//   phase_velocity_error, analytic_error, ns_per_node_update,
+//   ns_per_wavelength_period
+// courant_number is v*dt/dx in the medium, phase_velocity_error is the
+// relative error v_numerical/v - 1 and ns_per_wavelength_period is the time
+// taken to advance one wavelength of the grid by one period (N cells per
+// wavelength over N*sqrt(epsilon_r)/stability time steps), which compares
+// the orders at equal accuracy.
+
+#include <algorithm>    // std::max
+#include <chrono>       // chrono::steady_clock, chrono::duration
+#include <cmath>        // std::sqrt, std::sin, std::atan2, std::ceil, std::abs
+#include <cstdio>       // std::remove
+#include <fstream>      // std::ifstream, std::ofstream
+#include <iostream>     // std::cout, std::cerr
+#include <map>          // std::map
+#include <sstream>      // std::stringstream
+#include <string>       // std::string, std::stod
+#include <vector>       // std::vector
+
+#include "fdtd1d.h"
+#include "field_monitors.h"
+#include "material_map.h"
+#include "number_types.h"
+#include "yee_kernels.h"
+
+namespace {
+
+using fdtd1d::IntNumber;
+
+constexpr double kPi = 3.141592653589793238462643383279;
+constexpr int kNumThroughputRepetitions = 3;
+
+struct BenchmarkOptions {
+  std::vector<int> orders = {2, 4};
+  std::vector<double> epsilons = {1.0, 4.0, 16.0};
+  std::vector<double> cells_per_wavelength = {5.0, 10.0, 20.0, 40.0};
+  double stability_factor = 0.99;
+  double num_wavelengths = 20.0;
+  IntNumber throughput_nodes = IntNumber(1) << 20;
+  IntNumber throughput_steps = 200;
+  int num_threads = 1;
+  std::string output_file_name;
+};
+
+// returns false if an option is not recognized
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    std::string name = arg.substr(0, arg.find('='));
+    std::string value = arg.find('=') == std::string::npos ?
+                        std::string() : arg.substr(arg.find('=') + 1);
+    bool is_valid = !value.empty();
+    std::vector<double> values;
+    if (name == "--orders" && is_valid) {
+      is_valid = fdtd1d::ParseNumberList(value, &values);
+      options->orders.clear();
+      for (double order : values) {
+        is_valid = is_valid && (order == 2 || order == 4);
+        options->orders.push_back(static_cast<int>(order));
+      }
+    } else if (name == "--epsilon" && is_valid) {
+      is_valid = fdtd1d::ParseNumberList(value, &options->epsilons);
+      for (double epsilon : options->epsilons) {
+        is_valid = is_valid && epsilon >= 1.0;
+      }
+    } else if (name == "--cells-per-wavelength" && is_valid) {
+      is_valid = fdtd1d::ParseNumberList(value,
+                                         &options->cells_per_wavelength);
+      for (double cells : options->cells_per_wavelength) {
+        is_valid = is_valid && cells >= 4.0;
+      }
+    } else if (name == "--stability-factor" && is_valid) {
+      options->stability_factor = std::stod(value);
+      is_valid = options->stability_factor > 0.0 &&
+                 options->stability_factor <= 1.0;
+    } else if (name == "--wavelengths" && is_valid) {
+      options->num_wavelengths = std::max(std::stod(value), 1.0);
+    } else if (name == "--throughput-nodes" && is_valid) {
+      options->throughput_nodes = std::max<IntNumber>(std::stoll(value), 64);
+    } else if (name == "--throughput-steps" && is_valid) {
+      options->throughput_steps = std::max<IntNumber>(std::stoll(value), 1);
+    } else if (name == "--threads" && is_valid) {
+      options->num_threads = std::max(std::stoi(value), 1);
+    } else if (name == "--output" && is_valid) {
+      options->output_file_name = value;
+    } else {
+      is_valid = false;
+    }
+    if (!is_valid) {
+      std::cerr << "unknown or invalid option: " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// the largest stable Courant number of the order
+double GetCourantLimit(const int order) {
+  return order == 4 ? 6.0 / 7.0 : 1.0;
+}
+
+// the discrete spatial derivative of exp(i*k*x) divided by i*exp(i*k*x),
+// with theta = k*dx
+double GetDiscreteWavenumber(const int order, const double theta) {
+  if (order == 4) {
+    return 2.0*(fdtd1d::kFourthOrderNearWeight*std::sin(theta / 2) -
+                fdtd1d::kFourthOrderFarWeight*std::sin(3*theta / 2));
+  }
+  return 2.0*std::sin(theta / 2);
+}
+
+// v_numerical/v - 1 predicted by the dispersion relation for a wave of
+// cells_per_wavelength cells per wavelength at the Courant number courant
+// (v*dt/dx)
+double GetAnalyticError(const int order, const double cells_per_wavelength,
+                        const double courant) {
+  const double theta_exact = 2*kPi / cells_per_wavelength;
+  const double target = 2.0*std::sin(theta_exact*courant / 2) / courant;
+  // the discrete wavenumber increases on [0, pi]
+  double low = 0.0;
+  double high = kPi;
+  for (int i = 0; i < 200; ++i) {
+    double middle = (low + high) / 2;
+    if (GetDiscreteWavenumber(order, middle) < target) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+  return theta_exact / ((low + high) / 2) - 1.0;
+}
+
+// the numerical wavenumber times dx from the phase of the DFT monitor in
+// file_name. Returns a negative value if the file can not be read.
+double ReadNumericalWavenumber(const std::string& file_name) {
+  std::ifstream ifs(file_name);
+  std::string line;
+  if (!std::getline(ifs, line)) {
+    return -1.0;
+  }
+  std::vector<double> xs;
+  std::vector<double> phases;
+  while (std::getline(ifs, line)) {
+    std::vector<double> values;
+    if (!fdtd1d::ParseNumberList(line, &values) || values.size() != 5) {
+      return -1.0;
+    }
+    double phase = std::atan2(values[4], values[3]);
+    // unwraps the phase along x
+    if (!phases.empty()) {
+      while (phase - phases.back() > kPi) {
+        phase -= 2*kPi;
+      }
+      while (phase - phases.back() < -kPi) {
+        phase += 2*kPi;
+      }
+    }
+    xs.push_back(values[1]);
+    phases.push_back(phase);
+  }
+  if (xs.size() < 2) {
+    return -1.0;
+  }
+  // least squares slope of the phase, the grid spacing is 1
+  double x_mean = 0.0;
+  double phase_mean = 0.0;
+  for (std::size_t j = 0; j < xs.size(); ++j) {
+    x_mean += xs[j] / xs.size();
+    phase_mean += phases[j] / phases.size();
+  }
+  double covariance = 0.0;
+  double variance = 0.0;
+  for (std::size_t j = 0; j < xs.size(); ++j) {
+    covariance += (xs[j] - x_mean)*(phases[j] - phase_mean);
+    variance += (xs[j] - x_mean)*(xs[j] - x_mean);
+  }
+  return std::abs(covariance / variance);
+}
+
+// v_numerical/v - 1 measured on a grid of unit spacing filled with the
+// permittivity epsilon
+double MeasurePhaseVelocityError(const int order, const double epsilon,
+                                 const double cells_per_wavelength,
+                                 const BenchmarkOptions& options) {
+  const double speed = 1.0 / std::sqrt(epsilon);
+  const double frequency = speed / cells_per_wavelength;
+  // a pulse of a few periods, switched on and off smoothly
+  const double t_decay = 3.0 / frequency;
+  const double t_center = 6*t_decay;
+  // the pulse spreads over 2*t_center*speed cells. On the coarse grids its
+  // group velocity is well below the speed of light in the medium with the
+  // second order stencils and above it with the fourth order stencils, so
+  // the run lasts until a pulse twice slower has crossed the monitored
+  // nodes, and the walls are far enough for the reflections of a pulse twice
+  // faster to reach the monitored nodes after the end of the run.
+  const double margin = 2*t_center*speed + 2*cells_per_wavelength;
+  const double distance = (options.num_wavelengths + 2)*cells_per_wavelength;
+  const double x_source = margin + 2*distance;
+  const double x_begin = x_source + 2*cells_per_wavelength;
+  const double x_end = x_source + distance;
+  const double x_wall = x_end + margin + 1.5*distance;
+
+  fdtd1d::FDTD1D<double> fdtd;
+  fdtd.SetXAxisRangeAndGridSpacing(0.0, std::ceil(x_wall), 1.0);
+  fdtd.SetSpatialOrder(order);
+  fdtd.InitializeAndResetEMFieldArrays();
+  fdtd.SetStabilityFactorAndTimeResolution(options.stability_factor);
+  fdtd.SetSimulationTime(2*t_center + 2*distance / speed);
+  fdtd.SetNumberOfThreads(1);
+  fdtd1d::MaterialRegion medium;
+  medium.x_begin = 0.0;
+  medium.x_end = std::ceil(x_wall) + 1.0;
+  medium.begin.epsilon_r = epsilon;
+  fdtd1d::DFTMonitorRegion monitor;
+  monitor.x_begin = x_begin;
+  monitor.x_end = x_end;
+  monitor.f_min = frequency;
+  monitor.f_max = frequency;
+  const std::string file_prefix = "dispersion_benchmark_monitor";
+
+  // the messages of the solver are not part of the output
+  std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+  double k_dx = -1.0;
+  if (fdtd.SetMaterials({medium}) && fdtd.SetMonitors({}, {monitor})) {
+    fdtd.InsertModulatedGaussianPointSource(x_source, 1.0, t_center, t_decay,
+                                            frequency, 0.0);
+    fdtd.CreateThreadsAndRun();
+    if (fdtd.WriteMonitors(file_prefix)) {
+      k_dx = ReadNumericalWavenumber(file_prefix + "_dft.csv");
+    }
+    std::remove((file_prefix + "_dft.csv").c_str());
+  }
+  std::cout.rdbuf(cout_buffer);
+  std::cout.clear();
+  if (k_dx <= 0.0) {
+    return 0.0;
+  }
+  return (2*kPi / cells_per_wavelength) / k_dx - 1.0;
+}
+
+// the best time of an E and H node update in vacuum, in nanoseconds
+double MeasureNodeUpdateTime(const int order,
+                             const BenchmarkOptions& options) {
+  double best_time = 0.0;
+  for (int rep = 0; rep < kNumThroughputRepetitions; ++rep) {
+    fdtd1d::FDTD1D<double> fdtd;
+    fdtd.SetXAxisRangeAndGridSpacing(
+        0.0, static_cast<double>(options.throughput_nodes), 1.0);
+    fdtd.SetSpatialOrder(order);
+    fdtd.SetMemoryPlacement(true, false);
+    fdtd.InitializeAndResetEMFieldArrays();
+    fdtd.SetStabilityFactorAndTimeResolution(options.stability_factor);
+    const double dt = options.stability_factor*GetCourantLimit(order);
+    fdtd.SetSimulationTime((options.throughput_steps + 0.5)*dt);
+    fdtd.SetNumberOfThreads(options.num_threads);
+    fdtd.SetActiveRegionTracking(false);
+    fdtd.InsertGaussianPointSource(options.throughput_nodes / 2.0, 1.0,
+                                   20*dt, 5*dt);
+
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    auto t_start = std::chrono::steady_clock::now();
+    fdtd.CreateThreadsAndRun();
+    std::chrono::duration<double> time_span(
+        std::chrono::steady_clock::now() - t_start);
+    std::cout.rdbuf(cout_buffer);
+    std::cout.clear();
+
+    double time = time_span.count()*1.0e9 /
+                  (static_cast<double>(fdtd.get_num_x())*fdtd.get_num_t());
+    if (rep == 0 || time < best_time) {
+      best_time = time;
+    }
+  }
+  return best_time;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions options;
+  if (!ParseOptions(argc, argv, &options)) {
+    return 1;
+  }
+
+  std::map<int, double> node_update_time;
+  for (int order : options.orders) {
+    node_update_time[order] = MeasureNodeUpdateTime(order, options);
+    std::cerr << "order " << order << " : " << node_update_time[order]
+              << " ns per node update" << std::endl;
+  }
+
+  std::ofstream ofs;
+  if (!options.output_file_name.empty()) {
+    ofs.open(options.output_file_name);
+    if (!ofs) {
+      std::cerr << "Can not open " << options.output_file_name << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& out = options.output_file_name.empty() ? std::cout : ofs;
+  out << "order, epsilon_r, cells_per_wavelength, courant_number, "
+      << "phase_velocity_error, analytic_error, ns_per_node_update, "
+      << "ns_per_wavelength_period" << std::endl;
+  for (double epsilon : options.epsilons) {
+    for (double cells : options.cells_per_wavelength) {
+      for (int order : options.orders) {
+        const double stability =
+            options.stability_factor*GetCourantLimit(order);
+        const double courant = stability / std::sqrt(epsilon);
+        const double error = MeasurePhaseVelocityError(order, epsilon, cells,
+                                                       options);
+        const double node_updates = cells*cells*std::sqrt(epsilon) /
+                                    stability;
+        out << order << ", " << epsilon << ", " << cells << ", " << courant
+            << ", " << error << ", "
+            << GetAnalyticError(order, cells, courant) << ", "
+            << node_update_time[order] << ", "
+            << node_updates*node_update_time[order] << std::endl;
+      }
+    }
+  }
+  return 0;
+}
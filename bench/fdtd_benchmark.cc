@@ -0,0 +1,443 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Measures the throughput of the FDTD1D time stepping over a sweep of grid
+// sizes (from cache resident grids to grids of several GB), thread counts,
+// precisions, kernels and synchronization modes, and compares it with the
+// memory bandwidth measured by a STREAM triad on the same threads.
+//
+// usage: ./fdtd_benchmark [--option=value ...]
+// options:
+//   --max-threads=N       largest number of threads (default the number of
+//                         hardware threads). The thread counts are the powers
+//                         of two up to N, and N.
+//   --min-nodes=N         smallest grid (default 4096 nodes)
+//   --max-bytes=N         largest size of the E and H arrays in bytes (default
+//                         a quarter of the physical memory, at most 4 GiB).
+//                         The grid size doubles from --min-nodes up to it.
+//   --precisions=LIST     subset of double,float,mixed (default all)
+//   --kernels=LIST        subset of scalar,sse2,avx2,avx512 (default all the
+//                         kernels supported by the processor)
+//   --sync=LIST           subset of hybrid,spin (default both)
+//   --node-updates=N      E node updates per run, which sets the number of
+//                         time steps (at least 16) of each grid (default 2e8)
+//   --affinity=none|compact|scatter|LIST
+//                         pinning of the threads (default compact)
+//   --huge-pages          backs the fields by transparent huge pages
+//   --output=FILE         writes the results to FILE instead of the standard
+//                         output
+//
+// The fields are placed by first touch and the active region tracking is off,
+// so every node is updated at every time step. The output has one CSV line
+// per run:
+//   precision, kernel, sync, threads, num_x, num_t, field_bytes, seconds,
+//   mnode_updates_per_s, bandwidth_gbps, stream_gbps, roofline_fraction,
+//   strong_efficiency, weak_efficiency
+// bandwidth_gbps is the minimum traffic of the updates (each E or H node
+// update loads the E and H nodes and stores one of them) and
+// roofline_fraction is bandwidth_gbps / stream_gbps, which exceeds 1 for the
+// grids that fit in the cache. strong_efficiency is the speedup over 1 thread
+// on the same grid divided by the number of threads, and weak_efficiency
+// compares p threads on p times the nodes with 1 thread. They are empty when
+// the reference run is not part of the sweep.
+
+#include <unistd.h>     // sysconf
+
+#include <algorithm>    // std::min, std::max, std::find
+#include <chrono>       // chrono::steady_clock, chrono::duration
+#include <fstream>      // std::ofstream
+#include <iostream>     // std::cout, std::cerr
+#include <map>          // std::map
+#include <sstream>      // std::stringstream
+#include <string>       // std::string, std::stod
+#include <thread>       // std::thread
+#include <tuple>        // std::tuple
+#include <vector>       // std::vector
+
+#include "aligned_memory.h"
+#include "fdtd1d.h"
+#include "number_types.h"
+#include "thread_affinity.h"
+#include "thread_barrier.h"
+#include "yee_kernels.h"
+
+namespace {
+
+using fdtd1d::IntNumber;
+
+constexpr IntNumber kMinTimeSteps = 16;
+constexpr int kNumStreamRepetitions = 8;
+
+struct BenchmarkOptions {
+  int max_threads = 1;
+  IntNumber min_nodes = 4096;
+  IntNumber max_bytes = 0;
+  std::vector<fdtd1d::Precision> precisions = {fdtd1d::Precision::kDouble,
+                                               fdtd1d::Precision::kFloat,
+                                               fdtd1d::Precision::kMixed};
+  std::vector<fdtd1d::KernelType> kernels;
+  std::vector<fdtd1d::BarrierMode> sync_modes = {fdtd1d::BarrierMode::kHybrid,
+                                                 fdtd1d::BarrierMode::kSpin};
+  double node_updates = 2.0e8;
+  fdtd1d::AffinityPolicy affinity = fdtd1d::AffinityPolicy::kCompact;
+  std::vector<int> affinity_cpus;
+  bool huge_pages = false;
+  std::string output_file_name;
+};
+
+// the configuration and the timing of one run
+struct BenchmarkResult {
+  fdtd1d::Precision precision;
+  fdtd1d::KernelType kernel;
+  fdtd1d::BarrierMode sync_mode;
+  int num_threads;
+  IntNumber num_x;
+  IntNumber num_t;
+  IntNumber field_bytes;
+  double seconds;
+};
+
+std::vector<std::string> SplitList(const std::string& list) {
+  std::vector<std::string> items;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    items.push_back(item);
+  }
+  return items;
+}
+
+// returns false if an option is not recognized
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    std::string name = arg.substr(0, arg.find('='));
+    std::string value = arg.find('=') == std::string::npos ?
+                        std::string() : arg.substr(arg.find('=') + 1);
+    bool is_valid = !value.empty();
+    if (name == "--max-threads" && is_valid) {
+      options->max_threads = std::max(std::stoi(value), 1);
+    } else if (name == "--min-nodes" && is_valid) {
+      options->min_nodes = std::max<IntNumber>(std::stoll(value), 16);
+    } else if (name == "--max-bytes" && is_valid) {
+      options->max_bytes = static_cast<IntNumber>(std::stod(value));
+    } else if (name == "--node-updates" && is_valid) {
+      options->node_updates = std::stod(value);
+    } else if (name == "--output" && is_valid) {
+      options->output_file_name = value;
+    } else if (name == "--huge-pages" && value.empty()) {
+      options->huge_pages = true;
+    } else if (name == "--affinity" && is_valid) {
+      is_valid = fdtd1d::ParseAffinityPolicy(value, &options->affinity,
+                                             &options->affinity_cpus);
+    } else if (name == "--precisions" && is_valid) {
+      options->precisions.clear();
+      for (auto& item : SplitList(value)) {
+        fdtd1d::Precision precision;
+        is_valid = is_valid && fdtd1d::ParsePrecision(item, &precision);
+        options->precisions.push_back(precision);
+      }
+    } else if (name == "--kernels" && is_valid) {
+      options->kernels.clear();
+      for (auto& item : SplitList(value)) {
+        fdtd1d::KernelType kernel;
+        is_valid = is_valid && fdtd1d::ParseKernelType(item, &kernel) &&
+                   kernel != fdtd1d::KernelType::kAuto &&
+                   fdtd1d::IsKernelSupported(kernel);
+        options->kernels.push_back(kernel);
+      }
+    } else if (name == "--sync" && is_valid) {
+      options->sync_modes.clear();
+      for (auto& item : SplitList(value)) {
+        fdtd1d::BarrierMode mode;
+        is_valid = is_valid && fdtd1d::ParseBarrierMode(item, &mode);
+        options->sync_modes.push_back(mode);
+      }
+    } else {
+      is_valid = false;
+    }
+    if (!is_valid) {
+      std::cerr << "unknown, invalid or unsupported option: " << arg
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<int> GetThreadCounts(const int max_threads) {
+  std::vector<int> thread_counts;
+  for (int num_threads = 1; num_threads < max_threads; num_threads *= 2) {
+    thread_counts.push_back(num_threads);
+  }
+  thread_counts.push_back(max_threads);
+  return thread_counts;
+}
+
+// the best bandwidth of the triad a[i] = b[i] + s*c[i] on num_threads pinned
+// threads, in bytes per second. Each thread initializes its own part of the
+// arrays, as the solver does with first touch.
+double MeasureStreamBandwidth(const int num_threads,
+                              const IntNumber num_elements,
+                              const BenchmarkOptions& options) {
+  auto a = fdtd1d::AllocateAlignedArray<double>(num_elements);
+  auto b = fdtd1d::AllocateAlignedArray<double>(num_elements);
+  auto c = fdtd1d::AllocateAlignedArray<double>(num_elements);
+  std::vector<int> cpus = fdtd1d::GetThreadCpus(options.affinity, num_threads,
+                                                options.affinity_cpus);
+  fdtd1d::ThreadBarrier barrier;
+  barrier.Reset(num_threads, fdtd1d::BarrierMode::kSpin);
+  std::vector<std::chrono::steady_clock::time_point> times(
+      kNumStreamRepetitions + 1);
+
+  auto worker = [&](const int thread_index) {
+    if (!cpus.empty()) {
+      fdtd1d::PinCurrentThreadToCpu(cpus[thread_index]);
+    }
+    IntNumber begin = num_elements*thread_index / num_threads;
+    IntNumber end = num_elements*(thread_index + 1) / num_threads;
+    for (IntNumber i = begin; i < end; ++i) {
+      a[i] = 0.0;
+      b[i] = 1.0;
+      c[i] = 2.0;
+    }
+    const double s = 3.0;
+    for (int rep = 0; rep <= kNumStreamRepetitions; ++rep) {
+      barrier.Wait(thread_index, [&times, rep] {
+        times[rep] = std::chrono::steady_clock::now();
+      });
+      if (rep == kNumStreamRepetitions) {
+        break;
+      }
+      double* a_data = a.get();
+      const double* b_data = b.get();
+      const double* c_data = c.get();
+      for (IntNumber i = begin; i < end; ++i) {
+        a_data[i] = b_data[i] + s*c_data[i];
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  double best_time = 0.0;
+  for (int rep = 0; rep < kNumStreamRepetitions; ++rep) {
+    std::chrono::duration<double> time_span(times[rep + 1] - times[rep]);
+    if (rep == 0 || time_span.count() < best_time) {
+      best_time = time_span.count();
+    }
+  }
+  return 3.0 * sizeof(double) * num_elements / best_time;
+}
+
+template <typename Real, typename SourceReal>
+BenchmarkResult RunFDTD(const fdtd1d::KernelType kernel,
+                        const fdtd1d::BarrierMode sync_mode,
+                        const int num_threads, const IntNumber num_x,
+                        const IntNumber num_t,
+                        const BenchmarkOptions& options) {
+  fdtd1d::FDTD1D<Real, SourceReal> fdtd;
+  fdtd.SetXAxisRangeAndGridSpacing(SourceReal(0), SourceReal(num_x),
+                                   SourceReal(1));
+  fdtd.SetMemoryPlacement(true, options.huge_pages);
+  fdtd.InitializeAndResetEMFieldArrays();
+  SourceReal stability_factor(0.99);
+  fdtd.SetStabilityFactorAndTimeResolution(stability_factor);
+  SourceReal dt = stability_factor /
+                  fdtd1d::PhysicalConstants<SourceReal>::c;
+  fdtd.SetSimulationTime((num_t + SourceReal(0.5))*dt);
+  fdtd.SetNumberOfThreads(num_threads);
+  fdtd.SetSynchronizationMode(sync_mode);
+  fdtd.SetActiveRegionTracking(false);
+  fdtd.SetKernelType(kernel);
+  fdtd.SetThreadAffinity(options.affinity, options.affinity_cpus);
+  fdtd.InsertGaussianPointSource(SourceReal(num_x / 2), SourceReal(1),
+                                 20*dt, 5*dt);
+
+  // the messages of the solver are not part of the output
+  std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+  auto t_start = std::chrono::steady_clock::now();
+  fdtd.CreateThreadsAndRun();
+  std::chrono::duration<double> time_span(
+      std::chrono::steady_clock::now() - t_start);
+  std::cout.rdbuf(cout_buffer);
+  std::cout.clear();
+
+  BenchmarkResult result;
+  result.kernel = kernel;
+  result.sync_mode = sync_mode;
+  result.num_threads = num_threads;
+  result.num_x = fdtd.get_num_x();
+  result.num_t = fdtd.get_num_t();
+  result.field_bytes = 2*sizeof(Real)*result.num_x;
+  result.seconds = time_span.count();
+  return result;
+}
+
+BenchmarkResult RunFDTD(const fdtd1d::Precision precision,
+                        const fdtd1d::KernelType kernel,
+                        const fdtd1d::BarrierMode sync_mode,
+                        const int num_threads, const IntNumber num_x,
+                        const IntNumber num_t,
+                        const BenchmarkOptions& options) {
+  BenchmarkResult result;
+  switch (precision) {
+    case fdtd1d::Precision::kDouble:
+      result = RunFDTD<double, double>(kernel, sync_mode, num_threads, num_x,
+                                       num_t, options);
+      break;
+    case fdtd1d::Precision::kFloat:
+      result = RunFDTD<float, float>(kernel, sync_mode, num_threads, num_x,
+                                     num_t, options);
+      break;
+    case fdtd1d::Precision::kMixed:
+      result = RunFDTD<float, double>(kernel, sync_mode, num_threads, num_x,
+                                      num_t, options);
+      break;
+  }
+  result.precision = precision;
+  return result;
+}
+
+int GetRealSize(const fdtd1d::Precision precision) {
+  return precision == fdtd1d::Precision::kDouble ? sizeof(double) :
+                                                   sizeof(float);
+}
+
+IntNumber GetDefaultMaxBytes() {
+  IntNumber max_bytes = IntNumber(1) << 32;
+  long num_pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGESIZE);
+  if (num_pages > 0 && page_size > 0) {
+    max_bytes = std::min<IntNumber>(max_bytes,
+        static_cast<IntNumber>(num_pages) * page_size / 4);
+  }
+  return max_bytes;
+}
+
+// the elements of each array of the STREAM triad: 4 times the last level
+// cache, as required by STREAM, within the memory limit of the sweep
+IntNumber GetStreamArraySize(const IntNumber max_bytes) {
+  long cache_size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  cache_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+  if (cache_size <= 0) {
+    cache_size = 32L << 20;
+  }
+  IntNumber num_elements = std::max<IntNumber>(4*cache_size / sizeof(double),
+                                               IntNumber(1) << 22);
+  return std::min<IntNumber>(num_elements,
+                             std::max<IntNumber>(max_bytes / 24, 1 << 16));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkOptions options;
+  options.max_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  options.max_bytes = GetDefaultMaxBytes();
+  for (auto kernel : {fdtd1d::KernelType::kScalar, fdtd1d::KernelType::kSSE2,
+                      fdtd1d::KernelType::kAVX2, fdtd1d::KernelType::kAVX512}) {
+    if (fdtd1d::IsKernelSupported(kernel)) {
+      options.kernels.push_back(kernel);
+    }
+  }
+  if (!ParseOptions(argc, argv, &options)) {
+    return 1;
+  }
+  std::vector<int> thread_counts = GetThreadCounts(options.max_threads);
+
+  // the roofline of each thread count
+  IntNumber stream_size = GetStreamArraySize(options.max_bytes);
+  std::map<int, double> stream_bandwidth;
+  for (int num_threads : thread_counts) {
+    stream_bandwidth[num_threads] =
+        MeasureStreamBandwidth(num_threads, stream_size, options);
+    std::cerr << "stream triad, " << num_threads << " threads : "
+              << stream_bandwidth[num_threads]*1.0e-9 << " GB/s" << std::endl;
+  }
+
+  std::vector<BenchmarkResult> results;
+  for (auto precision : options.precisions) {
+    for (auto kernel : options.kernels) {
+      for (auto sync_mode : options.sync_modes) {
+        for (IntNumber num_x = options.min_nodes;
+             2*GetRealSize(precision)*num_x <= options.max_bytes;
+             num_x *= 2) {
+          IntNumber num_t = std::max<IntNumber>(
+              static_cast<IntNumber>(options.node_updates / num_x),
+              kMinTimeSteps);
+          for (int num_threads : thread_counts) {
+            results.push_back(RunFDTD(precision, kernel, sync_mode,
+                                      num_threads, num_x, num_t, options));
+            const BenchmarkResult& result = results.back();
+            std::cerr << fdtd1d::GetPrecisionName(precision) << ", "
+                      << fdtd1d::GetKernelTypeName(kernel) << ", "
+                      << fdtd1d::GetBarrierModeName(sync_mode) << ", "
+                      << num_threads << " threads, " << result.num_x
+                      << " nodes : " << result.seconds << " s" << std::endl;
+          }
+        }
+      }
+    }
+  }
+
+  // node updates per second of each run, to find the reference runs of the
+  // scaling efficiencies
+  using RunKey = std::tuple<int, int, int, int, IntNumber>;
+  auto GetKey = [](const BenchmarkResult& result, const int num_threads,
+                   const IntNumber num_x) {
+    return RunKey(static_cast<int>(result.precision),
+                  static_cast<int>(result.kernel),
+                  static_cast<int>(result.sync_mode), num_threads, num_x);
+  };
+  auto GetRate = [](const BenchmarkResult& result) {
+    return result.num_x * static_cast<double>(result.num_t) / result.seconds;
+  };
+  std::map<RunKey, double> rates;
+  for (auto& result : results) {
+    rates[GetKey(result, result.num_threads, result.num_x)] = GetRate(result);
+  }
+
+  std::ofstream output_file;
+  if (!options.output_file_name.empty()) {
+    output_file.open(options.output_file_name);
+  }
+  std::ostream& os = options.output_file_name.empty() ? std::cout :
+                                                         output_file;
+  os << "precision,kernel,sync,threads,num_x,num_t,field_bytes,seconds,"
+     << "mnode_updates_per_s,bandwidth_gbps,stream_gbps,roofline_fraction,"
+     << "strong_efficiency,weak_efficiency" << std::endl;
+  for (auto& result : results) {
+    double rate = GetRate(result);
+    double bandwidth = 6.0 * GetRealSize(result.precision) * rate;
+    double stream = stream_bandwidth[result.num_threads];
+    os << fdtd1d::GetPrecisionName(result.precision) << ","
+       << fdtd1d::GetKernelTypeName(result.kernel) << ","
+       << fdtd1d::GetBarrierModeName(result.sync_mode) << ","
+       << result.num_threads << "," << result.num_x << "," << result.num_t
+       << "," << result.field_bytes << "," << result.seconds << ","
+       << rate*1.0e-6 << "," << bandwidth*1.0e-9 << "," << stream*1.0e-9
+       << "," << bandwidth / stream << ",";
+    auto strong = rates.find(GetKey(result, 1, result.num_x));
+    if (strong != rates.end()) {
+      os << rate / (result.num_threads * strong->second);
+    }
+    os << ",";
+    auto weak = rates.end();
+    if (result.num_x % result.num_threads == 0) {
+      weak = rates.find(GetKey(result, 1, result.num_x / result.num_threads));
+    }
+    if (weak != rates.end()) {
+      os << rate / (result.num_threads * weak->second);
+    }
+    os << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+import os
+import sys
+import time
+import mmap
+import numpy as np
+
+# usage: python3 liveView.py [NAME]
+# Plots the E field published by fdtd1d --live=NAME (default /fdtd1d-live)
+# while the solver runs. The shared memory segment is described in
+# src/live_frames.h: a ring of frames that the solver overwrites without
+# waiting for the readers, each frame with a sequence lock. The segment is
+# mapped with numpy, so LiveFrames.view(k) is the frame k in place (zero
+# copy), and LiveFrames.read(k) copies it and checks that the solver did not
+# overwrite it during the copy. The sequence numbers rely on the ordering of
+# the stores of x86 processors, the values read in place are not checked.
+
+HEADER_SIZE = 4096
+SLOT_HEADER_SIZE = 64
+HEADER_TYPE = np.dtype({
+    'names': ['magic', 'version', 'num_slots', 'slot_size', 'real_size',
+              'num_values', 'space_stride', 'time_stride', 'num_x', 'num_t',
+              'x0', 'dx', 'dt', 'num_frames', 'is_finished'],
+    'formats': ['S8', '<u4', '<i8', '<i8', '<u4', '<i8', '<i8', '<i8', '<i8',
+                '<i8', '<f8', '<f8', '<f8', '<i8', '<i8'],
+    'offsets': [0, 8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88, 96, 128, 136],
+    'itemsize': HEADER_SIZE})
+
+
+class TornFrame(Exception):
+  """The frame was overwritten by the solver while it was read."""
+
+
+class LiveFrames:
+  """The frames published by a running solver. The frame k exists while
+  oldest() <= k < len(self), x holds the positions of its values."""
+
+  def __init__(self, name='/fdtd1d-live', timeout=10.0):
+    path = '/dev/shm/' + name.lstrip('/')
+    deadline = time.monotonic() + timeout
+    while True:
+      try:
+        with open(path, 'rb') as f:
+          self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.header = np.ndarray((), dtype=HEADER_TYPE, buffer=self.data)
+        if self.header['magic'] == b'FDTD1DLV':
+          break
+      except (FileNotFoundError, ValueError):
+        pass
+      if time.monotonic() > deadline:
+        raise TimeoutError('no fdtd1d live frames in ' + path)
+      time.sleep(0.05)
+
+    self.num_slots = int(self.header['num_slots'])
+    self.num_values = int(self.header['num_values'])
+    self.real_type = np.dtype('<f4' if self.header['real_size'] == 4
+                              else '<f8')
+    slot_type = np.dtype({
+        'names': ['sequence', 'ind_t', 'time', 'E'],
+        'formats': ['<u8', '<i8', '<f8', (self.real_type, (self.num_values,))],
+        'offsets': [0, 8, 16, SLOT_HEADER_SIZE],
+        'itemsize': int(self.header['slot_size'])})
+    self.slots = np.ndarray((self.num_slots,), dtype=slot_type,
+                            buffer=self.data, offset=HEADER_SIZE)
+    self.x = (self.header['x0'] + self.header['dx']*
+              self.header['space_stride']*np.arange(self.num_values))
+
+  def __len__(self):
+    return int(self.header['num_frames'])
+
+  def oldest(self):
+    return max(len(self) - self.num_slots + 1, 0)
+
+  def is_finished(self):
+    return bool(self.header['is_finished'])
+
+  def view(self, k):
+    """The values of the frame k in the segment, without any check."""
+    return self.slots[k % self.num_slots]['E']
+
+  def read(self, k):
+    """(time step, time, copy of the values) of the frame k. Raises
+    TornFrame if the frame is not complete or was overwritten."""
+    slot = self.slots[k % self.num_slots]
+    sequence = int(slot['sequence'])
+    if sequence != 2*k + 2:
+      raise TornFrame(k)
+    ind_t, t, values = int(slot['ind_t']), float(slot['time']), slot['E'].copy()
+    if int(slot['sequence']) != sequence:
+      raise TornFrame(k)
+    return ind_t, t, values
+
+  def latest(self):
+    """The last complete frame as (frame, time step, time, values), None if
+    no frame was published yet."""
+    while len(self) > 0:
+      k = len(self) - 1
+      try:
+        return (k,) + self.read(k)
+      except TornFrame:
+        pass
+    return None
+
+  def follow(self, poll_interval=0.01):
+    """Yields the frames as (frame, time step, time, values) as they are
+    published, until the run is finished. The frames the solver overwrote
+    before they were read are skipped."""
+    k = 0
+    while True:
+      finished = self.is_finished()
+      while k < len(self):
+        k = max(k, self.oldest())
+        try:
+          yield (k,) + self.read(k)
+        except TornFrame:
+          pass
+        k += 1
+      if finished:
+        return
+      time.sleep(poll_interval)
+
+
+if __name__ == '__main__':
+  from matplotlib import pyplot as plt
+
+  name = sys.argv[1] if len(sys.argv) > 1 else '/fdtd1d-live'
+  frames = LiveFrames(name)
+  print("Grid points : ", frames.num_values, ", slots : ", frames.num_slots)
+
+  plt.ion()
+  figure, axes = plt.subplots()
+  line, = axes.plot(frames.x, np.zeros(frames.num_values), 'b')
+  axes.set_xlabel('x')
+  axes.set_ylabel('E')
+  k_shown = -1
+  while not (frames.is_finished() and k_shown == len(frames) - 1):
+    latest = frames.latest()
+    if latest is not None and latest[0] != k_shown:
+      k_shown, ind_t, t, values = latest
+      line.set_ydata(values)
+      axes.relim()
+      axes.autoscale_view()
+      axes.set_title('time step %d, t = %g' % (ind_t, t))
+    plt.pause(0.05)
+  plt.ioff()
+  plt.show()
@@ -1,20 +1,146 @@
 
+import sys
 import numpy as np
-from matplotlib import pyplot as plt
 import time
 
-E = np.genfromtxt('output.csv', delimiter=',')
+# usage: python3 plotOutput.py [FILE]
+# FILE is the output of fdtd1d in the csv (default output.csv), raw or chunked
+# format. The binary formats are described in src/field_writer.h. They are
+# mapped to memory with numpy.memmap, so that opening a large file does not 
+# read it, and the snapshots of the chunked format are decoded one chunk at a
+# time when they are accessed.
 
-print("E.shape : ", E.shape)
-Nt = E.shape[0]
+HEADER_SIZE = 4096
+HEADER_TYPE = np.dtype([('magic', 'S8'), ('version', '<i4'), 
+                        ('real_size', '<i4'), ('num_e_values', '<i8'),
+                        ('num_h_values', '<i8'), ('time_stride', '<i8'),
+                        ('space_stride', '<i8'), ('x0', '<f8'), ('x1', '<f8'),
+                        ('dx', '<f8'), ('dt', '<f8'), ('t_final', '<f8'), 
+                        ('num_x', '<i8'), ('num_t', '<i8'), 
+                        ('num_snapshots', '<i8'), ('steps_per_chunk', '<i8'),
+                        ('num_chunks', '<i8'), ('index_offset', '<i8')])
 
-plt.ion()
-plt.figure()
-for i in range(Nt):
-  plt.plot(E[i,:], 'b')
-  plt.pause(0.05)
-  plt.clf()
-  
-plt.show()
+class FieldHistory:
+  """The snapshots of a raw or chunked file. history[k] is the E field of the
+  k-th snapshot, history.get_h(k) its H field (if written) and 
+  history.get_time_index(k) its time step."""
 
+  def __init__(self, file_name):
+    self.data = np.memmap(file_name, dtype=np.uint8, mode='r')
+    self.header = np.frombuffer(self.data, dtype=HEADER_TYPE, count=1)[0]
+    self.magic = self.header['magic']
+    if self.magic not in (b'FDTD1DRB', b'FDTD1DCH'):
+      raise ValueError(file_name + ' is not an fdtd1d binary file')
+    self.real_type = np.dtype('<f4' if self.header['real_size'] == 4 
+                              else '<f8')
+    self.word_type = np.dtype('<u4' if self.header['real_size'] == 4 
+                              else '<u8')
+    self.num_e_values = int(self.header['num_e_values'])
+    self.num_h_values = int(self.header['num_h_values'])
+    self.x = (self.header['x0'] + self.header['dx']*
+              self.header['space_stride']*np.arange(self.num_e_values))
+
+    if self.magic == b'FDTD1DRB':
+      snapshot_type = np.dtype([('ind_t', '<i8'), 
+                                ('E', self.real_type, (self.num_e_values,)),
+                                ('H', self.real_type, (self.num_h_values,))])
+      # the number of snapshots is 0 if the run did not finish
+      num_snapshots = (self.data.size - HEADER_SIZE) // snapshot_type.itemsize
+      self.snapshots = np.ndarray((num_snapshots,), dtype=snapshot_type,
+                                  buffer=self.data, offset=HEADER_SIZE)
+      self.num_snapshots = num_snapshots
+    else:
+      self.num_snapshots = int(self.header['num_snapshots'])
+      self.steps_per_chunk = int(self.header['steps_per_chunk'])
+      self.index = np.frombuffer(self.data, dtype='<i8', 
+                                 count=2*int(self.header['num_chunks']), 
+                                 offset=int(self.header['index_offset']))
+      self.index = self.index.reshape(-1, 2)
+      self.decoded_chunk = -1
+
+  def __len__(self):
+    return self.num_snapshots
+
+  def __getitem__(self, k):
+    return self.get_snapshot(k)[1][:self.num_e_values]
+
+  def get_h(self, k):
+    return self.get_snapshot(k)[1][self.num_e_values:]
+
+  def get_time_index(self, k):
+    return self.get_snapshot(k)[0]
+
+  def get_snapshot(self, k):
+    if k < 0:
+      k += self.num_snapshots
+    if k < 0 or k >= self.num_snapshots:
+      raise IndexError('snapshot index out of range')
+    if self.magic == b'FDTD1DRB':
+      snapshot = self.snapshots[k]
+      return snapshot['ind_t'], np.concatenate((snapshot['E'], snapshot['H']))
+    chunk, k_in_chunk = divmod(k, self.steps_per_chunk)
+    if chunk != self.decoded_chunk:
+      self.time_indices, self.values = self.decode_chunk(chunk)
+      self.decoded_chunk = chunk
+    return self.time_indices[k_in_chunk], self.values[k_in_chunk]
+
+  def decode_chunk(self, chunk):
+    """Inverts EncodeFieldChunk (see src/field_chunk_codec.h)."""
+    offset, size = (int(v) for v in self.index[chunk])
+    chunk_data = self.data[offset:offset + size]
+    num_frames = min(self.steps_per_chunk, 
+                     self.num_snapshots - chunk*self.steps_per_chunk)
+    time_indices = np.frombuffer(chunk_data, dtype='<i8', count=num_frames)
+    position = 8*num_frames
+    num_frames, num_values, word_size = np.frombuffer(
+        chunk_data, dtype='<i8', count=3, offset=position)
+    position += 24
+    num_words = int(num_frames*num_values)
+    
+    word_bytes = np.empty((num_words, int(word_size)), dtype=np.uint8)
+    for b in range(word_size):
+      encoding, plane_size = np.frombuffer(chunk_data, dtype='<i8', count=2,
+                                           offset=position)
+      position += 16
+      plane = chunk_data[position:position + plane_size]
+      position += plane_size
+      if encoding == 0:
+        word_bytes[:, b] = plane
+      else:
+        bitmap_size = (num_words + 7) // 8
+        is_nonzero = np.unpackbits(plane[:bitmap_size], count=num_words,
+                                   bitorder='little').astype(bool)
+        word_bytes[:, b] = 0
+        word_bytes[is_nonzero, b] = plane[bitmap_size:]
+    
+    words = word_bytes.view(self.word_type).reshape(num_frames, num_values)
+    words = np.bitwise_xor.accumulate(words, axis=0)
+    return time_indices, words.view(self.real_type)
+
+
+def open_field_history(file_name):
+  with open(file_name, 'rb') as f:
+    magic = f.read(8)
+  if magic in (b'FDTD1DRB', b'FDTD1DCH'):
+    return FieldHistory(file_name)
+  return np.genfromtxt(file_name, delimiter=',')
+
+
+if __name__ == '__main__':
+  from matplotlib import pyplot as plt
+
+  file_name = sys.argv[1] if len(sys.argv) > 1 else 'output.csv'
+  E = open_field_history(file_name)
+
+  print("Number of snapshots : ", len(E))
+  Nt = len(E)
+
+  plt.ion()
+  plt.figure()
+  for i in range(Nt):
+    plt.plot(E[i], 'b')
+    plt.pause(0.05)
+    plt.clf()
+    
+  plt.show()
 
@@ -0,0 +1,120 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_ALIGNED_MEMORY_H_
+#define FDTD_ALIGNED_MEMORY_H_
+
+// Defines arrays whose first element is aligned to kMemoryAlignment bytes, so
+// that the vectorized kernels can use aligned loads and stores on them.
+// Large arrays can also be backed by transparent huge pages, which cuts the
+// TLB misses of the sweeps over the field arrays.
+
+#include <cstdlib>        // posix_memalign, free
+#include <memory>         // std::unique_ptr
+#include <new>            // std::bad_alloc
+
+#include <sys/mman.h>     // madvise
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+// the alignment of the field arrays (the size of an AVX-512 register and of a
+// cache line)
+constexpr std::size_t kMemoryAlignment = 64;
+
+// the size of a transparent huge page on x86-64
+constexpr std::size_t kHugePageSize = 1 << 21;
+
+struct AlignedDeleter {
+  void operator()(void* data) const {
+    free(data);
+  }
+};
+
+template <typename T>
+using AlignedArray = std::unique_ptr<T[], AlignedDeleter>;
+
+// allocates an uninitialized array of num_elements elements. alignment should
+// be a power of two multiple of sizeof(void*).
+template <typename T>
+AlignedArray<T> AllocateAlignedArray(
+    const IntNumber num_elements, 
+    const std::size_t alignment = kMemoryAlignment) {
+  void* data = nullptr;
+  std::size_t num_bytes = sizeof(T)*static_cast<std::size_t>(num_elements);
+  if (posix_memalign(&data, alignment,
+                     num_bytes > 0 ? num_bytes : alignment) != 0) {
+    throw std::bad_alloc();
+  }
+  return AlignedArray<T>(static_cast<T*>(data));
+}
+
+// destroys the objects of an array of AllocateAlignedObjectArray before
+// freeing it
+template <typename T>
+struct AlignedObjectDeleter {
+  IntNumber num_elements = 0;
+  void operator()(T* data) const {
+    for (IntNumber i = 0; i < num_elements; ++i) {
+      data[i].~T();
+    }
+    free(data);
+  }
+};
+
+template <typename T>
+using AlignedObjectArray = std::unique_ptr<T[], AlignedObjectDeleter<T>>;
+
+// allocates an array of num_elements value-initialized objects aligned to
+// alignof(T). new[] of C++14 ignores the alignment of the types declared
+// alignas(kCacheLineSize) (the per-thread flags and counters padded against
+// false sharing), which then straddle two cache lines.
+template <typename T>
+AlignedObjectArray<T> AllocateAlignedObjectArray(
+    const IntNumber num_elements) {
+  void* data = nullptr;
+  const std::size_t alignment = alignof(T) > sizeof(void*) ?
+                                alignof(T) : sizeof(void*);
+  std::size_t num_bytes = sizeof(T)*static_cast<std::size_t>(num_elements);
+  if (posix_memalign(&data, alignment,
+                     num_bytes > 0 ? num_bytes : alignment) != 0) {
+    throw std::bad_alloc();
+  }
+  T* objects = static_cast<T*>(data);
+  for (IntNumber i = 0; i < num_elements; ++i) {
+    new (objects + i) T();
+  }
+  return AlignedObjectArray<T>(objects, AlignedObjectDeleter<T>{num_elements});
+}
+
+// allocates an uninitialized array of num_elements elements aligned to, and
+// padded to a multiple of, kHugePageSize and asks the kernel to back it with 
+// transparent huge pages. The pages are not touched, so that each of them is 
+// placed on the NUMA node of the thread writing it first. uses_huge_pages is
+// set to false if huge pages are not available, the array is then backed by 
+// normal pages.
+template <typename T>
+AlignedArray<T> AllocateHugePageArray(const IntNumber num_elements,
+                                      bool* uses_huge_pages = nullptr) {
+  std::size_t num_bytes = sizeof(T)*static_cast<std::size_t>(num_elements);
+  num_bytes = (num_bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  void* data = nullptr;
+  if (posix_memalign(&data, kHugePageSize,
+                     num_bytes > 0 ? num_bytes : kHugePageSize) != 0) {
+    throw std::bad_alloc();
+  }
+  bool advised = false;
+#ifdef MADV_HUGEPAGE
+  advised = (num_bytes > 0 && madvise(data, num_bytes, MADV_HUGEPAGE) == 0);
+#endif
+  if (uses_huge_pages != nullptr) {
+    *uses_huge_pages = advised;
+  }
+  return AlignedArray<T>(static_cast<T*>(data));
+}
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_ALIGNED_MEMORY_H_
@@ -0,0 +1,152 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "buffered_file_output.h"
+
+#include <fcntl.h>        // open, fcntl, O_DIRECT
+#include <unistd.h>       // write, pwrite, close
+
+#include <algorithm>      // std::min
+#include <cstring>        // std::memcpy, std::memmove
+#include <iostream>       // std::cout
+
+namespace fdtd1d {
+
+constexpr std::size_t BufferedFileOutput::kBlockSize;
+constexpr std::size_t BufferedFileOutput::kStagingBufferSize;
+
+BufferedFileOutput::BufferedFileOutput() {}
+
+BufferedFileOutput::~BufferedFileOutput() {
+  Close();
+}
+
+bool BufferedFileOutput::Open(const std::string& file_name,
+                              const bool use_direct_io) {
+  Close();
+  file_name_ = file_name;
+  direct_io_ = false;
+#ifdef O_DIRECT
+  if (use_direct_io) {
+    file_descriptor_ = open(file_name.c_str(),
+                            O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    direct_io_ = (file_descriptor_ >= 0);
+    if (!direct_io_) {
+      std::cout << "Direct I/O is not available for " << file_name
+                << ", writing through the page cache." << std::endl;
+    }
+  }
+#endif
+  if (file_descriptor_ < 0) {
+    file_descriptor_ = open(file_name.c_str(),
+                            O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (file_descriptor_ < 0) {
+    std::cout << "Can not open " << file_name << std::endl;
+    return false;
+  }
+  if (staging_buffer_ == nullptr) {
+    staging_buffer_ = AllocateAlignedArray<char>(kStagingBufferSize,
+                                                 kBlockSize);
+  }
+  staged_size_ = 0;
+  bytes_written_ = 0;
+  finished_ = false;
+  return true;
+}
+
+void BufferedFileOutput::Write(const void* data, const std::size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  std::size_t remaining_size = size;
+  while (remaining_size > 0) {
+    std::size_t copy_size = std::min(remaining_size,
+                                     kStagingBufferSize - staged_size_);
+    std::memcpy(staging_buffer_.get() + staged_size_, bytes, copy_size);
+    staged_size_ += copy_size;
+    bytes += copy_size;
+    remaining_size -= copy_size;
+    if (staged_size_ == kStagingBufferSize) {
+      WriteStagingBuffer(kStagingBufferSize);
+      staged_size_ = 0;
+    }
+  }
+  bytes_written_ += size;
+}
+
+void BufferedFileOutput::WriteStagingBuffer(const std::size_t size) {
+  std::size_t offset = 0;
+  while (offset < size) {
+    ssize_t result = write(file_descriptor_, staging_buffer_.get() + offset,
+                           size - offset);
+    if (result <= 0) {
+      std::cout << "Error writing to " << file_name_ << std::endl;
+      return;
+    }
+    offset += result;
+  }
+}
+
+void BufferedFileOutput::Finish() {
+  if (file_descriptor_ < 0 || finished_) {
+    return;
+  }
+  // the whole blocks are written directly, then direct I/O is switched off to
+  // write the tail, whose size is not a multiple of the block size
+  std::size_t tail_begin = direct_io_ ?
+                           staged_size_ / kBlockSize * kBlockSize : 0;
+  if (tail_begin > 0) {
+    WriteStagingBuffer(tail_begin);
+  }
+#ifdef O_DIRECT
+  if (direct_io_) {
+    int flags = fcntl(file_descriptor_, F_GETFL);
+    fcntl(file_descriptor_, F_SETFL, flags & ~O_DIRECT);
+  }
+#endif
+  if (staged_size_ > tail_begin) {
+    std::memmove(staging_buffer_.get(), staging_buffer_.get() + tail_begin,
+                 staged_size_ - tail_begin);
+    WriteStagingBuffer(staged_size_ - tail_begin);
+  }
+  staged_size_ = 0;
+  finished_ = true;
+}
+
+void BufferedFileOutput::WriteAt(const IntNumber offset, const void* data,
+                                 const std::size_t size) {
+  Finish();
+  const char* bytes = static_cast<const char*>(data);
+  std::size_t written_size = 0;
+  while (written_size < size) {
+    ssize_t result = pwrite(file_descriptor_, bytes + written_size,
+                            size - written_size, offset + written_size);
+    if (result <= 0) {
+      std::cout << "Error writing to " << file_name_ << std::endl;
+      return;
+    }
+    written_size += result;
+  }
+}
+
+void BufferedFileOutput::Close() {
+  if (file_descriptor_ < 0) {
+    return;
+  }
+  Finish();
+  close(file_descriptor_);
+  file_descriptor_ = -1;
+}
+
+bool BufferedFileOutput::is_open() {
+  return file_descriptor_ >= 0;
+}
+
+bool BufferedFileOutput::is_direct_io() {
+  return direct_io_;
+}
+
+IntNumber BufferedFileOutput::get_bytes_written() {
+  return bytes_written_;
+}
+
+}  // namespace fdtd1d
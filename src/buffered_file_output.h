@@ -0,0 +1,74 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_BUFFERED_FILE_OUTPUT_H_
+#define FDTD_BUFFERED_FILE_OUTPUT_H_
+
+// Defines a sequential binary file writer that gathers the written bytes in a
+// large aligned staging buffer and passes them to the operating system in big
+// blocks. With direct I/O (O_DIRECT) the blocks bypass the page cache, which
+// keeps long field histories from evicting useful data from memory. If the
+// file system does not support direct I/O the file is written through the page
+// cache instead.
+
+#include <string>         // std::string
+#include <cstddef>        // std::size_t
+
+#include "aligned_memory.h"
+#include "number_types.h"
+
+namespace fdtd1d {
+
+class BufferedFileOutput {
+  public:
+  BufferedFileOutput();
+  ~BufferedFileOutput();
+
+  // opens (and truncates) file_name. Returns false if the file can not be
+  // opened.
+  bool Open(const std::string& file_name, const bool use_direct_io);
+
+  // appends size bytes to the file
+  void Write(const void* data, const std::size_t size);
+
+  // writes the remaining bytes of the staging buffer. After Finish() only
+  // WriteAt() and Close() may be called.
+  void Finish();
+
+  // overwrites size bytes at the given offset of a finished file, e.g. to
+  // complete a header whose content is only known at the end
+  void WriteAt(const IntNumber offset, const void* data,
+               const std::size_t size);
+
+  // finishes and closes the file
+  void Close();
+
+  bool is_open();
+  bool is_direct_io();
+
+  // the total number of bytes appended to the file
+  IntNumber get_bytes_written();
+
+  private:
+  // writes the first size bytes of the staging buffer to the file
+  void WriteStagingBuffer(const std::size_t size);
+
+  // the block size of direct I/O. The file offset, the size and the address
+  // of each direct write should be multiples of this size.
+  static constexpr std::size_t kBlockSize = 4096;
+  static constexpr std::size_t kStagingBufferSize = 1 << 22;
+
+  int file_descriptor_ = -1;
+  bool direct_io_ = false;
+  bool finished_ = false;
+  std::string file_name_;
+
+  AlignedArray<char> staging_buffer_ = nullptr;
+  std::size_t staged_size_ = 0;   // number of bytes in staging_buffer_
+  IntNumber bytes_written_ = 0;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_BUFFERED_FILE_OUTPUT_H_
@@ -0,0 +1,300 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "checkpoint.h"
+
+#include <fcntl.h>        // open, O_CREAT
+#include <sys/mman.h>     // mmap, msync, munmap
+#include <sys/stat.h>     // fstat
+#include <unistd.h>       // ftruncate, close
+
+#include <chrono>         // std::chrono::steady_clock
+#include <cstdio>         // std::rename, std::remove
+#include <cstring>        // std::memcpy, std::memcmp
+#include <iostream>       // std::cout
+
+namespace fdtd1d {
+
+namespace {
+
+const char kCheckpointMagic[8] = {'F', 'D', 'T', 'D', '1', 'D', 'C', 'K'};
+
+// the fields start on page boundaries
+constexpr std::uint64_t kCheckpointAlignment = 4096;
+
+std::uint64_t AlignUp(const std::uint64_t offset) {
+  return (offset + kCheckpointAlignment - 1) / kCheckpointAlignment *
+         kCheckpointAlignment;
+}
+
+double SecondsSince(const std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - t).count();
+}
+
+// the record preceding the position and the parameters of a source
+struct SourceRecord {
+  std::int32_t type;
+  std::int32_t num_parameters;
+};
+
+}  // namespace
+
+CheckpointWriter::~CheckpointWriter() {
+  Wait();
+  if (mapping_ != nullptr) {
+    // Begin without Submit: the checkpoint is incomplete
+    Finish(false);
+  }
+}
+
+bool CheckpointWriter::Begin(const std::string& file_name,
+                             CheckpointHeader* header,
+                             const std::vector<char>& sources,
+                             const std::vector<char>& auxiliary,
+                             void** e_field, void** h_field) {
+  auto t_wait = std::chrono::steady_clock::now();
+  Wait();
+  wait_time_ += SecondsSince(t_wait);
+
+  std::memcpy(header->magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+  header->version = kCheckpointVersion;
+  header->sources_offset = sizeof(CheckpointHeader);
+  header->sources_size = sources.size();
+  header->auxiliary_offset = header->sources_offset + sources.size();
+  header->auxiliary_size = auxiliary.size();
+  header->e_field_offset = AlignUp(header->auxiliary_offset +
+                                   auxiliary.size());
+  header->h_field_offset = AlignUp(header->e_field_offset +
+                                   header->num_x*header->real_size);
+  header->file_size = header->h_field_offset +
+                      (header->num_x - 1)*header->real_size;
+
+  file_name_ = file_name;
+  std::string temporary_name = file_name + ".tmp";
+  fd_ = open(temporary_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0 ||
+      ftruncate(fd_, static_cast<off_t>(header->file_size)) != 0) {
+    std::cout << "Can not create the checkpoint " << temporary_name
+              << std::endl;
+    Finish(false);
+    ++num_failures_;
+    return false;
+  }
+  mapping_size_ = header->file_size;
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fd_, 0);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    std::cout << "Can not map the checkpoint " << temporary_name << std::endl;
+    Finish(false);
+    ++num_failures_;
+    return false;
+  }
+  char* bytes = static_cast<char*>(mapping_);
+  std::memcpy(bytes, header, sizeof(CheckpointHeader));
+  if (!sources.empty()) {
+    std::memcpy(bytes + header->sources_offset, sources.data(),
+                sources.size());
+  }
+  if (!auxiliary.empty()) {
+    std::memcpy(bytes + header->auxiliary_offset, auxiliary.data(),
+                auxiliary.size());
+  }
+  *e_field = bytes + header->e_field_offset;
+  *h_field = bytes + header->h_field_offset;
+  return true;
+}
+
+void CheckpointWriter::Submit() {
+  if (mapping_ == nullptr) {
+    return;
+  }
+  flush_thread_ = std::thread([this] {
+    auto t_flush = std::chrono::steady_clock::now();
+    bool is_flushed = (msync(mapping_, mapping_size_, MS_SYNC) == 0);
+    Finish(is_flushed);
+    flush_time_ += SecondsSince(t_flush);
+    if (is_flushed) {
+      ++num_checkpoints_;
+    } else {
+      ++num_failures_;
+    }
+  });
+}
+
+void CheckpointWriter::Wait() {
+  if (flush_thread_.joinable()) {
+    flush_thread_.join();
+  }
+}
+
+void CheckpointWriter::Finish(const bool is_complete) {
+  if (mapping_ != nullptr) {
+    munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  std::string temporary_name = file_name_ + ".tmp";
+  if (is_complete) {
+    std::rename(temporary_name.c_str(), file_name_.c_str());
+  } else {
+    std::remove(temporary_name.c_str());
+  }
+}
+
+void CheckpointWriter::PrintStatistics() {
+  Wait();
+  std::cout << "Checkpoints : " << num_checkpoints_ << " written";
+  if (num_failures_ > 0) {
+    std::cout << ", " << num_failures_ << " failed";
+  }
+  std::cout << ", flushed in " << flush_time_ << " s, the time stepping "
+            << "waited " << wait_time_ << " s" << std::endl;
+}
+
+CheckpointFile::~CheckpointFile() {
+  if (mapping_ != nullptr) {
+    munmap(const_cast<char*>(mapping_), mapping_size_);
+  }
+}
+
+bool CheckpointFile::Open(const std::string& file_name, std::string* error) {
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "can not open " + file_name;
+    return false;
+  }
+  struct stat file_status;
+  if (fstat(fd, &file_status) != 0 ||
+      static_cast<std::size_t>(file_status.st_size) <
+          sizeof(CheckpointHeader)) {
+    close(fd);
+    *error = file_name + " is too small";
+    return false;
+  }
+  mapping_size_ = static_cast<std::size_t>(file_status.st_size);
+  void* mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    *error = "can not map " + file_name;
+    return false;
+  }
+  mapping_ = static_cast<const char*>(mapping);
+
+  const CheckpointHeader& header = get_header();
+  if (std::memcmp(header.magic, kCheckpointMagic,
+                  sizeof(kCheckpointMagic)) != 0) {
+    *error = file_name + " is not a checkpoint";
+    return false;
+  }
+  if (header.version != kCheckpointVersion) {
+    *error = file_name + " has the unsupported version " +
+             std::to_string(header.version);
+    return false;
+  }
+  if (header.num_x < 2 || header.file_size != mapping_size_ ||
+      header.sources_offset + header.sources_size >
+          header.auxiliary_offset ||
+      header.auxiliary_offset + header.auxiliary_size >
+          header.e_field_offset ||
+      header.e_field_offset + header.num_x*header.real_size >
+          header.h_field_offset ||
+      header.h_field_offset + (header.num_x - 1)*header.real_size >
+          mapping_size_) {
+    *error = file_name + " is truncated or corrupted";
+    return false;
+  }
+  return true;
+}
+
+const CheckpointHeader& CheckpointFile::get_header() {
+  return *reinterpret_cast<const CheckpointHeader*>(mapping_);
+}
+
+const char* CheckpointFile::get_sources() {
+  return mapping_ + get_header().sources_offset;
+}
+
+const char* CheckpointFile::get_auxiliary() {
+  return mapping_ + get_header().auxiliary_offset;
+}
+
+const void* CheckpointFile::get_e_field() {
+  return mapping_ + get_header().e_field_offset;
+}
+
+const void* CheckpointFile::get_h_field() {
+  return mapping_ + get_header().h_field_offset;
+}
+
+template <typename Real>
+std::vector<char> EncodeCheckpointSources(
+    const std::vector<std::unique_ptr<PointSource<Real>>>& sources) {
+  std::vector<char> data;
+  std::vector<Real> values;
+  for (auto& source : sources) {
+    values.assign(1, source->get_position());
+    source->GetParameters(&values);
+    SourceRecord record = {static_cast<std::int32_t>(source->get_type()),
+                           static_cast<std::int32_t>(values.size() - 1)};
+    const char* record_bytes = reinterpret_cast<const char*>(&record);
+    const char* value_bytes = reinterpret_cast<const char*>(values.data());
+    data.insert(data.end(), record_bytes, record_bytes + sizeof(record));
+    data.insert(data.end(), value_bytes,
+                value_bytes + values.size()*sizeof(Real));
+  }
+  return data;
+}
+
+template <typename Real>
+bool DecodeCheckpointSources(
+    const char* data, const std::size_t size, const std::int64_t num_sources,
+    std::vector<std::unique_ptr<PointSource<Real>>>* sources) {
+  sources->clear();
+  std::size_t offset = 0;
+  std::vector<Real> parameters;
+  for (std::int64_t s = 0; s < num_sources; ++s) {
+    SourceRecord record;
+    if (offset + sizeof(record) > size) {
+      return false;
+    }
+    std::memcpy(&record, data + offset, sizeof(record));
+    offset += sizeof(record);
+    std::size_t values_size = (record.num_parameters + 1)*sizeof(Real);
+    if (record.num_parameters < 0 || offset + values_size > size) {
+      return false;
+    }
+    Real position;
+    std::memcpy(&position, data + offset, sizeof(Real));
+    parameters.resize(record.num_parameters);
+    if (record.num_parameters > 0) {
+      std::memcpy(parameters.data(), data + offset + sizeof(Real),
+                  values_size - sizeof(Real));
+    }
+    offset += values_size;
+    std::unique_ptr<PointSource<Real>> source = CreatePointSource(
+        static_cast<SourceType>(record.type), position, parameters);
+    if (source == nullptr) {
+      return false;
+    }
+    sources->emplace_back(std::move(source));
+  }
+  return offset == size;
+}
+
+template std::vector<char> EncodeCheckpointSources(
+    const std::vector<std::unique_ptr<PointSource<float>>>&);
+template std::vector<char> EncodeCheckpointSources(
+    const std::vector<std::unique_ptr<PointSource<double>>>&);
+template bool DecodeCheckpointSources(
+    const char*, const std::size_t, const std::int64_t,
+    std::vector<std::unique_ptr<PointSource<float>>>*);
+template bool DecodeCheckpointSources(
+    const char*, const std::size_t, const std::int64_t,
+    std::vector<std::unique_ptr<PointSource<double>>>*);
+
+}  // namespace fdtd1d
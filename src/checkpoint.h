@@ -0,0 +1,141 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_CHECKPOINT_H_
+#define FDTD_CHECKPOINT_H_
+
+// Saves the state of the solver (the fields, the time index, the grid and the
+// sources) to a checkpoint file from which an interrupted run is resumed, see
+// FDTD1D::SetCheckpointing and FDTD1D::RestoreCheckpoint.
+//
+// The checkpoint file is mapped to memory: the threads copy their chunks of
+// the fields straight into the mapped file (the page cache), and a background
+// thread flushes the mapping to the disk and renames the file to its final
+// name. The compute threads only wait if the previous checkpoint is still
+// being flushed. The rename replaces the previous checkpoint atomically, so
+// the file always holds a complete checkpoint.
+//
+// File layout (version kCheckpointVersion, native byte order):
+//   CheckpointHeader
+//   the sources at sources_offset: for each source an int32 SourceType and an
+//     int32 number of parameters, followed by the position and the
+//     parameters (see PointSource::GetParameters) in the source precision
+//   the auxiliary fields of the solver (e.g. of the absorbing layers) at
+//     auxiliary_offset, as saved by the solver
+//   the E and H fields at e_field_offset and h_field_offset (page aligned),
+//     in the precision of the fields
+
+#include <cstddef>        // std::size_t
+#include <cstdint>        // std::int64_t, std::uint64_t
+#include <memory>         // std::unique_ptr
+#include <string>         // std::string
+#include <thread>         // std::thread
+#include <vector>         // std::vector
+
+#include "em_source.h"
+#include "number_types.h"
+
+namespace fdtd1d {
+
+constexpr std::uint32_t kCheckpointVersion = 2;
+
+struct CheckpointHeader {
+  char magic[8];                  // "FDTD1DCK"
+  std::uint32_t version;
+  std::uint32_t real_size;        // sizeof the field values
+  std::uint32_t source_real_size; // sizeof the source parameters
+  std::int32_t rank;              // the rank of a decomposed grid, else 0
+  std::int32_t num_ranks;
+  std::int32_t reserved;
+  std::int64_t num_x;             // E nodes in the file
+  std::int64_t grid_offset;       // grid index of the first node
+  std::int64_t num_t;
+  std::int64_t ind_t;             // time steps done
+  double x0;
+  double x1;
+  double dx;
+  double dt;
+  std::int64_t num_sources;
+  std::uint64_t sources_offset;
+  std::uint64_t sources_size;
+  std::uint64_t auxiliary_offset;
+  std::uint64_t auxiliary_size;
+  std::uint64_t e_field_offset;
+  std::uint64_t h_field_offset;
+  std::uint64_t file_size;
+};
+
+class CheckpointWriter {
+  public:
+  ~CheckpointWriter();
+
+  // waits for the previous checkpoint, then creates the file file_name.tmp
+  // with the layout of header (the offsets and the sizes are filled in),
+  // maps it and writes the header, the sources and the auxiliary fields.
+  // e_field and h_field get the addresses of the fields in the mapping.
+  // Returns false if the file can not be created.
+  bool Begin(const std::string& file_name, CheckpointHeader* header,
+             const std::vector<char>& sources,
+             const std::vector<char>& auxiliary, void** e_field,
+             void** h_field);
+
+  // the fields are copied: flushes the mapping and renames the file to
+  // file_name on a background thread
+  void Submit();
+
+  // waits for the submitted checkpoint to be on the disk
+  void Wait();
+
+  void PrintStatistics();
+
+  private:
+  // unmaps and closes the file. The file is renamed if is_complete.
+  void Finish(const bool is_complete);
+
+  std::string file_name_;
+  int fd_ = -1;
+  void* mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
+  std::thread flush_thread_;
+
+  // statistics
+  IntNumber num_checkpoints_ = 0;
+  IntNumber num_failures_ = 0;
+  double wait_time_ = 0.0;        // seconds Begin waited for the flush
+  double flush_time_ = 0.0;       // seconds spent flushing
+};
+
+// a checkpoint file mapped read only
+class CheckpointFile {
+  public:
+  ~CheckpointFile();
+
+  // maps the file and checks the header. Returns false if the file is not a
+  // valid checkpoint, with the reason in error.
+  bool Open(const std::string& file_name, std::string* error);
+
+  const CheckpointHeader& get_header();
+  const char* get_sources();
+  const char* get_auxiliary();
+  const void* get_e_field();
+  const void* get_h_field();
+
+  private:
+  const char* mapping_ = nullptr;
+  std::size_t mapping_size_ = 0;
+};
+
+// converts the sources to the sources section of a checkpoint and back.
+// DecodeCheckpointSources returns false if the section is corrupted.
+template <typename Real>
+std::vector<char> EncodeCheckpointSources(
+    const std::vector<std::unique_ptr<PointSource<Real>>>& sources);
+template <typename Real>
+bool DecodeCheckpointSources(
+    const char* data, const std::size_t size, const std::int64_t num_sources,
+    std::vector<std::unique_ptr<PointSource<Real>>>* sources);
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_CHECKPOINT_H_
@@ -0,0 +1,184 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "cpml.h"
+
+#include <algorithm>      // std::min, std::max, std::fill
+#include <cmath>          // std::exp, std::pow
+#include <cstring>        // std::memcpy
+
+namespace fdtd1d {
+
+template <typename Real>
+bool CPMLBoundary<Real>::Initialize(const CPMLParameters& parameters,
+                                    const IntNumber num_x,
+                                    const IntNumber grid_offset,
+                                    const IntNumber num_local_x,
+                                    const double dx, const double dt_eps0) {
+  parameters_ = parameters;
+  grid_offset_ = grid_offset;
+  num_local_x_ = num_local_x;
+  dt_eps0_ = dt_eps0;
+  const IntNumber thickness = parameters.thickness;
+  if (thickness <= 0 || 2*thickness + 2 > num_x) {
+    parameters_.thickness = 0;
+    for (int k = 0; k < 2; ++k) {
+      e_layers_[k] = Layer();
+      h_layers_[k] = Layer();
+    }
+    e_layers_[1].begin = e_layers_[1].end = num_local_x;
+    h_layers_[1].begin = h_layers_[1].end = num_local_x;
+    return thickness <= 0;
+  }
+  // eta_0 = 1 in the normalized units of physical_constants.h
+  const double m = parameters.grading_order;
+  sigma_max_ = parameters.sigma_factor*0.8*(m + 1) / dx;
+
+  // in units of dx the E node i is at i and the H node i at i + 0.5. The
+  // left layer spans [0, thickness] and the right one [num_x - 1 -
+  // thickness, num_x - 1].
+  const double l = static_cast<double>(thickness);
+  const double x_right = static_cast<double>(num_x - 1 - thickness);
+  InitializeLayer(&e_layers_[0], 1, thickness, [l](const IntNumber i) {
+    return (l - i) / l;
+  });
+  InitializeLayer(&e_layers_[1], num_x - thickness, num_x - 1,
+                  [l, x_right](const IntNumber i) {
+    return (i - x_right) / l;
+  });
+  InitializeLayer(&h_layers_[0], 0, thickness, [l](const IntNumber i) {
+    return (l - i - 0.5) / l;
+  });
+  InitializeLayer(&h_layers_[1], num_x - 1 - thickness, num_x - 1,
+                  [l, x_right](const IntNumber i) {
+    return (i + 0.5 - x_right) / l;
+  });
+  return true;
+}
+
+template <typename Real>
+template <typename Function>
+void CPMLBoundary<Real>::InitializeLayer(Layer* layer,
+                                         const IntNumber global_begin,
+                                         const IntNumber global_end,
+                                         Function depth) {
+  layer->begin = std::min(std::max<IntNumber>(global_begin - grid_offset_, 0),
+                          num_local_x_);
+  layer->end = std::min(std::max(global_end - grid_offset_, layer->begin),
+                        num_local_x_);
+  const std::size_t size = static_cast<std::size_t>(layer->end -
+                                                    layer->begin);
+  layer->b.resize(size);
+  layer->a.resize(size);
+  layer->inv_kappa.resize(size);
+  layer->psi.assign(size, Real(0));
+  const double m = parameters_.grading_order;
+  for (std::size_t k = 0; k < size; ++k) {
+    double rho = depth(layer->begin + static_cast<IntNumber>(k) +
+                       grid_offset_);
+    double grading = std::pow(rho, m);
+    double sigma = sigma_max_*grading;
+    double kappa = 1.0 + (parameters_.kappa_max - 1.0)*grading;
+    double alpha = parameters_.alpha_max*(1.0 - rho);
+    double b = std::exp(-(sigma/kappa + alpha)*dt_eps0_);
+    double a = 0.0;
+    if (sigma > 0.0) {
+      a = sigma / (sigma*kappa + kappa*kappa*alpha)*(b - 1.0);
+    }
+    layer->b[k] = static_cast<Real>(b);
+    layer->a[k] = static_cast<Real>(a);
+    layer->inv_kappa[k] = static_cast<Real>(1.0 / kappa);
+  }
+}
+
+template <typename Real>
+void CPMLBoundary<Real>::UpdateE(Real* e, const Real* h,
+                                 const IntNumber ind_begin,
+                                 const IntNumber ind_end,
+                                 const Real coefficient) {
+  for (Layer& layer : e_layers_) {
+    IntNumber i_begin = std::max(ind_begin, layer.begin);
+    IntNumber i_end = std::min(ind_end, layer.end);
+    if (i_begin >= i_end) {
+      continue;
+    }
+    Real* psi = layer.psi.data() - layer.begin;
+    const Real* b = layer.b.data() - layer.begin;
+    const Real* a = layer.a.data() - layer.begin;
+    const Real* inv_kappa = layer.inv_kappa.data() - layer.begin;
+    for (IntNumber i = i_begin; i < i_end; ++i) {
+      Real curl = h[i] - h[i - 1];
+      psi[i] = b[i]*psi[i] + a[i]*curl;
+      e[i] -= (curl*inv_kappa[i] + psi[i])*coefficient;
+    }
+  }
+}
+
+template <typename Real>
+void CPMLBoundary<Real>::UpdateH(Real* h, const Real* e,
+                                 const IntNumber ind_begin,
+                                 const IntNumber ind_end,
+                                 const Real coefficient) {
+  for (Layer& layer : h_layers_) {
+    IntNumber i_begin = std::max(ind_begin, layer.begin);
+    IntNumber i_end = std::min(ind_end, layer.end);
+    if (i_begin >= i_end) {
+      continue;
+    }
+    Real* psi = layer.psi.data() - layer.begin;
+    const Real* b = layer.b.data() - layer.begin;
+    const Real* a = layer.a.data() - layer.begin;
+    const Real* inv_kappa = layer.inv_kappa.data() - layer.begin;
+    for (IntNumber i = i_begin; i < i_end; ++i) {
+      Real curl = e[i + 1] - e[i];
+      psi[i] = b[i]*psi[i] + a[i]*curl;
+      h[i] -= (curl*inv_kappa[i] + psi[i])*coefficient;
+    }
+  }
+}
+
+template <typename Real>
+void CPMLBoundary<Real>::Reset() {
+  for (int k = 0; k < 2; ++k) {
+    std::fill(e_layers_[k].psi.begin(), e_layers_[k].psi.end(), Real(0));
+    std::fill(h_layers_[k].psi.begin(), h_layers_[k].psi.end(), Real(0));
+  }
+}
+
+template <typename Real>
+std::size_t CPMLBoundary<Real>::get_state_size() {
+  std::size_t size = 0;
+  for (int k = 0; k < 2; ++k) {
+    size += (e_layers_[k].psi.size() + h_layers_[k].psi.size())*sizeof(Real);
+  }
+  return size;
+}
+
+template <typename Real>
+void CPMLBoundary<Real>::SaveState(char* data) {
+  for (Layer* layer : {&e_layers_[0], &e_layers_[1],
+                       &h_layers_[0], &h_layers_[1]}) {
+    std::size_t size = layer->psi.size()*sizeof(Real);
+    if (size > 0) {
+      std::memcpy(data, layer->psi.data(), size);
+    }
+    data += size;
+  }
+}
+
+template <typename Real>
+void CPMLBoundary<Real>::LoadState(const char* data) {
+  for (Layer* layer : {&e_layers_[0], &e_layers_[1],
+                       &h_layers_[0], &h_layers_[1]}) {
+    std::size_t size = layer->psi.size()*sizeof(Real);
+    if (size > 0) {
+      std::memcpy(layer->psi.data(), data, size);
+    }
+    data += size;
+  }
+}
+
+template class CPMLBoundary<float>;
+template class CPMLBoundary<double>;
+
+}  // namespace fdtd1d
@@ -0,0 +1,114 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_CPML_H_
+#define FDTD_CPML_H_
+
+// Convolutional perfectly matched layers (CPML) absorbing the waves leaving
+// the computational domain, so that the domain does not have to be padded to
+// keep the reflections of its ends away. See chapter 7 of "Taflove, A., &
+// Hagness, S. C. (2005). Computational electrodynamics".
+//
+// A layer of thickness cells lines each end of the grid, in front of the PEC
+// wall formed by the first (last) E node. Inside a layer the spatial
+// derivative of the updates is stretched and a recursively convolved
+// auxiliary field psi is added:
+//
+//   psi[i] = b[i]*psi[i] + a[i]*(h[i] - h[i - 1])
+//   e[i] -= ((h[i] - h[i - 1])/kappa[i] + psi[i])*dt/(dx*epsilon_0)
+//
+// and similarly for H. At the depth rho (0 at the inner edge, 1 at the wall)
+//   sigma = sigma_max*rho^m, kappa = 1 + (kappa_max - 1)*rho^m,
+//   alpha = alpha_max*(1 - rho),
+//   b = exp(-(sigma/kappa + alpha)*dt/epsilon_0),
+//   a = sigma/(sigma*kappa + kappa^2*alpha)*(b - 1)
+// with sigma_max = sigma_factor*0.8*(m + 1)/(eta_0*dx). The magnetic
+// conductivity is matched (sigma_m/mu_0 = sigma/epsilon_0), so the layers
+// are reflectionless at the interface for every frequency.
+//
+// The coefficients and psi only exist for the nodes of the layers. The
+// solver updates the interior nodes with the vectorized kernels and only
+// the nodes of the layers with UpdateE and UpdateH.
+
+#include <cstddef>        // std::size_t
+#include <vector>         // std::vector
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+struct CPMLParameters {
+  IntNumber thickness = 0;        // cells per layer, 0 : PEC ends
+  double grading_order = 3.0;     // m
+  double sigma_factor = 1.0;      // sigma_max relative to the optimum
+  double kappa_max = 1.0;
+  double alpha_max = 0.0;         // complex frequency shift (conductivity)
+};
+
+template <typename Real>
+class CPMLBoundary {
+  public:
+  // sets up the layers at the ends of a grid of num_x E nodes of spacing dx.
+  // The nodes in memory are the nodes [grid_offset, grid_offset +
+  // num_local_x) of the grid (see FDTD1D::SetDomainDecomposition), and the
+  // layers are clipped to them. dt_eps0 is dt/epsilon_0 in the units of the
+  // grid. Returns false if the two layers do not fit in the grid.
+  bool Initialize(const CPMLParameters& parameters, const IntNumber num_x,
+                  const IntNumber grid_offset, const IntNumber num_local_x,
+                  const double dx, const double dt_eps0);
+
+  bool is_enabled() { return parameters_.thickness > 0; }
+  const CPMLParameters& get_parameters() { return parameters_; }
+
+  // the local nodes before *_left_end and from *_right_begin on are in the
+  // layers, the others are interior nodes
+  IntNumber get_e_left_end() { return e_layers_[0].end; }
+  IntNumber get_e_right_begin() { return e_layers_[1].begin; }
+  IntNumber get_h_left_end() { return h_layers_[0].end; }
+  IntNumber get_h_right_begin() { return h_layers_[1].begin; }
+
+  // the E (H) update of the nodes of [ind_begin, ind_end) that are in the
+  // layers. coefficient is dt/(dx*epsilon_0) (dt/(dx*mu_0)).
+  void UpdateE(Real* e, const Real* h, const IntNumber ind_begin,
+               const IntNumber ind_end, const Real coefficient);
+  void UpdateH(Real* h, const Real* e, const IntNumber ind_begin,
+               const IntNumber ind_end, const Real coefficient);
+
+  // zeroes the auxiliary fields
+  void Reset();
+
+  // the auxiliary fields, saved by the checkpoints
+  std::size_t get_state_size();   // bytes
+  void SaveState(char* data);
+  void LoadState(const char* data);
+
+  private:
+  // the local nodes [begin, end) of a layer and their coefficients
+  struct Layer {
+    IntNumber begin = 0;
+    IntNumber end = 0;
+    std::vector<Real> b;
+    std::vector<Real> a;
+    std::vector<Real> inv_kappa;
+    std::vector<Real> psi;
+  };
+
+  // sets the nodes of layer to the local nodes of [global_begin, global_end)
+  // whose depths are given by depth(grid index)
+  template <typename Function>
+  void InitializeLayer(Layer* layer, const IntNumber global_begin,
+                       const IntNumber global_end, Function depth);
+
+  CPMLParameters parameters_;
+  IntNumber grid_offset_ = 0;
+  IntNumber num_local_x_ = 0;
+  double sigma_max_ = 0.0;
+  double dt_eps0_ = 0.0;
+  Layer e_layers_[2];     // left, right
+  Layer h_layers_[2];
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_CPML_H_
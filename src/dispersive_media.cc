@@ -0,0 +1,274 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "dispersive_media.h"
+
+#include <algorithm>      // std::sort, std::min, std::max, std::fill
+#include <cmath>          // std::ceil
+#include <cstring>        // std::memcpy
+
+#include "material_map.h"
+
+namespace fdtd1d {
+
+namespace {
+
+// the tolerance of the positions of the region ends, relative to dx
+constexpr double kPositionTolerance = 1e-9;
+
+// the local index of the first E node at or after x
+IntNumber GetFirstNode(const double x, const double x0, const double dx,
+                       const IntNumber grid_offset,
+                       const IntNumber num_nodes) {
+  double position = (x - x0) / dx - static_cast<double>(grid_offset);
+  if (position <= 0.0) {
+    return 0;
+  }
+  if (position >= static_cast<double>(num_nodes)) {
+    return num_nodes;
+  }
+  return std::min(num_nodes, static_cast<IntNumber>(
+      std::ceil(position - kPositionTolerance)));
+}
+
+// converts "X0,X1,EPS_INF" followed by groups of values_per_pole values, each
+// converted to a pole by to_pole
+template <typename Function>
+bool ParseDispersiveRegion(const std::string& text,
+                           const std::size_t values_per_pole,
+                           Function to_pole, DispersiveRegion* region) {
+  std::vector<double> values;
+  if (!ParseNumberList(text, &values) || values.size() < 3 + values_per_pole ||
+      (values.size() - 3) % values_per_pole != 0) {
+    return false;
+  }
+  DispersiveRegion parsed;
+  parsed.x_begin = values[0];
+  parsed.x_end = values[1];
+  parsed.epsilon_inf = values[2];
+  for (std::size_t k = 3; k < values.size(); k += values_per_pole) {
+    DispersivePole pole;
+    if (!to_pole(&values[k], &pole) || pole.omega_0 < 0.0 ||
+        pole.gamma < 0.0) {
+      return false;
+    }
+    parsed.poles.push_back(pole);
+  }
+  if (parsed.x_end <= parsed.x_begin || parsed.epsilon_inf <= 0.0) {
+    return false;
+  }
+  *region = parsed;
+  return true;
+}
+
+}  // namespace
+
+bool ParseDrudeRegion(const std::string& text, DispersiveRegion* region) {
+  return ParseDispersiveRegion(text, 2, [](const double* values,
+                                           DispersivePole* pole) {
+    pole->strength = values[0]*values[0];
+    pole->omega_0 = 0.0;
+    pole->gamma = values[1];
+    return true;
+  }, region);
+}
+
+bool ParseLorentzRegion(const std::string& text, DispersiveRegion* region) {
+  return ParseDispersiveRegion(text, 3, [](const double* values,
+                                           DispersivePole* pole) {
+    pole->strength = values[0]*values[1]*values[1];
+    pole->omega_0 = values[1];
+    pole->gamma = values[2];
+    return values[0] >= 0.0;
+  }, region);
+}
+
+template <typename Real>
+bool DispersiveMedia<Real>::Build(const std::vector<DispersiveRegion>& regions,
+                                  const IntNumber grid_offset,
+                                  const IntNumber num_local_x,
+                                  const double x0, const double dx,
+                                  const double dt,
+                                  const double courant_number,
+                                  const double e_coefficient) {
+  regions_.clear();
+  ranges_.clear();
+  std::vector<std::pair<double, double>> extents;
+  for (const DispersiveRegion& region : regions) {
+    double stability = courant_number*courant_number;
+    for (const DispersivePole& pole : region.poles) {
+      double w = pole.omega_0*pole.omega_0*dt*dt/4;
+      if (w >= 1.0) {
+        return false;
+      }
+      stability += pole.strength*dt*dt/4 / (1.0 - w);
+    }
+    if (stability >= region.epsilon_inf) {
+      return false;
+    }
+    extents.emplace_back(region.x_begin, region.x_end);
+  }
+  std::sort(extents.begin(), extents.end());
+  for (std::size_t k = 1; k < extents.size(); ++k) {
+    if (extents[k].first < extents[k - 1].second) {
+      return false;
+    }
+  }
+
+  for (const DispersiveRegion& description : regions) {
+    Region region;
+    region.begin = GetFirstNode(description.x_begin, x0, dx, grid_offset,
+                                num_local_x);
+    region.end = GetFirstNode(description.x_end, x0, dx, grid_offset,
+                              num_local_x);
+    if (region.begin >= region.end) {
+      continue;
+    }
+    region.coefficient = static_cast<Real>(e_coefficient /
+                                           description.epsilon_inf);
+    region.current_factor = 1.0 / description.epsilon_inf;
+    region.inv_epsilon_inf = static_cast<Real>(region.current_factor);
+    std::vector<DispersivePole> poles = description.poles;
+    std::stable_sort(poles.begin(), poles.end(),
+                     [](const DispersivePole& a, const DispersivePole& b) {
+                       return (a.omega_0 == 0.0) > (b.omega_0 == 0.0);
+                     });
+    region.num_drude_poles = 0;
+    for (const DispersivePole& pole : poles) {
+      region.num_drude_poles += (pole.omega_0 == 0.0) ? 1 : 0;
+    }
+    region.num_lorentz_poles = poles.size() - region.num_drude_poles;
+    for (const DispersivePole& pole : poles) {
+      double denominator = 1.0 + pole.gamma*dt/2;
+      region.c1.push_back(static_cast<Real>(
+          (2.0 - pole.omega_0*pole.omega_0*dt*dt) / denominator));
+      region.c2.push_back(static_cast<Real>(
+          (pole.gamma*dt/2 - 1.0) / denominator));
+      region.c3.push_back(static_cast<Real>(
+          pole.strength*dt*dt / denominator));
+    }
+    std::size_t num_nodes = static_cast<std::size_t>(region.end -
+                                                     region.begin);
+    region.auxiliary.assign(region.get_values_per_node()*num_nodes, Real(0));
+    regions_.push_back(std::move(region));
+  }
+  std::sort(regions_.begin(), regions_.end(),
+            [](const Region& a, const Region& b) {
+              return a.begin < b.begin;
+            });
+  for (const Region& region : regions_) {
+    ranges_.emplace_back(region.begin, region.end);
+  }
+  return true;
+}
+
+template <typename Real>
+std::size_t DispersiveMedia<Real>::get_num_poles() {
+  std::size_t num_poles = 0;
+  for (const Region& region : regions_) {
+    num_poles += region.c1.size();
+  }
+  return num_poles;
+}
+
+template <typename Real>
+IntNumber DispersiveMedia<Real>::get_num_nodes() {
+  IntNumber num_nodes = 0;
+  for (const Region& region : regions_) {
+    num_nodes += region.end - region.begin;
+  }
+  return num_nodes;
+}
+
+template <typename Real>
+void DispersiveMedia<Real>::UpdateE(Real* e, const Real* h,
+                                    const IntNumber ind_begin,
+                                    const IntNumber ind_end) {
+  for (Region& region : regions_) {
+    IntNumber i_begin = std::max(ind_begin, region.begin);
+    IntNumber i_end = std::min(ind_end, region.end);
+    if (i_begin >= i_end) {
+      continue;
+    }
+    const std::size_t num_drude_poles = region.num_drude_poles;
+    const std::size_t num_poles = num_drude_poles + region.num_lorentz_poles;
+    const Real* c1 = region.c1.data();
+    const Real* c2 = region.c2.data();
+    const Real* c3 = region.c3.data();
+    const Real coefficient = region.coefficient;
+    const Real inv_epsilon_inf = region.inv_epsilon_inf;
+    Real* q = region.auxiliary.data() + region.get_values_per_node()*
+              static_cast<std::size_t>(i_begin - region.begin);
+    for (IntNumber i = i_begin; i < i_end; ++i) {
+      const Real e_old = e[i];
+      Real dq = 0;
+      std::size_t k = 0;
+      for (; k < num_drude_poles; ++k, ++q) {
+        q[0] = c3[k]*e_old - c2[k]*q[0];
+        dq += q[0];
+      }
+      for (; k < num_poles; ++k, q += 2) {
+        Real q_new = c1[k]*q[0] + c2[k]*q[1] + c3[k]*e_old;
+        dq += q_new - q[0];
+        q[1] = q[0];
+        q[0] = q_new;
+      }
+      e[i] = e_old - (h[i] - h[i - 1])*coefficient - dq*inv_epsilon_inf;
+    }
+  }
+}
+
+template <typename Real>
+bool DispersiveMedia<Real>::GetCurrentFactor(const IntNumber ind_x,
+                                             double* factor) {
+  for (const Region& region : regions_) {
+    if (region.begin <= ind_x && ind_x < region.end) {
+      *factor = region.current_factor;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Real>
+void DispersiveMedia<Real>::Reset() {
+  for (Region& region : regions_) {
+    std::fill(region.auxiliary.begin(), region.auxiliary.end(), Real(0));
+  }
+}
+
+template <typename Real>
+std::size_t DispersiveMedia<Real>::get_state_size() {
+  std::size_t size = 0;
+  for (const Region& region : regions_) {
+    size += region.auxiliary.size()*sizeof(Real);
+  }
+  return size;
+}
+
+template <typename Real>
+void DispersiveMedia<Real>::SaveState(char* data) {
+  for (const Region& region : regions_) {
+    std::size_t size = region.auxiliary.size()*sizeof(Real);
+    if (size > 0) {
+      std::memcpy(data, region.auxiliary.data(), size);
+    }
+    data += size;
+  }
+}
+
+template <typename Real>
+void DispersiveMedia<Real>::LoadState(const char* data) {
+  for (Region& region : regions_) {
+    std::size_t size = region.auxiliary.size()*sizeof(Real);
+    if (size > 0) {
+      std::memcpy(region.auxiliary.data(), data, size);
+    }
+    data += size;
+  }
+}
+
+template class DispersiveMedia<float>;
+template class DispersiveMedia<double>;
+
+}  // namespace fdtd1d
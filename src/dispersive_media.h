@@ -0,0 +1,141 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_DISPERSIVE_MEDIA_H_
+#define FDTD_DISPERSIVE_MEDIA_H_
+
+// Dispersive media (metals and resonant dielectrics) described by Drude and
+// Lorentz poles and updated with the auxiliary differential equation (ADE)
+// method, see chapter 9 of "Taflove, A., & Hagness, S. C. (2005).
+// Computational electrodynamics". Each pole k adds a polarization P_k obeying
+//
+//   d^2 P_k/dt^2 + gamma_k*dP_k/dt + omega_k^2*P_k = epsilon_0*strength_k*E
+//
+// where a Lorentz pole has strength = delta_epsilon*omega_0^2 and a Drude
+// pole has omega_0 = 0 and strength = omega_p^2. The central differences
+// give, with q_k = P_k/epsilon_0,
+//
+//   q_k^{n+1} = c1_k*q_k^n + c2_k*q_k^{n-1} + c3_k*E^n
+//   E^{n+1} = E^n - (h[i] - h[i - 1])*dt/(dx*epsilon_0*epsilon_inf)
+//                 - sum_k (q_k^{n+1} - q_k^n)/epsilon_inf
+//
+// c1 = (2 - omega_0^2*dt^2)/(1 + gamma*dt/2), c2 = (gamma*dt/2 - 1)/(1 +
+// gamma*dt/2) and c3 = strength*dt^2/(1 + gamma*dt/2). For a Drude pole
+// c1 = 1 - c2, so only the increment d_k = q_k^{n+1} - q_k^n is kept:
+//
+//   d_k^{n+1} = -c2_k*d_k^n + c3_k*E^n
+//
+// which halves the auxiliary memory traffic of the metals.
+//
+// The scheme is stable if, with the Courant number S = c*dt/dx,
+//
+//   S^2 + sum_k (strength_k*dt^2/4)/(1 - omega_k^2*dt^2/4) < epsilon_inf
+//
+// (the von Neumann condition of a single pole, applied to the sum of the
+// poles), so strong poles need a smaller time step than vacuum.
+//
+// The auxiliary fields (d of the Drude poles, q^n and q^{n-1} of the Lorentz
+// poles) only exist for the nodes of the dispersive regions. They are stored
+// next to each other for each node, and the E update of a node advances its
+// poles in the same pass, so the auxiliary data of a node is touched once per
+// time step.
+
+#include <cstddef>        // std::size_t
+#include <string>         // std::string
+#include <utility>        // std::pair
+#include <vector>         // std::vector
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+struct DispersivePole {
+  double strength = 0.0;          // omega_p^2 or delta_epsilon*omega_0^2
+  double omega_0 = 0.0;           // resonance angular frequency, 0 : Drude
+  double gamma = 0.0;             // damping rate
+};
+
+// the E nodes in [x_begin, x_end)
+struct DispersiveRegion {
+  double x_begin = 0.0;
+  double x_end = 0.0;
+  double epsilon_inf = 1.0;       // relative permittivity at high frequency
+  std::vector<DispersivePole> poles;
+};
+
+// convert "X0,X1,EPS_INF,OMEGA_P,GAMMA[,OMEGA_P,GAMMA...]" to a Drude region
+// and "X0,X1,EPS_INF,DELTA_EPS,OMEGA_0,GAMMA[,DELTA_EPS,OMEGA_0,GAMMA...]" to
+// a Lorentz region. The frequencies are angular frequencies. Return false if
+// the text is not recognized or the parameters are not valid.
+bool ParseDrudeRegion(const std::string& text, DispersiveRegion* region);
+bool ParseLorentzRegion(const std::string& text, DispersiveRegion* region);
+
+template <typename Real>
+class DispersiveMedia {
+  public:
+  // sets up the regions for the E nodes [grid_offset, grid_offset +
+  // num_local_x) of a grid starting at x0 with the spacing dx and the time
+  // step dt. courant_number is c*dt/dx and e_coefficient is the vacuum
+  // coefficient dt/(dx*epsilon_0). Returns false if the regions overlap or
+  // are not stable.
+  bool Build(const std::vector<DispersiveRegion>& regions,
+             const IntNumber grid_offset, const IntNumber num_local_x,
+             const double x0, const double dx, const double dt,
+             const double courant_number, const double e_coefficient);
+
+  bool is_enabled() { return !regions_.empty(); }
+  std::size_t get_num_regions() { return regions_.size(); }
+  std::size_t get_num_poles();
+  IntNumber get_num_nodes();
+
+  // the sorted local node ranges [first, second) of the regions
+  const std::vector<std::pair<IntNumber, IntNumber>>& get_ranges() {
+    return ranges_;
+  }
+
+  // the E update of the nodes of [ind_begin, ind_end) that are in the
+  // regions, together with their auxiliary fields
+  void UpdateE(Real* e, const Real* h, const IntNumber ind_begin,
+               const IntNumber ind_end);
+
+  // returns true if the local E node ind_x is in a region, with the factor
+  // 1/epsilon_inf of the contribution of an electric current in factor
+  bool GetCurrentFactor(const IntNumber ind_x, double* factor);
+
+  // zeroes the auxiliary fields
+  void Reset();
+
+  // the auxiliary fields, saved by the checkpoints
+  std::size_t get_state_size();   // bytes
+  void SaveState(char* data);
+  void LoadState(const char* data);
+
+  private:
+  struct Region {
+    IntNumber begin;              // local E nodes
+    IntNumber end;
+    Real coefficient;             // dt/(dx*epsilon_0*epsilon_inf)
+    Real inv_epsilon_inf;
+    double current_factor;        // 1/epsilon_inf
+    // per pole, the Drude poles first
+    std::size_t num_drude_poles;
+    std::size_t num_lorentz_poles;
+    std::vector<Real> c1;
+    std::vector<Real> c2;
+    std::vector<Real> c3;
+    // for each node the d of the Drude poles followed by the q^n and q^{n-1}
+    // of the Lorentz poles: get_values_per_node() values per node
+    std::vector<Real> auxiliary;
+    std::size_t get_values_per_node() const {
+      return num_drude_poles + 2*num_lorentz_poles;
+    }
+  };
+
+  std::vector<Region> regions_;
+  std::vector<std::pair<IntNumber, IntNumber>> ranges_;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_DISPERSIVE_MEDIA_H_
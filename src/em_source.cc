@@ -3,40 +3,259 @@
 #include "em_source.h"
 
 #include <iostream>       // std::cout
+#include <limits>         // std::numeric_limits
 
 
 namespace fdtd1d {
 
-GaussianSource::GaussianSource(const RealNumber position, 
-                               const RealNumber amplitude, 
-                               const RealNumber t_center, 
-                               const RealNumber t_decay) {
-  position_ = position;
-  amplitude_ = amplitude;
-  t_center_ = t_center;
-  t_decay_ = t_decay;
+namespace {
+
+template <typename Real>
+constexpr Real kTwoPi = static_cast<Real>(6.283185307179586476925286766559);
+
+}  // namespace
+
+template <typename Real>
+PointSource<Real>::PointSource(const Real position) : position_(position) {}
+
+template <typename Real>
+PointSource<Real>::~PointSource() {}
+
+template <typename Real>
+Real PointSource<Real>::get_position() {
+  return position_;
 }
 
-void GaussianSource::set_index_x(const IntNumber ind_x) {
+template <typename Real>
+void PointSource<Real>::set_index_x(const IntNumber ind_x) {
   index_x_ = ind_x;
 }
 
-IntNumber GaussianSource::get_index_x() {
+template <typename Real>
+IntNumber PointSource<Real>::get_index_x() {
   return index_x_;
 }
 
-RealNumber GaussianSource::GetCurrentValue(const RealNumber t) {
-  auto temp = (t - t_center_) / t_decay_;
-  return amplitude_*exp(-temp*temp);
+template <typename Real>
+void PointSource<Real>::GetActiveTimeWindow(Real* t_begin, Real* t_end) {
+  *t_begin = -std::numeric_limits<Real>::infinity();
+  *t_end = std::numeric_limits<Real>::infinity();
 }
 
-void GaussianSource::PrintParameters() {
+template <typename Real>
+void PointSource<Real>::PrintParameters() {
   std::cout << "position : " << position_ << std::endl;
+  std::cout << "ind_x : " << index_x_ << std::endl;
+}
+
+template <typename Real>
+GaussianSource<Real>::GaussianSource(const Real position, 
+                                     const Real amplitude, 
+                                     const Real t_center, 
+                                     const Real t_decay) 
+    : PointSource<Real>(position) {
+  amplitude_ = amplitude;
+  t_center_ = t_center;
+  t_decay_ = t_decay;
+}
+
+template <typename Real>
+Real GaussianSource<Real>::GetCurrentValue(const Real t) {
+  auto temp = (t - t_center_) / t_decay_;
+  return amplitude_*std::exp(-temp*temp);
+}
+
+template <typename Real>
+void GaussianSource<Real>::GetActiveTimeWindow(Real* t_begin, Real* t_end) {
+  // std::exp(-x) is exactly 0 for x > -log(denorm_min). One is added to this
+  // bound to stay clear of the rounding of temp*temp.
+  const Real max_exponent = 
+      -std::log(std::numeric_limits<Real>::denorm_min()) + 1;
+  const Real half_width = std::abs(t_decay_)*std::sqrt(max_exponent);
+  *t_begin = t_center_ - half_width;
+  *t_end = t_center_ + half_width;
+}
+
+template <typename Real>
+void GaussianSource<Real>::PrintParameters() {
+  std::cout << "position : " << this->position_ << std::endl;
   std::cout << "amplitude : " << amplitude_ << std::endl;
   std::cout << "t_center : " << t_center_ << std::endl;
   std::cout << "t_decay : " << t_decay_ << std::endl;
-  std::cout << "ind_x : " << index_x_ << std::endl;
+  std::cout << "ind_x : " << this->index_x_ << std::endl;
 }
 
-}  // namespace fdtd1d
+template <typename Real>
+SourceType GaussianSource<Real>::get_type() {
+  return SourceType::kGaussian;
+}
+
+template <typename Real>
+void GaussianSource<Real>::GetParameters(std::vector<Real>* parameters) {
+  parameters->insert(parameters->end(), {amplitude_, t_center_, t_decay_});
+}
+
+template <typename Real>
+ModulatedGaussianSource<Real>::ModulatedGaussianSource(const Real position, 
+                                                       const Real amplitude, 
+                                                       const Real t_center,
+                                                       const Real t_decay,
+                                                       const Real frequency,
+                                                       const Real phase)
+    : GaussianSource<Real>(position, amplitude, t_center, t_decay),
+      frequency_(frequency), phase_(phase) {}
+
+template <typename Real>
+Real ModulatedGaussianSource<Real>::GetCurrentValue(const Real t) {
+  return GaussianSource<Real>::GetCurrentValue(t)*
+         std::sin(kTwoPi<Real>*frequency_*(t - this->t_center_) + phase_);
+}
+
+template <typename Real>
+void ModulatedGaussianSource<Real>::PrintParameters() {
+  GaussianSource<Real>::PrintParameters();
+  std::cout << "frequency : " << frequency_ << std::endl;
+  std::cout << "phase : " << phase_ << std::endl;
+}
 
+template <typename Real>
+SourceType ModulatedGaussianSource<Real>::get_type() {
+  return SourceType::kModulatedGaussian;
+}
+
+template <typename Real>
+void ModulatedGaussianSource<Real>::GetParameters(
+    std::vector<Real>* parameters) {
+  GaussianSource<Real>::GetParameters(parameters);
+  parameters->insert(parameters->end(), {frequency_, phase_});
+}
+
+template <typename Real>
+SinusoidalSource<Real>::SinusoidalSource(const Real position, 
+                                         const Real amplitude, 
+                                         const Real frequency,
+                                         const Real phase,
+                                         const Real t_start)
+    : PointSource<Real>(position), amplitude_(amplitude), 
+      frequency_(frequency), phase_(phase), t_start_(t_start) {}
+
+template <typename Real>
+Real SinusoidalSource<Real>::GetCurrentValue(const Real t) {
+  if (t < t_start_) {
+    return 0;
+  }
+  return amplitude_*std::sin(kTwoPi<Real>*frequency_*(t - t_start_) + phase_);
+}
+
+template <typename Real>
+void SinusoidalSource<Real>::GetActiveTimeWindow(Real* t_begin, Real* t_end) {
+  *t_begin = t_start_;
+  *t_end = std::numeric_limits<Real>::infinity();
+}
+
+template <typename Real>
+void SinusoidalSource<Real>::PrintParameters() {
+  PointSource<Real>::PrintParameters();
+  std::cout << "amplitude : " << amplitude_ << std::endl;
+  std::cout << "frequency : " << frequency_ << std::endl;
+  std::cout << "phase : " << phase_ << std::endl;
+  std::cout << "t_start : " << t_start_ << std::endl;
+}
+
+template <typename Real>
+SourceType SinusoidalSource<Real>::get_type() {
+  return SourceType::kSinusoidal;
+}
+
+template <typename Real>
+void SinusoidalSource<Real>::GetParameters(std::vector<Real>* parameters) {
+  parameters->insert(parameters->end(), 
+                     {amplitude_, frequency_, phase_, t_start_});
+}
+
+template <typename Real>
+TabulatedSource<Real>::TabulatedSource(const Real position, 
+                                       const Real t_start,
+                                       const Real sample_dt,
+                                       const std::vector<Real>& samples)
+    : PointSource<Real>(position), t_start_(t_start), sample_dt_(sample_dt),
+      samples_(samples) {}
+
+template <typename Real>
+Real TabulatedSource<Real>::GetCurrentValue(const Real t) {
+  Real position = (t - t_start_) / sample_dt_;
+  if (samples_.empty() || !(position >= 0) || 
+      position > static_cast<Real>(samples_.size() - 1)) {
+    return 0;
+  }
+  std::size_t k = static_cast<std::size_t>(position);
+  if (k + 1 >= samples_.size()) {
+    return samples_.back();
+  }
+  Real weight = position - k;
+  return samples_[k] + weight*(samples_[k + 1] - samples_[k]);
+}
+
+template <typename Real>
+void TabulatedSource<Real>::GetActiveTimeWindow(Real* t_begin, Real* t_end) {
+  *t_begin = t_start_;
+  *t_end = t_start_ + sample_dt_*(samples_.empty() ? 0 : samples_.size() - 1);
+}
+
+template <typename Real>
+void TabulatedSource<Real>::PrintParameters() {
+  PointSource<Real>::PrintParameters();
+  std::cout << "t_start : " << t_start_ << std::endl;
+  std::cout << "sample_dt : " << sample_dt_ << std::endl;
+  std::cout << "samples : " << samples_.size() << std::endl;
+}
+
+template <typename Real>
+SourceType TabulatedSource<Real>::get_type() {
+  return SourceType::kTabulated;
+}
+
+template <typename Real>
+void TabulatedSource<Real>::GetParameters(std::vector<Real>* parameters) {
+  parameters->insert(parameters->end(), {t_start_, sample_dt_});
+  parameters->insert(parameters->end(), samples_.begin(), samples_.end());
+}
+
+template <typename Real>
+std::unique_ptr<PointSource<Real>> CreatePointSource(
+    const SourceType type, const Real position, 
+    const std::vector<Real>& parameters) {
+  const std::vector<Real>& p = parameters;
+  std::unique_ptr<PointSource<Real>> source;
+  if (type == SourceType::kGaussian && p.size() == 3) {
+    source.reset(new GaussianSource<Real>(position, p[0], p[1], p[2]));
+  } else if (type == SourceType::kModulatedGaussian && p.size() == 5) {
+    source.reset(new ModulatedGaussianSource<Real>(position, p[0], p[1], 
+                                                   p[2], p[3], p[4]));
+  } else if (type == SourceType::kSinusoidal && p.size() == 4) {
+    source.reset(new SinusoidalSource<Real>(position, p[0], p[1], p[2], 
+                                            p[3]));
+  } else if (type == SourceType::kTabulated && p.size() >= 2) {
+    source.reset(new TabulatedSource<Real>(position, p[0], p[1], 
+        std::vector<Real>(p.begin() + 2, p.end())));
+  }
+  return source;
+}
+
+template class PointSource<float>;
+template class PointSource<double>;
+template class GaussianSource<float>;
+template class GaussianSource<double>;
+template class ModulatedGaussianSource<float>;
+template class ModulatedGaussianSource<double>;
+template class SinusoidalSource<float>;
+template class SinusoidalSource<double>;
+template class TabulatedSource<float>;
+template class TabulatedSource<double>;
+
+template std::unique_ptr<PointSource<float>> CreatePointSource(
+    const SourceType, const float, const std::vector<float>&);
+template std::unique_ptr<PointSource<double>> CreatePointSource(
+    const SourceType, const double, const std::vector<double>&);
+
+}  // namespace fdtd1d
@@ -5,49 +5,172 @@
 #define FDTD_SOURCE_H_
 
 // Defines electromagnetic sources with predefined temporal variations.
+//
+// All the point sources derive from PointSource. Besides the value of the 
+// current, each source reports the time window outside of which its current
+// is exactly 0, so that the solver can skip it outside of this window and 
+// tabulate its waveform once over the time steps of the window (see 
+// FDTD1D::PrepareSources).
+//
+// A source is described by its type, its position and the parameters of its
+// constructor (GetParameters), from which CreatePointSource builds an 
+// identical source. The checkpoints save the sources this way.
 
-#include <cmath>    // exp
+#include <cmath>    // std::exp, std::sin
+#include <memory>   // std::unique_ptr
+#include <vector>   // std::vector
 
 #include "number_types.h"
 
 namespace fdtd1d {
 
-// defines a point source that has a Gaussian temporal dependence. 
-class GaussianSource {
+enum class SourceType {
+  kGaussian = 1,
+  kModulatedGaussian = 2,
+  kSinusoidal = 3,
+  kTabulated = 4,
+};
+
+// a point source of electric current. Real is the floating point type used to
+// evaluate the source.
+template <typename Real>
+class PointSource {
   public:
-  GaussianSource(const RealNumber position, 
-                 const RealNumber amplitude, 
-                 const RealNumber t_center, // see t_center_ for description
-                 const RealNumber t_decay   // see t_decay_
-                 );
-                 
+  explicit PointSource(const Real position);
+  virtual ~PointSource();
+  
+  Real get_position();
   void set_index_x(const IntNumber ind_x);
   IntNumber get_index_x();
   
   // Returns the value of the electromagnetic current at a given time
-  RealNumber GetCurrentValue(const RealNumber t);
-  void PrintParameters();
+  virtual Real GetCurrentValue(const Real t) = 0;
   
-  private:
+  // the current is exactly 0 outside of [t_begin, t_end]. The default window 
+  // is the whole time axis.
+  virtual void GetActiveTimeWindow(Real* t_begin, Real* t_end);
+  
+  virtual void PrintParameters();
+  
+  virtual SourceType get_type() = 0;
+  // appends the arguments of the constructor that follow the position
+  virtual void GetParameters(std::vector<Real>* parameters) = 0;
+  
+  protected:
   // position of the point source
-  RealNumber position_;
+  Real position_;
+  
+  // the grid index describing the position of the source on the x axis
+  IntNumber index_x_ = 0;
+};
+
+// defines a point source that has a Gaussian temporal dependence. 
+template <typename Real>
+class GaussianSource : public PointSource<Real> {
+  public:
+  GaussianSource(const Real position, 
+                 const Real amplitude, 
+                 const Real t_center, // see t_center_ for description
+                 const Real t_decay   // see t_decay_
+                 );
+  
+  Real GetCurrentValue(const Real t) override;
+  
+  // the window where std::exp does not underflow to 0
+  void GetActiveTimeWindow(Real* t_begin, Real* t_end) override;
+  void PrintParameters() override;
+  SourceType get_type() override;
+  void GetParameters(std::vector<Real>* parameters) override;
   
+  protected:
   // the amplitude of the Gaussian
-  RealNumber amplitude_;
+  Real amplitude_;
   
   // The Gaussian profile is centered in time around t_center_
-  RealNumber t_center_;
+  Real t_center_;
   
   // The decay time of the Gaussian profile. the smaller t_decay_ the narrower
   // the generated electromagnetic pulse
-  RealNumber t_decay_;
+  Real t_decay_;
+};
+
+// a Gaussian pulse modulating a sinusoidal carrier:
+// J(t) = amplitude*exp(-((t - t_center)/t_decay)^2)*
+//        sin(2*pi*frequency*(t - t_center) + phase)
+template <typename Real>
+class ModulatedGaussianSource : public GaussianSource<Real> {
+  public:
+  ModulatedGaussianSource(const Real position, 
+                          const Real amplitude, 
+                          const Real t_center,
+                          const Real t_decay,
+                          const Real frequency,
+                          const Real phase);
   
-  // the grid index describing the position of the source on the x axis
-  IntNumber index_x_;
+  Real GetCurrentValue(const Real t) override;
+  void PrintParameters() override;
+  SourceType get_type() override;
+  void GetParameters(std::vector<Real>* parameters) override;
+  
+  private:
+  Real frequency_;
+  Real phase_;
 };
 
-}  //namespace fdtd1d
+// a sinusoidal current switched on at t_start:
+// J(t) = amplitude*sin(2*pi*frequency*(t - t_start) + phase) for t >= t_start
+template <typename Real>
+class SinusoidalSource : public PointSource<Real> {
+  public:
+  SinusoidalSource(const Real position, 
+                   const Real amplitude, 
+                   const Real frequency,
+                   const Real phase,
+                   const Real t_start);
+  
+  Real GetCurrentValue(const Real t) override;
+  void GetActiveTimeWindow(Real* t_begin, Real* t_end) override;
+  void PrintParameters() override;
+  SourceType get_type() override;
+  void GetParameters(std::vector<Real>* parameters) override;
+  
+  private:
+  Real amplitude_;
+  Real frequency_;
+  Real phase_;
+  Real t_start_;
+};
 
-#endif  // FDTD_SOURCE_H_
+// a current given by samples at t_start + k*sample_dt, linearly interpolated
+// between the samples and 0 outside of them
+template <typename Real>
+class TabulatedSource : public PointSource<Real> {
+  public:
+  TabulatedSource(const Real position, 
+                  const Real t_start,
+                  const Real sample_dt,
+                  const std::vector<Real>& samples);
+  
+  Real GetCurrentValue(const Real t) override;
+  void GetActiveTimeWindow(Real* t_begin, Real* t_end) override;
+  void PrintParameters() override;
+  SourceType get_type() override;
+  void GetParameters(std::vector<Real>* parameters) override;
+  
+  private:
+  Real t_start_;
+  Real sample_dt_;
+  std::vector<Real> samples_;
+};
+
+// creates a source of the given type from its position and the parameters 
+// returned by GetParameters. Returns nullptr if the parameters do not fit the
+// type.
+template <typename Real>
+std::unique_ptr<PointSource<Real>> CreatePointSource(
+    const SourceType type, const Real position, 
+    const std::vector<Real>& parameters);
 
+}  //namespace fdtd1d
 
+#endif  // FDTD_SOURCE_H_
@@ -1,19 +1,46 @@
 // Use of this source code is governed by the GNU General Public License v3.0.
 
-#include <assert.h>
-
 #include "fdtd1d.h"
 
 namespace fdtd1d {
 
-FDTD1D::FDTD1D() 
-    : num_of_e_updated_threads_(0), num_of_h_updated_threads_(0),
-      ind_t_(0), num_threads_(1), 
+bool ParseTimeSteppingEngine(const std::string& name, 
+                             TimeSteppingEngine* engine) {
+  if (name == "per-step") {
+    *engine = TimeSteppingEngine::kPerStep;
+  } else if (name == "temporal-blocking") {
+    *engine = TimeSteppingEngine::kTemporalBlocking;
+  } else if (name == "task-graph") {
+    *engine = TimeSteppingEngine::kTaskGraph;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetTimeSteppingEngineName(const TimeSteppingEngine engine) {
+  switch (engine) {
+    case TimeSteppingEngine::kPerStep:
+      return "per-step";
+    case TimeSteppingEngine::kTemporalBlocking:
+      return "temporal-blocking";
+    case TimeSteppingEngine::kTaskGraph:
+      return "task-graph";
+  }
+  return "unknown";
+}
+
+template <typename Real, typename SourceReal>
+constexpr IntNumber FDTD1D<Real, SourceReal>::kMaxTabulatedSteps;
+
+template <typename Real, typename SourceReal>
+FDTD1D<Real, SourceReal>::FDTD1D() 
+    : ind_t_(0), num_threads_(1), 
       output_file_name_("output.csv" /* default output file name */) {} 
 
-void FDTD1D::SetXAxisRangeAndGridSpacing(const RealNumber x0, 
-                                         const RealNumber x1, 
-                                         const RealNumber dx) {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetXAxisRangeAndGridSpacing(
+    const SourceReal x0, const SourceReal x1, const SourceReal dx) {
   x0_ = x0;
   x1_ = x1;
   num_x_ = static_cast<IntNumber>((x1 - x0) / dx);
@@ -22,15 +49,51 @@ void FDTD1D::SetXAxisRangeAndGridSpacing(const RealNumber x0,
   // into account the rounding error that was introduced in the floating point 
   // number to integer conversion in calculating num_x_
   dx_ = (x1 - x0) / num_x_;
+  run_state_is_valid_ = false;
 }
 
-void FDTD1D::InitializeAndResetEMFieldArrays() {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InitializeAndResetEMFieldArrays() {
   // the H field points are staggered with respect to the E field points. Each 
   // H point is located between two E points. Therefore the number of H points
   // is smaller by 1 unit.
-  e_field_.reset(new RealNumber[num_x_]);
-  h_field_.reset(new RealNumber[num_x_ - 1]);
+  if (e_field_ != nullptr && allocated_num_x_ == num_x_ && 
+      allocated_huge_pages_ == huge_pages_) {
+    // the arrays of the previous run are reused
+  } else if (huge_pages_) {
+    bool e_uses_huge_pages = false;
+    bool h_uses_huge_pages = false;
+    e_field_ = AllocateHugePageArray<Real>(num_x_, &e_uses_huge_pages);
+    h_field_ = AllocateHugePageArray<Real>(num_x_ - 1, &h_uses_huge_pages);
+    uses_huge_pages_ = e_uses_huge_pages && h_uses_huge_pages;
+  } else {
+    e_field_ = AllocateAlignedArray<Real>(num_x_);
+    h_field_ = AllocateAlignedArray<Real>(num_x_ - 1);
+    uses_huge_pages_ = false;
+  }
+  allocated_num_x_ = num_x_;
+  allocated_huge_pages_ = huge_pages_;
+  
+  // the output of an unfinished run
+  if (field_output_is_open_) {
+    field_writer_.Close();
+    field_output_is_open_ = false;
+  }
+  live_frames_.Finish();
+  ind_t_ = 0;
+  run_state_is_valid_ = false;
+  cpml_.Reset();
+  dispersion_.Reset();
+  monitors_.Reset();
+  for (auto& subgrid : subgrids_) {
+    subgrid.Reset();
+  }
   
+  // with the first touch placement the threads zero their own chunks
+  fields_need_first_touch_ = first_touch_;
+  if (first_touch_) {
+    return;
+  }
   for(IntNumber i=0; i<num_x_ - 1; ++i){
     e_field_[i] = 0.0;
     h_field_[i] = 0.0;
@@ -38,22 +101,63 @@ void FDTD1D::InitializeAndResetEMFieldArrays() {
   e_field_[num_x_ - 1] = 0.0;
 }
 
-void FDTD1D::SetStabilityFactorAndTimeResolution(
-    const RealNumber stability_factor) {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetStabilityFactorAndTimeResolution(
+    const SourceReal stability_factor) {
+  using Constants = PhysicalConstants<SourceReal>;
   stability_factor_ = stability_factor;
+  run_state_is_valid_ = false;
   
   // the duration of time step is calculated using the grid spacing dx_ and the
-  // specified stability factor
-  dt_ = stability_factor*dx_ / PhysicalConstants::c;
+  // specified stability factor. The fourth order differences amplify the 
+  // shortest waves by 9/8 + 1/24 = 7/6, which lowers the largest stable 
+  // Courant number from 1 to 6/7.
+  if (space_order_ == 4) {
+    dt_ = stability_factor*SourceReal(6)/SourceReal(7)*dx_ / Constants::c;
+  } else {
+    dt_ = stability_factor*dx_ / Constants::c;
+  }
+  
+  source_dt_dx_eps0_ = dt_/(dx_*Constants::epsilon_0);
+  dt_dx_eps0_ = static_cast<Real>(source_dt_dx_eps0_);
+  dt_dx_mu0_ = static_cast<Real>(dt_/(dx_*Constants::mu_0));
+  e_near_coefficient_ = static_cast<Real>(
+      source_dt_dx_eps0_*kFourthOrderNearWeight);
+  e_far_coefficient_ = static_cast<Real>(
+      source_dt_dx_eps0_*kFourthOrderFarWeight);
+  h_near_coefficient_ = static_cast<Real>(
+      dt_/(dx_*Constants::mu_0)*kFourthOrderNearWeight);
+  h_far_coefficient_ = static_cast<Real>(
+      dt_/(dx_*Constants::mu_0)*kFourthOrderFarWeight);
 }
 
-void FDTD1D::SetSimulationTime(const RealNumber t_final) {
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetSpatialOrder(const int space_order) {
+  if (space_order != 2 && space_order != 4) {
+    std::cout << "The spatial order " << space_order << " is not supported,"
+              << " it should be 2 or 4." << std::endl;
+    return false;
+  }
+  if (space_order == 4 && (halo_transport_ != nullptr || !subgrids_.empty())) {
+    std::cout << "The fourth order stencils do not support the domain " 
+              << "decomposition and the subgrids." << std::endl;
+    return false;
+  }
+  space_order_ = space_order;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetSimulationTime(const SourceReal t_final) {
   t_final_ = t_final;
   num_t_ = static_cast<IntNumber>(t_final_ / dt_);
+  run_state_is_valid_ = false;
 } 
 
-void FDTD1D::SetNumberOfThreads(const int num_threads) {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetNumberOfThreads(const int num_threads) {
   num_threads_ = num_threads;
+  run_state_is_valid_ = false;
   
   // calculate the chunk associated to each thread
   thread_data_chunk_bounds_.reset(new IntNumber[num_threads + 1]);
@@ -65,171 +169,2025 @@ void FDTD1D::SetNumberOfThreads(const int num_threads) {
   }
 }
 
-void FDTD1D::SetTheWriteToFileFlag(bool write_fields_to_file) {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetSynchronizationMode(const BarrierMode mode) {
+  barrier_mode_ = mode;
+  run_state_is_valid_ = false;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetTimeSteppingEngine(
+    const TimeSteppingEngine engine) {
+  time_stepping_engine_ = engine;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetTemporalBlockingParameters(
+    const int tile_depth, const IntNumber tile_width) {
+  tile_depth_ = tile_depth;
+  tile_width_ = tile_width;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetActiveRegionTracking(
+    const bool track_active_region) {
+  track_active_region_ = track_active_region;
+  run_state_is_valid_ = false;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetKernelType(const KernelType kernel_type) {
+  kernel_type_ = kernel_type;
+  kernels_ = &GetYeeKernels<Real>(kernel_type);
+  if (kernels_->type != kernel_type && kernel_type != KernelType::kAuto) {
+    std::cout << "The " << GetKernelTypeName(kernel_type) << " kernels are "
+              << "not supported by the processor." << std::endl;
+  }
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetDomainDecomposition(
+    HaloTransport* transport, const int rank, const int num_ranks) {
+  const IntNumber num_x = (halo_transport_ != nullptr) ? global_num_x_ : num_x_;
+  if (num_ranks < 1 || rank < 0 || rank >= num_ranks || 
+      num_x / num_ranks < 2) {
+    std::cout << "The " << num_x << " grid points can not be shared by " 
+              << num_ranks << " ranks." << std::endl;
+    return false;
+  }
+  // the ghost nodes hold one node of each neighbor, as much as the second 
+  // order stencils reach
+  if (num_ranks > 1 && space_order_ != 2) {
+    std::cout << "The domain decomposition requires the second order " 
+              << "stencils." << std::endl;
+    return false;
+  }
+  halo_transport_ = (num_ranks > 1) ? transport : nullptr;
+  rank_ = rank;
+  num_ranks_ = num_ranks;
+  global_num_x_ = num_x;
+  
+  // the owned E nodes and one ghost node on each side that has a neighbor
+  const IntNumber x_begin = num_x*rank / num_ranks;
+  const IntNumber x_end = num_x*(rank + 1) / num_ranks;
+  grid_offset_ = std::max<IntNumber>(x_begin - 1, 0);
+  num_x_ = std::min<IntNumber>(x_end + 1, num_x) - grid_offset_;
+  owned_x_begin_ = x_begin - grid_offset_;
+  owned_x_end_ = x_end - grid_offset_;
+  run_state_is_valid_ = false;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetAbsorbingBoundaries(
+    const CPMLParameters& parameters) {
+  using Constants = PhysicalConstants<SourceReal>;
+  const IntNumber num_x = (halo_transport_ != nullptr) ? global_num_x_ : num_x_;
+  if (!cpml_.Initialize(parameters, num_x, grid_offset_, num_x_, 
+                        static_cast<double>(dx_), 
+                        static_cast<double>(dt_/Constants::epsilon_0))) {
+    std::cout << "The absorbing layers of " << parameters.thickness 
+              << " cells do not fit in the " << num_x << " grid points." 
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetMaterials(
+    const std::vector<MaterialRegion>& regions) {
+  using Constants = PhysicalConstants<SourceReal>;
+  if (!materials_.Build(regions, grid_offset_, num_x_, 
+                        static_cast<double>(x0_), static_cast<double>(dx_),
+                        static_cast<double>(dt_/Constants::epsilon_0),
+                        static_cast<double>(source_dt_dx_eps0_),
+                        static_cast<double>(dt_/(dx_*Constants::mu_0)))) {
+    std::cout << "The materials are not valid." << std::endl;
+    return false;
+  }
+  material_regions_ = regions;
+  run_state_is_valid_ = false;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetDispersiveMedia(
+    const std::vector<DispersiveRegion>& regions) {
+  using Constants = PhysicalConstants<SourceReal>;
+  if (!dispersion_.Build(regions, grid_offset_, num_x_, 
+                         static_cast<double>(x0_), static_cast<double>(dx_),
+                         static_cast<double>(dt_), 
+                         static_cast<double>(dt_*Constants::c/dx_),
+                         static_cast<double>(source_dt_dx_eps0_))) {
+    std::cout << "The dispersive media overlap or are not stable at the " 
+              << "time step " << dt_ << "." << std::endl;
+    return false;
+  }
+  dispersive_regions_ = regions;
+  run_state_is_valid_ = false;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetMonitors(
+    const std::vector<double>& probes, 
+    const std::vector<DFTMonitorRegion>& dft_regions) {
+  const bool is_decomposed = (halo_transport_ != nullptr);
+  if (!monitors_.Build(probes, dft_regions, grid_offset_, 
+                       is_decomposed ? owned_x_begin_ : 0, 
+                       is_decomposed ? owned_x_end_ : num_x_,
+                       is_decomposed ? global_num_x_ : num_x_,
+                       static_cast<double>(x0_), static_cast<double>(dx_),
+                       static_cast<double>(dt_), num_t_)) {
+    std::cout << "The monitors are not inside of the grid." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetSubgrids(
+    const std::vector<SubgridRegion>& regions) {
+  if (!regions.empty() && space_order_ != 2) {
+    std::cout << "The subgrids require the second order stencils." 
+              << std::endl;
+    return false;
+  }
+  const bool is_decomposed = (halo_transport_ != nullptr);
+  const IntNumber num_x = is_decomposed ? global_num_x_ : num_x_;
+  const IntNumber owned_begin = is_decomposed ? owned_x_begin_ : 0;
+  const IntNumber owned_end = is_decomposed ? owned_x_end_ : num_x_;
+  // the global coarse nodes of the regions
+  std::vector<std::pair<IntNumber, IntNumber>> extents;
+  for (const SubgridRegion& region : regions) {
+    extents.emplace_back(
+        static_cast<IntNumber>(std::lround((region.x_begin - x0_) / dx_)),
+        static_cast<IntNumber>(std::lround((region.x_end - x0_) / dx_)));
+  }
+  std::vector<std::pair<IntNumber, IntNumber>> sorted_extents = extents;
+  std::sort(sorted_extents.begin(), sorted_extents.end());
+  // the checks are global, so that all the ranks accept or reject the 
+  // subgrids together
+  const IntNumber thickness = cpml_.get_parameters().thickness;
+  bool is_valid = true;
+  for (std::size_t k = 0; k < sorted_extents.size(); ++k) {
+    const IntNumber begin = sorted_extents[k].first;
+    const IntNumber end = sorted_extents[k].second;
+    is_valid = is_valid && end - begin >= 2 && 
+               begin >= std::max<IntNumber>(thickness, 1) && 
+               end <= num_x - 2 - thickness &&
+               (k == 0 || sorted_extents[k - 1].second < begin);
+    // the rank owning begin also owns end
+    for (int rank = 1; rank < num_ranks_ && is_decomposed; ++rank) {
+      const IntNumber rank_begin = num_x*rank / num_ranks_;
+      is_valid = is_valid && (rank_begin <= begin || rank_begin > end);
+    }
+  }
+  if (!is_valid) {
+    std::cout << "The subgrids should hold at least two cells and should not"
+              << " overlap or cross the ends of the grid, the absorbing " 
+              << "layers or the ranks." << std::endl;
+    return false;
+  }
+  
+  subgrids_.clear();
+  for (std::size_t k = 0; k < regions.size(); ++k) {
+    IntNumber begin = extents[k].first - grid_offset_;
+    IntNumber end = extents[k].second - grid_offset_;
+    if (begin >= owned_end || end < owned_begin) {
+      continue;
+    }
+    Subgrid<Real, SourceReal> subgrid;
+    if (!subgrid.Initialize(begin, end, regions[k].ratio, 
+                            static_cast<double>(x0_ + extents[k].first*dx_), 
+                            static_cast<double>(dx_), 
+                            static_cast<double>(dt_), material_regions_, 
+                            dispersive_regions_)) {
+      std::cout << "The media of the subgrids are not valid." << std::endl;
+      return false;
+    }
+    subgrids_.push_back(std::move(subgrid));
+  }
+  std::sort(subgrids_.begin(), subgrids_.end(), 
+            [](Subgrid<Real, SourceReal>& a, Subgrid<Real, SourceReal>& b) {
+              return a.get_begin() < b.get_begin();
+            });
+  run_state_is_valid_ = false;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::WriteMonitors(const std::string& file_prefix) {
+  if (!monitors_.is_enabled()) {
+    return true;
+  }
+  return monitors_.Write(GetCheckpointFileName(file_prefix));
+}
+
+template <typename Real, typename SourceReal>
+int FDTD1D<Real, SourceReal>::get_num_threads() {
+  return num_threads_;
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1D<Real, SourceReal>::get_num_x() {
+  return num_x_;
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1D<Real, SourceReal>::get_num_t() {
+  return num_t_;
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1D<Real, SourceReal>::get_ind_t() {
+  return ind_t_;
+}
+
+template <typename Real, typename SourceReal>
+SourceReal FDTD1D<Real, SourceReal>::get_time() {
+  return ind_t_*dt_;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetThreadAffinity(const AffinityPolicy policy,
+                                                 const std::vector<int>& cpus) {
+  affinity_policy_ = policy;
+  affinity_cpus_ = cpus;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetMemoryPlacement(const bool first_touch,
+                                                  const bool huge_pages) {
+  first_touch_ = first_touch;
+  huge_pages_ = huge_pages;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetLoadBalancing(const bool enable,
+                                                const IntNumber interval,
+                                                const double threshold) {
+  load_balancing_ = enable;
+  load_balancing_interval_ = std::max<IntNumber>(interval, 1);
+  load_balancing_threshold_ = threshold;
+  run_state_is_valid_ = false;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetProfiling(const bool enable,
+                                            const bool use_hardware_counters) {
+  profiler_.SetEnabled(enable, use_hardware_counters);
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::WriteProfileReport(
+    const std::string& file_name, const ProfileReportFormat format) {
+  return profiler_.WriteReport(file_name, format, profile_run_info_);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetCheckpointing(const std::string& file_name,
+                                                const IntNumber interval) {
+  checkpoint_file_name_ = file_name;
+  checkpoint_interval_ = std::max<IntNumber>(interval, 0);
+  run_state_is_valid_ = false;
+}
+
+template <typename Real, typename SourceReal>
+std::string FDTD1D<Real, SourceReal>::GetCheckpointFileName(
+    const std::string& file_name) {
+  if (halo_transport_ == nullptr) {
+    return file_name;
+  }
+  return file_name + "." + std::to_string(rank_);
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::RestoreCheckpoint(
+    const std::string& file_name) {
+  std::string checkpoint_name = GetCheckpointFileName(file_name);
+  CheckpointFile checkpoint;
+  std::string error;
+  if (!checkpoint.Open(checkpoint_name, &error)) {
+    std::cout << "Can not restore the checkpoint: " << error << std::endl;
+    return false;
+  }
+  const CheckpointHeader& header = checkpoint.get_header();
+  if (header.real_size != sizeof(Real) || 
+      header.source_real_size != sizeof(SourceReal) ||
+      header.rank != rank_ || header.num_ranks != num_ranks_ ||
+      header.num_x != num_x_ || header.grid_offset != grid_offset_ ||
+      header.x0 != static_cast<double>(x0_) || 
+      header.dx != static_cast<double>(dx_) || 
+      header.dt != static_cast<double>(dt_) || header.ind_t > num_t_) {
+    std::cout << "The checkpoint " << checkpoint_name << " was written with "
+              << "another grid, time step, precision or decomposition." 
+              << std::endl;
+    return false;
+  }
+  std::vector<std::unique_ptr<PointSource<SourceReal>>> sources;
+  if (!DecodeCheckpointSources(checkpoint.get_sources(), header.sources_size,
+                               header.num_sources, &sources)) {
+    std::cout << "The sources of the checkpoint " << checkpoint_name 
+              << " are corrupted." << std::endl;
+    return false;
+  }
+  if (!SetAuxiliaryState(checkpoint.get_auxiliary(), header.auxiliary_size)) {
+    std::cout << "The checkpoint " << checkpoint_name << " was written with "
+              << "other absorbing boundaries, dispersive media, monitors " 
+              << "or subgrids." 
+              << std::endl;
+    return false;
+  }
+  point_sources_.clear();
+  for (auto& source : sources) {
+    InsertPointSource(std::move(source));
+  }
+  
+  const Real* e_field = static_cast<const Real*>(checkpoint.get_e_field());
+  const Real* h_field = static_cast<const Real*>(checkpoint.get_h_field());
+  std::copy(e_field, e_field + num_x_, e_field_.get());
+  std::copy(h_field, h_field + num_x_ - 1, h_field_.get());
+  fields_need_first_touch_ = false;
+  ind_t_ = header.ind_t;
+  run_state_is_valid_ = false;
+  std::cout << "Resuming at the time step " << ind_t_ << " from " 
+            << checkpoint_name << std::endl;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetTheWriteToFileFlag(
+    bool write_fields_to_file) {
   write_fields_to_file_ = write_fields_to_file;
 }
 
-void FDTD1D::InsertGaussianPointSource(const RealNumber position, 
-                                       const RealNumber amplitude, 
-                                       const RealNumber t_center, 
-                                       const RealNumber t_decay) {
-  GaussianSource j_gaussian(position, amplitude, t_center, t_decay);
-  IntNumber ind_x = static_cast<IntNumber>((position - x0_)/dx_);
-  j_gaussian.set_index_x(ind_x);
-  point_sources_.emplace_back(j_gaussian);
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InsertPointSource(
+    std::unique_ptr<PointSource<SourceReal>> source) {
+  IntNumber ind_x = static_cast<IntNumber>((source->get_position() - x0_)/dx_);
+  // with domain decomposition the sources are applied by the rank owning 
+  // their node, the others place them outside of the grid
+  if (halo_transport_ != nullptr) {
+    ind_x -= grid_offset_;
+    if (ind_x < owned_x_begin_ || ind_x >= owned_x_end_) {
+      ind_x = -1;
+    }
+  }
+  source->set_index_x(ind_x);
+  point_sources_.emplace_back(std::move(source));
+  run_state_is_valid_ = false;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::ClearPointSources() {
+  point_sources_.clear();
+  prepared_sources_.clear();
+  run_state_is_valid_ = false;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InsertGaussianPointSource(
+    const SourceReal position, const SourceReal amplitude, 
+    const SourceReal t_center, const SourceReal t_decay) {
+  InsertPointSource(std::unique_ptr<PointSource<SourceReal>>(
+      new GaussianSource<SourceReal>(position, amplitude, t_center, t_decay)));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InsertModulatedGaussianPointSource(
+    const SourceReal position, const SourceReal amplitude, 
+    const SourceReal t_center, const SourceReal t_decay, 
+    const SourceReal frequency, const SourceReal phase) {
+  InsertPointSource(std::unique_ptr<PointSource<SourceReal>>(
+      new ModulatedGaussianSource<SourceReal>(position, amplitude, t_center,
+                                              t_decay, frequency, phase)));
 }
 
-void FDTD1D::UpdateElectricENodes(const int thread_index, 
-                                  const UpdateState& nextState) {
-  RealNumber dt_dx_eps0 = dt_/(dx_*PhysicalConstants::epsilon_0);
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InsertSinusoidalPointSource(
+    const SourceReal position, const SourceReal amplitude, 
+    const SourceReal frequency, const SourceReal phase, 
+    const SourceReal t_start) {
+  InsertPointSource(std::unique_ptr<PointSource<SourceReal>>(
+      new SinusoidalSource<SourceReal>(position, amplitude, frequency, phase,
+                                       t_start)));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InsertTabulatedPointSource(
+    const SourceReal position, const SourceReal t_start, 
+    const SourceReal sample_dt, const std::vector<SourceReal>& samples) {
+  InsertPointSource(std::unique_ptr<PointSource<SourceReal>>(
+      new TabulatedSource<SourceReal>(position, t_start, sample_dt, samples)));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::PrepareSources() {
+  prepared_sources_.clear();
+  IntNumber waveforms_size = 0;
+  for (auto& source : point_sources_) {
+    PreparedSource prepared = {source->get_index_x(), 0, num_t_, 
+                               source_dt_dx_eps0_, -1, source.get()};
+    // the current of a source in a medium charges the larger permittivity
+    double factor = 1.0;
+    if (!dispersion_.GetCurrentFactor(prepared.index_x, &factor) &&
+        materials_.is_enabled()) {
+      factor = materials_.GetCurrentFactor(prepared.index_x);
+    }
+    prepared.dt_dx_eps = static_cast<SourceReal>(source_dt_dx_eps0_*factor);
+    
+    // the time steps of the active window with a margin of one step for the
+    // rounding of ind_t*dt_
+    SourceReal t_begin, t_end;
+    source->GetActiveTimeWindow(&t_begin, &t_end);
+    SourceReal step_begin = std::floor(t_begin / dt_) - 1;
+    SourceReal step_end = std::ceil(t_end / dt_) + 2;
+    if (step_begin > 0) {
+      prepared.ind_t_begin = std::min<IntNumber>(
+          num_t_, static_cast<IntNumber>(step_begin));
+    }
+    if (step_end < num_t_) {
+      prepared.ind_t_end = std::max<IntNumber>(
+          prepared.ind_t_begin, static_cast<IntNumber>(step_end));
+    }
+    
+    IntNumber window_size = prepared.ind_t_end - prepared.ind_t_begin;
+    if (window_size <= kMaxTabulatedSteps) {
+      prepared.waveform_offset = waveforms_size;
+      waveforms_size += window_size;
+    }
+    prepared_sources_.push_back(prepared);
+  }
+  source_waveforms_.resize(waveforms_size);
+  std::stable_sort(prepared_sources_.begin(), prepared_sources_.end(),
+                   [](const PreparedSource& a, const PreparedSource& b) {
+                     return a.index_x < b.index_x;
+                   });
   
-  // Maxwell-Ampere law 
-  // update the inside of each chunk except its end points
-  for (IntNumber i = thread_data_chunk_bounds_[thread_index] + 1;
-      i < thread_data_chunk_bounds_[thread_index + 1]; ++i) {
-      e_field_[i] -= (h_field_[i] - h_field_[i - 1])*dt_dx_eps0;
+  // the sources covered by a subgrid are applied to the fine grid. Their 
+  // coarse nodes are overwritten by the subgrid.
+  for (auto& subgrid : subgrids_) {
+    subgrid.ClearSources();
+    for (auto& prepared : prepared_sources_) {
+      if (prepared.index_x > subgrid.get_begin() && 
+          prepared.index_x < subgrid.get_end()) {
+        subgrid.AddPointSource(prepared.source, prepared.ind_t_begin, 
+                               prepared.ind_t_end);
+      }
+    }
   }
   
-  // update the end point of the chunk if necessary
-  // each thread updates the beginning point of its associated chunk
-  // the end point is therefore automatically updated by the next thread
-  IntNumber ind_bound_0 = thread_data_chunk_bounds_[thread_index];
-  if (thread_index != 0) {
-    e_field_[ind_bound_0] -= 
-        (h_field_[ind_bound_0] - h_field_[ind_bound_0 - 1])*dt_dx_eps0;
+  // the sources of each chunk. The sources outside of the grid are never 
+  // applied.
+  thread_source_bounds_.resize(num_threads_ + 1);
+  for (int i = 0; i <= num_threads_; ++i) {
+    thread_source_bounds_[i] = std::lower_bound(
+        prepared_sources_.begin(), prepared_sources_.end(), 
+        thread_data_chunk_bounds_[i],
+        [](const PreparedSource& a, const IntNumber ind_x) {
+          return a.index_x < ind_x;
+        }) - prepared_sources_.begin();
   }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::TabulateSourceWaveforms(
+    const int thread_index) {
+  for (std::size_t s = thread_source_bounds_[thread_index]; 
+       s < thread_source_bounds_[thread_index + 1]; ++s) {
+    PreparedSource& prepared = prepared_sources_[s];
+    if (prepared.waveform_offset < 0) {
+      continue;
+    }
+    // the contributions are calculated as in the E update. The leading and 
+    // trailing contributions that are exactly +0 do not change E and are 
+    // dropped from the window.
+    SourceReal* waveform = source_waveforms_.data() + prepared.waveform_offset;
+    IntNumber window_size = prepared.ind_t_end - prepared.ind_t_begin;
+    for (IntNumber k = 0; k < window_size; ++k) {
+      SourceReal t = (prepared.ind_t_begin + k)*dt_;
+      waveform[k] = prepared.source->GetCurrentValue(t)*prepared.dt_dx_eps;
+    }
+    auto IsPositiveZero = [](const SourceReal value) {
+      return value == 0 && !std::signbit(value);
+    };
+    IntNumber k_begin = 0;
+    IntNumber k_end = window_size;
+    while (k_begin < k_end && IsPositiveZero(waveform[k_begin])) {
+      ++k_begin;
+    }
+    while (k_end > k_begin && IsPositiveZero(waveform[k_end - 1])) {
+      --k_end;
+    }
+    prepared.ind_t_end = prepared.ind_t_begin + k_end;
+    prepared.ind_t_begin += k_begin;
+    prepared.waveform_offset += k_begin;
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::FirstTouchFields(const int thread_index) {
+  if (!fields_need_first_touch_) {
+    return;
+  }
+  const IntNumber ind_begin = thread_data_chunk_bounds_[thread_index];
+  const IntNumber ind_end = thread_data_chunk_bounds_[thread_index + 1];
+  std::fill(e_field_.get() + ind_begin, e_field_.get() + ind_end, Real(0));
+  std::fill(h_field_.get() + ind_begin, 
+            h_field_.get() + std::min(ind_end, num_x_ - 1), Real(0));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateElectricENodes(const int thread_index) {
+  const IntNumber ind_begin = active_chunk_bounds_[thread_index];
+  const IntNumber ind_end = active_chunk_bounds_[thread_index + 1];
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t_begin = load_balancing_ ? ProfileNow() : 0;
+  if (profile == nullptr) {
+    UpdateElectricENodesInRange(ind_begin, ind_end, ind_t_);
+  } else {
+    std::int64_t t = ProfileNow();
+    UpdateElectricENodesInRangeWithoutSources(ind_begin, ind_end);
+    t = profile->Record(ProfilePhase::kEUpdate, t);
+    ApplyPointSourcesInRange(ind_begin, ind_end, ind_t_);
+    t = profile->Record(ProfilePhase::kSources, t);
+    if (monitors_.is_enabled()) {
+      RecordMonitorsInRange(ind_begin, ind_end, ind_t_);
+      profile->Record(ProfilePhase::kOutput, t);
+    }
+    profile->num_e_nodes += CountActiveNodes(
+        std::max<IntNumber>(ind_begin, 1), 
+        std::min<IntNumber>(ind_end, num_x_ - 1));
+  }
+  if (load_balancing_) {
+    chunk_costs_[thread_index].time += ProfileNow() - t_begin;
+    chunk_costs_[thread_index].num_nodes += 
+        CountActiveNodes(ind_begin, ind_end);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateMagneticHNodes(const int thread_index) {
+  const IntNumber ind_begin = active_chunk_bounds_[thread_index];
+  const IntNumber ind_end = active_chunk_bounds_[thread_index + 1];
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t_begin = load_balancing_ ? ProfileNow() : 0;
+  if (profile == nullptr) {
+    UpdateMagneticHNodesInRange(ind_begin, ind_end);
+  } else {
+    std::int64_t t = ProfileNow();
+    UpdateMagneticHNodesInRange(ind_begin, ind_end);
+    profile->Record(ProfilePhase::kHUpdate, t);
+    profile->num_h_nodes += CountActiveNodes(ind_begin, 
+        std::min<IntNumber>(ind_end, num_x_ - 1));
+  }
+  if (load_balancing_) {
+    chunk_costs_[thread_index].time += ProfileNow() - t_begin;
+  }
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1D<Real, SourceReal>::CountActiveNodes(const IntNumber ind_begin,
+                                                     const IntNumber ind_end) {
+  IntNumber num_nodes = 0;
+  ForEachActiveRange(ind_begin, ind_end, [&num_nodes](const IntNumber begin,
+                                                      const IntNumber end) {
+    num_nodes += end - begin;
+  });
+  return num_nodes;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::WaitAtBarrier(const int thread_index,
+                                             const ProfilePhase phase) {
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  if (profile == nullptr) {
+    barrier_.Wait(thread_index);
+    return;
+  }
+  std::int64_t t = ProfileNow();
+  barrier_.Wait(thread_index);
+  profile->Record(phase, t);
+}
+
+template <typename Real, typename SourceReal>
+template <typename Function>
+void FDTD1D<Real, SourceReal>::WaitAtBarrier(const int thread_index,
+                                             const ProfilePhase phase,
+                                             Function completion) {
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  if (profile == nullptr) {
+    barrier_.Wait(thread_index, completion);
+    return;
+  }
+  std::int64_t t = ProfileNow();
+  barrier_.Wait(thread_index, completion);
+  profile->Record(phase, t);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InitializeActiveRegion() {
+  active_intervals_.clear();
+  pending_sources_.clear();
+  next_pending_source_ = 0;
+  active_region_step_ = ind_t_ - 1;
+  active_chunk_bounds_.assign(thread_data_chunk_bounds_.get(), 
+                              thread_data_chunk_bounds_.get() + 
+                              num_threads_ + 1);
+  // the fields entering through the halos are not tracked
+  if (!track_active_region_ || halo_transport_ != nullptr) {
+    active_intervals_.emplace_back(0, num_x_);
+    active_region_is_full_ = true;
+    return;
+  }
+  active_region_is_full_ = false;
+  
+  // the hull of the non-zero nodes. -0 counts as non-zero because the update 
+  // of a -0 node can turn it into +0.
+  auto IsNonZero = [](const Real value) {
+    return value != 0 || std::signbit(value);
+  };
+  // the fields that were just zeroed by FirstTouchFields are not scanned
+  IntNumber ind_first = num_x_;
+  IntNumber ind_last = -1;
+  for (IntNumber i = 0; i < num_x_ && !fields_need_first_touch_; ++i) {
+    if (IsNonZero(e_field_[i]) || (i < num_x_ - 1 && IsNonZero(h_field_[i]))) {
+      ind_first = std::min(ind_first, i);
+      ind_last = i;
+    }
+  }
+  if (ind_first <= ind_last) {
+    active_intervals_.emplace_back(ind_first, ind_last + 1);
+  }
+  // the fine grids are not tracked, the coarse nodes and the H nodes they 
+  // cover stay active
+  for (auto& subgrid : subgrids_) {
+    active_intervals_.emplace_back(subgrid.get_begin(), 
+                                   subgrid.get_end() + 1);
+  }
+  std::sort(active_intervals_.begin(), active_intervals_.end());
   
-  // takes into account the effect of the electric current
-  RealNumber t = ind_t_*dt_;
-  for (auto& j : point_sources_) {
-    auto ind_j = j.get_index_x();
-    auto j_value = j.GetCurrentValue(t);
-    if (ind_j >= thread_data_chunk_bounds_[thread_index] && 
-        ind_j < thread_data_chunk_bounds_[thread_index + 1]) {
-      e_field_[ind_j] -= j_value*dt_dx_eps0;
+  for (auto& source : prepared_sources_) {
+    if (source.index_x >= 0 && source.index_x < num_x_ &&
+        source.ind_t_begin < source.ind_t_end && source.ind_t_end > ind_t_) {
+      pending_sources_.emplace_back(std::max(source.ind_t_begin, ind_t_),
+                                    source.index_x);
     }
   }
+  std::sort(pending_sources_.begin(), pending_sources_.end());
+  fields_need_first_touch_ = false;
+}
 
-  // job done --> increase num_of_e_updated_threads_
-  num_of_e_updated_threads_ += 1;
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::AdvanceActiveRegion(const IntNumber ind_t) {
+  if (active_region_is_full_ || ind_t <= active_region_step_) {
+    return;
+  }
+  // the fields spread by one node per time step with the second order 
+  // stencils and by three nodes with the fourth order stencils, whose E and 
+  // H updates both reach one and a half cells away
+  const IntNumber reach = space_order_ - 1;
+  IntNumber growth = (ind_t - active_region_step_)*reach;
+  for (auto& interval : active_intervals_) {
+    interval.first -= growth;
+    interval.second += growth;
+  }
+  
+  // a source applied at the E node x at the time step ind_t_source can reach 
+  // the E nodes [x - r, x + r] and the H nodes [x - r - 1, x + r] at the time
+  // step ind_t_source + r with the second order stencils, and the E nodes 
+  // [x - 3r, x + 3r] and the H nodes [x - 3r - 2, x + 3r + 1] with the fourth
+  // order stencils. One node is added on each side as a safety margin.
+  bool is_sorted = true;
+  while (next_pending_source_ < pending_sources_.size() && 
+         pending_sources_[next_pending_source_].first <= ind_t) {
+    IntNumber r = ind_t - pending_sources_[next_pending_source_].first;
+    IntNumber x = pending_sources_[next_pending_source_].second;
+    active_intervals_.emplace_back(x - r*reach - reach - 1, 
+                                   x + r*reach + reach + 1);
+    is_sorted = false;
+    ++next_pending_source_;
+  }
+  if (!is_sorted) {
+    std::sort(active_intervals_.begin(), active_intervals_.end());
+  }
+  
+  // clips the intervals to the grid and merges the overlapping intervals
+  std::size_t num_merged = 0;
+  for (auto& interval : active_intervals_) {
+    IntNumber begin = std::max<IntNumber>(interval.first, 0);
+    IntNumber end = std::min<IntNumber>(interval.second, num_x_);
+    if (begin >= end) {
+      continue;
+    }
+    if (num_merged > 0 && begin <= active_intervals_[num_merged - 1].second) {
+      active_intervals_[num_merged - 1].second = 
+          std::max(active_intervals_[num_merged - 1].second, end);
+    } else {
+      active_intervals_[num_merged++] = std::make_pair(begin, end);
+    }
+  }
+  active_intervals_.resize(num_merged);
+  active_region_step_ = ind_t;
+  active_region_is_full_ = (num_merged == 1 && 
+                            active_intervals_[0].first == 0 &&
+                            active_intervals_[0].second == num_x_);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateActiveChunkBounds() {
+  if (active_region_is_full_ || first_touch_) {
+    std::copy(thread_data_chunk_bounds_.get(), 
+              thread_data_chunk_bounds_.get() + num_threads_ + 1,
+              active_chunk_bounds_.begin());
+    return;
+  }
+  if (active_intervals_.empty()) {
+    std::fill(active_chunk_bounds_.begin(), active_chunk_bounds_.end(), 0);
+    return;
+  }
+  if (load_balancing_) {
+    SplitByCost(active_intervals_, active_chunk_bounds_.data());
+    return;
+  }
+  IntNumber num_active_nodes = 0;
+  for (auto& interval : active_intervals_) {
+    num_active_nodes += interval.second - interval.first;
+  }
+  active_chunk_bounds_[0] = active_intervals_.front().first;
+  active_chunk_bounds_[num_threads_] = active_intervals_.back().second;
+  std::size_t k = 0;
+  IntNumber num_nodes_before = 0;    // active nodes before interval k
+  for (int i = 1; i < num_threads_; ++i) {
+    IntNumber target = num_active_nodes*i / num_threads_;
+    while (num_nodes_before + active_intervals_[k].second - 
+           active_intervals_[k].first < target) {
+      num_nodes_before += active_intervals_[k].second - 
+                          active_intervals_[k].first;
+      ++k;
+    }
+    active_chunk_bounds_[i] = active_intervals_[k].first + 
+                              target - num_nodes_before;
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InitializeLoadBalancing() {
+  cost_model_bounds_.assign({0, num_x_});
+  cost_model_densities_.assign({1.0});
+  chunk_costs_ = AllocateAlignedObjectArray<ChunkCost>(num_threads_);
+  num_rebalances_ = 0;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::BalanceLoad() {
+  if (!load_balancing_ || ind_t_ % load_balancing_interval_ != 0 ||
+      active_intervals_.empty()) {
+    return;
+  }
+  std::int64_t total_time = 0;
+  std::int64_t max_time = 0;
+  IntNumber total_nodes = 0;
+  for (int i = 0; i < num_threads_; ++i) {
+    total_time += chunk_costs_[i].time;
+    max_time = std::max(max_time, chunk_costs_[i].time);
+    total_nodes += chunk_costs_[i].num_nodes;
+  }
+  
+  // hysteresis: the chunks only move if the slowest thread is behind the 
+  // mean by more than the threshold
+  double mean_time = static_cast<double>(total_time) / num_threads_;
+  if (total_nodes > 0 && total_time > 0 && 
+      max_time > (1.0 + load_balancing_threshold_)*mean_time) {
+    // the cost per node of each chunk is attributed to the nodes of the last
+    // chunk of the thread. The threads without nodes get the mean cost and
+    // the costs are kept positive so that every node has a cost.
+    double mean_density = static_cast<double>(total_time) / total_nodes;
+    cost_model_bounds_.assign(active_chunk_bounds_.begin(), 
+                              active_chunk_bounds_.end());
+    cost_model_bounds_.front() = 0;
+    cost_model_bounds_.back() = num_x_;
+    cost_model_densities_.resize(num_threads_);
+    for (int i = 0; i < num_threads_; ++i) {
+      double density = mean_density;
+      if (chunk_costs_[i].num_nodes > 0) {
+        density = static_cast<double>(chunk_costs_[i].time) / 
+                  chunk_costs_[i].num_nodes;
+      }
+      cost_model_densities_[i] = std::max(density, 1.0e-3*mean_density);
+    }
+    std::vector<std::pair<IntNumber, IntNumber>> grid(1, 
+        std::make_pair(IntNumber(0), num_x_));
+    SplitByCost(grid, thread_data_chunk_bounds_.get());
+    ++num_rebalances_;
+  }
+  for (int i = 0; i < num_threads_; ++i) {
+    chunk_costs_[i].time = 0;
+    chunk_costs_[i].num_nodes = 0;
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SplitByCost(
+    const std::vector<std::pair<IntNumber, IntNumber>>& intervals, 
+    IntNumber* bounds) {
+  // visits the pieces [begin, end) of the intervals with a constant cost per
+  // node in the cost model
+  auto ForEachPiece = [this, &intervals](auto function) {
+    std::size_t j = 0;
+    for (auto& interval : intervals) {
+      IntNumber begin = interval.first;
+      while (begin < interval.second) {
+        while (j + 1 < cost_model_densities_.size() && 
+               cost_model_bounds_[j + 1] <= begin) {
+          ++j;
+        }
+        IntNumber end = std::min(interval.second, cost_model_bounds_[j + 1]);
+        if (end <= begin) {
+          end = interval.second;
+        }
+        if (!function(begin, end, cost_model_densities_[j])) {
+          return;
+        }
+        begin = end;
+      }
+    }
+  };
+  double total_cost = 0.0;
+  ForEachPiece([&total_cost](IntNumber begin, IntNumber end, double density) {
+    total_cost += (end - begin)*density;
+    return true;
+  });
   
-  // if all the threads have completed their job set the state to the next state
-  if (num_of_e_updated_threads_ >= num_threads_) {
-    assert(num_of_e_updated_threads_ == num_threads_);
-    //std::cout << num_of_e_updated_threads_ << std::endl;
-    num_of_e_updated_threads_ = 0;
-    update_state_ = nextState;
+  bounds[0] = intervals.front().first;
+  bounds[num_threads_] = intervals.back().second;
+  int k = 1;
+  double cost_before = 0.0;     // the cost of the pieces before this one
+  ForEachPiece([&](IntNumber begin, IntNumber end, double density) {
+    double piece_cost = (end - begin)*density;
+    while (k < num_threads_ && 
+           cost_before + piece_cost >= total_cost*k / num_threads_) {
+      double target = total_cost*k / num_threads_;
+      IntNumber offset = std::llround((target - cost_before) / density);
+      bounds[k++] = std::min(begin + std::max<IntNumber>(offset, 0), end);
+    }
+    cost_before += piece_cost;
+    return k < num_threads_;
+  });
+  for (; k < num_threads_; ++k) {
+    bounds[k] = bounds[num_threads_];
   }
 }
 
-void FDTD1D::UpdateMagneticHNodes(const int thread_index, 
-                                  const UpdateState& nextState) {
-  RealNumber dt_dx_mu0 = dt_/(dx_*PhysicalConstants::mu_0);
+template <typename Real, typename SourceReal>
+template <typename Function>
+void FDTD1D<Real, SourceReal>::ForEachActiveRange(const IntNumber ind_begin,
+                                                  const IntNumber ind_end,
+                                                  Function function) {
+  auto interval = std::upper_bound(
+      active_intervals_.begin(), active_intervals_.end(), ind_begin,
+      [](const IntNumber ind_x, const std::pair<IntNumber, IntNumber>& a) {
+        return ind_x < a.second;
+      });
+  for (; interval != active_intervals_.end() && interval->first < ind_end;
+       ++interval) {
+    IntNumber begin = std::max(ind_begin, interval->first);
+    IntNumber end = std::min(ind_end, interval->second);
+    if (begin < end) {
+      function(begin, end);
+    }
+  }
+}
 
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateElectricENodesInRange(
+    const IntNumber ind_begin, const IntNumber ind_end, const IntNumber ind_t) {
+  UpdateElectricENodesInRangeWithoutSources(ind_begin, ind_end);
+  ApplyPointSourcesInRange(ind_begin, ind_end, ind_t);
+  if (monitors_.is_enabled()) {
+    RecordMonitorsInRange(ind_begin, ind_end, ind_t);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::RecordMonitorsInRange(
+    const IntNumber ind_begin, const IntNumber ind_end, const IntNumber ind_t) {
+  // the nodes covered by the subgrids only get their values once the 
+  // subgrids are advanced, see AdvanceSubgrids
+  IntNumber i = ind_begin;
+  for (auto& subgrid : subgrids_) {
+    const IntNumber covered_begin = subgrid.get_begin() + 1;
+    const IntNumber covered_end = subgrid.get_end();
+    if (covered_end <= i) {
+      continue;
+    }
+    if (covered_begin >= ind_end) {
+      break;
+    }
+    if (i < covered_begin) {
+      monitors_.Record(e_field_.get(), i, covered_begin, ind_t);
+    }
+    i = covered_end;
+  }
+  if (i < ind_end) {
+    monitors_.Record(e_field_.get(), i, ind_end, ind_t);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateSubgrids(const int thread_index) {
+  if (subgrids_.empty()) {
+    return;
+  }
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  const IntNumber chunk_0 = thread_data_chunk_bounds_[thread_index];
+  const IntNumber chunk_1 = thread_data_chunk_bounds_[thread_index + 1];
+  for (auto& subgrid : subgrids_) {
+    if (subgrid.get_begin() >= chunk_0 && subgrid.get_begin() < chunk_1) {
+      subgrid.Advance(*kernels_, e_field_.get(), ind_t_);
+    }
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kSubgridUpdate, t);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kSubgridWait, [this] {
+    for (auto& subgrid : subgrids_) {
+      subgrid.Restrict(e_field_.get());
+      if (monitors_.is_enabled()) {
+        monitors_.Record(e_field_.get(), subgrid.get_begin() + 1, 
+                         subgrid.get_end(), ind_t_);
+      }
+    }
+  });
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateElectricENodesInRangeWithoutSources(
+    const IntNumber ind_begin, const IntNumber ind_end) {
+  // Maxwell-Ampere law 
+  // The first and the last E nodes of the grid are on the boundaries of the 
+  // computational domain and are not updated.
+  IntNumber i_begin = std::max<IntNumber>(ind_begin, 1);
+  IntNumber i_end = std::min<IntNumber>(ind_end, num_x_ - 1);
+  if (!cpml_.is_enabled()) {
+    ForEachActiveRange(i_begin, i_end, [this](const IntNumber begin, 
+                                              const IntNumber end) {
+      UpdateInteriorENodes(begin, end);
+    });
+    return;
+  }
+  // the nodes of the absorbing layers at the ends of the range, the interior
+  // nodes with the kernels
+  const IntNumber left_end = cpml_.get_e_left_end();
+  const IntNumber right_begin = cpml_.get_e_right_begin();
+  ForEachActiveRange(i_begin, i_end, [this, left_end, right_begin](
+                                         const IntNumber begin, 
+                                         const IntNumber end) {
+    Real* e = e_field_.get();
+    const Real* h = h_field_.get();
+    cpml_.UpdateE(e, h, begin, std::min(end, left_end), dt_dx_eps0_);
+    IntNumber interior_begin = std::max(begin, left_end);
+    IntNumber interior_end = std::min(end, right_begin);
+    if (interior_begin < interior_end) {
+      UpdateInteriorENodes(interior_begin, interior_end);
+    }
+    cpml_.UpdateE(e, h, std::max(begin, right_begin), end, dt_dx_eps0_);
+  });
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::ApplyPointSourcesInRange(
+    const IntNumber ind_begin, const IntNumber ind_end, const IntNumber ind_t) {
+  // takes into account the effect of the electric current of the sources in
+  // [ind_begin, ind_end) that are active at ind_t. The contribution is 
+  // accumulated in the source precision.
+  auto source = std::lower_bound(
+      prepared_sources_.begin(), prepared_sources_.end(), ind_begin,
+      [](const PreparedSource& a, const IntNumber ind_x) {
+        return a.index_x < ind_x;
+      });
+  for (; source != prepared_sources_.end() && source->index_x < ind_end; 
+       ++source) {
+    if (ind_t < source->ind_t_begin || ind_t >= source->ind_t_end) {
+      continue;
+    }
+    SourceReal contribution;
+    if (source->waveform_offset >= 0) {
+      contribution = source_waveforms_[
+          source->waveform_offset + ind_t - source->ind_t_begin];
+    } else {
+      SourceReal t = ind_t*dt_;
+      contribution = source->source->GetCurrentValue(t)*source->dt_dx_eps;
+    }
+    e_field_[source->index_x] = static_cast<Real>(
+        e_field_[source->index_x] - contribution);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateMagneticHNodesInRange(
+    const IntNumber ind_begin, const IntNumber ind_end) {
   // Maxwell-Faraday law 
-  // the magnetic fields are all located inside the chunks
-  // update the inside of each chunk except its last point inside the chunk
-  for (IntNumber i = thread_data_chunk_bounds_[thread_index];
-      i < thread_data_chunk_bounds_[thread_index + 1] - 1; ++i) {
-    h_field_[i] -= (e_field_[i+1] - e_field_[i])*dt_dx_mu0;
-  }
-  
-  // update the last point inside the chunk as well, except for the last thread,
-  // for which it is calculated in the previous loop
-  IntNumber ind_bound_1 = thread_data_chunk_bounds_[thread_index + 1] - 1;
-  if (thread_index != num_threads_ - 1) {
-    h_field_[ind_bound_1] -= (e_field_[ind_bound_1+1] - e_field_[ind_bound_1])*
-                             dt_dx_mu0;
-  }
-  
-  // job done --> increase num_of_h_updated_threads_
-  num_of_h_updated_threads_ += 1;
-  
-  // if all the threads have completed their job set the state to the next state
-  if (num_of_h_updated_threads_ >= num_threads_) {
-    assert(num_of_h_updated_threads_ == num_threads_);
-    //std::cout << num_of_h_updated_threads_ << std::endl;
-    num_of_h_updated_threads_ = 0;
-    update_state_ = nextState;
-  }
-}
-
-// It starts with the initial state in kUpdateE, therefore the first while loop
-// is executed and all the threads update the E nodes in their chunks, and the 
-// next state is set to kUpdateH when the job is complete and all the threads
-// have returned.
-// then the second while loop is executed and all the threads update magnetic 
-// fields in their corresponding chunk, and at the end the state is again set
-// to kUpdateE.
-// he process is repeated until the final time step is passed.
-void FDTD1D::UpdateFieldsCuncurrently(const int thread_index) {
-  UpdateState nextState = UpdateState::kUpdateH;
-  for (IntNumber i = 0; i < num_t_; ++i) {
-    if (thread_index == 0) {
-      ind_t_ = i;
+  // Each H node is located between two E nodes and the H node i is updated 
+  // together with the E node i on its left side.
+  IntNumber i_end = std::min<IntNumber>(ind_end, num_x_ - 1);
+  if (!cpml_.is_enabled()) {
+    ForEachActiveRange(ind_begin, i_end, [this](const IntNumber begin, 
+                                                const IntNumber end) {
+      UpdateInteriorHNodes(begin, end);
+    });
+    return;
+  }
+  const IntNumber left_end = cpml_.get_h_left_end();
+  const IntNumber right_begin = cpml_.get_h_right_begin();
+  ForEachActiveRange(ind_begin, i_end, [this, left_end, right_begin](
+                                           const IntNumber begin, 
+                                           const IntNumber end) {
+    Real* h = h_field_.get();
+    const Real* e = e_field_.get();
+    cpml_.UpdateH(h, e, begin, std::min(end, left_end), dt_dx_mu0_);
+    IntNumber interior_begin = std::max(begin, left_end);
+    IntNumber interior_end = std::min(end, right_begin);
+    if (interior_begin < interior_end) {
+      UpdateInteriorHNodes(interior_begin, interior_end);
     }
-    
-    nextState = UpdateState::kUpdateH;
-    while(update_state_ != UpdateState::kUpdateE) {
+    cpml_.UpdateH(h, e, std::max(begin, right_begin), end, dt_dx_mu0_);
+  });
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateInteriorENodes(const IntNumber ind_begin,
+                                                    const IntNumber ind_end) {
+  if (!dispersion_.is_enabled()) {
+    UpdateNonDispersiveENodes(ind_begin, ind_end);
+    return;
+  }
+  // the nodes of the dispersive media are updated with their poles, the 
+  // nodes between them by the kernels
+  IntNumber i = ind_begin;
+  for (const auto& range : dispersion_.get_ranges()) {
+    if (range.second <= i) {
+      continue;
+    }
+    if (range.first >= ind_end) {
+      break;
     }
-    FDTD1D::UpdateElectricENodes(thread_index, nextState);
+    if (i < range.first) {
+      UpdateNonDispersiveENodes(i, range.first);
+    }
+    IntNumber end = std::min(ind_end, range.second);
+    dispersion_.UpdateE(e_field_.get(), h_field_.get(), 
+                        std::max(i, range.first), end);
+    i = end;
+  }
+  if (i < ind_end) {
+    UpdateNonDispersiveENodes(i, ind_end);
+  }
+}
 
-    nextState = UpdateState::kUpdateE;
-    while(update_state_ != UpdateState::kUpdateH) {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateNonDispersiveENodes(
+    const IntNumber ind_begin, const IntNumber ind_end) {
+  if (space_order_ == 2) {
+    UpdateENodesWithOrder(ind_begin, ind_end, 2);
+    return;
+  }
+  // the fourth order update of the E node i reads the H nodes [i - 2, i + 1],
+  // hence the E nodes 1 and num_x_ - 2 next to the walls keep the second 
+  // order update
+  const IntNumber inner_begin = std::min<IntNumber>(
+      std::max<IntNumber>(ind_begin, 2), ind_end);
+  const IntNumber inner_end = std::max<IntNumber>(
+      std::min<IntNumber>(ind_end, num_x_ - 2), inner_begin);
+  UpdateENodesWithOrder(ind_begin, inner_begin, 2);
+  UpdateENodesWithOrder(inner_begin, inner_end, space_order_);
+  UpdateENodesWithOrder(inner_end, ind_end, 2);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateInteriorHNodes(const IntNumber ind_begin,
+                                                    const IntNumber ind_end) {
+  if (space_order_ == 2) {
+    UpdateHNodesWithOrder(ind_begin, ind_end, 2);
+    return;
+  }
+  // the fourth order update of the H node i reads the E nodes [i - 1, i + 2]
+  const IntNumber inner_begin = std::min<IntNumber>(
+      std::max<IntNumber>(ind_begin, 1), ind_end);
+  const IntNumber inner_end = std::max<IntNumber>(
+      std::min<IntNumber>(ind_end, num_x_ - 2), inner_begin);
+  UpdateHNodesWithOrder(ind_begin, inner_begin, 2);
+  UpdateHNodesWithOrder(inner_begin, inner_end, space_order_);
+  UpdateHNodesWithOrder(inner_end, ind_end, 2);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateENodesWithOrder(
+    const IntNumber ind_begin, const IntNumber ind_end, 
+    const int space_order) {
+  if (ind_begin >= ind_end) {
+    return;
+  }
+  if (materials_.is_enabled()) {
+    materials_.UpdateE(*kernels_, e_field_.get(), h_field_.get(), ind_begin,
+                       ind_end, space_order);
+  } else if (space_order == 4) {
+    kernels_->update_e4(e_field_.get(), h_field_.get(), ind_begin, ind_end, 
+                        1, e_near_coefficient_, e_far_coefficient_);
+  } else {
+    kernels_->update_e(e_field_.get(), h_field_.get(), ind_begin, ind_end, 1,
+                       dt_dx_eps0_);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateHNodesWithOrder(
+    const IntNumber ind_begin, const IntNumber ind_end, 
+    const int space_order) {
+  if (ind_begin >= ind_end) {
+    return;
+  }
+  if (materials_.is_enabled()) {
+    materials_.UpdateH(*kernels_, h_field_.get(), e_field_.get(), ind_begin,
+                       ind_end, space_order);
+  } else if (space_order == 4) {
+    kernels_->update_h4(h_field_.get(), e_field_.get(), ind_begin, ind_end, 
+                        1, h_near_coefficient_, h_far_coefficient_);
+  } else {
+    kernels_->update_h(h_field_.get(), e_field_.get(), ind_begin, ind_end, 1,
+                       dt_dx_mu0_);
+  }
+}
+
+// All the threads update the E nodes in their chunks and wait at the barrier
+// until every thread is done. Then they update the H nodes in their chunks and
+// wait at the barrier again. The last thread arriving at the second barrier
+// advances the time index before the threads are released.
+// The process is repeated until the final time step is passed.
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateFieldsCuncurrently(
+    const int thread_index) {
+  // the run continues from ind_t_, which is not 0 after a restart
+  const IntNumber num_steps = ind_t_stop_ - ind_t_;
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  FirstTouchFields(thread_index);
+  if (!run_state_is_valid_) {
+    TabulateSourceWaveforms(thread_index);
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kSetup, t);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kSetupWait, [this] { 
+    if (!run_state_is_valid_) {
+      InitializeActiveRegion(); 
     }
-    FDTD1D::UpdateMagneticHNodes(thread_index, nextState);
+    AdvanceActiveRegion(ind_t_);
+    UpdateActiveChunkBounds();
+  });
+  
+  for (IntNumber i = 0; i < num_steps; ++i) {
+    UpdateElectricENodes(thread_index);
+    WaitAtBarrier(thread_index, ProfilePhase::kEWait, [this] { 
+      SubmitCheckpoint(); 
+      PublishLiveFrame();
+    });
+    UpdateSubgrids(thread_index);
+
+    UpdateMagneticHNodes(thread_index);
+    WaitAtBarrier(thread_index, ProfilePhase::kHWait, [this] { 
+      ++ind_t_; 
+      AdvanceActiveRegion(ind_t_);
+      BalanceLoad();
+      UpdateActiveChunkBounds();
+      BeginCheckpoint(ind_t_ - 1);
+      BeginLiveFrame(ind_t_ - 1);
+    });
+    CopyFieldsToCheckpoint(thread_index);
+    CopyFieldsToLiveFrame(thread_index);
   }
 }
 
-// similar to FDTD1D::UpdateFieldsCuncurrently except after the second while
-// loop the fields are written to the output file.
-void FDTD1D::UpdateFieldsAndWriteToFileCuncurrently(const int thread_index) {
-  UpdateState nextState = UpdateState::kUpdateH;
-  for (IntNumber i = 0; i < num_t_; ++i) {
-    if (thread_index == 0) {
-      ind_t_ = i;
+// similar to FDTD1D::UpdateFieldsCuncurrently except that after each 
+// time_stride time steps the fields are copied to a snapshot buffer. The last 
+// thread finishing the H update acquires the buffer, all the threads copy 
+// their chunks into it and the last thread finishing the next E update passes
+// it to the field writer thread. The threads only wait for the disk if all the
+// snapshot buffers are waiting to be written.
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateFieldsAndWriteToFileCuncurrently(
+    const int thread_index) {
+  const IntNumber num_steps = ind_t_stop_ - ind_t_;
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  FirstTouchFields(thread_index);
+  if (!run_state_is_valid_) {
+    TabulateSourceWaveforms(thread_index);
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kSetup, t);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kSetupWait, [this] { 
+    if (!run_state_is_valid_) {
+      InitializeActiveRegion(); 
     }
+    AdvanceActiveRegion(ind_t_);
+    UpdateActiveChunkBounds();
+  });
+  
+  const IntNumber time_stride = field_writer_.get_time_stride();
+  for (IntNumber i = 0; i < num_steps; ++i) {
+    UpdateElectricENodes(thread_index);
+    WaitAtBarrier(thread_index, ProfilePhase::kEWait, [this] { 
+      SubmitFieldSnapshot(); 
+      SubmitCheckpoint();
+      PublishLiveFrame();
+    });
+    UpdateSubgrids(thread_index);
 
-    nextState = UpdateState::kUpdateH;
-    while(update_state_ != UpdateState::kUpdateE) {
+    UpdateMagneticHNodes(thread_index);
+    WaitAtBarrier(thread_index, ProfilePhase::kHWait, [this, time_stride] { 
+      ++ind_t_; 
+      AdvanceActiveRegion(ind_t_);
+      BalanceLoad();
+      UpdateActiveChunkBounds();
+      if (ind_t_ % time_stride == 0) {
+        field_snapshot_ = field_writer_.AcquireBuffer();
+      }
+      BeginCheckpoint(ind_t_ - 1);
+      BeginLiveFrame(ind_t_ - 1);
+    });
+    
+    // the threads copy the nodes they update next, which the others do not
+    // modify before the snapshot is submitted
+    if (field_snapshot_ != nullptr) {
+      t = (profile != nullptr) ? ProfileNow() : 0;
+      ForEachSnapshotRange(thread_index, [this](const IntNumber begin,
+                                                const IntNumber end) {
+        field_writer_.CopyFieldsToBuffer(field_snapshot_, 
+            e_field_.get(), h_field_.get(), begin, end);
+      });
+      if (profile != nullptr) {
+        profile->Record(ProfilePhase::kOutput, t);
+      }
     }
-    FDTD1D::UpdateElectricENodes(thread_index, nextState);
+    CopyFieldsToCheckpoint(thread_index);
+    CopyFieldsToLiveFrame(thread_index);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kEWait, 
+                [this] { SubmitFieldSnapshot(); });
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SubmitFieldSnapshot() {
+  if (field_snapshot_ != nullptr) {
+    field_writer_.SubmitBuffer(field_snapshot_, ind_t_);
+    field_snapshot_ = nullptr;
+  }
+}
 
-    nextState = UpdateState::kUpdateOutputFile;
-    while(update_state_ != UpdateState::kUpdateH) {
+template <typename Real, typename SourceReal>
+template <typename Function>
+void FDTD1D<Real, SourceReal>::ForEachSnapshotRange(const int thread_index,
+                                                    Function function) {
+  IntNumber ind_begin = active_chunk_bounds_[thread_index];
+  IntNumber ind_end = active_chunk_bounds_[thread_index + 1];
+  if (thread_index == 0 && active_chunk_bounds_[0] > 0) {
+    function(IntNumber(0), active_chunk_bounds_[0]);
+  }
+  if (ind_begin < ind_end) {
+    function(ind_begin, ind_end);
+  }
+  if (thread_index == num_threads_ - 1 && ind_end < num_x_) {
+    function(ind_end, num_x_);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::BeginCheckpoint(const IntNumber ind_t_before) {
+  if (checkpoint_interval_ <= 0 || 
+      ind_t_ / checkpoint_interval_ == ind_t_before / checkpoint_interval_) {
+    return;
+  }
+  CheckpointHeader header = {};
+  header.real_size = sizeof(Real);
+  header.source_real_size = sizeof(SourceReal);
+  header.rank = rank_;
+  header.num_ranks = num_ranks_;
+  header.num_x = num_x_;
+  header.grid_offset = grid_offset_;
+  header.num_t = num_t_;
+  header.ind_t = ind_t_;
+  header.x0 = static_cast<double>(x0_);
+  header.x1 = static_cast<double>(x1_);
+  header.dx = static_cast<double>(dx_);
+  header.dt = static_cast<double>(dt_);
+  header.num_sources = static_cast<std::int64_t>(point_sources_.size());
+  void* e_field = nullptr;
+  void* h_field = nullptr;
+  if (checkpoint_writer_.Begin(GetCheckpointFileName(checkpoint_file_name_),
+                               &header, checkpoint_sources_, 
+                               GetAuxiliaryState(), &e_field, &h_field)) {
+    checkpoint_e_field_ = static_cast<Real*>(e_field);
+    checkpoint_h_field_ = static_cast<Real*>(h_field);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::CopyFieldsToCheckpoint(const int thread_index) {
+  if (checkpoint_e_field_ == nullptr) {
+    return;
+  }
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  ForEachSnapshotRange(thread_index, [this](const IntNumber begin, 
+                                            const IntNumber end) {
+    std::copy(e_field_.get() + begin, e_field_.get() + end, 
+              checkpoint_e_field_ + begin);
+    std::copy(h_field_.get() + begin, 
+              h_field_.get() + std::min(end, num_x_ - 1), 
+              checkpoint_h_field_ + begin);
+  });
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kOutput, t);
+  }
+}
+
+template <typename Real, typename SourceReal>
+std::vector<char> FDTD1D<Real, SourceReal>::GetAuxiliaryState() {
+  const std::size_t cpml_size = cpml_.get_state_size();
+  const std::size_t dispersion_size = dispersion_.get_state_size();
+  const std::size_t monitors_size = monitors_.get_state_size();
+  std::size_t size = cpml_size + dispersion_size + monitors_size;
+  for (auto& subgrid : subgrids_) {
+    size += subgrid.get_state_size();
+  }
+  std::vector<char> state(size);
+  char* data = state.data();
+  cpml_.SaveState(data);
+  dispersion_.SaveState(data += cpml_size);
+  monitors_.SaveState(data += dispersion_size);
+  data += monitors_size;
+  for (auto& subgrid : subgrids_) {
+    subgrid.SaveState(data);
+    data += subgrid.get_state_size();
+  }
+  return state;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::SetAuxiliaryState(const char* data, 
+                                                 const std::size_t size) {
+  const std::size_t cpml_size = cpml_.get_state_size();
+  const std::size_t dispersion_size = dispersion_.get_state_size();
+  const std::size_t monitors_size = monitors_.get_state_size();
+  std::size_t expected_size = cpml_size + dispersion_size + monitors_size;
+  for (auto& subgrid : subgrids_) {
+    expected_size += subgrid.get_state_size();
+  }
+  if (size != expected_size) {
+    return false;
+  }
+  cpml_.LoadState(data);
+  dispersion_.LoadState(data += cpml_size);
+  monitors_.LoadState(data += dispersion_size);
+  data += monitors_size;
+  for (auto& subgrid : subgrids_) {
+    subgrid.LoadState(data);
+    data += subgrid.get_state_size();
+  }
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SubmitCheckpoint() {
+  if (checkpoint_e_field_ != nullptr) {
+    checkpoint_writer_.Submit();
+    checkpoint_e_field_ = nullptr;
+    checkpoint_h_field_ = nullptr;
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetLiveFrames(const std::string& name, 
+                                             const IntNumber time_stride,
+                                             const IntNumber space_stride,
+                                             const IntNumber num_slots) {
+  live_frame_name_ = name;
+  live_time_stride_ = std::max<IntNumber>(time_stride, 1);
+  live_space_stride_ = std::max<IntNumber>(space_stride, 1);
+  live_num_slots_ = std::max<IntNumber>(num_slots, 2);
+  live_frames_.Close();
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::OpenLiveFrames() {
+  // the runs continuing an unfinished run keep publishing in its segment
+  if (live_frame_name_.empty() || 
+      (live_frames_.is_open() && !live_frames_.is_finished())) {
+    return;
+  }
+  const std::string name = (halo_transport_ == nullptr) ? live_frame_name_ :
+      live_frame_name_ + "." + std::to_string(rank_);
+  LiveFrameFormat format = {};
+  format.real_size = sizeof(Real);
+  format.num_values = (num_x_ + live_space_stride_ - 1) / live_space_stride_;
+  format.space_stride = live_space_stride_;
+  format.time_stride = live_time_stride_;
+  format.num_x = num_x_;
+  format.num_t = num_t_;
+  format.x0 = static_cast<double>(x0_ + grid_offset_*dx_);
+  format.dx = static_cast<double>(dx_);
+  format.dt = static_cast<double>(dt_);
+  std::string error;
+  if (!live_frames_.Create(name, format, live_num_slots_, &error)) {
+    std::cout << "Can not create the live frames " << name << ": " << error 
+              << std::endl;
+    live_frame_name_.clear();
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::BeginLiveFrame(const IntNumber ind_t_before) {
+  if (!live_frames_.is_open() || 
+      ind_t_ / live_time_stride_ == ind_t_before / live_time_stride_) {
+    return;
+  }
+  live_frame_ = static_cast<Real*>(
+      live_frames_.BeginFrame(ind_t_, static_cast<double>(ind_t_*dt_)));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::CopyFieldsToLiveFrame(const int thread_index) {
+  if (live_frame_ == nullptr) {
+    return;
+  }
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  const IntNumber stride = live_space_stride_;
+  ForEachSnapshotRange(thread_index, [this, stride](const IntNumber begin, 
+                                                    const IntNumber end) {
+    for (IntNumber i = (begin + stride - 1) / stride; i*stride < end; ++i) {
+      live_frame_[i] = e_field_[i*stride];
     }
-    FDTD1D::UpdateMagneticHNodes(thread_index, nextState);
+  });
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kOutput, t);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::PublishLiveFrame() {
+  if (live_frame_ != nullptr) {
+    live_frames_.PublishFrame();
+    live_frame_ = nullptr;
+  }
+}
+
+// Temporal blocking: the time steps are grouped into blocks of tile_depth_ 
+// steps and each block is computed in two phases. On the (x, t) plane:
+//
+//        t ^      thread 0    |    thread 1    |    thread 2
+//          |  \   phase 1   / \   phase 1   / \   phase 1   /
+//          |   \           /   \           /   \           /
+//          |    \_________/ ph. \_________/ ph. \_________/
+//          |                  2               2
+//          +-------------------------------------------------> x
+//
+// Phase 1: each thread advances the trapezoid inside its chunk whose edges
+//   shrink by one grid point per time step. These nodes only depend on nodes
+//   inside the same chunk, so no synchronization is needed inside the block. 
+//   The trapezoid is traversed in skewed tiles of tile_width_ points, so that
+//   each tile is advanced tile_depth_ steps while it is in the cache.
+// Phase 2: after a barrier, each thread fills the inverted triangle around the
+//   left boundary of its chunk, which depends on the two neighboring
+//   trapezoids.
+//
+// Each node is updated exactly once per time step with the same operations
+// as the per-step engine, hence the results are identical.
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateFieldsWithTemporalBlocking(
+    const int thread_index) {
+  const IntNumber chunk_0 = thread_data_chunk_bounds_[thread_index];
+  const IntNumber chunk_1 = thread_data_chunk_bounds_[thread_index + 1];
+  const bool is_first_chunk = (thread_index == 0);
+  const bool is_last_chunk = (thread_index == num_threads_ - 1);
+  
+  // the triangles of phase 2 around two neighboring chunk boundaries should 
+  // not overlap, which limits the depth of the blocks by the smallest chunk.
+  IntNumber min_chunk_size = num_x_;
+  for (int i = 0; i < num_threads_; ++i) {
+    min_chunk_size = std::min<IntNumber>(min_chunk_size, 
+        thread_data_chunk_bounds_[i + 1] - thread_data_chunk_bounds_[i]);
+  }
+  const IntNumber max_depth = std::max<IntNumber>(
+      std::min<IntNumber>(tile_depth_, (min_chunk_size + 1) / 2), 1);
+  const IntNumber tile_width = std::max<IntNumber>(tile_width_, 1);
+  
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  const IntNumber ind_t_begin = ind_t_;
+  
+  // the active region covers the whole block, the chunks stay fixed
+  FirstTouchFields(thread_index);
+  if (!run_state_is_valid_) {
+    TabulateSourceWaveforms(thread_index);
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kSetup, t);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kSetupWait, [this, max_depth] { 
+    if (!run_state_is_valid_) {
+      InitializeActiveRegion(); 
+    }
+    AdvanceActiveRegion(std::min(ind_t_stop_, ind_t_ + max_depth) - 1);
+  });
+  
+  for (IntNumber ind_t_0 = ind_t_begin; ind_t_0 < ind_t_stop_; 
+       ind_t_0 += max_depth) {
+    const IntNumber depth = std::min<IntNumber>(max_depth, 
+                                                ind_t_stop_ - ind_t_0);
     
-    nextState = UpdateState::kUpdateE;
-    if (thread_index == 0) {
-      WriteEfieldValuesToCSVFile(output_file_name_);
-      update_state_ = nextState;
+    // phase 1 : the trapezoid inside the chunk, traversed in skewed tiles. The 
+    // ends of the computational domain do not shrink.
+    t = (profile != nullptr) ? ProfileNow() : 0;
+    for (IntNumber tile_0 = chunk_0; tile_0 < chunk_1 + depth; 
+         tile_0 += tile_width) {
+      IntNumber tile_1 = tile_0 + tile_width;
+      for (IntNumber k = 0; k < depth; ++k) {
+        IntNumber e_begin = is_first_chunk ? 0 : chunk_0 + k;
+        IntNumber e_end = is_last_chunk ? num_x_ : chunk_1 - k;
+        IntNumber h_begin = is_first_chunk ? 0 : chunk_0 + k;
+        IntNumber h_end = is_last_chunk ? num_x_ - 1 : chunk_1 - k - 1;
+        
+        e_begin = std::max<IntNumber>(e_begin, tile_0 - k);
+        e_end = std::min<IntNumber>(e_end, tile_1 - k);
+        if (e_begin < e_end) {
+          UpdateElectricENodesInRange(e_begin, e_end, ind_t_0 + k);
+        }
+        h_begin = std::max<IntNumber>(h_begin, tile_0 - k - 1);
+        h_end = std::min<IntNumber>(h_end, tile_1 - k - 1);
+        if (h_begin < h_end) {
+          UpdateMagneticHNodesInRange(h_begin, h_end);
+        }
+        if (profile != nullptr) {
+          profile->num_e_nodes += CountActiveNodes(
+              std::max<IntNumber>(e_begin, 1), 
+              std::min<IntNumber>(e_end, num_x_ - 1));
+          profile->num_h_nodes += CountActiveNodes(h_begin, h_end);
+        }
+      }
     }
+    if (profile != nullptr) {
+      profile->Record(ProfilePhase::kTileUpdate, t);
+    }
+    WaitAtBarrier(thread_index, ProfilePhase::kTileWait, 
+                  [this] { 
+      SubmitCheckpoint(); 
+      PublishLiveFrame();
+    });
     
+    // phase 2 : the triangle around the left boundary of the chunk
+    t = (profile != nullptr) ? ProfileNow() : 0;
+    if (!is_first_chunk) {
+      for (IntNumber k = 0; k < depth; ++k) {
+        if (k > 0) {
+          UpdateElectricENodesInRange(chunk_0 - k, chunk_0 + k, ind_t_0 + k);
+        }
+        UpdateMagneticHNodesInRange(chunk_0 - k - 1, chunk_0 + k);
+        if (profile != nullptr) {
+          profile->num_e_nodes += CountActiveNodes(chunk_0 - k, chunk_0 + k);
+          profile->num_h_nodes += CountActiveNodes(chunk_0 - k - 1, 
+                                                   chunk_0 + k);
+        }
+      }
+    }
+    if (profile != nullptr) {
+      profile->Record(ProfilePhase::kTileUpdate, t);
+    }
+    WaitAtBarrier(thread_index, ProfilePhase::kBlockWait, 
+                  [this, depth, max_depth] { 
+      ind_t_ += depth; 
+      AdvanceActiveRegion(std::min(ind_t_stop_, ind_t_ + max_depth) - 1);
+      BeginCheckpoint(ind_t_ - depth);
+      BeginLiveFrame(ind_t_ - depth);
+    });
+    // phase 1 of the next block only modifies the chunk of the thread
+    CopyFieldsToCheckpoint(thread_index);
+    CopyFieldsToLiveFrame(thread_index);
+  }
+}
+
+// Task graph: the grid is split in many more tiles than threads and the 
+// update of the tile i over the time step n is a task T(i, n), see 
+// tile_task_graph.h. T(i, n) updates the E nodes of the tile, then the H 
+// nodes on their left:
+//
+//   E nodes     |a         ...         b-1|
+//   H nodes   |a-1        ...       b-2|
+//
+// so that it only waits for T(i - 1, n) and T(i + 1, n - 1) instead of all 
+// the threads. The fourth order stencils read two nodes on each side, and
+// the H nodes of the task shift by three nodes, [a - 3, b - 3), so that the
+// same two dependencies still hold (the last tile keeps the H nodes up to 
+// the end of the grid). The threads pick the ready tasks from work-stealing
+// deques, and a thread delayed by the system only delays the tiles around
+// its own.
+//
+// The threads only synchronize at the checkpoints, at the live frames, at the
+// end of the run and every tile_depth_ steps while the active region grows, 
+// since the active intervals only change in the barrier completions. The 
+// tiles move between the threads, so the fields are not kept on the NUMA node
+// of the thread that first touched them.
+//
+// Each node is updated exactly once per time step with the same operations
+// as the per-step engine, hence the results are identical.
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateFieldsWithTaskGraph(
+    const int thread_index) {
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  FirstTouchFields(thread_index);
+  if (!run_state_is_valid_) {
+    TabulateSourceWaveforms(thread_index);
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kSetup, t);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kSetupWait, [this] { 
+    if (!run_state_is_valid_) {
+      InitializeActiveRegion(); 
+    }
+    InitializeTaskTiles();
+  });
+  
+  // ind_t_ only changes in the completion of the second barrier
+  while (ind_t_ < ind_t_stop_) {
+    WaitAtBarrier(thread_index, ProfilePhase::kBlockWait, [this] {
+      SubmitCheckpoint();
+      PublishLiveFrame();
+      BeginTaskGraphSegment();
+    });
+    RunTileTasks(thread_index);
+    WaitAtBarrier(thread_index, ProfilePhase::kBlockWait, [this] { 
+      const IntNumber ind_t_before = ind_t_;
+      ind_t_ = task_graph_segment_end_;
+      BeginCheckpoint(ind_t_before);
+      BeginLiveFrame(ind_t_before);
+    });
+    CopyFieldsToCheckpoint(thread_index);
+    CopyFieldsToLiveFrame(thread_index);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::InitializeTaskTiles() {
+  // enough tiles to keep the threads busy, since at most every other tile
+  // is ready at a time, but not so small that the scheduling dominates
+  constexpr IntNumber kMinTileWidth = 64;
+  const IntNumber tile_width = std::max<IntNumber>(tile_width_, 1);
+  IntNumber num_tiles = std::max<IntNumber>((num_x_ + tile_width - 1) / 
+                                            tile_width, 8*num_threads_);
+  num_tiles = std::max<IntNumber>(
+      std::min<IntNumber>(num_tiles, num_x_ / kMinTileWidth), 1);
+  task_tile_bounds_.resize(num_tiles + 1);
+  for (IntNumber i = 0; i <= num_tiles; ++i) {
+    task_tile_bounds_[i] = num_x_*i / num_tiles;
   }
 }
 
-void FDTD1D::CreateThreadsAndRun() {
-  std::vector<std::thread> threads;
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::BeginTaskGraphSegment() {
+  IntNumber ind_t_end = ind_t_stop_;
+  if (checkpoint_interval_ > 0) {
+    ind_t_end = std::min<IntNumber>(
+        ind_t_end, (ind_t_ / checkpoint_interval_ + 1)*checkpoint_interval_);
+  }
+  if (live_frames_.is_open()) {
+    ind_t_end = std::min<IntNumber>(
+        ind_t_end, (ind_t_ / live_time_stride_ + 1)*live_time_stride_);
+  }
+  if (!active_region_is_full_) {
+    ind_t_end = std::min<IntNumber>(ind_t_end, 
+                                    ind_t_ + std::max(tile_depth_, 1));
+  }
+  AdvanceActiveRegion(ind_t_end - 1);
+  task_graph_segment_end_ = ind_t_end;
+  task_graph_.Reset(static_cast<int>(task_tile_bounds_.size() - 1), ind_t_, 
+                    ind_t_end, num_threads_);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::RunTileTasks(const int thread_index) {
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  // the shift of the H nodes of a task, see UpdateFieldsWithTaskGraph
+  const IntNumber h_shift = space_order_ - 1;
+  int tile = 0;
+  IntNumber ind_t = 0;
+  while (task_graph_.Acquire(thread_index, &tile, &ind_t)) {
+    if (profile != nullptr) {
+      t = profile->Record(ProfilePhase::kTaskWait, t);
+    }
+    const IntNumber e_begin = task_tile_bounds_[tile];
+    const IntNumber e_end = task_tile_bounds_[tile + 1];
+    const IntNumber h_begin = std::max<IntNumber>(e_begin - h_shift, 0);
+    const IntNumber h_end = (e_end == num_x_) ? num_x_ - 1 : e_end - h_shift;
+    UpdateElectricENodesInRange(e_begin, e_end, ind_t);
+    UpdateMagneticHNodesInRange(h_begin, h_end);
+    task_graph_.Complete(thread_index, tile);
+    if (profile != nullptr) {
+      profile->num_e_nodes += CountActiveNodes(
+          std::max<IntNumber>(e_begin, 1), 
+          std::min<IntNumber>(e_end, num_x_ - 1));
+      profile->num_h_nodes += CountActiveNodes(h_begin, h_end);
+      t = profile->Record(ProfilePhase::kTileUpdate, t);
+    }
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kTaskWait, t);
+  }
+}
+
+// Domain decomposition: the ranks advance their parts of the grid as the 
+// per-step engine and exchange the nodes next to their boundaries every half
+// time step. The E node owned_x_begin_ of a rank with a left neighbor needs 
+// the H node on its left, which is owned by the left neighbor, and the last H
+// node of a rank with a right neighbor needs the E node on its right:
+//
+//   rank r          ghost  owned                  owned  ghost
+//   E nodes           0      1    2   ...  num_x_-2  num_x_-1
+//   H nodes             0      1     ...       num_x_-2
+//                    ^recv   ^send              ^send   ^recv
+//
+// The interior nodes do not depend on the ghost nodes, so the threads update
+// them first and the first (last) thread receives the ghost node, updates the
+// node next to it and sends it to the neighbor afterwards. The interior 
+// updates of all the threads hide the time the message takes. Each node is 
+// updated exactly once per time step with the same operations as the single 
+// process solver, hence the results are identical.
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::UpdateFieldsWithHaloExchange(
+    const int thread_index) {
+  const bool has_left = (rank_ > 0);
+  const bool has_right = (rank_ < num_ranks_ - 1);
+  const bool is_first_thread = (thread_index == 0);
+  const bool is_last_thread = (thread_index == num_threads_ - 1);
+  const IntNumber chunk_0 = thread_data_chunk_bounds_[thread_index];
+  const IntNumber chunk_1 = thread_data_chunk_bounds_[thread_index + 1];
+  // the interior nodes of the chunk. The ghost E nodes are skipped by 
+  // UpdateElectricENodesInRange as boundaries of the local grid.
+  const IntNumber e_begin = std::max<IntNumber>(chunk_0, has_left ? 2 : 0);
+  const IntNumber h_begin = std::max<IntNumber>(chunk_0, has_left ? 1 : 0);
+  const IntNumber h_end = std::min<IntNumber>(chunk_1, 
+                                              num_x_ - (has_right ? 2 : 1));
+  const IntNumber num_steps = ind_t_stop_ - ind_t_;
   
+  ThreadProfile* profile = profiler_.get_thread_profile(thread_index);
+  std::int64_t t = (profile != nullptr) ? ProfileNow() : 0;
+  FirstTouchFields(thread_index);
+  if (!run_state_is_valid_) {
+    TabulateSourceWaveforms(thread_index);
+  }
+  if (profile != nullptr) {
+    profile->Record(ProfilePhase::kSetup, t);
+  }
+  WaitAtBarrier(thread_index, ProfilePhase::kSetupWait, [this] { 
+    if (!run_state_is_valid_) {
+      InitializeActiveRegion(); 
+    }
+  });
+  if (is_last_thread && has_right) {
+    halo_transport_->Send(Neighbor::kRight, &h_field_[num_x_ - 2], 
+                          sizeof(Real));
+  }
+  
+  for (IntNumber i = 0; i < num_steps; ++i) {
+    t = (profile != nullptr) ? ProfileNow() : 0;
+    if (e_begin < chunk_1) {
+      UpdateElectricENodesInRange(e_begin, chunk_1, ind_t_);
+    }
+    if (is_first_thread && has_left) {
+      if (profile != nullptr) {
+        t = profile->Record(ProfilePhase::kEUpdate, t);
+      }
+      halo_transport_->Receive(Neighbor::kLeft, &h_field_[0], sizeof(Real));
+      if (profile != nullptr) {
+        t = profile->Record(ProfilePhase::kHaloWait, t);
+      }
+      UpdateElectricENodesInRange(1, 2, ind_t_);
+      halo_transport_->Send(Neighbor::kLeft, &e_field_[1], sizeof(Real));
+    }
+    if (profile != nullptr) {
+      profile->Record(ProfilePhase::kEUpdate, t);
+      profile->num_e_nodes += std::max<IntNumber>(
+          std::min<IntNumber>(chunk_1, num_x_ - 1) - 
+          std::max<IntNumber>(e_begin, 1), 0);
+      profile->num_e_nodes += (is_first_thread && has_left) ? 1 : 0;
+    }
+    WaitAtBarrier(thread_index, ProfilePhase::kEWait, [this] { 
+      SubmitCheckpoint(); 
+      PublishLiveFrame();
+    });
+    UpdateSubgrids(thread_index);
+    
+    t = (profile != nullptr) ? ProfileNow() : 0;
+    if (h_begin < h_end) {
+      UpdateMagneticHNodesInRange(h_begin, h_end);
+    }
+    if (is_last_thread && has_right) {
+      if (profile != nullptr) {
+        t = profile->Record(ProfilePhase::kHUpdate, t);
+      }
+      halo_transport_->Receive(Neighbor::kRight, &e_field_[num_x_ - 1], 
+                               sizeof(Real));
+      if (profile != nullptr) {
+        t = profile->Record(ProfilePhase::kHaloWait, t);
+      }
+      UpdateMagneticHNodesInRange(num_x_ - 2, num_x_ - 1);
+      // the left node of the neighbor is updated again at the next time step
+      if (i + 1 < num_steps) {
+        halo_transport_->Send(Neighbor::kRight, &h_field_[num_x_ - 2], 
+                              sizeof(Real));
+      }
+    }
+    if (profile != nullptr) {
+      profile->Record(ProfilePhase::kHUpdate, t);
+      profile->num_h_nodes += std::max<IntNumber>(h_end - h_begin, 0);
+      profile->num_h_nodes += (is_last_thread && has_right) ? 1 : 0;
+    }
+    WaitAtBarrier(thread_index, ProfilePhase::kHWait, [this] { 
+      ++ind_t_; 
+      BeginCheckpoint(ind_t_ - 1);
+      BeginLiveFrame(ind_t_ - 1);
+    });
+    CopyFieldsToCheckpoint(thread_index);
+    CopyFieldsToLiveFrame(thread_index);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::CreateThreadsAndRun() {
   std::cout << "Initializing " << num_threads_ << " threads..." << std::endl;
-  update_state_ = UpdateState::kUpdateE;
-  for (int i = 0; i < num_threads_; ++i)
-    if (!write_fields_to_file_) {
-      threads.emplace_back(
-        std::thread(&FDTD1D::UpdateFieldsCuncurrently, this, i));
-    } else {
-      remove(output_file_name_.c_str());  // write over the last file
-      threads.emplace_back(
-        std::thread(&FDTD1D::UpdateFieldsAndWriteToFileCuncurrently, this, i));
+  if (halo_transport_ != nullptr && write_fields_to_file_) {
+    std::cout << "Writing the fields is not supported with domain "
+              << "decomposition." << std::endl;
+    write_fields_to_file_ = false;
+  }
+  if (write_fields_to_file_ && 
+      time_stepping_engine_ != TimeSteppingEngine::kPerStep) {
+    std::cout << "Writing the fields at each time step requires the " 
+              << GetTimeSteppingEngineName(TimeSteppingEngine::kPerStep)
+              << " engine." << std::endl;
+  }
+  if (!subgrids_.empty() && 
+      time_stepping_engine_ != TimeSteppingEngine::kPerStep) {
+    std::cout << "The subgrids require the " 
+              << GetTimeSteppingEngineName(TimeSteppingEngine::kPerStep)
+              << " engine." << std::endl;
+  }
+  if (space_order_ != 2 && 
+      time_stepping_engine_ == TimeSteppingEngine::kTemporalBlocking) {
+    std::cout << "The fourth order stencils do not support the " 
+              << GetTimeSteppingEngineName(time_stepping_engine_)
+              << " engine, the " 
+              << GetTimeSteppingEngineName(TimeSteppingEngine::kPerStep)
+              << " engine is used." << std::endl;
+  }
+  
+  std::int64_t t_start = ProfileNow();
+  Step(num_t_ - ind_t_);
+  if (checkpoint_interval_ > 0) {
+    checkpoint_writer_.PrintStatistics();
+  }
+  profile_run_info_.num_x = num_x_;
+  profile_run_info_.num_t = num_t_;
+  profile_run_info_.wall_time = (ProfileNow() - t_start)*1.0e-9;
+  profiler_.PrintSummary(profile_run_info_);
+  if (load_balancing_) {
+    std::cout << "Load balancing : " << num_rebalances_ 
+              << " repartitions, final chunk bounds: ";
+    for (int i = 0; i <= num_threads_; ++i) {
+      std::cout << thread_data_chunk_bounds_[i] << " ";
     }
+    std::cout << std::endl;
+  }
+  if (GetThreadFunction() == &FDTD1D::UpdateFieldsWithTaskGraph) {
+    std::cout << "Task graph : " << task_tile_bounds_.size() - 1 
+              << " tiles, " << task_graph_.get_num_steals() 
+              << " tasks stolen in the last segment" << std::endl;
+  }
+  if (worker_pool_.get_num_unpinned_threads() > 0) {
+    std::cout << worker_pool_.get_num_unpinned_threads() 
+              << " threads could not be pinned." << std::endl;
+  }
+  if (write_fields_to_file_) {
+    field_writer_.PrintStatistics();
+  }
+}
+
+template <typename Real, typename SourceReal>
+typename FDTD1D<Real, SourceReal>::ThreadFunction 
+FDTD1D<Real, SourceReal>::GetThreadFunction() {
+  if (halo_transport_ != nullptr) {
+    return &FDTD1D::UpdateFieldsWithHaloExchange;
+  }
+  if (write_fields_to_file_) {
+    return &FDTD1D::UpdateFieldsAndWriteToFileCuncurrently;
+  }
+  if (subgrids_.empty() && space_order_ == 2 &&
+      time_stepping_engine_ == TimeSteppingEngine::kTemporalBlocking) {
+    return &FDTD1D::UpdateFieldsWithTemporalBlocking;
+  }
+  if (subgrids_.empty() && 
+      time_stepping_engine_ == TimeSteppingEngine::kTaskGraph) {
+    return &FDTD1D::UpdateFieldsWithTaskGraph;
+  }
+  return &FDTD1D::UpdateFieldsCuncurrently;
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1D<Real, SourceReal>::Step(const IntNumber num_steps) {
+  const IntNumber ind_t_begin = ind_t_;
+  ind_t_stop_ = std::min(num_t_, ind_t_ + std::max<IntNumber>(num_steps, 0));
+  if (ind_t_stop_ <= ind_t_) {
+    return 0;
+  }
+  if (halo_transport_ != nullptr) {
+    write_fields_to_file_ = false;
+  }
+  // the sources, the barrier, the cost model and the active region of the 
+  // previous call are reused, see run_state_is_valid_
+  if (!run_state_is_valid_) {
+    PrepareSources();
+    barrier_.Reset(num_threads_, barrier_mode_);
+  }
+  if (write_fields_to_file_ && !field_output_is_open_) {
+    FieldOutputMetadata metadata = {
+        static_cast<double>(x0_), static_cast<double>(x1_), 
+        static_cast<double>(dx_), static_cast<double>(t_final_), 
+        static_cast<double>(dt_), num_x_, num_t_};
+    if (!field_writer_.Open(output_file_name_, metadata)) {
+      return 0;
+    }
+    field_output_is_open_ = true;
+  }
+  const ThreadFunction thread_function = GetThreadFunction();
   
-  for (int i = 0; i < num_threads_; ++i) {
-    threads[i].join();
+  // each worker is pinned before it touches its chunk, so that the first 
+  // touch already happens on its final NUMA node
+  thread_cpus_ = GetThreadCpus(affinity_policy_, num_threads_, affinity_cpus_);
+  worker_pool_.Start(num_threads_, thread_cpus_);
+  profiler_.Reset(num_threads_);
+  if (!run_state_is_valid_) {
+    InitializeLoadBalancing();
+    if (checkpoint_interval_ > 0) {
+      checkpoint_sources_ = EncodeCheckpointSources(point_sources_);
+    }
+  }
+  OpenLiveFrames();
+  worker_pool_.Run([this, thread_function](const int i) {
+    profiler_.StartHardwareCounters(i);
+    (this->*thread_function)(i);
+    profiler_.StopHardwareCounters(i);
+  });
+  run_state_is_valid_ = true;
+  // the checkpoint and the live frame of the last time step
+  SubmitCheckpoint();
+  PublishLiveFrame();
+  
+  if (field_output_is_open_ && ind_t_ == num_t_) {
+    field_writer_.Close();
+    field_output_is_open_ = false;
   }
+  if (ind_t_ == num_t_) {
+    live_frames_.Finish();
+  }
+  return ind_t_ - ind_t_begin;
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1D<Real, SourceReal>::RunUntil(const SourceReal t) {
+  const IntNumber ind_t = static_cast<IntNumber>(std::ceil(t / dt_));
+  return Step(ind_t - ind_t_);
 }
 
-void FDTD1D::PrintEFieldValues() {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::PrintEFieldValues() {
+  if (halo_transport_ != nullptr) {
+    std::vector<Real> e_field;
+    if (GatherEFieldValues(&e_field)) {
+      std::cout << std::endl << "Electric field values: " << std::endl;
+      for (std::size_t i = 0; i < e_field.size(); ++i) {
+        std::cout << e_field[i] << " ";
+      }
+      std::cout << std::endl;
+    }
+    return;
+  }
   std::cout << std::endl << "Electric field values: " << std::endl;
   for (int i = 0; i < num_x_; ++i) {
     std::cout << e_field_[i] << " ";
@@ -237,11 +2195,73 @@ void FDTD1D::PrintEFieldValues() {
   std::cout << std::endl;
 }
 
-void FDTD1D::SetOutputCSVFileName(const std::string& file_name) {
+template <typename Real, typename SourceReal>
+bool FDTD1D<Real, SourceReal>::GatherEFieldValues(std::vector<Real>* e_field) {
+  if (halo_transport_ == nullptr) {
+    e_field->assign(e_field_.get(), e_field_.get() + num_x_);
+    return true;
+  }
+  // the nodes travel to the left along the chain of ranks. Each rank appends
+  // the nodes of the ranks on its right to its own nodes.
+  e_field->assign(e_field_.get() + owned_x_begin_, 
+                  e_field_.get() + owned_x_end_);
+  if (rank_ < num_ranks_ - 1) {
+    std::int64_t num_right_nodes = 0;
+    halo_transport_->Receive(Neighbor::kRight, &num_right_nodes, 
+                             sizeof(num_right_nodes));
+    std::size_t num_own_nodes = e_field->size();
+    e_field->resize(num_own_nodes + num_right_nodes);
+    halo_transport_->Receive(Neighbor::kRight, e_field->data() + num_own_nodes,
+                             num_right_nodes*sizeof(Real));
+  }
+  if (rank_ > 0) {
+    std::int64_t num_nodes = static_cast<std::int64_t>(e_field->size());
+    halo_transport_->Send(Neighbor::kLeft, &num_nodes, sizeof(num_nodes));
+    halo_transport_->Send(Neighbor::kLeft, e_field->data(), 
+                          e_field->size()*sizeof(Real));
+    e_field->clear();
+    return false;
+  }
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetOutputCSVFileName(
+    const std::string& file_name) {
+  output_file_name_ = file_name;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetOutputFileName(
+    const std::string& file_name) {
   output_file_name_ = file_name;
 }
 
-void FDTD1D::WriteEfieldValuesToCSVFile(const std::string& file_name) {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetFieldOutputOptions(
+    const OutputFormat format, const IntNumber time_stride, 
+    const IntNumber space_stride, const bool write_h_field) {
+  field_writer_.SetOutputFormat(format);
+  field_writer_.SetDecimation(time_stride, space_stride);
+  field_writer_.SetWriteHField(write_h_field);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetFieldOutputBuffering(
+    const int num_buffers, const bool use_direct_io) {
+  field_writer_.SetNumberOfBuffers(num_buffers);
+  field_writer_.SetDirectIO(use_direct_io);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::SetFieldOutputChunkSize(
+    const IntNumber steps_per_chunk) {
+  field_writer_.SetStepsPerChunk(steps_per_chunk);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::WriteEfieldValuesToCSVFile(
+    const std::string& file_name) {
   std::ofstream ofs(file_name, std::ofstream::app);
   for (int i = 0; i < num_x_ - 1; ++i) {
     ofs << e_field_[i] << ", ";
@@ -250,7 +2270,8 @@ void FDTD1D::WriteEfieldValuesToCSVFile(const std::string& file_name) {
   ofs.close();
 }
 
-void FDTD1D::PrintParameters() {
+template <typename Real, typename SourceReal>
+void FDTD1D<Real, SourceReal>::PrintParameters() {
   std::cout << "Grid: " << std::endl;
   std::cout << "x0 : " << x0_ << std::endl;
   std::cout << "x1 : " << x1_ << std::endl;
@@ -259,6 +2280,84 @@ void FDTD1D::PrintParameters() {
   std::cout << "dt : " << dt_ << std::endl;
   std::cout << "Nx : " << num_x_ << std::endl;
   std::cout << "Nt : " << num_t_ << std::endl;
+  if (halo_transport_ != nullptr) {
+    std::cout << "Domain decomposition : rank " << rank_ << " of " 
+              << num_ranks_ << ", grid points [" 
+              << grid_offset_ + owned_x_begin_ << ", " 
+              << grid_offset_ + owned_x_end_ << ") of " << global_num_x_ 
+              << std::endl;
+  }
+  std::cout << "Absorbing boundaries : ";
+  if (cpml_.is_enabled()) {
+    const CPMLParameters& cpml = cpml_.get_parameters();
+    std::cout << "CPML " << cpml.thickness << " cells, order " 
+              << cpml.grading_order << ", sigma factor " << cpml.sigma_factor
+              << ", kappa " << cpml.kappa_max << ", alpha " << cpml.alpha_max
+              << std::endl;
+  } else {
+    std::cout << "PEC" << std::endl;
+  }
+  std::cout << "Materials : ";
+  if (materials_.is_enabled()) {
+    std::cout << materials_.get_num_regions() << " regions in " 
+              << materials_.get_num_segments() << " E and H segments, " 
+              << materials_.get_num_graded_nodes() << " graded nodes" 
+              << std::endl;
+  } else {
+    std::cout << "vacuum" << std::endl;
+  }
+  if (dispersion_.is_enabled()) {
+    std::cout << "Dispersive media : " << dispersion_.get_num_regions() 
+              << " regions, " << dispersion_.get_num_poles() << " poles, " 
+              << dispersion_.get_num_nodes() << " nodes" << std::endl;
+  }
+  if (!subgrids_.empty()) {
+    std::cout << "Subgrids :";
+    for (auto& subgrid : subgrids_) {
+      std::cout << " [" << grid_offset_ + subgrid.get_begin() << ", " 
+                << grid_offset_ + subgrid.get_end() << "] x" 
+                << subgrid.get_ratio();
+    }
+    std::cout << std::endl;
+  }
+  if (monitors_.is_enabled()) {
+    std::cout << "Monitors : " << monitors_.get_num_probes() << " probes, " 
+              << monitors_.get_num_dft_monitors() << " DFT monitors of " 
+              << monitors_.get_num_dft_values() << " values" << std::endl;
+  }
+  std::cout << "Synchronization : " << GetBarrierModeName(barrier_mode_) 
+            << std::endl;
+  std::cout << "Kernels : " << GetKernelTypeName(kernels_->type) << std::endl;
+  std::cout << "Spatial order : " << space_order_ << std::endl;
+  std::cout << "Time stepping : " 
+            << GetTimeSteppingEngineName(time_stepping_engine_) << std::endl;
+  std::cout << "Active region tracking : " 
+            << (track_active_region_ ? "on" : "off") << std::endl;
+  if (time_stepping_engine_ == TimeSteppingEngine::kTemporalBlocking ||
+      time_stepping_engine_ == TimeSteppingEngine::kTaskGraph) {
+    std::cout << "Tile depth : " << tile_depth_ << std::endl;
+    std::cout << "Tile width : " << tile_width_ << std::endl;
+  }
+  std::cout << "Thread affinity : " << GetAffinityPolicyName(affinity_policy_)
+            << std::endl;
+  std::cout << "Load balancing : ";
+  if (load_balancing_) {
+    std::cout << "every " << load_balancing_interval_ << " steps, threshold "
+              << load_balancing_threshold_ << std::endl;
+  } else {
+    std::cout << "off" << std::endl;
+  }
+  std::cout << "Profiling : " << (profiler_.is_enabled() ? "on" : "off") 
+            << std::endl;
+  std::cout << "First touch : " << (first_touch_ ? "on" : "off") << std::endl;
+  std::cout << "Huge pages : " << (!huge_pages_ ? "off" : 
+                                    uses_huge_pages_ ? "on" : "unavailable")
+            << std::endl;
+  if (!live_frame_name_.empty()) {
+    std::cout << "Live frames : " << live_frame_name_ << ", every " 
+              << live_time_stride_ << " steps and " << live_space_stride_ 
+              << " points, " << live_num_slots_ << " slots" << std::endl;
+  }
   
   
   std::cout << "\nThread data chunk bounds: " << std::endl;
@@ -267,13 +2366,32 @@ void FDTD1D::PrintParameters() {
   }
   std::cout << std::endl;
   
+  std::vector<int> thread_cpus = 
+      GetThreadCpus(affinity_policy_, num_threads_, affinity_cpus_);
+  if (!thread_cpus.empty()) {
+    std::cout << "\nThread CPUs: " << std::endl;
+    for (int cpu : thread_cpus) {
+      std::cout << cpu << " ";
+    }
+    std::cout << std::endl;
+  }
+  
   
-  std::cout << "\nPoint sources: " << std::endl;
-  for (auto J : point_sources_) {
-    J.PrintParameters();
+  std::cout << "\nPoint sources: " << point_sources_.size() << std::endl;
+  const std::size_t kMaxPrintedSources = 8;
+  for (std::size_t i = 0; i < point_sources_.size(); ++i) {
+    if (i == kMaxPrintedSources) {
+      std::cout << "..." << std::endl;
+      break;
+    }
+    point_sources_[i]->PrintParameters();
   }
 }
 
+template class FDTD1D<double>;
+template class FDTD1D<float>;
+template class FDTD1D<float, double>;
+
 }  // namespace fdtd1d
 
 
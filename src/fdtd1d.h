@@ -22,101 +22,697 @@
 #include <iostream>       // std::cout
 #include <fstream>        // std::ofstream
 #include <vector>         // std::vector
-#include <thread>         // std::thread
 #include <memory>         // std::unique_ptr
-#include <atomic>         // std::atomic
+#include <utility>        // std::pair
+#include <algorithm>      // std::min, std::max, std::lower_bound
 
+#include "aligned_memory.h"
+#include "checkpoint.h"
+#include "cpml.h"
+#include "dispersive_media.h"
 #include "em_source.h"
+#include "field_monitors.h"
+#include "field_writer.h"
+#include "halo_transport.h"
+#include "live_frames.h"
+#include "material_map.h"
 #include "number_types.h"
 #include "physical_constants.h"
+#include "subgrid.h"
+#include "thread_affinity.h"
+#include "thread_barrier.h"
+#include "thread_profiler.h"
+#include "tile_task_graph.h"
+#include "worker_pool.h"
+#include "yee_kernels.h"
 
 namespace fdtd1d {
 
-enum class UpdateState {
-  kUpdateE = 1,
-  kUpdateH = 2,
-  kUpdateOutputFile = 3,
+// the algorithm used to advance the fields in time
+// kPerStep ---> all the threads update the E and H nodes of their chunks and 
+//   synchronize after each half time step
+// kTemporalBlocking ---> each thread advances its chunk several time steps
+//   between synchronizations using trapezoidal tiles in (x, t). See 
+//   UpdateFieldsWithTemporalBlocking.
+// kTaskGraph ---> the grid is split in many small tiles and the update of a 
+//   tile over a time step only waits for the neighboring tiles. See 
+//   UpdateFieldsWithTaskGraph.
+enum class TimeSteppingEngine {
+  kPerStep = 1,
+  kTemporalBlocking = 2,
+  kTaskGraph = 3,
 };
 
+// converts "per-step", "temporal-blocking" and "task-graph" to the 
+// corresponding engine. 
+// Returns false if the name is not recognized.
+bool ParseTimeSteppingEngine(const std::string& name, 
+                             TimeSteppingEngine* engine);
+const char* GetTimeSteppingEngineName(const TimeSteppingEngine engine);
 
+// Real is the floating point type of the field arrays and of the E and H 
+// updates. SourceReal is the floating point type of the time, the grid 
+// parameters and the source contributions. FDTD1D<double>, FDTD1D<float> and
+// the mixed precision FDTD1D<float, double> are available.
+template <typename Real, typename SourceReal = Real>
 class FDTD1D {
   public:
   FDTD1D();
-  void SetXAxisRangeAndGridSpacing(const RealNumber x0, const RealNumber x1, 
-                              const RealNumber dx);
+  void SetXAxisRangeAndGridSpacing(const SourceReal x0, const SourceReal x1, 
+                              const SourceReal dx);
   void InitializeAndResetEMFieldArrays();
-  void SetStabilityFactorAndTimeResolution(const RealNumber stability_factor);
-  void SetSimulationTime(const RealNumber t_final);
+  void SetStabilityFactorAndTimeResolution(const SourceReal stability_factor);
+  
+  // selects the order of the spatial differences of the E and H updates: 2 
+  // for the Yee scheme or 4 for the FDTD(2,4) scheme (see yee_kernels.h), 
+  // whose stencils reach two nodes on each side. The fourth order scheme is
+  // stable up to the Courant number 6/7, so the time step becomes 
+  // stability_factor*6/7*dx/c. The absorbing layers, the dispersive media 
+  // and the nodes next to the walls keep the second order updates, and the 
+  // temporal blocking engine falls back to the per-step engine. Should be 
+  // called before SetDomainDecomposition and 
+  // SetStabilityFactorAndTimeResolution. Returns false if the order is not 2
+  // or 4, or if the fourth order is combined with the domain decomposition 
+  // or the subgrids.
+  bool SetSpatialOrder(const int space_order);
+  void SetSimulationTime(const SourceReal t_final);
   void SetNumberOfThreads(const int num_threads);
   
+  // sets how the threads wait for each other after each E and H update. 
+  // see thread_barrier.h
+  void SetSynchronizationMode(const BarrierMode mode);
+  
+  void SetTimeSteppingEngine(const TimeSteppingEngine engine);
+  
+  // parameters of the kTemporalBlocking engine. tile_depth is the number of 
+  // time steps advanced between two synchronizations and tile_width is the 
+  // number of grid points in each tile. tile_width should be chosen such that
+  // the E and H fields of a tile fit in the cache. The kTaskGraph engine uses
+  // tiles of at most tile_width grid points, and synchronizes the threads 
+  // every tile_depth time steps while the active region grows.
+  void SetTemporalBlockingParameters(const int tile_depth, 
+                                     const IntNumber tile_width);
+  
+  // restricts the E and H updates to the cells that the fields of the 
+  // sources can have reached (on by default), see InitializeActiveRegion
+  void SetActiveRegionTracking(const bool track_active_region);
+  
+  // selects the vectorized kernels of the E and H updates. By default 
+  // (KernelType::kAuto) the best kernel supported by the processor is used.
+  void SetKernelType(const KernelType kernel_type);
+  
+  // pins the worker threads to CPUs, see thread_affinity.h. cpus is only used
+  // by AffinityPolicy::kExplicit.
+  void SetThreadAffinity(const AffinityPolicy policy, 
+                         const std::vector<int>& cpus = std::vector<int>());
+  
+  // placement of the field arrays in memory. With first_touch the arrays are
+  // only allocated by InitializeAndResetEMFieldArrays and each thread zeroes
+  // its own chunk when the threads start (see FirstTouchFields), so that the
+  // pages of a chunk land on the NUMA node of the thread updating it. With 
+  // huge_pages the arrays are backed by transparent huge pages if available.
+  // Should be called before InitializeAndResetEMFieldArrays.
+  void SetMemoryPlacement(const bool first_touch, const bool huge_pages);
+  
+  // repartitions the chunks of the threads from their measured cost (the 
+  // kPerStep engine). The threads time their E and H updates, and every 
+  // interval time steps the cost per node of each chunk is estimated. If the
+  // slowest thread exceeds the mean time by more than threshold (hysteresis)
+  // thread_data_chunk_bounds_ are moved so that the chunks have the same 
+  // estimated cost, see BalanceLoad. The results do not depend on the chunks.
+  void SetLoadBalancing(const bool enable, const IntNumber interval = 64,
+                        const double threshold = 0.05);
+  
+  // records the time spent by each thread in each phase of the time stepping
+  // and at each synchronization point, and the nodes it updated (see 
+  // thread_profiler.h). The summary is printed after each run. With 
+  // use_hardware_counters the hardware counters of the threads are also read.
+  void SetProfiling(const bool enable, const bool use_hardware_counters);
+  
+  // writes the profile of the last run. Returns false if the file can not be
+  // written.
+  bool WriteProfileReport(const std::string& file_name, 
+                          const ProfileReportFormat format);
+  
+  // splits the grid between num_ranks processes along the x axis. The rank 
+  // owns the E nodes [N*rank/num_ranks, N*(rank + 1)/num_ranks) of the N 
+  // nodes of the grid and the H nodes on their right side, and holds one 
+  // ghost node of each neighbor. The ghost H node on the left and the ghost E
+  // node on the right are received from the neighbors through transport 
+  // every half time step, see UpdateFieldsWithHaloExchange. num_x_ becomes 
+  // the number of local nodes while x0_ and dx_ keep describing the whole 
+  // grid. Should be called after SetXAxisRangeAndGridSpacing and before 
+  // InitializeAndResetEMFieldArrays, SetNumberOfThreads and the sources. 
+  // Returns false if a rank would own less than two nodes.
+  bool SetDomainDecomposition(HaloTransport* transport, const int rank,
+                              const int num_ranks);
+  
+  // lines both ends of the grid with convolutional perfectly matched layers
+  // (see cpml.h) instead of the reflecting PEC walls. The layers are updated
+  // within the E and H updates of the chunks holding them. Should be called
+  // after SetStabilityFactorAndTimeResolution and SetDomainDecomposition. 
+  // Returns false if the layers do not fit in the grid.
+  bool SetAbsorbingBoundaries(const CPMLParameters& parameters);
+  
+  // fills the regions of the grid with dielectric, magnetic or lossy media 
+  // (see material_map.h), vacuum elsewhere. The nodes of the absorbing 
+  // layers stay in vacuum. Should be called after 
+  // SetStabilityFactorAndTimeResolution and SetDomainDecomposition. Returns
+  // false if a region is not valid.
+  bool SetMaterials(const std::vector<MaterialRegion>& regions);
+  
+  // fills the regions of the grid with Drude and Lorentz media (see 
+  // dispersive_media.h). Their E nodes replace the materials of 
+  // SetMaterials, their H nodes keep them. Should be called after 
+  // SetStabilityFactorAndTimeResolution and SetDomainDecomposition. Returns
+  // false if the regions overlap or a pole is not stable at the time step.
+  bool SetDispersiveMedia(const std::vector<DispersiveRegion>& regions);
+  
+  // records E at the nodes nearest to the positions probes after every time 
+  // step, and the running DFT of E over the nodes and frequencies of 
+  // dft_regions (see field_monitors.h). The monitors are updated by the 
+  // threads right after the E updates of their nodes. Should be called after
+  // SetSimulationTime and SetDomainDecomposition. Returns false if a monitor
+  // is outside of the grid.
+  bool SetMonitors(const std::vector<double>& probes,
+                   const std::vector<DFTMonitorRegion>& dft_regions);
+  
+  // refines the regions of the grid in space and time (see subgrid.h). The 
+  // fine grids are advanced by the last thread finishing the E update of 
+  // each time step. The media of SetMaterials and SetDispersiveMedia are 
+  // rebuilt on the fine grids, so it should be called after them, after 
+  // SetAbsorbingBoundaries and after SetSimulationTime. With subgrids the 
+  // temporal blocking engine falls back to the per-step engine. Returns 
+  // false if the subgrids overlap, hold less than two coarse cells, or cross
+  // the ends of the grid, the absorbing layers or the boundaries of the 
+  // ranks.
+  bool SetSubgrids(const std::vector<SubgridRegion>& regions);
+  
+  // writes the monitors of the last run to file_prefix_probes.csv and 
+  // file_prefix_dft.csv. With domain decomposition each rank writes the 
+  // monitors of its nodes with the prefix file_prefix.RANK. Returns false if
+  // a file can not be written.
+  bool WriteMonitors(const std::string& file_prefix);
+  
+  // writes a checkpoint of the fields, the time index and the sources to 
+  // file_name every interval time steps (0 disables), see checkpoint.h. The
+  // threads copy their chunks into the mapped file after the time step and 
+  // the file is flushed in the background. With domain decomposition each
+  // rank writes file_name.RANK.
+  void SetCheckpointing(const std::string& file_name, 
+                        const IntNumber interval);
+  
+  // publishes every time_stride time steps the E field at every space_stride
+  // grid point in the shared memory segment name (empty disables), a ring of
+  // num_slots frames, see live_frames.h. The threads copy their chunks into
+  // the frame after the time step and never wait for the readers. With 
+  // domain decomposition each rank publishes its part in name.RANK.
+  void SetLiveFrames(const std::string& name, const IntNumber time_stride,
+                     const IntNumber space_stride, const IntNumber num_slots);
+  
+  // restores the fields, the time index and the sources saved in a 
+  // checkpoint, so that CreateThreadsAndRun continues the interrupted run 
+  // with the results of an uninterrupted one. The grid, the time step and the
+  // precision should be those of the checkpoint, and the sources of the 
+  // checkpoint replace the inserted ones. Should be called after 
+  // InitializeAndResetEMFieldArrays. Returns false if the checkpoint can not
+  // be read or does not fit.
+  bool RestoreCheckpoint(const std::string& file_name);
+  
   int get_num_threads();
+  IntNumber get_num_x();
+  IntNumber get_num_t();
+  IntNumber get_ind_t();          // the current time step
+  SourceReal get_time();          // get_ind_t()*dt
   void PrintParameters();
   
-  // adds a gaussian point source to the problem
-  void InsertGaussianPointSource(const RealNumber position, 
-                                 const RealNumber amplitude, 
-                                 const RealNumber t_center, 
-                                 const RealNumber t_decay);
+  // adds a point source to the problem. See em_source.h for the sources.
+  void InsertPointSource(std::unique_ptr<PointSource<SourceReal>> source);
+  // removes the point sources, so that the next run can insert new ones
+  void ClearPointSources();
+  void InsertGaussianPointSource(const SourceReal position, 
+                                 const SourceReal amplitude, 
+                                 const SourceReal t_center, 
+                                 const SourceReal t_decay);
+  void InsertModulatedGaussianPointSource(const SourceReal position, 
+                                          const SourceReal amplitude, 
+                                          const SourceReal t_center, 
+                                          const SourceReal t_decay,
+                                          const SourceReal frequency,
+                                          const SourceReal phase);
+  void InsertSinusoidalPointSource(const SourceReal position, 
+                                   const SourceReal amplitude, 
+                                   const SourceReal frequency,
+                                   const SourceReal phase,
+                                   const SourceReal t_start);
+  void InsertTabulatedPointSource(const SourceReal position, 
+                                  const SourceReal t_start,
+                                  const SourceReal sample_dt,
+                                  const std::vector<SourceReal>& samples);
+  
+  // sorts the point sources by grid index and finds their active time 
+  // windows. Called by CreateThreadsAndRun().
+  void PrepareSources();
+  
+  // tabulates the contributions of the sources in the chunk of the thread over
+  // their active time windows. Each thread calls it before the time stepping.
+  void TabulateSourceWaveforms(const int thread_index);
+  
+  // zeroes the E and H nodes of the chunk of the thread if the field arrays
+  // were allocated without being initialized. Each thread calls it first.
+  void FirstTouchFields(const int thread_index);
+  
+  // Active region: in 1D the fields spread by at most one grid point per time
+  // step. Starting from the non-zero nodes of the current fields, and from 
+  // each source once its first non-zero contribution is applied, the nodes 
+  // that can be non-zero form a set of intervals growing by one node on each
+  // side per time step. The nodes outside of these intervals are still 0 and
+  // their updates would not change them, so the E and H updates skip them and
+  // the results are identical to the full sweep.
+  
+  // finds the non-zero nodes of the fields and the first time step of each
+  // source. Called by the last thread after the sources are tabulated.
+  void InitializeActiveRegion();
+  
+  // grows active_intervals_ to cover the nodes that can be non-zero after the
+  // updates of the time step ind_t. The intervals of a later time step are a
+  // superset of those of an earlier one.
+  void AdvanceActiveRegion(const IntNumber ind_t);
+  
+  // splits the active intervals in num_threads_ chunks with the same number
+  // of active nodes (the kPerStep engine). With the first touch placement the
+  // threads keep their own chunks, whose pages are local to them.
+  void UpdateActiveChunkBounds();
+  
+  // resets the cost model to a uniform cost per node. Called before the 
+  // threads start.
+  void InitializeLoadBalancing();
+  
+  // repartitions thread_data_chunk_bounds_ if the load is unbalanced. Called
+  // by the last thread after each time step, while the others wait.
+  void BalanceLoad();
+  
+  // splits the nodes of the sorted and disjoint intervals in num_threads_ 
+  // chunks [bounds[i], bounds[i + 1]) with the same cost in the cost model.
+  // E and H nodes share the chunks, so the staggered ownership is unchanged:
+  // the thread of E node i also owns the H node i on its right side.
+  void SplitByCost(
+      const std::vector<std::pair<IntNumber, IntNumber>>& intervals,
+      IntNumber* bounds);
+  
+  // calls function(begin, end) for each non-empty intersection [begin, end) 
+  // of [ind_begin, ind_end) with the active intervals
+  template <typename Function>
+  void ForEachActiveRange(const IntNumber ind_begin, const IntNumber ind_end,
+                          Function function);
   // at each time step the electric fields are updated using this function based
   // on the Maxwell-Ampere equation
-  void UpdateElectricENodes(const int thread_index, 
-                            const UpdateState& nextState);
+  void UpdateElectricENodes(const int thread_index);
                             
   // at each time step the magnetic fields are updated using this function based
   // on the Maxwell-Faraday equation
-  void UpdateMagneticHNodes(const int thread_index, 
-                            const UpdateState& nextState);
+  void UpdateMagneticHNodes(const int thread_index);
+  
+  // updates the E nodes in [ind_begin, ind_end) to the time step ind_t, 
+  // including the point sources located in this range, and records the 
+  // monitors of the range. The nodes on the boundaries of the computational
+  // domain are not updated.
+  void UpdateElectricENodesInRange(const IntNumber ind_begin,
+                                   const IntNumber ind_end,
+                                   const IntNumber ind_t);
+  
+  // the two parts of UpdateElectricENodesInRange: the update of the E nodes
+  // by the H field and the contributions of the point sources
+  void UpdateElectricENodesInRangeWithoutSources(const IntNumber ind_begin,
+                                                 const IntNumber ind_end);
+  void ApplyPointSourcesInRange(const IntNumber ind_begin, 
+                                const IntNumber ind_end,
+                                const IntNumber ind_t);
+  
+  // updates the H nodes in [ind_begin, ind_end)
+  void UpdateMagneticHNodesInRange(const IntNumber ind_begin,
+                                   const IntNumber ind_end);
+  
+  // the E (H) update of the nodes in [ind_begin, ind_end) outside of the 
+  // absorbing layers, in vacuum or in the media of materials_ and 
+  // dispersion_. UpdateNonDispersiveENodes skips the dispersive media.
+  void UpdateInteriorENodes(const IntNumber ind_begin, 
+                            const IntNumber ind_end);
+  void UpdateNonDispersiveENodes(const IntNumber ind_begin, 
+                                 const IntNumber ind_end);
+  void UpdateInteriorHNodes(const IntNumber ind_begin, 
+                            const IntNumber ind_end);
+  
+  // the updates of UpdateNonDispersiveENodes and UpdateInteriorHNodes with
+  // the differences of the order space_order, see SetSpatialOrder
+  void UpdateENodesWithOrder(const IntNumber ind_begin, 
+                             const IntNumber ind_end, const int space_order);
+  void UpdateHNodesWithOrder(const IntNumber ind_begin, 
+                             const IntNumber ind_end, const int space_order);
                             
   void UpdateFieldsCuncurrently(const int thread_index);
   void UpdateFieldsAndWriteToFileCuncurrently(const int thread_index);
+  void UpdateFieldsWithTemporalBlocking(const int thread_index);
+  void UpdateFieldsWithHaloExchange(const int thread_index);
+  void UpdateFieldsWithTaskGraph(const int thread_index);
+  
+  // the kTaskGraph engine: splits the grid in tiles, prepares the tasks up to
+  // the next synchronization and runs them
+  void InitializeTaskTiles();
+  void BeginTaskGraphSegment();
+  void RunTileTasks(const int thread_index);
+  
+  // runs the simulation from the current time step to the end, printing the
+  // progress and the summaries
   void CreateThreadsAndRun();
   
-  // prints the values of the electric field at the end of the simulation
+  // Embedding: the solver keeps its worker threads and its field arrays 
+  // between runs, so that a caller running many short simulations only pays
+  // for the time stepping. A typical loop is
+  //
+  //   fdtd.InitializeAndResetEMFieldArrays();   // reuses the arrays
+  //   fdtd.ClearPointSources();
+  //   fdtd.InsertGaussianPointSource(...);
+  //   fdtd.RunUntil(t);                         // or Step(n) repeatedly
+  //   fdtd.GatherEFieldValues(&e_field);
+  //
+  // The workers are started by the first run and pinned once (see 
+  // worker_pool.h); they are only restarted when the number of threads or 
+  // the affinity changes. Step and RunUntil do not print anything. The 
+  // first call prepares and tabulates the sources, bins them to the threads,
+  // resets the cost model of the load balancing and scans the fields for the
+  // active region. The following calls continue from that state, so that 
+  // Step(1) in a loop costs about as much as one long call. The state is 
+  // rebuilt after the sources, the time step, the simulation time, the 
+  // number of threads, the media or the fields change.
+  
+  // advances the fields by num_steps time steps, or up to the last time 
+  // step of SetSimulationTime. Returns the number of time steps advanced.
+  IntNumber Step(const IntNumber num_steps);
+  
+  // advances the fields up to the first time step at or after t (at most 
+  // the last time step). Returns the number of time steps advanced.
+  IntNumber RunUntil(const SourceReal t);
+  
+  
+  // prints the values of the electric field at the end of the simulation. 
+  // With domain decomposition every rank should call it and rank 0 prints 
+  // the whole grid.
   void PrintEFieldValues();
   
+  // collects the E nodes owned by the ranks, in the order of the grid, into
+  // e_field on rank 0 and returns true on rank 0. Every rank should call it.
+  // Without domain decomposition e_field is a copy of the E field.
+  bool GatherEFieldValues(std::vector<Real>* e_field);
+  
   void SetOutputCSVFileName(const std::string& file_name);
+  void SetOutputFileName(const std::string& file_name);
   void SetTheWriteToFileFlag(bool write_fields_to_file);
+  
+  // the fields are written by a background thread, see field_writer.h. A 
+  // snapshot is written every time_stride time steps, keeping every 
+  // space_stride-th grid point. 
+  void SetFieldOutputOptions(const OutputFormat format, 
+                             const IntNumber time_stride,
+                             const IntNumber space_stride,
+                             const bool write_h_field);
+  // num_buffers snapshots can wait to be written before the threads have to
+  // wait for the disk
+  void SetFieldOutputBuffering(const int num_buffers, const bool use_direct_io);
+  // snapshots per compressed chunk of the OutputFormat::kChunked format
+  void SetFieldOutputChunkSize(const IntNumber steps_per_chunk);
+  
+  // writes the electric field directly from the calling thread
   void WriteEfieldValuesToCSVFile(const std::string& file_name);
   
   private:
-  RealNumber x0_;               // [x0_, x1_] : computational domain range
-  RealNumber x1_;
-  RealNumber dx_;               // grid point spacing
-  RealNumber t_final_;          // simulation stops at t_final_
-  RealNumber dt_;               // duration of each time step
+  SourceReal x0_;               // [x0_, x1_] : computational domain range
+  SourceReal x1_;
+  SourceReal dx_;               // grid point spacing
+  SourceReal t_final_;          // simulation stops at t_final_
+  SourceReal dt_;               // duration of each time step
   IntNumber num_x_;             // total number of spatial grid points
   IntNumber num_t_;             // total number of time steps
   IntNumber ind_t_;             // current time index ---> t = ind_t_*dt
-  RealNumber stability_factor_; // numerical stability factor
+  SourceReal stability_factor_; // numerical stability factor
+  
+  // the update coefficients dt_/(dx_*epsilon_0) and dt_/(dx_*mu_0) used in
+  // the E and H updates, and dt_/(dx_*epsilon_0) in the source precision
+  Real dt_dx_eps0_;
+  Real dt_dx_mu0_;
+  SourceReal source_dt_dx_eps0_;
+  
+  // the order of the spatial differences (see SetSpatialOrder) and the 
+  // coefficients of the fourth order updates in vacuum, dt_dx_eps0_ and 
+  // dt_dx_mu0_ weighted by kFourthOrderNearWeight and kFourthOrderFarWeight
+  int space_order_ = 2;
+  Real e_near_coefficient_ = 0;
+  Real e_far_coefficient_ = 0;
+  Real h_near_coefficient_ = 0;
+  Real h_far_coefficient_ = 0;
   
-  // the electric (e) and magnetic (h) field arrays
-  std::unique_ptr<RealNumber[]> e_field_ = nullptr;
-  std::unique_ptr<RealNumber[]> h_field_ = nullptr;
+  // the electric (e) and magnetic (h) field arrays. They are reused by 
+  // InitializeAndResetEMFieldArrays while the number of nodes and the memory
+  // placement do not change.
+  AlignedArray<Real> e_field_ = nullptr;
+  AlignedArray<Real> h_field_ = nullptr;
+  IntNumber allocated_num_x_ = 0;
+  bool allocated_huge_pages_ = false;
+  
+  // the kernels used in the E and H updates
+  KernelType kernel_type_ = KernelType::kAuto;
+  const YeeKernels<Real>* kernels_ = 
+      &GetYeeKernels<Real>(KernelType::kAuto);
   
   // the electric current sources are hold in this container 
-  std::vector<GaussianSource> point_sources_;
+  std::vector<std::unique_ptr<PointSource<SourceReal>>> point_sources_;
+  
+  // a point source ready for the E update. Its contribution 
+  // J(t)*dt_dx_eps is subtracted from the E node index_x at the time steps 
+  // [ind_t_begin, ind_t_end) and is 0 at the other time steps. dt_dx_eps is 
+  // dt/(dx*epsilon_0) in vacuum and dt/(dx*epsilon)/(1 + loss) in a medium.
+  struct PreparedSource {
+    IntNumber index_x;
+    IntNumber ind_t_begin;
+    IntNumber ind_t_end;
+    SourceReal dt_dx_eps;
+    // the contribution at ind_t is source_waveforms_[waveform_offset + ind_t -
+    // ind_t_begin], or is evaluated by source if waveform_offset is -1
+    IntNumber waveform_offset;
+    PointSource<SourceReal>* source;
+  };
   
-  // sets the current state of the algorithm. The threads watch the state of 
-  // this flag to decide their next action.
-  // update_state_ = kUpdateE ---> the electric field should be updated
-  // update_state_ = kUpdateH ---> the magnetic field should be updated
-  // update_state_ = kUpdateOutputFile ---> the fields should be written to 
-  //   the output file
-  std::atomic<UpdateState> update_state_;
+  // the sources in the order of their grid index, so that the sources of a 
+  // chunk (or of any range of nodes) are contiguous and are found by a binary
+  // search. The sources at the same grid index keep the order of insertion.
+  std::vector<PreparedSource> prepared_sources_;
+  std::vector<SourceReal> source_waveforms_;
+  
+  // the sources of the chunk of thread i are prepared_sources_[
+  // thread_source_bounds_[i], thread_source_bounds_[i + 1])
+  std::vector<std::size_t> thread_source_bounds_;
+  
+  // the longest active window (in time steps) that is tabulated. The sources
+  // with longer windows are evaluated at each time step of their window.
+  static constexpr IntNumber kMaxTabulatedSteps = 1 << 16;
   
   int num_threads_ = 1;         // number of threads
   
+  // the domain decomposition, see SetDomainDecomposition. The local node i is
+  // the node grid_offset_ + i of the whole grid, and the rank owns the local
+  // E nodes [owned_x_begin_, owned_x_end_).
+  HaloTransport* halo_transport_ = nullptr;
+  int rank_ = 0;
+  int num_ranks_ = 1;
+  IntNumber global_num_x_ = 0;
+  IntNumber grid_offset_ = 0;
+  IntNumber owned_x_begin_ = 0;
+  IntNumber owned_x_end_ = 0;
+  
+  // the absorbing layers at the ends of the grid, see SetAbsorbingBoundaries
+  CPMLBoundary<Real> cpml_;
+  
+  // the media of the grid, see SetMaterials. Vacuum if not enabled.
+  MaterialMap<Real> materials_;
+  
+  // the dispersive media, see SetDispersiveMedia
+  DispersiveMedia<Real> dispersion_;
+  
+  // the probes and the DFT monitors, see SetMonitors
+  FieldMonitors<Real> monitors_;
+  
+  // the refined regions in the order of the grid, see SetSubgrids. The 
+  // regions of the media are kept to build the media of the subgrids.
+  std::vector<Subgrid<Real, SourceReal>> subgrids_;
+  std::vector<MaterialRegion> material_regions_;
+  std::vector<DispersiveRegion> dispersive_regions_;
+  
+  // advances the subgrids over the time step ind_t_ after the E update. Each
+  // thread advances the subgrids starting in its chunk, then the last thread
+  // arriving at the barrier copies the fine grids on the coarse nodes they 
+  // cover and records the monitors of these nodes, before the H update.
+  void UpdateSubgrids(const int thread_index);
+  
+  // records the monitors of the E nodes [ind_begin, ind_end) after their 
+  // update at the time step ind_t, except the nodes covered by the subgrids
+  void RecordMonitorsInRange(const IntNumber ind_begin, 
+                             const IntNumber ind_end, const IntNumber ind_t);
+  
   // holds the beginning and end of each chunk of grid handled by a given thread 
   std::unique_ptr<IntNumber[]> thread_data_chunk_bounds_ = nullptr;
+  
+  // the load balancing: each thread adds the time of its E and H updates and
+  // the active nodes of its chunks to its ChunkCost. The cost model is a 
+  // piecewise constant cost per node, cost_model_densities_[j] on 
+  // [cost_model_bounds_[j], cost_model_bounds_[j + 1]).
+  struct alignas(kCacheLineSize) ChunkCost {
+    std::int64_t time;        // nanoseconds
+    IntNumber num_nodes;
+  };
+  bool load_balancing_ = false;
+  IntNumber load_balancing_interval_ = 64;
+  double load_balancing_threshold_ = 0.05;
+  AlignedObjectArray<ChunkCost> chunk_costs_ = nullptr;
+  std::vector<IntNumber> cost_model_bounds_;
+  std::vector<double> cost_model_densities_;
+  int num_rebalances_ = 0;
+  
+  // the CPU of each thread (empty if the threads are not pinned)
+  AffinityPolicy affinity_policy_ = AffinityPolicy::kNone;
+  std::vector<int> affinity_cpus_;      // the list of AffinityPolicy::kExplicit
+  std::vector<int> thread_cpus_;
+  
+  bool first_touch_ = false;
+  bool huge_pages_ = false;
+  bool uses_huge_pages_ = false;        // huge pages were granted
+  // the field arrays are not initialized yet, the threads zero them
+  bool fields_need_first_touch_ = false;
 
-  // counts the number of thread that completed their job at a given states
-  std::atomic<int> num_of_e_updated_threads_;
-  std::atomic<int> num_of_h_updated_threads_;
+  // the threads wait at this barrier after updating the E fields and after
+  // updating the H fields in their chunks. The last thread arriving at the
+  // barrier after the H update advances ind_t_ (and writes the output file).
+  BarrierMode barrier_mode_ = BarrierMode::kHybrid;
+  ThreadBarrier barrier_;
+  
+  // the worker threads, kept between the runs
+  WorkerPool worker_pool_;
+  
+  // the threads advance the fields from ind_t_ to ind_t_stop_, see Step
+  IntNumber ind_t_stop_ = 0;
+  // the prepared sources and their waveforms, the source bins of the 
+  // threads, the cost model and the active region are up to date, so that 
+  // Step continues from them. Cleared by the setters changing them.
+  bool run_state_is_valid_ = false;
+  
+  // the sorted and disjoint intervals [first, second) of the nodes that can be
+  // non-zero up to the time step active_region_step_. They only change in 
+  // the barrier completions.
+  bool track_active_region_ = true;
+  std::vector<std::pair<IntNumber, IntNumber>> active_intervals_;
+  IntNumber active_region_step_ = 0;
+  bool active_region_is_full_ = false;    // active_intervals_ = [0, num_x_)
+  // (first non-zero time step, grid index) of the sources that did not start
+  // at active_region_step_, in the order of their first time step
+  std::vector<std::pair<IntNumber, IntNumber>> pending_sources_;
+  std::size_t next_pending_source_ = 0;
+  // the chunks of the kPerStep engine, which share the active nodes evenly
+  std::vector<IntNumber> active_chunk_bounds_;
+  
+  TimeSteppingEngine time_stepping_engine_ = TimeSteppingEngine::kPerStep;
+  int tile_depth_ = 16;             // time steps per temporal block
+  IntNumber tile_width_ = 16384;    // grid points per tile
+  
+  // the tiles of the kTaskGraph engine, tile i covers the E nodes 
+  // [task_tile_bounds_[i], task_tile_bounds_[i + 1]). The tasks are run up to 
+  // task_graph_segment_end_ before the threads synchronize.
+  TileTaskGraph task_graph_;
+  std::vector<IntNumber> task_tile_bounds_;
+  IntNumber task_graph_segment_end_ = 0;
   
   // write the output electric field to the output file after each time step
   // the saved values can then be used to visualize the fields.
   bool write_fields_to_file_ = false;
   std::string output_file_name_;
+  FieldWriter<Real> field_writer_;
+  // the output file stays open from the first time step to the last one
+  bool field_output_is_open_ = false;
+  
+  // the thread function of the selected engine
+  using ThreadFunction = void (FDTD1D::*)(const int);
+  ThreadFunction GetThreadFunction();
+  
+  // the buffer receiving the snapshot of the current time step. It is 
+  // acquired by the last thread finishing the H update, filled by all the 
+  // threads and submitted to field_writer_ after the next E update.
+  Real* field_snapshot_ = nullptr;
+  
+  // submits field_snapshot_ if it is not empty
+  void SubmitFieldSnapshot();
+  
+  // calls function(begin, end) for the nodes the thread copies to a snapshot
+  // of the fields taken after a time step: the active chunk it updates at
+  // the next time step, and the nodes outside of all the chunks for the first
+  // and the last thread. No other thread modifies these nodes before the 
+  // next barrier.
+  template <typename Function>
+  void ForEachSnapshotRange(const int thread_index, Function function);
+  
+  // the checkpoints, see SetCheckpointing. BeginCheckpoint maps a new 
+  // checkpoint file when ind_t_ passed a multiple of checkpoint_interval_ 
+  // since ind_t_before, the threads copy their nodes into it with 
+  // CopyFieldsToCheckpoint and SubmitCheckpoint hands it over to the
+  // background flush. Begin and Submit are called in barrier completions.
+  std::string checkpoint_file_name_;
+  IntNumber checkpoint_interval_ = 0;
+  CheckpointWriter checkpoint_writer_;
+  std::vector<char> checkpoint_sources_;    // encoded once per run
+  Real* checkpoint_e_field_ = nullptr;
+  Real* checkpoint_h_field_ = nullptr;
+  
+  // file_name, or file_name.RANK with domain decomposition
+  std::string GetCheckpointFileName(const std::string& file_name);
+  void BeginCheckpoint(const IntNumber ind_t_before);
+  void CopyFieldsToCheckpoint(const int thread_index);
+  void SubmitCheckpoint();
+  
+  // the live frames, see SetLiveFrames. BeginLiveFrame starts a frame when 
+  // ind_t_ passed a multiple of live_time_stride_ since ind_t_before, the 
+  // threads copy their nodes into it with CopyFieldsToLiveFrame and 
+  // PublishLiveFrame completes it. Begin and Publish are called in barrier 
+  // completions, next to the checkpoints.
+  std::string live_frame_name_;
+  IntNumber live_time_stride_ = 1;
+  IntNumber live_space_stride_ = 1;
+  IntNumber live_num_slots_ = 16;
+  LiveFrameRing live_frames_;
+  Real* live_frame_ = nullptr;
+  void OpenLiveFrames();
+  void BeginLiveFrame(const IntNumber ind_t_before);
+  void CopyFieldsToLiveFrame(const int thread_index);
+  void PublishLiveFrame();
+  
+  // the state of the solver beyond the E and H fields (the auxiliary fields 
+  // of the absorbing layers and of the dispersive media, the records of the
+  // monitors and the fine fields of the subgrids), saved in the auxiliary 
+  // section of the checkpoints. SetAuxiliaryState returns false if
+  // the size does not match.
+  std::vector<char> GetAuxiliaryState();
+  bool SetAuxiliaryState(const char* data, const std::size_t size);
+  
+  // the per thread measurements, see SetProfiling
+  ThreadProfiler profiler_;
+  ProfileRunInfo profile_run_info_ = {0, 0, sizeof(Real), 0.0};
+  
+  // the number of active nodes in [ind_begin, ind_end)
+  IntNumber CountActiveNodes(const IntNumber ind_begin, 
+                             const IntNumber ind_end);
+  
+  // barrier_.Wait() whose waiting time is added to phase in the profile of 
+  // the thread
+  void WaitAtBarrier(const int thread_index, const ProfilePhase phase);
+  template <typename Function>
+  void WaitAtBarrier(const int thread_index, const ProfilePhase phase, 
+                     Function completion);
   
 };
 
@@ -0,0 +1,428 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "fdtd1d_ensemble.h"
+
+namespace fdtd1d {
+
+template <typename Real, typename SourceReal>
+constexpr IntNumber FDTD1DEnsemble<Real, SourceReal>::kBlockWidth;
+
+template <typename Real, typename SourceReal>
+FDTD1DEnsemble<Real, SourceReal>::FDTD1DEnsemble() 
+    : ind_t_(0), num_threads_(1) {}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetXAxisRangeAndGridSpacing(
+    const SourceReal x0, const SourceReal x1, const SourceReal dx) {
+  x0_ = x0;
+  x1_ = x1;
+  num_x_ = static_cast<IntNumber>((x1 - x0) / dx);
+  dx_ = (x1 - x0) / num_x_;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetNumberOfInstances(
+    const int num_instances) {
+  num_instances_ = std::max(num_instances, 1);
+  num_blocks_ = (num_instances_ + kBlockWidth - 1) / kBlockWidth;
+  point_sources_.resize(num_blocks_);
+  point_source_lanes_.resize(num_blocks_);
+  prepared_sources_.resize(num_blocks_);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::InitializeAndResetEMFieldArrays() {
+  IntNumber e_size = num_blocks_*num_x_*kBlockWidth;
+  IntNumber h_size = num_blocks_*(num_x_ - 1)*kBlockWidth;
+  e_field_ = AllocateAlignedArray<Real>(e_size);
+  h_field_ = AllocateAlignedArray<Real>(h_size);
+  
+  for (IntNumber i = 0; i < e_size; ++i) {
+    e_field_[i] = 0.0;
+  }
+  for (IntNumber i = 0; i < h_size; ++i) {
+    h_field_[i] = 0.0;
+  }
+}
+
+template <typename Real, typename SourceReal>
+Real* FDTD1DEnsemble<Real, SourceReal>::GetBlockEField(const IntNumber block) {
+  return e_field_.get() + block*num_x_*kBlockWidth;
+}
+
+template <typename Real, typename SourceReal>
+Real* FDTD1DEnsemble<Real, SourceReal>::GetBlockHField(const IntNumber block) {
+  return h_field_.get() + block*(num_x_ - 1)*kBlockWidth;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetStabilityFactorAndTimeResolution(
+    const SourceReal stability_factor) {
+  using Constants = PhysicalConstants<SourceReal>;
+  stability_factor_ = stability_factor;
+  dt_ = stability_factor*dx_ / Constants::c;
+  
+  source_dt_dx_eps0_ = dt_/(dx_*Constants::epsilon_0);
+  dt_dx_eps0_ = static_cast<Real>(source_dt_dx_eps0_);
+  dt_dx_mu0_ = static_cast<Real>(dt_/(dx_*Constants::mu_0));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetSimulationTime(
+    const SourceReal t_final) {
+  t_final_ = t_final;
+  num_t_ = static_cast<IntNumber>(t_final_ / dt_);
+} 
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetNumberOfThreads(
+    const int num_threads) {
+  num_threads_ = num_threads;
+  thread_data_chunk_bounds_.reset(new IntNumber[num_threads + 1]);
+  thread_data_chunk_bounds_[0] = 0;
+  thread_data_chunk_bounds_[num_threads] = num_x_;
+  for(int i = 1; i < num_threads; ++i){
+    thread_data_chunk_bounds_[i] = 
+      static_cast<IntNumber>(i*std::lround(num_x_ / num_threads_));
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetSynchronizationMode(
+    const BarrierMode mode) {
+  barrier_mode_ = mode;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::SetKernelType(
+    const KernelType kernel_type) {
+  kernel_type_ = kernel_type;
+  kernels_ = &GetYeeKernels<Real>(kernel_type);
+  if (kernels_->type != kernel_type && kernel_type != KernelType::kAuto) {
+    std::cout << "The " << GetKernelTypeName(kernel_type) << " kernels are "
+              << "not supported by the processor." << std::endl;
+  }
+}
+
+template <typename Real, typename SourceReal>
+int FDTD1DEnsemble<Real, SourceReal>::get_num_instances() {
+  return num_instances_;
+}
+
+template <typename Real, typename SourceReal>
+IntNumber FDTD1DEnsemble<Real, SourceReal>::get_num_x() {
+  return num_x_;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1DEnsemble<Real, SourceReal>::InsertPointSource(
+    const int instance, std::unique_ptr<PointSource<SourceReal>> source) {
+  if (instance < 0 || instance >= num_instances_) {
+    std::cout << "The ensemble has no instance " << instance << "." 
+              << std::endl;
+    return false;
+  }
+  IntNumber ind_x = static_cast<IntNumber>((source->get_position() - x0_)/dx_);
+  source->set_index_x(ind_x);
+  point_sources_[instance / kBlockWidth].emplace_back(std::move(source));
+  point_source_lanes_[instance / kBlockWidth].push_back(instance % kBlockWidth);
+  ++num_point_sources_;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1DEnsemble<Real, SourceReal>::InsertGaussianPointSource(
+    const int instance, const SourceReal position, const SourceReal amplitude,
+    const SourceReal t_center, const SourceReal t_decay) {
+  return InsertPointSource(instance, std::unique_ptr<PointSource<SourceReal>>(
+      new GaussianSource<SourceReal>(position, amplitude, t_center, t_decay)));
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::PrepareSources() {
+  IntNumber waveforms_size = 0;
+  for (IntNumber block = 0; block < num_blocks_; ++block) {
+    auto& prepared_sources = prepared_sources_[block];
+    prepared_sources.clear();
+    for (std::size_t s = 0; s < point_sources_[block].size(); ++s) {
+      PointSource<SourceReal>* source = point_sources_[block][s].get();
+      PreparedSource prepared = {source->get_index_x(), 
+                                 point_source_lanes_[block][s], 0, num_t_, 
+                                 -1, source};
+      // the time steps of the active window with a margin of one step for 
+      // the rounding of ind_t*dt_
+      SourceReal t_begin, t_end;
+      source->GetActiveTimeWindow(&t_begin, &t_end);
+      SourceReal step_begin = std::floor(t_begin / dt_) - 1;
+      SourceReal step_end = std::ceil(t_end / dt_) + 2;
+      if (step_begin > 0) {
+        prepared.ind_t_begin = std::min<IntNumber>(
+            num_t_, static_cast<IntNumber>(step_begin));
+      }
+      if (step_end < num_t_) {
+        prepared.ind_t_end = std::max<IntNumber>(
+            prepared.ind_t_begin, static_cast<IntNumber>(step_end));
+      }
+      
+      IntNumber window_size = prepared.ind_t_end - prepared.ind_t_begin;
+      if (window_size <= kMaxTabulatedSteps) {
+        prepared.waveform_offset = waveforms_size;
+        waveforms_size += window_size;
+      }
+      prepared_sources.push_back(prepared);
+    }
+    std::stable_sort(prepared_sources.begin(), prepared_sources.end(),
+                     [](const PreparedSource& a, const PreparedSource& b) {
+                       return a.index_x < b.index_x;
+                     });
+  }
+  source_waveforms_.resize(waveforms_size);
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::TabulateSourceWaveforms(
+    const int thread_index) {
+  if (num_blocks_ >= num_threads_) {
+    for (IntNumber block = thread_index; block < num_blocks_; 
+         block += num_threads_) {
+      for (PreparedSource& prepared : prepared_sources_[block]) {
+        TabulateSourceWaveform(&prepared);
+      }
+    }
+    return;
+  }
+  const IntNumber ind_begin = thread_data_chunk_bounds_[thread_index];
+  const IntNumber ind_end = thread_data_chunk_bounds_[thread_index + 1];
+  for (IntNumber block = 0; block < num_blocks_; ++block) {
+    for (PreparedSource& prepared : prepared_sources_[block]) {
+      if (prepared.index_x >= ind_begin && prepared.index_x < ind_end) {
+        TabulateSourceWaveform(&prepared);
+      }
+    }
+  }
+}
+
+// see FDTD1D::TabulateSourceWaveforms
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::TabulateSourceWaveform(
+    PreparedSource* prepared) {
+  if (prepared->waveform_offset < 0) {
+    return;
+  }
+  SourceReal* waveform = source_waveforms_.data() + prepared->waveform_offset;
+  IntNumber window_size = prepared->ind_t_end - prepared->ind_t_begin;
+  for (IntNumber k = 0; k < window_size; ++k) {
+    SourceReal t = (prepared->ind_t_begin + k)*dt_;
+    waveform[k] = prepared->source->GetCurrentValue(t)*source_dt_dx_eps0_;
+  }
+  auto IsPositiveZero = [](const SourceReal value) {
+    return value == 0 && !std::signbit(value);
+  };
+  IntNumber k_begin = 0;
+  IntNumber k_end = window_size;
+  while (k_begin < k_end && IsPositiveZero(waveform[k_begin])) {
+    ++k_begin;
+  }
+  while (k_end > k_begin && IsPositiveZero(waveform[k_end - 1])) {
+    --k_end;
+  }
+  prepared->ind_t_end = prepared->ind_t_begin + k_end;
+  prepared->ind_t_begin += k_begin;
+  prepared->waveform_offset += k_begin;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::UpdateElectricENodesInRange(
+    const IntNumber block, const IntNumber ind_begin, const IntNumber ind_end,
+    const IntNumber ind_t) {
+  // the grid point i of the block is the contiguous range 
+  // [i*kBlockWidth, (i + 1)*kBlockWidth) and its neighbors are kBlockWidth 
+  // values away
+  Real* e_field = GetBlockEField(block);
+  IntNumber i_begin = std::max<IntNumber>(ind_begin, 1);
+  IntNumber i_end = std::min<IntNumber>(ind_end, num_x_ - 1);
+  if (i_begin < i_end) {
+    kernels_->update_e(e_field, GetBlockHField(block), i_begin*kBlockWidth, 
+                       i_end*kBlockWidth, kBlockWidth, dt_dx_eps0_);
+  }
+  ApplyPointSourcesInRange(block, ind_begin, ind_end, ind_t);
+}
+
+// see FDTD1D::ApplyPointSourcesInRange
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::ApplyPointSourcesInRange(
+    const IntNumber block, const IntNumber ind_begin, const IntNumber ind_end,
+    const IntNumber ind_t) {
+  const auto& prepared_sources = prepared_sources_[block];
+  auto source = std::lower_bound(
+      prepared_sources.begin(), prepared_sources.end(), ind_begin,
+      [](const PreparedSource& a, const IntNumber ind_x) {
+        return a.index_x < ind_x;
+      });
+  Real* e_field = GetBlockEField(block);
+  for (; source != prepared_sources.end() && source->index_x < ind_end; 
+       ++source) {
+    if (ind_t < source->ind_t_begin || ind_t >= source->ind_t_end) {
+      continue;
+    }
+    SourceReal contribution;
+    if (source->waveform_offset >= 0) {
+      contribution = source_waveforms_[
+          source->waveform_offset + ind_t - source->ind_t_begin];
+    } else {
+      SourceReal t = ind_t*dt_;
+      contribution = source->source->GetCurrentValue(t)*source_dt_dx_eps0_;
+    }
+    Real& e = e_field[source->index_x*kBlockWidth + source->lane];
+    e = static_cast<Real>(e - contribution);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::UpdateMagneticHNodesInRange(
+    const IntNumber block, const IntNumber ind_begin, 
+    const IntNumber ind_end) {
+  IntNumber i_end = std::min<IntNumber>(ind_end, num_x_ - 1);
+  if (ind_begin < i_end) {
+    kernels_->update_h(GetBlockHField(block), GetBlockEField(block), 
+                       ind_begin*kBlockWidth, i_end*kBlockWidth, kBlockWidth, 
+                       dt_dx_mu0_);
+  }
+}
+
+// the blocks are independent, so each thread advances its blocks one after 
+// the other without synchronization while their fields are in the cache
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::UpdateBlocksIndependently(
+    const int thread_index) {
+  TabulateSourceWaveforms(thread_index);
+  for (IntNumber block = thread_index; block < num_blocks_; 
+       block += num_threads_) {
+    for (IntNumber ind_t = 0; ind_t < num_t_; ++ind_t) {
+      UpdateElectricENodesInRange(block, 0, num_x_, ind_t);
+      UpdateMagneticHNodesInRange(block, 0, num_x_);
+    }
+  }
+  barrier_.Wait(thread_index, [this] { ind_t_ = num_t_; });
+}
+
+// see FDTD1D::UpdateFieldsCuncurrently
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::UpdateFieldsCuncurrently(
+    const int thread_index) {
+  const IntNumber ind_begin = thread_data_chunk_bounds_[thread_index];
+  const IntNumber ind_end = thread_data_chunk_bounds_[thread_index + 1];
+  TabulateSourceWaveforms(thread_index);
+  for (IntNumber i = 0; i < num_t_; ++i) {
+    for (IntNumber block = 0; block < num_blocks_; ++block) {
+      UpdateElectricENodesInRange(block, ind_begin, ind_end, ind_t_);
+    }
+    barrier_.Wait(thread_index);
+
+    for (IntNumber block = 0; block < num_blocks_; ++block) {
+      UpdateMagneticHNodesInRange(block, ind_begin, ind_end);
+    }
+    barrier_.Wait(thread_index, [this] { ++ind_t_; });
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::CreateThreadsAndRun() {
+  std::vector<std::thread> threads;
+  
+  std::cout << "Initializing " << num_threads_ << " threads..." << std::endl;
+  ind_t_ = 0;
+  PrepareSources();
+  barrier_.Reset(num_threads_, barrier_mode_);
+  for (int i = 0; i < num_threads_; ++i) {
+    if (num_blocks_ >= num_threads_) {
+      threads.emplace_back(
+        std::thread(&FDTD1DEnsemble::UpdateBlocksIndependently, this, i));
+    } else {
+      threads.emplace_back(
+        std::thread(&FDTD1DEnsemble::UpdateFieldsCuncurrently, this, i));
+    }
+  }
+  
+  for (int i = 0; i < num_threads_; ++i) {
+    threads[i].join();
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::GetEFieldValues(
+    const int instance, std::vector<Real>* e_field) {
+  e_field->resize(num_x_);
+  for (IntNumber i = 0; i < num_x_; ++i) {
+    (*e_field)[i] = GetBlockEField(instance / kBlockWidth)[
+        i*kBlockWidth + instance % kBlockWidth];
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::GetHFieldValues(
+    const int instance, std::vector<Real>* h_field) {
+  h_field->resize(num_x_ - 1);
+  for (IntNumber i = 0; i < num_x_ - 1; ++i) {
+    (*h_field)[i] = GetBlockHField(instance / kBlockWidth)[
+        i*kBlockWidth + instance % kBlockWidth];
+  }
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::PrintEFieldValues(const int instance) {
+  std::cout << std::endl << "Electric field values of instance " << instance
+            << ": " << std::endl;
+  const Real* e_field = GetBlockEField(instance / kBlockWidth);
+  for (IntNumber i = 0; i < num_x_; ++i) {
+    std::cout << e_field[i*kBlockWidth + instance % kBlockWidth] << " ";
+  }
+  std::cout << std::endl;
+}
+
+template <typename Real, typename SourceReal>
+bool FDTD1DEnsemble<Real, SourceReal>::WriteFieldsToFile(
+    const int instance, const std::string& file_name, 
+    FieldWriter<Real>* writer) {
+  FieldOutputMetadata metadata = {
+      static_cast<double>(x0_), static_cast<double>(x1_), 
+      static_cast<double>(dx_), static_cast<double>(t_final_), 
+      static_cast<double>(dt_), num_x_, num_t_};
+  if (!writer->Open(file_name, metadata)) {
+    return false;
+  }
+  std::vector<Real> e_field;
+  std::vector<Real> h_field;
+  GetEFieldValues(instance, &e_field);
+  GetHFieldValues(instance, &h_field);
+  Real* buffer = writer->AcquireBuffer();
+  writer->CopyFieldsToBuffer(buffer, e_field.data(), h_field.data(), 0, 
+                             num_x_);
+  writer->SubmitBuffer(buffer, ind_t_);
+  writer->Close();
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+void FDTD1DEnsemble<Real, SourceReal>::PrintParameters() {
+  std::cout << "Grid: " << std::endl;
+  std::cout << "x0 : " << x0_ << std::endl;
+  std::cout << "x1 : " << x1_ << std::endl;
+  std::cout << "dx : " << dx_ << std::endl;
+  std::cout << "t1 : " << t_final_ << std::endl;
+  std::cout << "dt : " << dt_ << std::endl;
+  std::cout << "Nx : " << num_x_ << std::endl;
+  std::cout << "Nt : " << num_t_ << std::endl;
+  std::cout << "Instances : " << num_instances_ << " (" << num_blocks_ 
+            << " blocks of " << kBlockWidth << ")" << std::endl;
+  std::cout << "Point sources : " << num_point_sources_ << std::endl;
+  std::cout << "Synchronization : " << GetBarrierModeName(barrier_mode_) 
+            << std::endl;
+  std::cout << "Kernels : " << GetKernelTypeName(kernels_->type) << std::endl;
+}
+
+template class FDTD1DEnsemble<double>;
+template class FDTD1DEnsemble<float>;
+template class FDTD1DEnsemble<float, double>;
+
+}  // namespace fdtd1d
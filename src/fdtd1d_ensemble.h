@@ -0,0 +1,204 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_FDTD1D_ENSEMBLE_H_
+#define FDTD_FDTD1D_ENSEMBLE_H_
+
+// Simulates an ensemble of independent one dimensional FDTD problems that 
+// share the grid and the time step and differ only in their point sources, 
+// e.g. the runs of a parameter sweep.
+//
+// The instances are grouped in blocks of kBlockWidth instances, the number of
+// values in a vector register (kMemoryAlignment/sizeof(Real)). Inside a block
+// the fields are interleaved, the values of all the instances of the block at
+// grid point i are stored next to each other:
+//
+// e_field_[(block*num_x_ + i)*kBlockWidth + lane] 
+//     ---> E at grid point i of the instance block*kBlockWidth + lane
+//
+// so that one vector instruction advances all the instances of a block at a
+// grid point (the Yee kernels with the stride kBlockWidth, see 
+// yee_kernels.h). The fields of a block take kBlockWidth times the memory of
+// one simulation and stay in the cache for moderate grids.
+//
+// If there are at least as many blocks as threads, each thread advances whole
+// blocks through all the time steps without any synchronization. Otherwise 
+// the threads share the grid points of each block as in FDTD1D and 
+// synchronize after each half time step. Each instance gives exactly the 
+// same results as FDTD1D with the same parameters and sources.
+//
+// The point sources are prepared as in FDTD1D: the sources of each block are
+// sorted by grid index, and their contributions over their active time 
+// windows are tabulated by the thread applying them before the time 
+// stepping, so that a block only visits its sources active at a time step.
+
+#include <string>         // std::string
+#include <cmath>          // std::lround, std::floor, std::signbit
+#include <iostream>       // std::cout
+#include <vector>         // std::vector
+#include <thread>         // std::thread
+#include <memory>         // std::unique_ptr
+#include <algorithm>      // std::min, std::max, std::stable_sort
+
+#include "aligned_memory.h"
+#include "em_source.h"
+#include "field_writer.h"
+#include "number_types.h"
+#include "physical_constants.h"
+#include "thread_barrier.h"
+#include "yee_kernels.h"
+
+namespace fdtd1d {
+
+template <typename Real, typename SourceReal = Real>
+class FDTD1DEnsemble {
+  public:
+  FDTD1DEnsemble();
+  void SetXAxisRangeAndGridSpacing(const SourceReal x0, const SourceReal x1, 
+                                   const SourceReal dx);
+  void SetNumberOfInstances(const int num_instances);
+  void InitializeAndResetEMFieldArrays();
+  void SetStabilityFactorAndTimeResolution(const SourceReal stability_factor);
+  void SetSimulationTime(const SourceReal t_final);
+  void SetNumberOfThreads(const int num_threads);
+  void SetSynchronizationMode(const BarrierMode mode);
+  void SetKernelType(const KernelType kernel_type);
+  
+  int get_num_instances();
+  IntNumber get_num_x();
+  void PrintParameters();
+  
+  // adds a point source to the given instance (see em_source.h for the 
+  // sources). Returns false if there is no such instance.
+  bool InsertPointSource(const int instance,
+                         std::unique_ptr<PointSource<SourceReal>> source);
+  bool InsertGaussianPointSource(const int instance,
+                                 const SourceReal position, 
+                                 const SourceReal amplitude, 
+                                 const SourceReal t_center, 
+                                 const SourceReal t_decay);
+  
+  // sorts the point sources of each block by grid index and finds their 
+  // active time windows, see FDTD1D::PrepareSources. Called by 
+  // CreateThreadsAndRun().
+  void PrepareSources();
+  
+  // tabulates the contributions of the sources the thread applies: those of
+  // its blocks, or of its chunk of every block if the threads share the 
+  // blocks. Each thread calls it before the time stepping.
+  void TabulateSourceWaveforms(const int thread_index);
+  
+  // updates the E nodes of the instances of a block in [ind_begin, ind_end)
+  // to the time step ind_t, see FDTD1D::UpdateElectricENodesInRange
+  void UpdateElectricENodesInRange(const IntNumber block,
+                                   const IntNumber ind_begin,
+                                   const IntNumber ind_end,
+                                   const IntNumber ind_t);
+  
+  // updates the H nodes of the instances of a block in [ind_begin, ind_end)
+  void UpdateMagneticHNodesInRange(const IntNumber block,
+                                   const IntNumber ind_begin,
+                                   const IntNumber ind_end);
+  
+  // each thread advances the blocks thread_index, thread_index + num_threads_
+  // ... through all the time steps
+  void UpdateBlocksIndependently(const int thread_index);
+  // the threads advance the chunks of all the blocks step by step
+  void UpdateFieldsCuncurrently(const int thread_index);
+  void CreateThreadsAndRun();
+  
+  // copies the fields of one instance to e_field (num_x values) and h_field
+  // (num_x - 1 values)
+  void GetEFieldValues(const int instance, std::vector<Real>* e_field);
+  void GetHFieldValues(const int instance, std::vector<Real>* h_field);
+  
+  // prints the values of the electric field of one instance
+  void PrintEFieldValues(const int instance);
+  
+  // writes the fields of one instance at the current time step as a single
+  // snapshot of writer, which holds the format and the decimation of the 
+  // output (see field_writer.h). Returns false if the file can not be 
+  // opened.
+  bool WriteFieldsToFile(const int instance, const std::string& file_name,
+                         FieldWriter<Real>* writer);
+  
+  private:
+  SourceReal x0_;               // [x0_, x1_] : computational domain range
+  SourceReal x1_;
+  SourceReal dx_;               // grid point spacing
+  SourceReal t_final_;          // simulation stops at t_final_
+  SourceReal dt_;               // duration of each time step
+  IntNumber num_x_;             // total number of spatial grid points
+  IntNumber num_t_;             // total number of time steps
+  IntNumber ind_t_;             // current time index ---> t = ind_t_*dt
+  SourceReal stability_factor_; // numerical stability factor
+  
+  Real dt_dx_eps0_;
+  Real dt_dx_mu0_;
+  SourceReal source_dt_dx_eps0_;
+  
+  int num_instances_ = 1;
+  // the number of instances in a block, which is also the distance between 
+  // the values of two neighboring grid points
+  static constexpr IntNumber kBlockWidth = kMemoryAlignment / sizeof(Real);
+  IntNumber num_blocks_ = 1;
+  
+  // the interleaved electric (e) and magnetic (h) field arrays of the blocks.
+  // The padding instances of the last block have no sources and stay 0.
+  AlignedArray<Real> e_field_ = nullptr;
+  AlignedArray<Real> h_field_ = nullptr;
+  
+  Real* GetBlockEField(const IntNumber block);
+  Real* GetBlockHField(const IntNumber block);
+  
+  KernelType kernel_type_ = KernelType::kAuto;
+  const YeeKernels<Real>* kernels_ = 
+      &GetYeeKernels<Real>(KernelType::kAuto);
+  
+  // the point sources of each block and the lane of their instance
+  std::vector<std::vector<std::unique_ptr<PointSource<SourceReal>>>> 
+      point_sources_;
+  std::vector<std::vector<int>> point_source_lanes_;
+  IntNumber num_point_sources_ = 0;
+  
+  // a point source of a block ready for the E update. Its contribution 
+  // J(t)*dt/(dx*epsilon_0) is subtracted from the E node index_x of the lane
+  // at the time steps [ind_t_begin, ind_t_end), see FDTD1D::PreparedSource.
+  struct PreparedSource {
+    IntNumber index_x;
+    int lane;
+    IntNumber ind_t_begin;
+    IntNumber ind_t_end;
+    // the contribution at ind_t is source_waveforms_[waveform_offset + ind_t -
+    // ind_t_begin], or is evaluated by source if waveform_offset is -1
+    IntNumber waveform_offset;
+    PointSource<SourceReal>* source;
+  };
+  
+  // the sources of each block in the order of their grid index
+  std::vector<std::vector<PreparedSource>> prepared_sources_;
+  std::vector<SourceReal> source_waveforms_;
+  
+  // adds the contributions of the sources of the block in [ind_begin, 
+  // ind_end) that are active at ind_t
+  void ApplyPointSourcesInRange(const IntNumber block,
+                                const IntNumber ind_begin,
+                                const IntNumber ind_end,
+                                const IntNumber ind_t);
+  
+  // the contributions of a source over its active window
+  void TabulateSourceWaveform(PreparedSource* prepared);
+  
+  // the longest active window that is tabulated, as in FDTD1D
+  static constexpr IntNumber kMaxTabulatedSteps = 1 << 16;
+  
+  int num_threads_ = 1;
+  std::unique_ptr<IntNumber[]> thread_data_chunk_bounds_ = nullptr;
+  
+  BarrierMode barrier_mode_ = BarrierMode::kHybrid;
+  ThreadBarrier barrier_;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_FDTD1D_ENSEMBLE_H_
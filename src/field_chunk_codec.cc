@@ -0,0 +1,203 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "field_chunk_codec.h"
+
+#include <cstdint>        // std::uint32_t, std::uint64_t
+#include <cstring>        // std::memcpy
+
+namespace fdtd1d {
+
+namespace {
+
+void AppendInt64(const std::int64_t value,
+                 std::vector<unsigned char>* encoded) {
+  unsigned char bytes[sizeof(value)];
+  std::memcpy(bytes, &value, sizeof(value));
+  encoded->insert(encoded->end(), bytes, bytes + sizeof(value));
+}
+
+// appends the plane, the bytes of the plane are the bytes_in_plane bytes
+// plane[0], plane[stride], plane[2*stride] ...
+void AppendPlane(const unsigned char* plane, const IntNumber bytes_in_plane,
+                 const int stride, std::vector<unsigned char>* encoded) {
+  IntNumber num_nonzero_bytes = 0;
+  for (IntNumber i = 0; i < bytes_in_plane; ++i) {
+    num_nonzero_bytes += (plane[i*stride] != 0);
+  }
+  IntNumber bitmap_size = (bytes_in_plane + 7) / 8;
+  
+  if (bitmap_size + num_nonzero_bytes >= bytes_in_plane) {
+    AppendInt64(static_cast<std::int64_t>(PlaneEncoding::kRawPlane), encoded);
+    AppendInt64(bytes_in_plane, encoded);
+    std::size_t position = encoded->size();
+    encoded->resize(position + bytes_in_plane);
+    unsigned char* output = encoded->data() + position;
+    for (IntNumber i = 0; i < bytes_in_plane; ++i) {
+      output[i] = plane[i*stride];
+    }
+    return;
+  }
+  
+  AppendInt64(static_cast<std::int64_t>(PlaneEncoding::kSparsePlane), encoded);
+  AppendInt64(bitmap_size + num_nonzero_bytes, encoded);
+  std::size_t position = encoded->size();
+  encoded->resize(position + bitmap_size + num_nonzero_bytes, 0);
+  unsigned char* bitmap = encoded->data() + position;
+  unsigned char* nonzero_bytes = bitmap + bitmap_size;
+  for (IntNumber i = 0; i < bytes_in_plane; ++i) {
+    unsigned char byte = plane[i*stride];
+    if (byte != 0) {
+      bitmap[i / 8] |= static_cast<unsigned char>(1 << (i % 8));
+      *nonzero_bytes++ = byte;
+    }
+  }
+}
+
+// reads an int64 at position and advances position. Returns false at the 
+// end of the chunk.
+bool ReadInt64(const unsigned char* encoded, const std::size_t size,
+               std::size_t* position, std::int64_t* value) {
+  if (size - *position < sizeof(*value)) {
+    return false;
+  }
+  std::memcpy(value, encoded + *position, sizeof(*value));
+  *position += sizeof(*value);
+  return true;
+}
+
+// the inverse of AppendPlane
+bool ReadPlane(const unsigned char* encoded, const std::size_t size,
+               std::size_t* position, const IntNumber bytes_in_plane, 
+               const int stride, unsigned char* plane) {
+  std::int64_t encoding = 0;
+  std::int64_t plane_size = 0;
+  if (!ReadInt64(encoded, size, position, &encoding) ||
+      !ReadInt64(encoded, size, position, &plane_size) ||
+      plane_size < 0 || 
+      static_cast<std::uint64_t>(plane_size) > size - *position) {
+    return false;
+  }
+  const unsigned char* input = encoded + *position;
+  *position += static_cast<std::size_t>(plane_size);
+  
+  if (encoding == static_cast<std::int64_t>(PlaneEncoding::kRawPlane)) {
+    if (plane_size != bytes_in_plane) {
+      return false;
+    }
+    for (IntNumber i = 0; i < bytes_in_plane; ++i) {
+      plane[i*stride] = input[i];
+    }
+    return true;
+  }
+  if (encoding != static_cast<std::int64_t>(PlaneEncoding::kSparsePlane)) {
+    return false;
+  }
+  IntNumber bitmap_size = (bytes_in_plane + 7) / 8;
+  if (plane_size < bitmap_size) {
+    return false;
+  }
+  const unsigned char* bitmap = input;
+  const unsigned char* nonzero_bytes = bitmap + bitmap_size;
+  const unsigned char* nonzero_bytes_end = input + plane_size;
+  for (IntNumber i = 0; i < bytes_in_plane; ++i) {
+    unsigned char byte = 0;
+    if ((bitmap[i / 8] >> (i % 8)) & 1) {
+      if (nonzero_bytes == nonzero_bytes_end) {
+        return false;
+      }
+      byte = *nonzero_bytes++;
+    }
+    plane[i*stride] = byte;
+  }
+  return nonzero_bytes == nonzero_bytes_end;
+}
+
+template <typename Word>
+void EncodeWords(const void* frames, const IntNumber num_frames,
+                 const IntNumber num_values, 
+                 std::vector<unsigned char>* encoded) {
+  // step 1: XOR with the previous snapshot, from the last snapshot backwards
+  IntNumber num_words = num_frames*num_values;
+  std::vector<Word> words(num_words);
+  std::memcpy(words.data(), frames, sizeof(Word)*num_words);
+  for (IntNumber i = num_words - 1; i >= num_values; --i) {
+    words[i] ^= words[i - num_values];
+  }
+  
+  // steps 2 and 3: the byte planes of the little endian words
+  const unsigned char* bytes = 
+      reinterpret_cast<const unsigned char*>(words.data());
+  for (int b = 0; b < static_cast<int>(sizeof(Word)); ++b) {
+    AppendPlane(bytes + b, num_words, sizeof(Word), encoded);
+  }
+}
+
+template <typename Word>
+bool DecodeWords(const unsigned char* encoded, const std::size_t size,
+                 std::size_t position, const IntNumber num_frames,
+                 const IntNumber num_values, 
+                 std::vector<unsigned char>* frames) {
+  IntNumber num_words = num_frames*num_values;
+  std::vector<Word> words(num_words);
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(words.data());
+  for (int b = 0; b < static_cast<int>(sizeof(Word)); ++b) {
+    if (!ReadPlane(encoded, size, &position, num_words, sizeof(Word), 
+                   bytes + b)) {
+      return false;
+    }
+  }
+  // the XOR with the previous snapshot, which is already decoded
+  for (IntNumber i = num_values; i < num_words; ++i) {
+    words[i] ^= words[i - num_values];
+  }
+  frames->resize(sizeof(Word)*num_words);
+  std::memcpy(frames->data(), words.data(), sizeof(Word)*num_words);
+  return position == size;
+}
+
+}  // namespace
+
+void EncodeFieldChunk(const void* frames, const IntNumber num_frames,
+                      const IntNumber num_values, const int word_size,
+                      std::vector<unsigned char>* encoded) {
+  AppendInt64(num_frames, encoded);
+  AppendInt64(num_values, encoded);
+  AppendInt64(word_size, encoded);
+  if (word_size == sizeof(std::uint32_t)) {
+    EncodeWords<std::uint32_t>(frames, num_frames, num_values, encoded);
+  } else {
+    EncodeWords<std::uint64_t>(frames, num_frames, num_values, encoded);
+  }
+}
+
+bool DecodeFieldChunk(const unsigned char* encoded, const std::size_t size,
+                      IntNumber* num_frames, IntNumber* num_values,
+                      int* word_size, std::vector<unsigned char>* frames) {
+  std::size_t position = 0;
+  std::int64_t header[3];
+  for (std::int64_t& value : header) {
+    if (!ReadInt64(encoded, size, &position, &value)) {
+      return false;
+    }
+  }
+  // the planes hold at least one bit per byte, which bounds the number of 
+  // words of a valid chunk by the size of the chunk
+  if (header[0] < 0 || header[1] < 0 || 
+      (header[2] != sizeof(std::uint32_t) && 
+       header[2] != sizeof(std::uint64_t)) ||
+      (header[1] > 0 && 
+       header[0] > static_cast<std::int64_t>(8*size) / header[1])) {
+    return false;
+  }
+  *num_frames = header[0];
+  *num_values = header[1];
+  *word_size = static_cast<int>(header[2]);
+  if (*word_size == sizeof(std::uint32_t)) {
+    return DecodeWords<std::uint32_t>(encoded, size, position, *num_frames,
+                                      *num_values, frames);
+  }
+  return DecodeWords<std::uint64_t>(encoded, size, position, *num_frames,
+                                    *num_values, frames);
+}
+
+}  // namespace fdtd1d
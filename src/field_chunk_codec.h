@@ -0,0 +1,58 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_FIELD_CHUNK_CODEC_H_
+#define FDTD_FIELD_CHUNK_CODEC_H_
+
+// Defines the lossless compression of a chunk of consecutive field snapshots.
+//
+// The snapshots are treated as integer words holding the bit patterns of the 
+// values (word_size is 4 for float and 8 for double):
+//
+// 1. Each word is replaced by its XOR with the word of the same grid point in
+//    the previous snapshot of the chunk (the first snapshot is kept as is). 
+//    Slowly changing values share the sign, the exponent and the leading 
+//    mantissa bits, and the nodes the wave has not reached are exactly 0, 
+//    so most of the high bytes become 0.
+// 2. The words are split into word_size byte planes (byte b of every word, 
+//    in the order of the snapshots and then of the grid points). 
+// 3. Each plane is stored either as is (kRawPlane) or as a bitmap with one bit
+//    per byte, set for the non-zero bytes, followed by the non-zero bytes 
+//    (kSparsePlane), whichever is smaller.
+//
+// Encoded chunk:
+//   int64 num_frames, int64 num_values, int64 word_size,
+//   for each of the word_size planes (least significant byte first):
+//     int64 encoding (kRawPlane or kSparsePlane), int64 size in bytes, 
+//     the size bytes of the plane.
+// The bitmap bits are in the little endian bit order (bit j of byte k 
+// describes the byte 8*k + j of the plane).
+
+#include <cstddef>        // std::size_t
+#include <vector>         // std::vector
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+enum class PlaneEncoding {
+  kRawPlane = 0,
+  kSparsePlane = 1,
+};
+
+// appends the encoding of num_frames consecutive snapshots of num_values 
+// words of word_size bytes (4 or 8) to encoded. frames holds the snapshots 
+// one after the other.
+void EncodeFieldChunk(const void* frames, const IntNumber num_frames,
+                      const IntNumber num_values, const int word_size,
+                      std::vector<unsigned char>* encoded);
+
+// decodes the chunk of size bytes at encoded, written by EncodeFieldChunk,
+// to frames. Returns false if the chunk is truncated or corrupted.
+bool DecodeFieldChunk(const unsigned char* encoded, const std::size_t size,
+                      IntNumber* num_frames, IntNumber* num_values,
+                      int* word_size, std::vector<unsigned char>* frames);
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_FIELD_CHUNK_CODEC_H_
@@ -0,0 +1,323 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "field_monitors.h"
+
+#include <algorithm>      // std::stable_sort, std::lower_bound, std::fill
+#include <cmath>          // std::cos, std::sin, std::sqrt, std::lround
+#include <cstring>        // std::memcpy
+#include <fstream>        // std::ofstream
+#include <iomanip>        // std::setprecision
+#include <iostream>       // std::cout
+
+#include "material_map.h"
+
+namespace fdtd1d {
+
+namespace {
+
+constexpr double kTwoPi = 6.283185307179586476925286766559;
+
+// appends the values of an array to a state and reads them back
+template <typename T>
+void SaveArray(const std::vector<T>& values, char** data) {
+  std::size_t size = values.size()*sizeof(T);
+  if (size > 0) {
+    std::memcpy(*data, values.data(), size);
+  }
+  *data += size;
+}
+
+template <typename T>
+void LoadArray(const char** data, std::vector<T>* values) {
+  std::size_t size = values->size()*sizeof(T);
+  if (size > 0) {
+    std::memcpy(values->data(), *data, size);
+  }
+  *data += size;
+}
+
+}  // namespace
+
+bool ParseDFTMonitorRegion(const std::string& text, DFTMonitorRegion* region) {
+  std::vector<double> values;
+  if (!ParseNumberList(text, &values) ||
+      (values.size() != 3 && values.size() != 5)) {
+    return false;
+  }
+  DFTMonitorRegion parsed;
+  parsed.x_begin = values[0];
+  parsed.x_end = values[1];
+  parsed.f_min = values[2];
+  parsed.f_max = values[2];
+  if (values.size() == 5) {
+    parsed.f_max = values[3];
+    parsed.num_frequencies = static_cast<IntNumber>(values[4]);
+    if (static_cast<double>(parsed.num_frequencies) != values[4]) {
+      return false;
+    }
+  }
+  if (parsed.x_end < parsed.x_begin || parsed.f_min < 0.0 ||
+      parsed.f_max < parsed.f_min || parsed.num_frequencies < 1) {
+    return false;
+  }
+  *region = parsed;
+  return true;
+}
+
+template <typename Real>
+bool FieldMonitors<Real>::Build(
+    const std::vector<double>& probes,
+    const std::vector<DFTMonitorRegion>& dft_regions,
+    const IntNumber grid_offset, const IntNumber owned_begin,
+    const IntNumber owned_end, const IntNumber global_num_x,
+    const double x0, const double dx, const double dt,
+    const IntNumber num_t) {
+  probes_.clear();
+  dft_monitors_.clear();
+  grid_offset_ = grid_offset;
+  owned_begin_ = owned_begin;
+  owned_end_ = owned_end;
+  x0_ = x0;
+  dx_ = dx;
+  dt_ = dt;
+  num_t_ = std::max<IntNumber>(num_t, 0);
+  const double x1 = x0 + global_num_x*dx;
+  const double tolerance = 0.5*dx;
+  for (double x : probes) {
+    if (x < x0 - tolerance || x > x1 + tolerance) {
+      return false;
+    }
+  }
+  for (const DFTMonitorRegion& region : dft_regions) {
+    if (region.x_begin < x0 - tolerance || region.x_end > x1 + tolerance ||
+        region.x_end < region.x_begin || region.num_frequencies < 1) {
+      return false;
+    }
+  }
+
+  for (double x : probes) {
+    Probe probe;
+    probe.index_x = GetLocalNode(x);
+    if (probe.index_x < 0) {
+      continue;
+    }
+    probe.x = x0_ + static_cast<double>(grid_offset_ + probe.index_x)*dx_;
+    probe.samples.assign(static_cast<std::size_t>(num_t_), Real(0));
+    probes_.push_back(std::move(probe));
+  }
+  std::stable_sort(probes_.begin(), probes_.end(),
+                   [](const Probe& a, const Probe& b) {
+                     return a.index_x < b.index_x;
+                   });
+
+  // the phase factor of the time step n is coarse[n / B]*fine[n % B]
+  phasor_block_ = std::max<IntNumber>(static_cast<IntNumber>(
+      std::ceil(std::sqrt(static_cast<double>(num_t_)))), 1);
+  num_phasor_blocks_ = std::max<IntNumber>(
+      (num_t_ + phasor_block_ - 1) / phasor_block_, 1);
+  for (std::size_t m = 0; m < dft_regions.size(); ++m) {
+    const DFTMonitorRegion& region = dft_regions[m];
+    // the owned nodes nearest to the ends of the region
+    IntNumber global_begin = static_cast<IntNumber>(
+        std::lround((region.x_begin - x0_) / dx_));
+    IntNumber global_end = static_cast<IntNumber>(
+        std::lround((region.x_end - x0_) / dx_)) + 1;
+    global_begin = std::max(global_begin, grid_offset_ + owned_begin_);
+    global_end = std::min(global_end, grid_offset_ + owned_end_);
+    if (global_begin >= global_end) {
+      continue;
+    }
+    DFTMonitor monitor;
+    monitor.index = m;
+    monitor.begin = global_begin - grid_offset_;
+    monitor.end = global_end - grid_offset_;
+    for (IntNumber k = 0; k < region.num_frequencies; ++k) {
+      monitor.frequencies.push_back(region.num_frequencies == 1 ?
+          region.f_min : region.f_min + (region.f_max - region.f_min)*k /
+                                        (region.num_frequencies - 1));
+    }
+    for (double frequency : monitor.frequencies) {
+      const double omega_dt = kTwoPi*frequency*dt_;
+      for (IntNumber r = 0; r < phasor_block_; ++r) {
+        monitor.fine_real.push_back(std::cos(omega_dt*r));
+        monitor.fine_imag.push_back(-std::sin(omega_dt*r));
+      }
+      for (IntNumber q = 0; q < num_phasor_blocks_; ++q) {
+        double phase = omega_dt*static_cast<double>(q*phasor_block_ + 1);
+        monitor.coarse_real.push_back(std::cos(phase)*dt_);
+        monitor.coarse_imag.push_back(-std::sin(phase)*dt_);
+      }
+    }
+    std::size_t num_values = monitor.frequencies.size()*
+                             static_cast<std::size_t>(monitor.end -
+                                                      monitor.begin);
+    monitor.real.assign(num_values, 0.0);
+    monitor.imag.assign(num_values, 0.0);
+    dft_monitors_.push_back(std::move(monitor));
+  }
+  return true;
+}
+
+template <typename Real>
+IntNumber FieldMonitors<Real>::GetLocalNode(const double x) {
+  IntNumber index_x = static_cast<IntNumber>(std::lround((x - x0_) / dx_)) -
+                      grid_offset_;
+  if (index_x < owned_begin_ || index_x >= owned_end_) {
+    return -1;
+  }
+  return index_x;
+}
+
+template <typename Real>
+std::size_t FieldMonitors<Real>::get_num_dft_values() {
+  std::size_t num_values = 0;
+  for (const DFTMonitor& monitor : dft_monitors_) {
+    num_values += monitor.real.size();
+  }
+  return num_values;
+}
+
+template <typename Real>
+void FieldMonitors<Real>::Record(const Real* e, const IntNumber ind_begin,
+                                 const IntNumber ind_end,
+                                 const IntNumber ind_t) {
+  if (ind_t < 0 || ind_t >= num_t_) {
+    return;
+  }
+  auto probe = std::lower_bound(
+      probes_.begin(), probes_.end(), ind_begin,
+      [](const Probe& a, const IntNumber ind_x) { return a.index_x < ind_x; });
+  for (; probe != probes_.end() && probe->index_x < ind_end; ++probe) {
+    probe->samples[ind_t] = e[probe->index_x];
+  }
+
+  const IntNumber q = ind_t / phasor_block_;
+  const IntNumber r = ind_t % phasor_block_;
+  for (DFTMonitor& monitor : dft_monitors_) {
+    const IntNumber i_begin = std::max(ind_begin, monitor.begin);
+    const IntNumber i_end = std::min(ind_end, monitor.end);
+    if (i_begin >= i_end) {
+      continue;
+    }
+    const std::size_t num_nodes = static_cast<std::size_t>(monitor.end -
+                                                           monitor.begin);
+    for (std::size_t k = 0; k < monitor.frequencies.size(); ++k) {
+      const double coarse_real = monitor.coarse_real[k*num_phasor_blocks_ + q];
+      const double coarse_imag = monitor.coarse_imag[k*num_phasor_blocks_ + q];
+      const double fine_real = monitor.fine_real[k*phasor_block_ + r];
+      const double fine_imag = monitor.fine_imag[k*phasor_block_ + r];
+      const double phasor_real = coarse_real*fine_real - coarse_imag*fine_imag;
+      const double phasor_imag = coarse_real*fine_imag + coarse_imag*fine_real;
+      double* real = monitor.real.data() + k*num_nodes;
+      double* imag = monitor.imag.data() + k*num_nodes;
+      for (IntNumber i = i_begin; i < i_end; ++i) {
+        const double value = static_cast<double>(e[i]);
+        real[i - monitor.begin] += value*phasor_real;
+        imag[i - monitor.begin] += value*phasor_imag;
+      }
+    }
+  }
+}
+
+template <typename Real>
+bool FieldMonitors<Real>::Write(const std::string& file_prefix) {
+  if (!probes_.empty()) {
+    const std::string file_name = file_prefix + "_probes.csv";
+    std::ofstream ofs(file_name);
+    if (!ofs) {
+      std::cout << "Can not open " << file_name << std::endl;
+      return false;
+    }
+    ofs << "t";
+    for (const Probe& probe : probes_) {
+      ofs << ", E(" << probe.x << ")";
+    }
+    ofs << "\n" << std::setprecision(17);
+    for (IntNumber n = 0; n < num_t_; ++n) {
+      ofs << static_cast<double>(n + 1)*dt_;
+      for (const Probe& probe : probes_) {
+        ofs << ", " << probe.samples[n];
+      }
+      ofs << "\n";
+    }
+    if (!ofs) {
+      return false;
+    }
+  }
+  if (!dft_monitors_.empty()) {
+    const std::string file_name = file_prefix + "_dft.csv";
+    std::ofstream ofs(file_name);
+    if (!ofs) {
+      std::cout << "Can not open " << file_name << std::endl;
+      return false;
+    }
+    ofs << std::setprecision(17);
+    ofs << "monitor, x, frequency, real, imag\n";
+    for (const DFTMonitor& monitor : dft_monitors_) {
+      const std::size_t num_nodes = static_cast<std::size_t>(monitor.end -
+                                                             monitor.begin);
+      for (std::size_t k = 0; k < monitor.frequencies.size(); ++k) {
+        for (std::size_t j = 0; j < num_nodes; ++j) {
+          double x = x0_ + static_cast<double>(grid_offset_ + monitor.begin +
+                                               j)*dx_;
+          ofs << monitor.index << ", " << x << ", ";
+          ofs << monitor.frequencies[k] << ", ";
+          ofs << monitor.real[k*num_nodes + j] << ", "
+              << monitor.imag[k*num_nodes + j] << "\n";
+        }
+      }
+    }
+    if (!ofs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Real>
+void FieldMonitors<Real>::Reset() {
+  for (Probe& probe : probes_) {
+    std::fill(probe.samples.begin(), probe.samples.end(), Real(0));
+  }
+  for (DFTMonitor& monitor : dft_monitors_) {
+    std::fill(monitor.real.begin(), monitor.real.end(), 0.0);
+    std::fill(monitor.imag.begin(), monitor.imag.end(), 0.0);
+  }
+}
+
+template <typename Real>
+std::size_t FieldMonitors<Real>::get_state_size() {
+  std::size_t size = 0;
+  for (const Probe& probe : probes_) {
+    size += probe.samples.size()*sizeof(Real);
+  }
+  return size + 2*get_num_dft_values()*sizeof(double);
+}
+
+template <typename Real>
+void FieldMonitors<Real>::SaveState(char* data) {
+  for (const Probe& probe : probes_) {
+    SaveArray(probe.samples, &data);
+  }
+  for (const DFTMonitor& monitor : dft_monitors_) {
+    SaveArray(monitor.real, &data);
+    SaveArray(monitor.imag, &data);
+  }
+}
+
+template <typename Real>
+void FieldMonitors<Real>::LoadState(const char* data) {
+  for (Probe& probe : probes_) {
+    LoadArray(&data, &probe.samples);
+  }
+  for (DFTMonitor& monitor : dft_monitors_) {
+    LoadArray(&data, &monitor.real);
+    LoadArray(&data, &monitor.imag);
+  }
+}
+
+template class FieldMonitors<float>;
+template class FieldMonitors<double>;
+
+}  // namespace fdtd1d
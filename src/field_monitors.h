@@ -0,0 +1,132 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_FIELD_MONITORS_H_
+#define FDTD_FIELD_MONITORS_H_
+
+// Monitors of the E field computed during the time stepping, instead of
+// writing the whole field history and transforming it afterwards:
+//
+// - a probe records E at one node after every time step,
+// - a DFT monitor accumulates, for the nodes between two positions and a set
+//   of frequencies f, the running discrete Fourier transform
+//
+//     E(x, f) = sum_n E(x, t_n)*exp(-2*pi*i*f*t_n)*dt,   t_n = (n + 1)*dt
+//
+//   where E(x, t_n) is the field after the E update of the time step n.
+//
+// The monitors are updated by the thread updating their nodes, right after
+// the E update of a range of nodes, while the values are still in the cache.
+// Every engine updates each node once per time step, so all of them record
+// the same values even though the ranges of a time step are not updated at
+// the same time. The phase factor of the time step n is the product
+// coarse[n / B]*fine[n % B] of two tables of about sqrt(Nt) phasors per
+// frequency computed once, so there is no sin or cos in the time stepping
+// and, unlike the recurrence z_{n+1} = z_n*exp(-2*pi*i*f*dt), the rounding
+// errors do not grow with the number of time steps.
+
+#include <cstddef>        // std::size_t
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+// the E nodes from x_begin to x_end (both included) at num_frequencies
+// frequencies evenly spaced from f_min to f_max
+struct DFTMonitorRegion {
+  double x_begin = 0.0;
+  double x_end = 0.0;
+  double f_min = 0.0;
+  double f_max = 0.0;
+  IntNumber num_frequencies = 1;
+};
+
+// converts "X0,X1,F" or "X0,X1,F_MIN,F_MAX,NUM_FREQUENCIES" to a DFT monitor.
+// Returns false if the text is not recognized or the monitor is not valid.
+bool ParseDFTMonitorRegion(const std::string& text, DFTMonitorRegion* region);
+
+template <typename Real>
+class FieldMonitors {
+  public:
+  // sets up the probes at the positions probes and the DFT monitors of
+  // dft_regions for a grid of global_num_x nodes starting at x0 with the
+  // spacing dx, the time step dt and num_t time steps. Only the nodes of the
+  // local E nodes [owned_begin, owned_end), the nodes [grid_offset +
+  // owned_begin, grid_offset + owned_end) of the grid, are monitored here.
+  // Returns false if a monitor is outside of the grid.
+  bool Build(const std::vector<double>& probes,
+             const std::vector<DFTMonitorRegion>& dft_regions,
+             const IntNumber grid_offset, const IntNumber owned_begin,
+             const IntNumber owned_end, const IntNumber global_num_x,
+             const double x0, const double dx, const double dt,
+             const IntNumber num_t);
+
+  bool is_enabled() { return !probes_.empty() || !dft_monitors_.empty(); }
+  std::size_t get_num_probes() { return probes_.size(); }
+  std::size_t get_num_dft_monitors() { return dft_monitors_.size(); }
+  // the number of (node, frequency) accumulators
+  std::size_t get_num_dft_values();
+
+  // records the E nodes of [ind_begin, ind_end) after their update at the
+  // time step ind_t. Several threads can record disjoint ranges.
+  void Record(const Real* e, const IntNumber ind_begin,
+              const IntNumber ind_end, const IntNumber ind_t);
+
+  // writes the probes to file_prefix_probes.csv (the time and a column per
+  // probe) and the DFT monitors to file_prefix_dft.csv (a line per node and
+  // frequency). Returns false if a file can not be written.
+  bool Write(const std::string& file_prefix);
+
+  // zeroes the records
+  void Reset();
+
+  // the records, saved by the checkpoints
+  std::size_t get_state_size();   // bytes
+  void SaveState(char* data);
+  void LoadState(const char* data);
+
+  private:
+  struct Probe {
+    IntNumber index_x;            // local E node
+    double x;
+    std::vector<Real> samples;    // after each time step
+  };
+
+  struct DFTMonitor {
+    std::size_t index;            // in the regions given to Build
+    IntNumber begin;              // local E nodes
+    IntNumber end;
+    std::vector<double> frequencies;
+    // [frequency][n % phasor_block_] and [frequency][n / phasor_block_], dt
+    // included in the coarse phasors
+    std::vector<double> fine_real;
+    std::vector<double> fine_imag;
+    std::vector<double> coarse_real;
+    std::vector<double> coarse_imag;
+    // the transform, [frequency][node - begin]
+    std::vector<double> real;
+    std::vector<double> imag;
+  };
+
+  // the local E node nearest to x, or -1 if it is not owned
+  IntNumber GetLocalNode(const double x);
+
+  std::vector<Probe> probes_;           // in the order of the nodes
+  std::vector<DFTMonitor> dft_monitors_;
+  IntNumber grid_offset_ = 0;
+  IntNumber owned_begin_ = 0;
+  IntNumber owned_end_ = 0;
+  double x0_ = 0.0;
+  double dx_ = 1.0;
+  double dt_ = 1.0;
+  IntNumber num_t_ = 0;
+  IntNumber phasor_block_ = 1;
+  IntNumber num_phasor_blocks_ = 1;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_FIELD_MONITORS_H_
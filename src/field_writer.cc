@@ -0,0 +1,366 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "field_writer.h"
+
+#include <algorithm>      // std::min
+#include <chrono>         // chrono::steady_clock, chrono::duration
+#include <cstring>        // std::memcpy
+#include <iostream>       // std::cout
+
+#include "field_chunk_codec.h"
+
+namespace fdtd1d {
+
+namespace {
+
+// the header of the kRawBinary and kChunked formats, padded to 
+// kBinaryHeaderSize bytes
+constexpr std::size_t kBinaryHeaderSize = 4096;
+constexpr int kBinaryVersion = 1;
+
+struct BinaryHeader {
+  char magic[8];                // "FDTD1DRB" (raw) or "FDTD1DCH" (chunked)
+  std::int32_t version;
+  std::int32_t real_size;       // 4 (float) or 8 (double)
+  std::int64_t num_e_values;    // E values per snapshot
+  std::int64_t num_h_values;    // H values per snapshot
+  std::int64_t time_stride;
+  std::int64_t space_stride;
+  double x0;
+  double x1;
+  double dx;
+  double dt;
+  double t_final;
+  std::int64_t num_x;
+  std::int64_t num_t;
+  std::int64_t num_snapshots;   // 0 if the file was not closed
+  std::int64_t steps_per_chunk; // kChunked only
+  std::int64_t num_chunks;      // kChunked only
+  std::int64_t index_offset;    // kChunked only
+};
+
+}  // namespace
+
+bool ParseOutputFormat(const std::string& name, OutputFormat* format) {
+  if (name == "csv") {
+    *format = OutputFormat::kCSV;
+  } else if (name == "raw") {
+    *format = OutputFormat::kRawBinary;
+  } else if (name == "chunked") {
+    *format = OutputFormat::kChunked;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetOutputFormatName(const OutputFormat format) {
+  switch (format) {
+    case OutputFormat::kCSV:
+      return "csv";
+    case OutputFormat::kRawBinary:
+      return "raw";
+    case OutputFormat::kChunked:
+      return "chunked";
+  }
+  return "unknown";
+}
+
+template <typename Real>
+constexpr IntNumber FieldWriter<Real>::kDefaultChunkSize;
+
+template <typename Real>
+FieldWriter<Real>::FieldWriter() {}
+
+template <typename Real>
+FieldWriter<Real>::~FieldWriter() {
+  Close();
+}
+
+template <typename Real>
+void FieldWriter<Real>::SetOutputFormat(const OutputFormat format) {
+  format_ = format;
+}
+
+template <typename Real>
+void FieldWriter<Real>::SetDecimation(const IntNumber time_stride,
+                                      const IntNumber space_stride) {
+  time_stride_ = time_stride > 0 ? time_stride : 1;
+  space_stride_ = space_stride > 0 ? space_stride : 1;
+}
+
+template <typename Real>
+void FieldWriter<Real>::SetNumberOfBuffers(const int num_buffers) {
+  num_buffers_ = num_buffers > 0 ? num_buffers : 1;
+}
+
+template <typename Real>
+void FieldWriter<Real>::SetDirectIO(const bool use_direct_io) {
+  use_direct_io_ = use_direct_io;
+}
+
+template <typename Real>
+void FieldWriter<Real>::SetWriteHField(const bool write_h_field) {
+  write_h_field_ = write_h_field;
+}
+
+template <typename Real>
+void FieldWriter<Real>::SetStepsPerChunk(const IntNumber steps_per_chunk) {
+  steps_per_chunk_ = steps_per_chunk > 0 ? steps_per_chunk : 0;
+}
+
+template <typename Real>
+IntNumber FieldWriter<Real>::get_time_stride() {
+  return time_stride_;
+}
+
+template <typename Real>
+bool FieldWriter<Real>::Open(const std::string& file_name,
+                             const FieldOutputMetadata& metadata) {
+  Close();
+  metadata_ = metadata;
+  num_e_values_ = (metadata.num_x + space_stride_ - 1) / space_stride_;
+  num_h_values_ = 0;
+  if (write_h_field_ && format_ != OutputFormat::kCSV) {
+    num_h_values_ = (metadata.num_x - 1 + space_stride_ - 1) / space_stride_;
+  }
+
+  if (format_ == OutputFormat::kCSV) {
+    csv_file_.open(file_name, std::ofstream::trunc);
+    if (!csv_file_.is_open()) {
+      std::cout << "Can not open " << file_name << std::endl;
+      return false;
+    }
+  } else {
+    if (!binary_file_.Open(file_name, use_direct_io_)) {
+      return false;
+    }
+    WriteBinaryHeader(false);
+  }
+
+  // the buffers are reused as long as the snapshot size does not change
+  IntNumber buffer_size = num_e_values_ + num_h_values_;
+  if (format_ == OutputFormat::kChunked) {
+    chunk_size_ = steps_per_chunk_;
+    if (chunk_size_ == 0) {
+      chunk_size_ = std::max<IntNumber>(
+          1, kDefaultChunkSize / (sizeof(Real)*buffer_size));
+    }
+    chunk_snapshots_.resize(chunk_size_*buffer_size);
+    chunk_time_indices_.resize(chunk_size_);
+    num_chunk_snapshots_ = 0;
+  }
+  chunk_index_.clear();
+  index_offset_ = 0;
+  buffers_.clear();
+  free_buffers_.clear();
+  for (int i = 0; i < num_buffers_; ++i) {
+    buffers_.emplace_back(AllocateAlignedArray<Real>(buffer_size));
+    free_buffers_.push_back(buffers_.back().get());
+  }
+  queued_buffers_.clear();
+  closing_ = false;
+  num_snapshots_ = 0;
+  num_bytes_before_encoding_ = 0;
+  num_backpressure_waits_ = 0;
+  backpressure_wait_time_ = 0.0;
+  writer_thread_ = std::thread(&FieldWriter::WriterThread, this);
+  return true;
+}
+
+template <typename Real>
+Real* FieldWriter<Real>::AcquireBuffer() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (free_buffers_.empty()) {
+    ++num_backpressure_waits_;
+    auto t_start = std::chrono::steady_clock::now();
+    while (free_buffers_.empty()) {
+      buffer_freed_.wait(lock);
+    }
+    std::chrono::duration<double> wait_time(
+        std::chrono::steady_clock::now() - t_start);
+    backpressure_wait_time_ += wait_time.count();
+  }
+  Real* buffer = free_buffers_.back();
+  free_buffers_.pop_back();
+  return buffer;
+}
+
+template <typename Real>
+void FieldWriter<Real>::CopyFieldsToBuffer(Real* buffer, const Real* e_field,
+                                           const Real* h_field,
+                                           const IntNumber ind_begin,
+                                           const IntNumber ind_end) {
+  // the first grid point in [ind_begin, ind_end) that is kept
+  IntNumber i_begin = (ind_begin + space_stride_ - 1) / space_stride_ *
+                      space_stride_;
+  for (IntNumber i = i_begin; i < ind_end; i += space_stride_) {
+    buffer[i / space_stride_] = e_field[i];
+  }
+  if (num_h_values_ > 0) {
+    Real* h_buffer = buffer + num_e_values_;
+    IntNumber i_end = std::min<IntNumber>(ind_end, metadata_.num_x - 1);
+    for (IntNumber i = i_begin; i < i_end; i += space_stride_) {
+      h_buffer[i / space_stride_] = h_field[i];
+    }
+  }
+}
+
+template <typename Real>
+void FieldWriter<Real>::SubmitBuffer(Real* buffer, const IntNumber ind_t) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queued_buffers_.emplace_back(buffer, ind_t);
+  }
+  buffer_queued_.notify_one();
+}
+
+template <typename Real>
+void FieldWriter<Real>::Close() {
+  if (!writer_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+  }
+  buffer_queued_.notify_one();
+  writer_thread_.join();
+  if (format_ == OutputFormat::kCSV) {
+    csv_file_.close();
+    return;
+  }
+  if (format_ == OutputFormat::kChunked) {
+    if (num_chunk_snapshots_ > 0) {
+      WriteChunk();
+    }
+    WriteChunkIndex();
+  }
+  WriteBinaryHeader(true);
+  binary_file_.Close();
+}
+
+template <typename Real>
+void FieldWriter<Real>::PrintStatistics() {
+  std::cout << "Field snapshots written : " << num_snapshots_ << std::endl;
+  if (format_ == OutputFormat::kChunked && num_bytes_before_encoding_ > 0) {
+    std::cout << "Compression ratio : " 
+              << static_cast<double>(num_bytes_before_encoding_) / 
+                 (index_offset_ - kBinaryHeaderSize) << std::endl;
+  }
+  std::cout << "Waits for a free snapshot buffer : " << num_backpressure_waits_
+            << " (" << backpressure_wait_time_ << " seconds)" << std::endl;
+}
+
+template <typename Real>
+void FieldWriter<Real>::WriterThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    while (queued_buffers_.empty() && !closing_) {
+      buffer_queued_.wait(lock);
+    }
+    if (queued_buffers_.empty()) {
+      return;   // closing and nothing left to write
+    }
+    auto snapshot = queued_buffers_.front();
+    queued_buffers_.pop_front();
+
+    // the snapshot is encoded and written without holding the lock
+    lock.unlock();
+    WriteSnapshot(snapshot.first, snapshot.second);
+    lock.lock();
+
+    ++num_snapshots_;
+    free_buffers_.push_back(snapshot.first);
+    buffer_freed_.notify_one();
+  }
+}
+
+template <typename Real>
+void FieldWriter<Real>::WriteBinaryHeader(const bool overwrite) {
+  BinaryHeader header;
+  std::memcpy(header.magic, 
+              format_ == OutputFormat::kChunked ? "FDTD1DCH" : "FDTD1DRB", 
+              sizeof(header.magic));
+  header.version = kBinaryVersion;
+  header.real_size = sizeof(Real);
+  header.num_e_values = num_e_values_;
+  header.num_h_values = num_h_values_;
+  header.time_stride = time_stride_;
+  header.space_stride = space_stride_;
+  header.x0 = metadata_.x0;
+  header.x1 = metadata_.x1;
+  header.dx = metadata_.dx;
+  header.dt = metadata_.dt;
+  header.t_final = metadata_.t_final;
+  header.num_x = metadata_.num_x;
+  header.num_t = metadata_.num_t;
+  header.num_snapshots = overwrite ? num_snapshots_ : 0;
+  header.steps_per_chunk = 
+      format_ == OutputFormat::kChunked ? chunk_size_ : 0;
+  header.num_chunks = chunk_index_.size() / 2;
+  header.index_offset = overwrite ? index_offset_ : 0;
+
+  char padded_header[kBinaryHeaderSize] = {0};
+  static_assert(sizeof(header) <= kBinaryHeaderSize, "header too large");
+  std::memcpy(padded_header, &header, sizeof(header));
+  if (overwrite) {
+    binary_file_.WriteAt(0, padded_header, kBinaryHeaderSize);
+  } else {
+    binary_file_.Write(padded_header, kBinaryHeaderSize);
+  }
+}
+
+template <typename Real>
+void FieldWriter<Real>::WriteSnapshot(const Real* buffer,
+                                      const IntNumber ind_t) {
+  if (format_ == OutputFormat::kCSV) {
+    for (IntNumber i = 0; i < num_e_values_ - 1; ++i) {
+      csv_file_ << buffer[i] << ", ";
+    }
+    csv_file_ << buffer[num_e_values_ - 1] << "\n";
+  } else if (format_ == OutputFormat::kRawBinary) {
+    std::int64_t time_index = ind_t;
+    binary_file_.Write(&time_index, sizeof(time_index));
+    binary_file_.Write(buffer, sizeof(Real)*(num_e_values_ + num_h_values_));
+  } else {
+    IntNumber snapshot_size = num_e_values_ + num_h_values_;
+    std::memcpy(chunk_snapshots_.data() + num_chunk_snapshots_*snapshot_size,
+                buffer, sizeof(Real)*snapshot_size);
+    chunk_time_indices_[num_chunk_snapshots_] = ind_t;
+    if (++num_chunk_snapshots_ == chunk_size_) {
+      WriteChunk();
+    }
+  }
+}
+
+template <typename Real>
+void FieldWriter<Real>::WriteChunk() {
+  IntNumber snapshot_size = num_e_values_ + num_h_values_;
+  encoded_chunk_.clear();
+  EncodeFieldChunk(chunk_snapshots_.data(), num_chunk_snapshots_, 
+                   snapshot_size, sizeof(Real), &encoded_chunk_);
+  
+  std::size_t time_indices_size = sizeof(std::int64_t)*num_chunk_snapshots_;
+  chunk_index_.push_back(binary_file_.get_bytes_written());
+  chunk_index_.push_back(time_indices_size + encoded_chunk_.size());
+  binary_file_.Write(chunk_time_indices_.data(), time_indices_size);
+  binary_file_.Write(encoded_chunk_.data(), encoded_chunk_.size());
+  
+  num_bytes_before_encoding_ += 
+      (sizeof(std::int64_t) + sizeof(Real)*snapshot_size)*num_chunk_snapshots_;
+  num_chunk_snapshots_ = 0;
+}
+
+template <typename Real>
+void FieldWriter<Real>::WriteChunkIndex() {
+  index_offset_ = binary_file_.get_bytes_written();
+  binary_file_.Write(chunk_index_.data(), 
+                     sizeof(std::int64_t)*chunk_index_.size());
+}
+
+template class FieldWriter<float>;
+template class FieldWriter<double>;
+
+}  // namespace fdtd1d
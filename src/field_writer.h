@@ -0,0 +1,163 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_FIELD_WRITER_H_
+#define FDTD_FIELD_WRITER_H_
+
+// Writes the field history to a file on a background thread.
+//
+// The solver takes a buffer from a pool of reusable buffers (AcquireBuffer),
+// copies a snapshot of the fields into it (each thread copies its own chunk
+// with CopyFieldsToBuffer) and hands it over to the writer thread
+// (SubmitBuffer). The writer thread encodes and writes the snapshot and
+// returns the buffer to the pool. The compute threads only wait for the disk
+// when all the buffers of the pool are waiting to be written (backpressure).
+//
+// The snapshots can be decimated in time (one snapshot every time_stride
+// steps) and in space (every space_stride-th grid point).
+//
+// Output formats:
+// kCSV ---> one line of comma separated E values per snapshot
+// kRawBinary ---> a kBinaryHeaderSize bytes header (see BinaryHeader in
+//   field_writer.cc) followed by the snapshots. Each snapshot holds the
+//   time index (int64) followed by the E values and then the H values (if
+//   enabled) in the precision of the solver.
+// kChunked ---> the same header followed by chunks of steps_per_chunk 
+//   consecutive snapshots and by the chunk index. Each chunk holds the time 
+//   indices of its snapshots (int64) followed by the snapshots compressed 
+//   with EncodeFieldChunk (see field_chunk_codec.h). The index, at the 
+//   index_offset of the header, holds the offset and the size (int64) of 
+//   each chunk, so that any snapshot is found without reading the file.
+
+#include <string>               // std::string
+#include <vector>               // std::vector
+#include <deque>                // std::deque
+#include <thread>               // std::thread
+#include <mutex>                // std::mutex
+#include <condition_variable>   // std::condition_variable
+#include <fstream>              // std::ofstream
+#include <utility>              // std::pair
+
+#include "aligned_memory.h"
+#include "buffered_file_output.h"
+#include "number_types.h"
+
+namespace fdtd1d {
+
+enum class OutputFormat {
+  kCSV = 1,
+  kRawBinary = 2,
+  kChunked = 3,
+};
+
+// converts "csv", "raw" and "chunked" to the corresponding OutputFormat.
+// Returns false if the name is not recognized.
+bool ParseOutputFormat(const std::string& name, OutputFormat* format);
+const char* GetOutputFormatName(const OutputFormat format);
+
+// describes the grid and the time steps of the simulation
+struct FieldOutputMetadata {
+  double x0;
+  double x1;
+  double dx;
+  double t_final;
+  double dt;
+  IntNumber num_x;
+  IntNumber num_t;
+};
+
+template <typename Real>
+class FieldWriter {
+  public:
+  FieldWriter();
+  ~FieldWriter();
+
+  void SetOutputFormat(const OutputFormat format);
+  void SetDecimation(const IntNumber time_stride, const IntNumber space_stride);
+  // the number of snapshot buffers in the pool
+  void SetNumberOfBuffers(const int num_buffers);
+  void SetDirectIO(const bool use_direct_io);
+  // the H field is not written in the kCSV format
+  void SetWriteHField(const bool write_h_field);
+  // the number of snapshots in each chunk of the kChunked format. With 0 
+  // (default) the chunks hold about kDefaultChunkSize bytes of snapshots.
+  void SetStepsPerChunk(const IntNumber steps_per_chunk);
+
+  IntNumber get_time_stride();
+
+  // starts the writer thread. Returns false if the file can not be opened.
+  bool Open(const std::string& file_name, const FieldOutputMetadata& metadata);
+
+  // returns a free buffer. Blocks until a buffer is available.
+  Real* AcquireBuffer();
+
+  // copies the E nodes in [ind_begin, ind_end) and the H nodes in
+  // [ind_begin, min(ind_end, num_x - 1)) to buffer after decimation
+  void CopyFieldsToBuffer(Real* buffer, const Real* e_field,
+                          const Real* h_field, const IntNumber ind_begin,
+                          const IntNumber ind_end);
+
+  // queues buffer, holding the snapshot after ind_t time steps, for writing
+  void SubmitBuffer(Real* buffer, const IntNumber ind_t);
+
+  // writes the queued snapshots and stops the writer thread
+  void Close();
+
+  void PrintStatistics();
+
+  private:
+  void WriterThread();
+  // writes the header at the beginning of the file. It is written again by
+  // Close() once the number of snapshots and the index are known.
+  void WriteBinaryHeader(const bool overwrite);
+  void WriteSnapshot(const Real* buffer, const IntNumber ind_t);
+  void WriteChunk();
+  void WriteChunkIndex();
+
+  static constexpr IntNumber kDefaultChunkSize = 1 << 24;
+
+  OutputFormat format_ = OutputFormat::kCSV;
+  IntNumber time_stride_ = 1;
+  IntNumber space_stride_ = 1;
+  int num_buffers_ = 4;
+  bool use_direct_io_ = false;
+  bool write_h_field_ = false;
+  IntNumber steps_per_chunk_ = 0;
+
+  FieldOutputMetadata metadata_;
+  IntNumber num_e_values_ = 0;    // number of E values in each snapshot
+  IntNumber num_h_values_ = 0;    // number of H values in each snapshot
+
+  std::vector<AlignedArray<Real>> buffers_;
+  std::vector<Real*> free_buffers_;
+  std::deque<std::pair<Real*, IntNumber>> queued_buffers_;
+  std::mutex mutex_;
+  std::condition_variable buffer_freed_;
+  std::condition_variable buffer_queued_;
+  bool closing_ = false;
+  std::thread writer_thread_;
+
+  BufferedFileOutput binary_file_;
+  std::ofstream csv_file_;
+
+  // the snapshots of the current chunk of the kChunked format
+  IntNumber chunk_size_ = 1;    // snapshots per chunk
+  IntNumber num_chunk_snapshots_ = 0;
+  std::vector<Real> chunk_snapshots_;
+  std::vector<std::int64_t> chunk_time_indices_;
+  std::vector<unsigned char> encoded_chunk_;
+  // offset and size of each chunk written
+  std::vector<std::int64_t> chunk_index_;
+  IntNumber index_offset_ = 0;
+
+  // statistics
+  IntNumber num_snapshots_ = 0;
+  IntNumber num_bytes_before_encoding_ = 0;
+  IntNumber num_backpressure_waits_ = 0;
+  double backpressure_wait_time_ = 0.0;   // seconds
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_FIELD_WRITER_H_
@@ -0,0 +1,465 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "halo_transport.h"
+
+#include <fcntl.h>        // O_CREAT, O_EXCL, O_RDWR
+#include <sys/mman.h>     // shm_open, shm_unlink, mmap, munmap
+#include <sys/socket.h>   // socket, bind, listen, accept, connect
+#include <sys/stat.h>     // fstat
+#include <sys/un.h>       // sockaddr_un
+#include <unistd.h>       // ftruncate, close, read, write, unlink, getpid
+
+#include <algorithm>      // std::min
+#include <atomic>         // std::atomic
+#include <cerrno>         // errno
+#include <chrono>         // std::chrono::milliseconds
+#include <cstdint>        // std::uint64_t
+#include <cstdlib>        // std::exit
+#include <cstring>        // std::memcpy, std::strerror
+#include <iostream>       // std::cerr
+#include <random>         // std::random_device
+#include <thread>         // std::this_thread::yield, sleep_for
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>    // _mm_pause
+#endif
+
+#include "thread_barrier.h"
+
+namespace fdtd1d {
+
+namespace {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+void ExitOnBrokenLink(const char* operation) {
+  std::cerr << "Halo " << operation << " failed: " << std::strerror(errno)
+            << std::endl;
+  std::exit(EXIT_FAILURE);
+}
+
+// Shared memory: the link between the ranks r and r + 1 has the ring 2*r
+// carrying the messages to the right and the ring 2*r + 1 carrying the
+// messages to the left. A ring is a byte queue with a single writer and a
+// single reader. The counters only grow, the writer owns write_count and the
+// reader owns read_count, and the segment starts zeroed.
+//
+// The rings follow one handshake slot per rank. Rank 0 replaces any segment
+// of the same name (left behind by a run that was killed) by a new one. Every
+// other rank writes a random session id to its request and only uses the
+// segment once rank 0 copies the id to the reply. A rank that mapped an old
+// segment never gets the reply, and it maps the new one once the name refers
+// to it. Rank 0 waits for all the ranks, so that no rank is left without the
+// segment when rank 0 removes its name at the end.
+constexpr std::size_t kSharedRingCapacity = 1 << 16;   // bytes, power of 2
+
+// spins before the waiting side starts yielding the CPU to the other ranks
+constexpr int kSharedRingSpinCount = 1024;
+
+// the time the ranks wait for each other to open the segment
+constexpr int kSharedOpenTimeoutMilliseconds = 30000;
+
+struct alignas(kCacheLineSize) SharedRingCounter {
+  std::atomic<std::uint64_t> value;
+};
+
+struct SharedRing {
+  SharedRingCounter write_count;
+  SharedRingCounter read_count;
+  char data[kSharedRingCapacity];
+};
+
+struct alignas(kCacheLineSize) SharedHandshake {
+  std::atomic<std::uint64_t> request;   // written by the rank
+  std::atomic<std::uint64_t> reply;     // written by rank 0
+};
+
+class SharedMemoryTransport : public HaloTransport {
+  public:
+  SharedMemoryTransport(const std::string& name, const int rank,
+                        const int num_ranks)
+      : HaloTransport(rank, num_ranks), name_(name) {}
+
+  ~SharedMemoryTransport() override {
+    // every rank mapped the segment before the Open of rank 0 returned
+    if (handshakes_ != nullptr && rank_ == 0) {
+      shm_unlink(name_.c_str());
+    }
+    Unmap();
+  }
+
+  bool Open() {
+    return (rank_ == 0) ? Create() : Attach();
+  }
+
+  void Send(const Neighbor neighbor, const void* data,
+            const std::size_t size) override {
+    SharedRing* ring = (neighbor == Neighbor::kRight) ?
+                       &rings_[2*rank_] : &rings_[2*(rank_ - 1) + 1];
+    const char* bytes = static_cast<const char*>(data);
+    std::uint64_t write_count =
+        ring->write_count.value.load(std::memory_order_relaxed);
+    std::size_t num_sent = 0;
+    while (num_sent < size) {
+      std::uint64_t free_size = kSharedRingCapacity - (write_count -
+          WaitFor(ring->read_count, write_count - kSharedRingCapacity + 1));
+      std::size_t n = std::min<std::size_t>(free_size, size - num_sent);
+      CopyToRing(ring, write_count, bytes + num_sent, n);
+      write_count += n;
+      num_sent += n;
+      ring->write_count.value.store(write_count, std::memory_order_release);
+    }
+  }
+
+  void Receive(const Neighbor neighbor, void* data,
+               const std::size_t size) override {
+    SharedRing* ring = (neighbor == Neighbor::kLeft) ?
+                       &rings_[2*(rank_ - 1)] : &rings_[2*rank_ + 1];
+    char* bytes = static_cast<char*>(data);
+    std::uint64_t read_count =
+        ring->read_count.value.load(std::memory_order_relaxed);
+    std::size_t num_received = 0;
+    while (num_received < size) {
+      std::uint64_t available =
+          WaitFor(ring->write_count, read_count + 1) - read_count;
+      std::size_t n = std::min<std::size_t>(available, size - num_received);
+      CopyFromRing(ring, read_count, bytes + num_received, n);
+      read_count += n;
+      num_received += n;
+      ring->read_count.value.store(read_count, std::memory_order_release);
+    }
+  }
+
+  private:
+  std::size_t GetSegmentSize() {
+    return sizeof(SharedHandshake)*num_ranks_ +
+           sizeof(SharedRing)*2*(num_ranks_ - 1);
+  }
+
+  // maps the segment of the file descriptor fd and closes it
+  bool Map(const int fd) {
+    void* address = mmap(nullptr, GetSegmentSize(), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+      return false;
+    }
+    handshakes_ = static_cast<SharedHandshake*>(address);
+    rings_ = reinterpret_cast<SharedRing*>(handshakes_ + num_ranks_);
+    return true;
+  }
+
+  void Unmap() {
+    if (handshakes_ != nullptr) {
+      munmap(handshakes_, GetSegmentSize());
+      handshakes_ = nullptr;
+      rings_ = nullptr;
+    }
+  }
+
+  // rank 0: creates a new zero filled segment and answers the requests of
+  // the other ranks
+  bool Create() {
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(GetSegmentSize())) != 0) {
+      close(fd);
+      return false;
+    }
+    if (!Map(fd)) {
+      return false;
+    }
+    for (int i = 0; i < 2*(num_ranks_ - 1); ++i) {
+      rings_[i].write_count.value.store(0, std::memory_order_relaxed);
+      rings_[i].read_count.value.store(0, std::memory_order_relaxed);
+    }
+
+    for (int rank = 1; rank < num_ranks_; ++rank) {
+      SharedHandshake& handshake = handshakes_[rank];
+      std::uint64_t session_id = 0;
+      for (int k = 0; k < kSharedOpenTimeoutMilliseconds && session_id == 0;
+           ++k) {
+        session_id = handshake.request.load(std::memory_order_acquire);
+        if (session_id == 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+      if (session_id == 0) {
+        errno = ETIMEDOUT;
+        return false;
+      }
+      handshake.reply.store(session_id, std::memory_order_release);
+    }
+    return true;
+  }
+
+  // ranks 1 ... num_ranks - 1: maps the segment of rank 0 and waits for
+  // the reply to the request
+  bool Attach() {
+    const std::uint64_t session_id = GetSessionId();
+    struct stat mapped{};
+    for (int k = 0; k < kSharedOpenTimeoutMilliseconds; ++k) {
+      if (handshakes_ != nullptr &&
+          handshakes_[rank_].reply.load(std::memory_order_acquire) ==
+          session_id) {
+        return true;
+      }
+      // the name refers to no segment (rank 0 did not start), to a
+      // segment rank 0 did not size yet, or to another segment than the
+      // one mapped
+      struct stat current;
+      int fd = shm_open(name_.c_str(), O_RDWR, 0600);
+      if (fd >= 0 && fstat(fd, &current) == 0 &&
+          current.st_size == static_cast<off_t>(GetSegmentSize()) &&
+          (handshakes_ == nullptr || current.st_ino != mapped.st_ino ||
+           current.st_dev != mapped.st_dev)) {
+        Unmap();
+        mapped = current;
+        if (!Map(fd)) {
+          return false;
+        }
+        handshakes_[rank_].request.store(session_id,
+                                         std::memory_order_release);
+      } else if (fd >= 0) {
+        close(fd);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    errno = ETIMEDOUT;
+    return false;
+  }
+
+  // a nonzero id that differs between the processes and the runs
+  static std::uint64_t GetSessionId() {
+    std::random_device random;
+    std::uint64_t id = (static_cast<std::uint64_t>(random()) << 32) ^
+                       random() ^ static_cast<std::uint64_t>(getpid());
+    return (id == 0) ? 1 : id;
+  }
+
+  // waits until the counter reaches at least min_value (compared as signed
+  // distances, so that min_value may be "negative" for an empty ring) and
+  // returns it
+  static std::uint64_t WaitFor(SharedRingCounter& counter,
+                               const std::uint64_t min_value) {
+    auto IsReached = [min_value](const std::uint64_t value) {
+      return static_cast<std::int64_t>(value - min_value) >= 0;
+    };
+    std::uint64_t value = counter.value.load(std::memory_order_acquire);
+    for (int i = 0; i < kSharedRingSpinCount && !IsReached(value); ++i) {
+      CpuRelax();
+      value = counter.value.load(std::memory_order_acquire);
+    }
+    while (!IsReached(value)) {
+      std::this_thread::yield();
+      value = counter.value.load(std::memory_order_acquire);
+    }
+    return value;
+  }
+
+  static void CopyToRing(SharedRing* ring, const std::uint64_t position,
+                         const char* bytes, const std::size_t size) {
+    std::size_t offset = position & (kSharedRingCapacity - 1);
+    std::size_t first = std::min(size, kSharedRingCapacity - offset);
+    std::memcpy(ring->data + offset, bytes, first);
+    std::memcpy(ring->data, bytes + first, size - first);
+  }
+
+  static void CopyFromRing(SharedRing* ring, const std::uint64_t position,
+                           char* bytes, const std::size_t size) {
+    std::size_t offset = position & (kSharedRingCapacity - 1);
+    std::size_t first = std::min(size, kSharedRingCapacity - offset);
+    std::memcpy(bytes, ring->data + offset, first);
+    std::memcpy(bytes + first, ring->data, size - first);
+  }
+
+  std::string name_;
+  SharedHandshake* handshakes_ = nullptr;
+  SharedRing* rings_ = nullptr;
+};
+
+// Unix domain sockets: rank r listens on "name.r" for its left neighbor and
+// connects to "name.(r + 1)". The connection is accepted after connecting to
+// the right, and the socket file is removed once it is accepted.
+constexpr int kConnectTimeoutMilliseconds = 30000;
+
+class UnixSocketTransport : public HaloTransport {
+  public:
+  UnixSocketTransport(const std::string& name, const int rank,
+                      const int num_ranks)
+      : HaloTransport(rank, num_ranks), name_(name) {}
+
+  ~UnixSocketTransport() override {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  bool Open() {
+    int listen_fd = -1;
+    if (rank_ > 0) {
+      sockaddr_un address = GetAddress(rank_);
+      unlink(address.sun_path);
+      listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (listen_fd < 0 ||
+          bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+               sizeof(address)) != 0 ||
+          listen(listen_fd, 1) != 0) {
+        if (listen_fd >= 0) {
+          close(listen_fd);
+        }
+        return false;
+      }
+    }
+
+    bool is_connected = true;
+    if (rank_ < num_ranks_ - 1) {
+      is_connected = ConnectToRight();
+    }
+
+    if (rank_ > 0) {
+      if (is_connected) {
+        fds_[static_cast<int>(Neighbor::kLeft)] =
+            accept(listen_fd, nullptr, nullptr);
+        is_connected = fds_[static_cast<int>(Neighbor::kLeft)] >= 0;
+      }
+      close(listen_fd);
+      unlink(GetAddress(rank_).sun_path);
+    }
+    return is_connected;
+  }
+
+  void Send(const Neighbor neighbor, const void* data,
+            const std::size_t size) override {
+    int fd = fds_[static_cast<int>(neighbor)];
+    const char* bytes = static_cast<const char*>(data);
+    std::size_t num_sent = 0;
+    while (num_sent < size) {
+      ssize_t n = write(fd, bytes + num_sent, size - num_sent);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        ExitOnBrokenLink("send");
+      }
+      num_sent += static_cast<std::size_t>(n);
+    }
+  }
+
+  void Receive(const Neighbor neighbor, void* data,
+               const std::size_t size) override {
+    int fd = fds_[static_cast<int>(neighbor)];
+    char* bytes = static_cast<char*>(data);
+    std::size_t num_received = 0;
+    while (num_received < size) {
+      ssize_t n = read(fd, bytes + num_received, size - num_received);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        if (n == 0) {
+          errno = ECONNRESET;
+        }
+        ExitOnBrokenLink("receive");
+      }
+      num_received += static_cast<std::size_t>(n);
+    }
+  }
+
+  private:
+  sockaddr_un GetAddress(const int rank) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::string path = name_ + "." + std::to_string(rank);
+    path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+    return address;
+  }
+
+  // the right neighbor may not listen yet, the connection is retried
+  bool ConnectToRight() {
+    sockaddr_un address = GetAddress(rank_ + 1);
+    for (int k = 0; k < kConnectTimeoutMilliseconds; ++k) {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0) {
+        return false;
+      }
+      if (connect(fd, reinterpret_cast<sockaddr*>(&address),
+                  sizeof(address)) == 0) {
+        fds_[static_cast<int>(Neighbor::kRight)] = fd;
+        return true;
+      }
+      close(fd);
+      if (errno != ENOENT && errno != ECONNREFUSED) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+
+  std::string name_;
+  int fds_[2] = {-1, -1};       // indexed by Neighbor
+};
+
+}  // namespace
+
+bool ParseTransportType(const std::string& name, TransportType* type) {
+  if (name == "shm") {
+    *type = TransportType::kSharedMemory;
+  } else if (name == "socket") {
+    *type = TransportType::kUnixSocket;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetTransportTypeName(const TransportType type) {
+  switch (type) {
+    case TransportType::kSharedMemory:
+      return "shm";
+    case TransportType::kUnixSocket:
+      return "socket";
+  }
+  return "unknown";
+}
+
+std::unique_ptr<HaloTransport> CreateHaloTransport(const TransportType type,
+                                                   const std::string& name,
+                                                   const int rank,
+                                                   const int num_ranks) {
+  if (num_ranks < 2 || rank < 0 || rank >= num_ranks) {
+    return nullptr;
+  }
+  bool is_open = false;
+  std::unique_ptr<HaloTransport> transport;
+  if (type == TransportType::kSharedMemory) {
+    auto shared_memory = new SharedMemoryTransport(name, rank, num_ranks);
+    transport.reset(shared_memory);
+    is_open = shared_memory->Open();
+  } else {
+    auto unix_socket = new UnixSocketTransport(name, rank, num_ranks);
+    transport.reset(unix_socket);
+    is_open = unix_socket->Open();
+  }
+  if (!is_open) {
+    std::cerr << "Rank " << rank << " could not connect the "
+              << GetTransportTypeName(type) << " transport " << name << ": "
+              << std::strerror(errno) << std::endl;
+    return nullptr;
+  }
+  return transport;
+}
+
+}  // namespace fdtd1d
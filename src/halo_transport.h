@@ -0,0 +1,80 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_HALO_TRANSPORT_H_
+#define FDTD_HALO_TRANSPORT_H_
+
+// Moves the halos between the processes (ranks) of a decomposed grid, see
+// FDTD1D::SetDomainDecomposition. The ranks form a chain along the x axis and
+// each rank only talks to its left (rank - 1) and right (rank + 1) neighbors.
+// The messages between two neighbors arrive in the order they were sent.
+//
+// Transports:
+// kSharedMemory ---> the ranks map a POSIX shared memory segment holding one
+//                    single producer single consumer byte ring per direction
+//                    of each link. The waiting side spins briefly and then
+//                    yields the CPU. Rank 0 creates a new segment, replacing
+//                    one left behind by a killed run, and the other ranks
+//                    only use it once rank 0 answers their session id.
+// kUnixSocket   ---> each link is a connected Unix domain stream socket.
+//
+// Both transports run the ranks on one Linux machine. Send and Receive may be
+// called concurrently for the two neighbors (by different threads), but
+// each neighbor is used by one thread at a time.
+
+#include <cstddef>        // std::size_t
+#include <memory>         // std::unique_ptr
+#include <string>         // std::string
+
+namespace fdtd1d {
+
+enum class TransportType {
+  kSharedMemory = 1,
+  kUnixSocket = 2,
+};
+
+// converts "shm" and "socket" to the corresponding transport. Returns false
+// if the name is not recognized.
+bool ParseTransportType(const std::string& name, TransportType* type);
+const char* GetTransportTypeName(const TransportType type);
+
+enum class Neighbor {
+  kLeft = 0,
+  kRight = 1,
+};
+
+class HaloTransport {
+  public:
+  virtual ~HaloTransport() {}
+
+  // blocks until the size bytes are sent to (received from) the neighbor. A
+  // broken link ends the process, since the ranks can not continue without
+  // their neighbors.
+  virtual void Send(const Neighbor neighbor, const void* data,
+                    const std::size_t size) = 0;
+  virtual void Receive(const Neighbor neighbor, void* data,
+                       const std::size_t size) = 0;
+
+  int get_rank() { return rank_; }
+  int get_num_ranks() { return num_ranks_; }
+
+  protected:
+  HaloTransport(const int rank, const int num_ranks)
+      : rank_(rank), num_ranks_(num_ranks) {}
+
+  int rank_;
+  int num_ranks_;
+};
+
+// connects the rank to its neighbors. All the ranks should use the same name:
+// the name of the shared memory segment ("/name") or the prefix of the paths
+// of the sockets. Returns nullptr if the connection fails.
+std::unique_ptr<HaloTransport> CreateHaloTransport(const TransportType type,
+                                                   const std::string& name,
+                                                   const int rank,
+                                                   const int num_ranks);
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_HALO_TRANSPORT_H_
@@ -0,0 +1,124 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "live_frames.h"
+
+#include <fcntl.h>        // O_CREAT, O_EXCL, O_RDWR
+#include <sys/mman.h>     // shm_open, shm_unlink, mmap, munmap
+#include <unistd.h>       // ftruncate, close
+
+#include <cerrno>         // errno
+#include <cstring>        // std::memcpy, std::strerror
+
+namespace fdtd1d {
+
+// the readers (build/liveView.py) use these offsets
+static_assert(offsetof(LiveFrameRingHeader, format) == 32,
+              "the live frame header layout changed");
+static_assert(offsetof(LiveFrameRingHeader, num_frames) == 128,
+              "the live frame header layout changed");
+static_assert(offsetof(LiveFrameRingHeader, is_finished) == 136,
+              "the live frame header layout changed");
+
+LiveFrameRing::~LiveFrameRing() {
+  Close();
+}
+
+bool LiveFrameRing::Create(const std::string& name,
+                           const LiveFrameFormat& format,
+                           const std::int64_t num_slots, std::string* error) {
+  Close();
+  const std::size_t values_size =
+      static_cast<std::size_t>(format.num_values)*format.real_size;
+  const std::size_t slot_size =
+      (kLiveFrameSlotHeaderSize + values_size + 63) / 64*64;
+  const std::size_t segment_size =
+      kLiveFrameHeaderSize + static_cast<std::size_t>(num_slots)*slot_size;
+
+  // a new segment, so that the readers of a previous run do not see the
+  // header change under them
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    *error = std::strerror(errno);
+    return false;
+  }
+  // ftruncate zero fills the segment, hence all the sequences are 0
+  if (ftruncate(fd, static_cast<off_t>(segment_size)) != 0) {
+    *error = std::strerror(errno);
+    close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  void* address = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) {
+    *error = std::strerror(errno);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  name_ = name;
+  segment_size_ = segment_size;
+  next_frame_ = 0;
+  header_ = static_cast<LiveFrameRingHeader*>(address);
+  header_->version = kLiveFrameVersion;
+  header_->num_slots = num_slots;
+  header_->slot_size = static_cast<std::int64_t>(slot_size);
+  header_->format = format;
+  header_->num_frames.store(0, std::memory_order_relaxed);
+  header_->is_finished.store(0, std::memory_order_relaxed);
+  // the readers check the magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header_->magic, "FDTD1DLV", 8);
+  return true;
+}
+
+void LiveFrameRing::Close() {
+  if (header_ == nullptr) {
+    return;
+  }
+  munmap(header_, segment_size_);
+  shm_unlink(name_.c_str());
+  header_ = nullptr;
+}
+
+void* LiveFrameRing::BeginFrame(const IntNumber ind_t, const double time) {
+  LiveFrameHeader* slot = GetSlot(next_frame_);
+  slot->sequence.store(2*next_frame_ + 1, std::memory_order_relaxed);
+  // the values are not written before the readers can see the odd sequence
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->ind_t = ind_t;
+  slot->time = time;
+  return reinterpret_cast<char*>(slot) + kLiveFrameSlotHeaderSize;
+}
+
+void LiveFrameRing::PublishFrame() {
+  LiveFrameHeader* slot = GetSlot(next_frame_);
+  ++next_frame_;
+  slot->sequence.store(2*next_frame_, std::memory_order_release);
+  header_->num_frames.store(next_frame_, std::memory_order_release);
+}
+
+void LiveFrameRing::Finish() {
+  if (header_ != nullptr) {
+    header_->is_finished.store(1, std::memory_order_release);
+  }
+}
+
+bool LiveFrameRing::is_finished() {
+  return header_ != nullptr &&
+         header_->is_finished.load(std::memory_order_relaxed) != 0;
+}
+
+std::int64_t LiveFrameRing::get_num_frames() {
+  return next_frame_;
+}
+
+LiveFrameHeader* LiveFrameRing::GetSlot(const std::int64_t frame) {
+  return reinterpret_cast<LiveFrameHeader*>(
+      reinterpret_cast<char*>(header_) + kLiveFrameHeaderSize +
+      (frame % header_->num_slots)*header_->slot_size);
+}
+
+}  // namespace fdtd1d
@@ -0,0 +1,118 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_LIVE_FRAMES_H_
+#define FDTD_LIVE_FRAMES_H_
+
+// Publishes decimated frames of the E field in a POSIX shared memory segment
+// while the solver runs, so that other processes can plot or analyze the
+// fields live (see build/liveView.py) without any output file.
+//
+// The segment is a ring of num_slots frames with a single writer (the
+// solver) and any number of readers. The writer never waits for the readers:
+// it overwrites the oldest frame whatever the readers are doing, and each
+// frame is protected by a sequence lock instead. The sequence of the frame k
+// is 2k + 1 while it is written and 2k + 2 once it is complete, so a reader
+// copies a frame and checks that the sequence was the same even number
+// before and after the copy; otherwise the frame was torn by the writer and
+// the reader takes a newer one.
+//
+// Segment layout (version kLiveFrameVersion, native byte order):
+//   LiveFrameRingHeader, padded to kLiveFrameHeaderSize bytes
+//   num_slots slots of slot_size bytes, the frame k in the slot k % num_slots:
+//     LiveFrameHeader, padded to kLiveFrameSlotHeaderSize bytes
+//     num_values values of real_size bytes: E at x0 + i*dx*space_stride
+
+#include <atomic>         // std::atomic
+#include <cstddef>        // std::size_t
+#include <cstdint>        // std::int64_t, std::uint64_t
+#include <string>         // std::string
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+constexpr std::uint32_t kLiveFrameVersion = 1;
+constexpr std::size_t kLiveFrameHeaderSize = 4096;
+constexpr std::size_t kLiveFrameSlotHeaderSize = 64;
+
+// the grid of the frames, written once when the segment is created
+struct LiveFrameFormat {
+  std::uint32_t real_size;        // sizeof the field values
+  std::int64_t num_values;        // values per frame
+  std::int64_t space_stride;      // grid points between two values
+  std::int64_t time_stride;       // time steps between two frames
+  std::int64_t num_x;             // E nodes of the grid
+  std::int64_t num_t;
+  double x0;                      // position of the first value
+  double dx;                      // grid spacing
+  double dt;
+};
+
+struct LiveFrameRingHeader {
+  char magic[8];                  // "FDTD1DLV"
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::int64_t num_slots;
+  std::int64_t slot_size;         // bytes from a slot to the next one
+  LiveFrameFormat format;
+  // the frames published so far, the latest one is num_frames - 1
+  alignas(64) std::atomic<std::int64_t> num_frames;
+  // 1 once the run reached its last time step
+  std::atomic<std::int64_t> is_finished;
+};
+
+struct LiveFrameHeader {
+  std::atomic<std::uint64_t> sequence;
+  std::int64_t ind_t;             // time step of the fields
+  double time;
+};
+
+static_assert(sizeof(LiveFrameRingHeader) <= kLiveFrameHeaderSize,
+              "the live frame header does not fit in its page");
+static_assert(sizeof(LiveFrameHeader) <= kLiveFrameSlotHeaderSize,
+              "the live frame slot header does not fit in its cache line");
+
+class LiveFrameRing {
+  public:
+  LiveFrameRing() = default;
+  LiveFrameRing(const LiveFrameRing&) = delete;
+  LiveFrameRing& operator=(const LiveFrameRing&) = delete;
+  ~LiveFrameRing();
+
+  // replaces the segment name (e.g. "fdtd1d_live", /dev/shm/fdtd1d_live on
+  // Linux) by a new ring of num_slots frames. The readers of the previous
+  // segment keep their mapping. Returns false with the reason in error if
+  // the segment can not be created.
+  bool Create(const std::string& name, const LiveFrameFormat& format,
+              const std::int64_t num_slots, std::string* error);
+
+  // unmaps and removes the segment
+  void Close();
+
+  bool is_open() { return header_ != nullptr; }
+  bool is_finished();
+
+  // marks the slot of the next frame as being written and returns the
+  // address of its values. Then PublishFrame completes it.
+  void* BeginFrame(const IntNumber ind_t, const double time);
+  void PublishFrame();
+
+  // tells the readers that no more frames will come
+  void Finish();
+
+  std::int64_t get_num_frames();
+
+  private:
+  LiveFrameHeader* GetSlot(const std::int64_t frame);
+
+  std::string name_;
+  LiveFrameRingHeader* header_ = nullptr;
+  std::size_t segment_size_ = 0;
+  std::int64_t next_frame_ = 0;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_LIVE_FRAMES_H_
@@ -1,52 +1,706 @@
 // Use of this source code is governed by the GNU General Public License v3.0.
 
 #include <chrono>       // chrono::steady_clock, chrono::duration
+#include <iostream>     // std::cout, std::cerr
+#include <string>       // std::string, std::stoi
+#include <vector>       // std::vector
+#include <algorithm>    // std::max
+#include <memory>       // std::unique_ptr
+#include <sys/wait.h>   // waitpid
+#include <unistd.h>     // fork, getpid
 
 #include "number_types.h"
 #include "fdtd1d.h"
+#include "fdtd1d_ensemble.h"
+#include "halo_transport.h"
+#include "thread_affinity.h"
+#include "thread_barrier.h"
+#include "thread_profiler.h"
+#include "yee_kernels.h"
+#include "field_writer.h"
 
+// usage: ./fdtd1d [NUMBER_OF_THREADS] [--option=value ...]
+// options:
+//   --precision=double|float|mixed
+//                         floating point type of the fields (default double).
+//                         mixed stores the fields in float and calculates the
+//                         time and the sources in double.
+//   --sync=hybrid|spin    how the threads wait for each other (default hybrid)
+//   --engine=per-step|temporal-blocking|task-graph
+//                         time stepping algorithm (default per-step)
+//   --active-region=on|off
+//                         skips the nodes the fields have not reached yet 
+//                         (default on)
+//   --tile-depth=N        time steps per block of the temporal-blocking engine
+//                         (between synchronizations of the task-graph engine
+//                         while the active region grows)
+//   --tile-width=N        grid points per tile of the temporal-blocking and 
+//                         task-graph engines
+//   --kernel=auto|scalar|sse2|avx2|avx512
+//                         forces the kernels of the E and H updates (default
+//                         auto, the best kernels supported by the processor)
+//   --space-order=2|4     order of the spatial differences (default 2). 4 
+//                         selects the FDTD(2,4) stencils with a time step 
+//                         shortened by 6/7, see FDTD1D::SetSpatialOrder.
+//   --affinity=none|compact|scatter|LIST
+//                         pins the threads to the CPUs (default none), see
+//                         thread_affinity.h. LIST is a list of CPUs such as
+//                         0,2,4-7.
+//   --first-touch         each thread zeroes its own chunk of the fields, so
+//                         that its pages are on the NUMA node of the thread
+//   --huge-pages          backs the fields by transparent huge pages
+//   --load-balance[=N]    moves the chunks of the threads every N time steps
+//                         (default 64) to equalize their measured cost
+//   --load-balance-threshold=X
+//                         the chunks only move if the slowest thread exceeds
+//                         the mean by more than the fraction X (default 0.05)
+//   --ranks=N             splits the grid between N processes exchanging their
+//                         boundary nodes (default 1), see 
+//                         FDTD1D::SetDomainDecomposition. The process forks 
+//                         the ranks 1 to N - 1 itself, unless --rank is given.
+//   --rank=R              runs only the rank R of --ranks, for ranks started
+//                         separately with the same --transport-name
+//   --transport=shm|socket
+//                         shared memory or Unix domain sockets between the 
+//                         ranks (default shm), see halo_transport.h
+//   --transport-name=NAME name of the shared memory segment or prefix of the
+//                         socket paths (default derived from the process id)
+//   --pml=N               absorbing CPML layers of N cells at both ends of 
+//                         the grid instead of PEC walls, see cpml.h
+//   --pml-order=M         polynomial grading order of the layers (default 3)
+//   --pml-sigma=F         maximum conductivity relative to the optimal one 
+//                         (default 1)
+//   --pml-kappa=K         maximum coordinate stretching (default 1)
+//   --pml-alpha=A         maximum complex frequency shift (default 0)
+//   --material=X0,X1,EPS_R[,MU_R[,SIGMA]]
+//                         fills [X0, X1) with a medium of relative 
+//                         permittivity EPS_R, relative permeability MU_R and 
+//                         conductivity SIGMA. Can be repeated, the last 
+//                         region wins where they overlap. See material_map.h
+//   --graded-material=X0,X1,EPS_R0,EPS_R1[,MU_R0,MU_R1[,SIGMA0,SIGMA1]]
+//                         a medium varying linearly from X0 to X1
+//   --drude=X0,X1,EPS_INF,OMEGA_P,GAMMA[,OMEGA_P,GAMMA...]
+//                         fills [X0, X1) with a Drude medium (a metal) of 
+//                         plasma angular frequencies OMEGA_P and damping 
+//                         rates GAMMA, see dispersive_media.h
+//   --lorentz=X0,X1,EPS_INF,DELTA_EPS,OMEGA_0,GAMMA[,...]
+//                         fills [X0, X1) with a multi-pole Lorentz medium of
+//                         resonance angular frequencies OMEGA_0, one 
+//                         DELTA_EPS,OMEGA_0,GAMMA triple per pole. The 
+//                         dispersive regions should not overlap.
+//   --subgrid=X0,X1,RATIO refines the grid from X0 to X1 by the integer 
+//                         RATIO in space and time. Can be repeated, the 
+//                         subgrids should not overlap. See subgrid.h
+//   --probe=X             records E at the grid point nearest to X after 
+//                         every time step. Can be repeated.
+//   --dft=X0,X1,F|X0,X1,F_MIN,F_MAX,NUM
+//                         accumulates the Fourier transform of E at the grid
+//                         points from X0 to X1 at the frequency F or at NUM
+//                         frequencies from F_MIN to F_MAX. Can be repeated, 
+//                         see field_monitors.h
+//   --monitor-output=PREFIX
+//                         writes the probes to PREFIX_probes.csv and the
+//                         transforms to PREFIX_dft.csv (default monitors)
+//   --profile             prints the time spent by each thread in each phase,
+//                         the load imbalance and the achieved bandwidth, see
+//                         thread_profiler.h
+//   --profile-counters    also reads the hardware counters of the threads
+//   --profile-report=FILE writes the profile to FILE, in CSV if FILE ends with
+//                         .csv and in JSON otherwise
+//   --checkpoint=FILE     writes a checkpoint of the solver state to FILE every
+//                         --checkpoint-interval time steps, see checkpoint.h
+//   --checkpoint-interval=N
+//                         time steps between the checkpoints (default 1000)
+//   --resume=FILE         continues the run saved in the checkpoint FILE
+//   --live=NAME           publishes the E field in the shared memory segment
+//                         NAME (e.g. /fdtd1d-live) while the solver runs, for
+//                         build/liveView.py, see live_frames.h
+//   --live-time-stride=N  publishes a frame every N time steps (default 10)
+//   --live-space-stride=N publishes every N-th grid point (default 1)
+//   --live-slots=N        frames kept in the segment (default 16)
+//   --source-type=gaussian|modulated-gaussian|sinusoid|tabulated
+//                         temporal variation of the sources (default gaussian)
+//   --num-sources=N       number of point sources, evenly distributed over the
+//                         grid (default 1, at the center of the grid)
+//   --ensemble=N          runs a sweep of N instances of the problem in one
+//                         interleaved ensemble (see fdtd1d_ensemble.h). The
+//                         source of instance n has the amplitude 1 + 0.1*n,
+//                         is delayed by 0.01*n and shifted by n % 100 grid
+//                         points. Only the precision, sync, kernel and output
+//                         options apply to the ensemble, which writes the 
+//                         final fields of the instance n to FILE.n (FILE for
+//                         the instance 0) instead of the field history.
+//   --output-format=csv|raw|chunked
+//                         writes the field history (default no output). raw
+//                         is a binary file with a header and chunked is a
+//                         compressed binary file with an index, see 
+//                         field_writer.h.
+//   --output=FILE         name of the output file (default output.csv or
+//                         output.bin)
+//   --output-chunk-steps=N
+//                         snapshots per chunk of the chunked format (default
+//                         about 16 MB of snapshots)
+//   --output-time-stride=N
+//                         writes a snapshot every N time steps (default 1)
+//   --output-space-stride=N
+//                         writes every N-th grid point (default 1)
+//   --output-h            also writes the H field (binary formats only)
+//   --output-buffers=N    snapshots waiting to be written before the solver
+//                         waits for the disk (default 4)
+//   --direct-io           writes the binary output bypassing the page cache
 
-int main(int argc, char* argv[]) {
-  auto t_start = std::chrono::steady_clock::now();
+namespace {
 
-  // x axis grid parameters
-  fdtd1d::RealNumber x0(-10.0);
-  fdtd1d::RealNumber x1(10.0);
-  fdtd1d::RealNumber dx(0.01);
-  // simulation time and stability factor
-  fdtd1d::RealNumber t_final(22.0);
-  fdtd1d::RealNumber stabilityFactor(0.99); 
-  // number of threads
-  int num_threads(1);
-  if (argc == 2) {
-    num_threads = std::stoi(argv[1]);
-    if (num_threads < 1) {
-      num_threads = 1;
+// the run time options given on the command line
+struct SimulationOptions {
+  int num_threads = 1;
+  fdtd1d::Precision precision = fdtd1d::Precision::kDouble;
+  fdtd1d::BarrierMode barrier_mode = fdtd1d::BarrierMode::kHybrid;
+  fdtd1d::TimeSteppingEngine engine = fdtd1d::TimeSteppingEngine::kPerStep;
+  bool track_active_region = true;
+  int tile_depth = 16;
+  fdtd1d::IntNumber tile_width = 16384;
+  fdtd1d::KernelType kernel_type = fdtd1d::KernelType::kAuto;
+  int space_order = 2;
+  fdtd1d::AffinityPolicy affinity = fdtd1d::AffinityPolicy::kNone;
+  std::vector<int> affinity_cpus;
+  bool first_touch = false;
+  bool huge_pages = false;
+  int num_ranks = 1;
+  int rank = -1;                      // -1 : forks the ranks
+  fdtd1d::TransportType transport = fdtd1d::TransportType::kSharedMemory;
+  std::string transport_name;
+  fdtd1d::CPMLParameters cpml;
+  std::vector<fdtd1d::MaterialRegion> materials;
+  std::vector<fdtd1d::DispersiveRegion> dispersive_media;
+  std::vector<fdtd1d::SubgridRegion> subgrids;
+  std::vector<double> probes;
+  std::vector<fdtd1d::DFTMonitorRegion> dft_monitors;
+  std::string monitor_file_prefix = "monitors";
+  bool load_balancing = false;
+  fdtd1d::IntNumber load_balancing_interval = 64;
+  double load_balancing_threshold = 0.05;
+  bool profile = false;
+  bool profile_counters = false;
+  std::string profile_report_file_name;
+  std::string checkpoint_file_name;
+  fdtd1d::IntNumber checkpoint_interval = 1000;
+  std::string resume_file_name;
+  std::string live_frame_name;
+  fdtd1d::IntNumber live_time_stride = 10;
+  fdtd1d::IntNumber live_space_stride = 1;
+  fdtd1d::IntNumber live_num_slots = 16;
+  std::string source_type = "gaussian";
+  int num_sources = 1;
+  int num_instances = 0;              // 0 : a single simulation
+  bool write_output = false;
+  fdtd1d::OutputFormat output_format = fdtd1d::OutputFormat::kCSV;
+  std::string output_file_name;
+  fdtd1d::IntNumber output_time_stride = 1;
+  fdtd1d::IntNumber output_space_stride = 1;
+  bool output_h_field = false;
+  int output_buffers = 4;
+  fdtd1d::IntNumber output_chunk_steps = 0;
+  bool direct_io = false;
+};
+
+// returns false if an option is not recognized
+bool ParseOptions(int argc, char* argv[], SimulationOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg.compare(0, 2, "--") != 0) {
+      options->num_threads = std::stoi(arg);
+      if (options->num_threads < 1) {
+        options->num_threads = 1;
+      }
+      continue;
+    }
+    std::string name = arg.substr(2, arg.find('=') - 2);
+    std::string value = arg.find('=') == std::string::npos ? 
+                        std::string() : arg.substr(arg.find('=') + 1);
+    if (name == "precision" && 
+        fdtd1d::ParsePrecision(value, &options->precision)) {
+      continue;
+    }
+    if (name == "sync" && 
+        fdtd1d::ParseBarrierMode(value, &options->barrier_mode)) {
+      continue;
+    }
+    if (name == "engine" && 
+        fdtd1d::ParseTimeSteppingEngine(value, &options->engine)) {
+      continue;
+    }
+    if (name == "kernel" && 
+        fdtd1d::ParseKernelType(value, &options->kernel_type)) {
+      continue;
+    }
+    if (name == "space-order" && (value == "2" || value == "4")) {
+      options->space_order = std::stoi(value);
+      continue;
+    }
+    if (name == "affinity" && fdtd1d::ParseAffinityPolicy(
+            value, &options->affinity, &options->affinity_cpus)) {
+      continue;
+    }
+    if (name == "first-touch" && value.empty()) {
+      options->first_touch = true;
+      continue;
+    }
+    if (name == "huge-pages" && value.empty()) {
+      options->huge_pages = true;
+      continue;
+    }
+    if (name == "ranks" && !value.empty()) {
+      options->num_ranks = std::max(std::stoi(value), 1);
+      continue;
+    }
+    if (name == "rank" && !value.empty()) {
+      options->rank = std::stoi(value);
+      continue;
+    }
+    if (name == "transport" && 
+        fdtd1d::ParseTransportType(value, &options->transport)) {
+      continue;
+    }
+    if (name == "transport-name" && !value.empty()) {
+      options->transport_name = value;
+      continue;
+    }
+    if (name == "load-balance") {
+      options->load_balancing = true;
+      if (!value.empty()) {
+        options->load_balancing_interval = std::stoll(value);
+      }
+      continue;
+    }
+    if (name == "load-balance-threshold" && !value.empty()) {
+      options->load_balancing_threshold = std::stod(value);
+      continue;
+    }
+    if (name == "profile" && value.empty()) {
+      options->profile = true;
+      continue;
+    }
+    if (name == "profile-counters" && value.empty()) {
+      options->profile = true;
+      options->profile_counters = true;
+      continue;
+    }
+    if (name == "profile-report" && !value.empty()) {
+      options->profile = true;
+      options->profile_report_file_name = value;
+      continue;
+    }
+    if (name == "pml" && !value.empty()) {
+      options->cpml.thickness = std::stoll(value);
+      continue;
+    }
+    if (name == "pml-order" && !value.empty()) {
+      options->cpml.grading_order = std::stod(value);
+      continue;
+    }
+    if (name == "pml-sigma" && !value.empty()) {
+      options->cpml.sigma_factor = std::stod(value);
+      continue;
+    }
+    if (name == "pml-kappa" && !value.empty()) {
+      options->cpml.kappa_max = std::stod(value);
+      continue;
+    }
+    if (name == "pml-alpha" && !value.empty()) {
+      options->cpml.alpha_max = std::stod(value);
+      continue;
+    }
+    if (name == "material" || name == "graded-material") {
+      fdtd1d::MaterialRegion region;
+      if (fdtd1d::ParseMaterialRegion(value, name == "graded-material", 
+                                      &region)) {
+        options->materials.push_back(region);
+        continue;
+      }
+    }
+    if (name == "drude" || name == "lorentz") {
+      fdtd1d::DispersiveRegion region;
+      if (name == "drude" ? fdtd1d::ParseDrudeRegion(value, &region) : 
+                            fdtd1d::ParseLorentzRegion(value, &region)) {
+        options->dispersive_media.push_back(region);
+        continue;
+      }
+    }
+    if (name == "subgrid") {
+      fdtd1d::SubgridRegion region;
+      if (fdtd1d::ParseSubgridRegion(value, &region)) {
+        options->subgrids.push_back(region);
+        continue;
+      }
+    }
+    if (name == "probe" && !value.empty()) {
+      options->probes.push_back(std::stod(value));
+      continue;
+    }
+    if (name == "dft") {
+      fdtd1d::DFTMonitorRegion region;
+      if (fdtd1d::ParseDFTMonitorRegion(value, &region)) {
+        options->dft_monitors.push_back(region);
+        continue;
+      }
+    }
+    if (name == "monitor-output" && !value.empty()) {
+      options->monitor_file_prefix = value;
+      continue;
+    }
+    if (name == "checkpoint" && !value.empty()) {
+      options->checkpoint_file_name = value;
+      continue;
+    }
+    if (name == "checkpoint-interval" && !value.empty()) {
+      options->checkpoint_interval = std::stoll(value);
+      continue;
+    }
+    if (name == "resume" && !value.empty()) {
+      options->resume_file_name = value;
+      continue;
+    }
+    if (name == "live" && !value.empty()) {
+      options->live_frame_name = value;
+      continue;
+    }
+    if (name == "live-time-stride" && !value.empty()) {
+      options->live_time_stride = std::stoll(value);
+      continue;
+    }
+    if (name == "live-space-stride" && !value.empty()) {
+      options->live_space_stride = std::stoll(value);
+      continue;
+    }
+    if (name == "live-slots" && !value.empty()) {
+      options->live_num_slots = std::stoll(value);
+      continue;
+    }
+    if (name == "active-region" && (value == "on" || value == "off")) {
+      options->track_active_region = (value == "on");
+      continue;
+    }
+    if (name == "tile-depth" && !value.empty()) {
+      options->tile_depth = std::stoi(value);
+      continue;
+    }
+    if (name == "tile-width" && !value.empty()) {
+      options->tile_width = std::stoll(value);
+      continue;
+    }
+    if (name == "source-type" && 
+        (value == "gaussian" || value == "modulated-gaussian" || 
+         value == "sinusoid" || value == "tabulated")) {
+      options->source_type = value;
+      continue;
+    }
+    if (name == "num-sources" && !value.empty()) {
+      options->num_sources = std::max(std::stoi(value), 1);
+      continue;
+    }
+    if (name == "ensemble" && !value.empty()) {
+      options->num_instances = std::stoi(value);
+      continue;
+    }
+    if (name == "output-format" && 
+        fdtd1d::ParseOutputFormat(value, &options->output_format)) {
+      options->write_output = true;
+      continue;
+    }
+    if (name == "output" && !value.empty()) {
+      options->output_file_name = value;
+      continue;
+    }
+    if (name == "output-time-stride" && !value.empty()) {
+      options->output_time_stride = std::stoll(value);
+      continue;
+    }
+    if (name == "output-space-stride" && !value.empty()) {
+      options->output_space_stride = std::stoll(value);
+      continue;
+    }
+    if (name == "output-h" && value.empty()) {
+      options->output_h_field = true;
+      continue;
+    }
+    if (name == "output-chunk-steps" && !value.empty()) {
+      options->output_chunk_steps = std::stoll(value);
+      continue;
+    }
+    if (name == "output-buffers" && !value.empty()) {
+      options->output_buffers = std::stoi(value);
+      continue;
     }
+    if (name == "direct-io" && value.empty()) {
+      options->direct_io = true;
+      continue;
+    }
+    std::cerr << "unknown or invalid option: " << arg << std::endl;
+    return false;
   }
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+void RunSimulation(const SimulationOptions& options) {
+  // x axis grid parameters
+  SourceReal x0(-10.0);
+  SourceReal x1(10.0);
+  SourceReal dx(0.01);
+  // simulation time and stability factor
+  SourceReal t_final(22.0);
+  SourceReal stabilityFactor(0.99); 
   
-  fdtd1d::FDTD1D fdtd;
+  // the transport outlives the solver using it
+  std::unique_ptr<fdtd1d::HaloTransport> transport;
+  fdtd1d::FDTD1D<Real, SourceReal> fdtd;
   fdtd.SetXAxisRangeAndGridSpacing(x0, x1, dx);
+  if (!fdtd.SetSpatialOrder(options.space_order)) {
+    return;
+  }
+  if (options.num_ranks > 1) {
+    transport = fdtd1d::CreateHaloTransport(options.transport, 
+                                            options.transport_name,
+                                            options.rank, options.num_ranks);
+    if (transport == nullptr || 
+        !fdtd.SetDomainDecomposition(transport.get(), options.rank, 
+                                     options.num_ranks)) {
+      return;
+    }
+  }
+  fdtd.SetMemoryPlacement(options.first_touch, options.huge_pages);
   fdtd.InitializeAndResetEMFieldArrays();
   fdtd.SetStabilityFactorAndTimeResolution(stabilityFactor);
   fdtd.SetSimulationTime(t_final);
-  fdtd.SetNumberOfThreads(num_threads);
+  fdtd.SetNumberOfThreads(options.num_threads);
+  fdtd.SetSynchronizationMode(options.barrier_mode);
+  fdtd.SetTimeSteppingEngine(options.engine);
+  fdtd.SetTemporalBlockingParameters(options.tile_depth, options.tile_width);
+  fdtd.SetActiveRegionTracking(options.track_active_region);
+  fdtd.SetKernelType(options.kernel_type);
+  fdtd.SetThreadAffinity(options.affinity, options.affinity_cpus);
+  fdtd.SetLoadBalancing(options.load_balancing, 
+                        options.load_balancing_interval,
+                        options.load_balancing_threshold);
+  fdtd.SetProfiling(options.profile, options.profile_counters);
+  if (!fdtd.SetAbsorbingBoundaries(options.cpml) || 
+      !fdtd.SetMaterials(options.materials) ||
+      !fdtd.SetDispersiveMedia(options.dispersive_media) ||
+      !fdtd.SetSubgrids(options.subgrids) ||
+      !fdtd.SetMonitors(options.probes, options.dft_monitors)) {
+    return;
+  }
+  
+  //electric sources j, evenly distributed over the grid
+  for (int n = 0; n < options.num_sources; ++n) {
+    SourceReal j_position = x0 + (x1 - x0)*(n + SourceReal(0.5)) / 
+                                 options.num_sources;
+    SourceReal j_amplitude(1.0);
+    SourceReal j_t_center(1.0);
+    SourceReal j_t_decay(0.2);
+    SourceReal j_frequency(2.0);
+    SourceReal j_phase(0.0);
+    if (options.source_type == "gaussian") {
+      fdtd.InsertGaussianPointSource(j_position, j_amplitude, 
+                                     j_t_center, j_t_decay);
+    } else if (options.source_type == "modulated-gaussian") {
+      fdtd.InsertModulatedGaussianPointSource(j_position, j_amplitude, 
+                                              j_t_center, j_t_decay, 
+                                              j_frequency, j_phase);
+    } else if (options.source_type == "sinusoid") {
+      fdtd.InsertSinusoidalPointSource(j_position, j_amplitude, j_frequency,
+                                       j_phase, SourceReal(0.0));
+    } else {
+      // a triangular pulse sampled every 0.1 time units
+      std::vector<SourceReal> samples = {0.0, 0.25, 0.5, 0.75, 1.0, 
+                                         0.75, 0.5, 0.25, 0.0};
+      fdtd.InsertTabulatedPointSource(j_position, SourceReal(0.5), 
+                                      SourceReal(0.1), samples);
+    }
+  }
   
-  //electric source j
-  fdtd1d::RealNumber j_position(0.0);
-  fdtd1d::RealNumber j_amplitude(1.0);
-  fdtd1d::RealNumber j_t_center(1.0);
-  fdtd1d::RealNumber j_t_decay(0.2);
-  fdtd.InsertGaussianPointSource(j_position, j_amplitude, 
-                                 j_t_center, j_t_decay);
+  if (!options.resume_file_name.empty() && 
+      !fdtd.RestoreCheckpoint(options.resume_file_name)) {
+    return;
+  }
+  if (!options.checkpoint_file_name.empty()) {
+    fdtd.SetCheckpointing(options.checkpoint_file_name, 
+                          options.checkpoint_interval);
+  }
+  if (!options.live_frame_name.empty()) {
+    fdtd.SetLiveFrames(options.live_frame_name, options.live_time_stride,
+                       options.live_space_stride, options.live_num_slots);
+  }
   
+  std::cout << "Precision : " << fdtd1d::GetPrecisionName(options.precision)
+            << std::endl;
   fdtd.PrintParameters();
-  fdtd.SetTheWriteToFileFlag(false);
-  //fdtd.SetOutputCSVFileName("efiled-utput.csv");
+  fdtd.SetTheWriteToFileFlag(options.write_output);
+  if (options.write_output) {
+    std::string file_name = options.output_file_name;
+    if (file_name.empty()) {
+      file_name = options.output_format == fdtd1d::OutputFormat::kCSV ?
+                  "output.csv" : "output.bin";
+    }
+    fdtd.SetOutputFileName(file_name);
+    fdtd.SetFieldOutputOptions(options.output_format, 
+                               options.output_time_stride,
+                               options.output_space_stride, 
+                               options.output_h_field);
+    fdtd.SetFieldOutputBuffering(options.output_buffers, options.direct_io);
+    fdtd.SetFieldOutputChunkSize(options.output_chunk_steps);
+  }
 
   fdtd.CreateThreadsAndRun();
+  fdtd.WriteMonitors(options.monitor_file_prefix);
+  
+  const std::string& report_name = options.profile_report_file_name;
+  if (!report_name.empty()) {
+    bool is_csv = report_name.size() >= 4 && 
+                  report_name.compare(report_name.size() - 4, 4, ".csv") == 0;
+    fdtd.WriteProfileReport(report_name, is_csv ? 
+                            fdtd1d::ProfileReportFormat::kCSV : 
+                            fdtd1d::ProfileReportFormat::kJSON);
+  }
   
   //fdtd.PrintEFieldValues();
+}
+
+template <typename Real, typename SourceReal>
+void RunEnsemble(const SimulationOptions& options) {
+  // the problem of RunSimulation
+  SourceReal x0(-10.0);
+  SourceReal x1(10.0);
+  SourceReal dx(0.01);
+  SourceReal t_final(22.0);
+  SourceReal stabilityFactor(0.99); 
+  
+  fdtd1d::FDTD1DEnsemble<Real, SourceReal> ensemble;
+  ensemble.SetXAxisRangeAndGridSpacing(x0, x1, dx);
+  ensemble.SetNumberOfInstances(options.num_instances);
+  ensemble.InitializeAndResetEMFieldArrays();
+  ensemble.SetStabilityFactorAndTimeResolution(stabilityFactor);
+  ensemble.SetSimulationTime(t_final);
+  ensemble.SetNumberOfThreads(options.num_threads);
+  ensemble.SetSynchronizationMode(options.barrier_mode);
+  ensemble.SetKernelType(options.kernel_type);
+  
+  // the sweep, instance 0 is the problem of RunSimulation
+  for (int n = 0; n < ensemble.get_num_instances(); ++n) {
+    SourceReal j_position = SourceReal(0.0) + (n % 100)*dx;
+    SourceReal j_amplitude = SourceReal(1.0) + SourceReal(0.1)*n;
+    SourceReal j_t_center = SourceReal(1.0) + SourceReal(0.01)*n;
+    SourceReal j_t_decay(0.2);
+    if (!ensemble.InsertGaussianPointSource(n, j_position, j_amplitude, 
+                                            j_t_center, j_t_decay)) {
+      return;
+    }
+  }
+  
+  std::cout << "Precision : " << fdtd1d::GetPrecisionName(options.precision)
+            << std::endl;
+  ensemble.PrintParameters();
+  
+  ensemble.CreateThreadsAndRun();
+  
+  // the final fields of the instance n go to FILE.n, those of the instance 0
+  // to FILE
+  if (options.write_output) {
+    std::string file_name = options.output_file_name;
+    if (file_name.empty()) {
+      file_name = options.output_format == fdtd1d::OutputFormat::kCSV ?
+                  "output.csv" : "output.bin";
+    }
+    fdtd1d::FieldWriter<Real> writer;
+    writer.SetOutputFormat(options.output_format);
+    writer.SetDecimation(1, options.output_space_stride);
+    writer.SetWriteHField(options.output_h_field);
+    writer.SetDirectIO(options.direct_io);
+    for (int n = 0; n < ensemble.get_num_instances(); ++n) {
+      if (!ensemble.WriteFieldsToFile(n, n == 0 ? file_name : 
+                                      file_name + "." + std::to_string(n),
+                                      &writer)) {
+        return;
+      }
+    }
+    std::cout << "Final fields of " << ensemble.get_num_instances() 
+              << " instances written to " << file_name << std::endl;
+  }
+}
+
+template <typename Real, typename SourceReal>
+void Run(const SimulationOptions& options) {
+  if (options.num_instances > 0 && options.num_ranks > 1) {
+    std::cout << "The ensemble runs in a single process." << std::endl;
+  } else if (options.num_instances > 0) {
+    RunEnsemble<Real, SourceReal>(options);
+  } else {
+    RunSimulation<Real, SourceReal>(options);
+  }
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+  auto t_start = std::chrono::steady_clock::now();
+
+  SimulationOptions options;
+  if (!ParseOptions(argc, argv, &options)) {
+    return 1;
+  }
+  
+  // the ranks of a decomposed grid are forked before any thread is started.
+  // Only rank 0 prints.
+  std::vector<pid_t> rank_processes;
+  if (options.num_ranks > 1) {
+    if (options.transport_name.empty()) {
+      options.transport_name = 
+          (options.transport == fdtd1d::TransportType::kSharedMemory ? 
+           "/fdtd1d-" : "/tmp/fdtd1d-") + std::to_string(getpid());
+    }
+    if (options.rank < 0) {
+      options.rank = 0;
+      for (int rank = 1; rank < options.num_ranks; ++rank) {
+        pid_t pid = fork();
+        if (pid == 0) {
+          options.rank = rank;
+          rank_processes.clear();
+          break;
+        }
+        if (pid < 0) {
+          std::cerr << "Could not start the rank " << rank << std::endl;
+          return 1;
+        }
+        rank_processes.push_back(pid);
+      }
+    }
+    if (options.rank > 0) {
+      std::cout.rdbuf(nullptr);
+    }
+  }
+  
+  switch (options.precision) {
+    case fdtd1d::Precision::kDouble:
+      Run<double, double>(options);
+      break;
+    case fdtd1d::Precision::kFloat:
+      Run<float, float>(options);
+      break;
+    case fdtd1d::Precision::kMixed:
+      Run<float, double>(options);
+      break;
+  }
+  
+  int exit_code = 0;
+  for (pid_t pid : rank_processes) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || 
+        WEXITSTATUS(status) != 0) {
+      exit_code = 1;
+    }
+  }
   
   auto t_end = std::chrono::steady_clock::now();
   std::chrono::duration<double> time_span(t_end - t_start);
@@ -54,6 +708,6 @@ int main(int argc, char* argv[]) {
   std::cout << std::endl << "It took " << time_span.count() 
             << " seconds." << std::endl;
 
-  return 0;  
+  return exit_code;  
 }
 
@@ -0,0 +1,323 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "material_map.h"
+
+#include <algorithm>      // std::sort, std::unique, std::upper_bound
+#include <cmath>          // std::ceil
+#include <sstream>        // std::istringstream
+#include <utility>        // std::pair
+
+namespace fdtd1d {
+
+namespace {
+
+// the tolerance of the positions of the region ends, relative to dx
+constexpr double kPositionTolerance = 1e-9;
+
+bool IsValidMaterial(const Material& material) {
+  return material.epsilon_r > 0.0 && material.mu_r > 0.0 &&
+         material.sigma >= 0.0;
+}
+
+}  // namespace
+
+bool ParseNumberList(const std::string& text, std::vector<double>* values) {
+  values->clear();
+  std::istringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::size_t end = 0;
+    try {
+      values->push_back(std::stod(item, &end));
+    } catch (...) {
+      return false;
+    }
+    if (end != item.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseMaterialRegion(const std::string& text, const bool is_graded,
+                         MaterialRegion* region) {
+  std::vector<double> values;
+  if (!ParseNumberList(text, &values)) {
+    return false;
+  }
+  // the material values follow x_begin and x_end, one (two if graded) for
+  // each of epsilon_r, mu_r and sigma
+  const std::size_t per_value = is_graded ? 2 : 1;
+  if (values.size() < 2 + per_value || values.size() > 2 + 3*per_value ||
+      (values.size() - 2) % per_value != 0) {
+    return false;
+  }
+  MaterialRegion parsed;
+  parsed.x_begin = values[0];
+  parsed.x_end = values[1];
+  parsed.is_graded = is_graded;
+  double* begin_values[3] = {&parsed.begin.epsilon_r, &parsed.begin.mu_r,
+                             &parsed.begin.sigma};
+  double* end_values[3] = {&parsed.end.epsilon_r, &parsed.end.mu_r,
+                           &parsed.end.sigma};
+  for (std::size_t k = 0; k*per_value + 2 < values.size(); ++k) {
+    *begin_values[k] = values[2 + k*per_value];
+    *end_values[k] = values[2 + k*per_value + per_value - 1];
+  }
+  if (parsed.x_end <= parsed.x_begin || !IsValidMaterial(parsed.begin) ||
+      !IsValidMaterial(parsed.end)) {
+    return false;
+  }
+  *region = parsed;
+  return true;
+}
+
+template <typename Real>
+bool MaterialMap<Real>::Build(const std::vector<MaterialRegion>& regions,
+                              const IntNumber grid_offset,
+                              const IntNumber num_local_x,
+                              const double x0, const double dx,
+                              const double dt_eps0,
+                              const double e_coefficient,
+                              const double h_coefficient) {
+  for (const MaterialRegion& region : regions) {
+    if (region.x_end <= region.x_begin || !IsValidMaterial(region.begin) ||
+        (region.is_graded && !IsValidMaterial(region.end))) {
+      return false;
+    }
+  }
+  regions_ = regions;
+  grid_offset_ = grid_offset;
+  x0_ = x0;
+  dx_ = dx;
+  dt_eps0_ = dt_eps0;
+  e_segments_.clear();
+  h_segments_.clear();
+  e_decay_.clear();
+  e_coefficient_.clear();
+  h_coefficient_.clear();
+  if (regions_.empty()) {
+    return true;
+  }
+
+  // the coefficients are calculated from the vacuum ones, so that the vacuum
+  // segments have exactly the coefficients of the solver
+  BuildSegments(num_local_x, 0.0, [this, e_coefficient](
+                                      const Material& material, Real* decay,
+                                      Real* coefficient) {
+    double loss = material.sigma*dt_eps0_ / (2*material.epsilon_r);
+    *decay = static_cast<Real>((1.0 - loss) / (1.0 + loss));
+    *coefficient = static_cast<Real>(
+        e_coefficient / (material.epsilon_r*(1.0 + loss)));
+  }, &e_segments_, &e_decay_, &e_coefficient_);
+  BuildSegments(num_local_x - 1, 0.5, [h_coefficient](
+                                          const Material& material,
+                                          Real* decay, Real* coefficient) {
+    *decay = Real(1);
+    *coefficient = static_cast<Real>(h_coefficient / material.mu_r);
+  }, &h_segments_, nullptr, &h_coefficient_);
+  return true;
+}
+
+template <typename Real>
+Material MaterialMap<Real>::GetMaterial(const MaterialRegion& region,
+                                        const double x) {
+  if (!region.is_graded) {
+    return region.begin;
+  }
+  double s = (x - region.x_begin) / (region.x_end - region.x_begin);
+  s = std::min(std::max(s, 0.0), 1.0);
+  Material material;
+  material.epsilon_r = region.begin.epsilon_r +
+                       (region.end.epsilon_r - region.begin.epsilon_r)*s;
+  material.mu_r = region.begin.mu_r + (region.end.mu_r - region.begin.mu_r)*s;
+  material.sigma = region.begin.sigma +
+                   (region.end.sigma - region.begin.sigma)*s;
+  return material;
+}
+
+template <typename Real>
+IntNumber MaterialMap<Real>::GetFirstNode(const double x,
+                                          const double node_shift,
+                                          const IntNumber num_nodes) {
+  double position = (x - x0_) / dx_ - static_cast<double>(grid_offset_) -
+                    node_shift;
+  if (position <= 0.0) {
+    return 0;
+  }
+  if (position >= static_cast<double>(num_nodes)) {
+    return num_nodes;
+  }
+  return std::min(num_nodes, static_cast<IntNumber>(
+      std::ceil(position - kPositionTolerance)));
+}
+
+template <typename Real>
+template <typename Function>
+void MaterialMap<Real>::BuildSegments(const IntNumber num_nodes,
+                                      const double node_shift,
+                                      Function coefficients,
+                                      std::vector<Segment>* segments,
+                                      std::vector<Real>* graded_decay,
+                                      std::vector<Real>* graded_coefficient) {
+  if (num_nodes <= 0) {
+    return;
+  }
+  // the local nodes of each region. The material is constant between two
+  // consecutive ends of the regions.
+  std::vector<std::pair<IntNumber, IntNumber>> region_nodes;
+  std::vector<IntNumber> breaks = {0, num_nodes};
+  for (const MaterialRegion& region : regions_) {
+    region_nodes.emplace_back(
+        GetFirstNode(region.x_begin, node_shift, num_nodes),
+        GetFirstNode(region.x_end, node_shift, num_nodes));
+    breaks.push_back(region_nodes.back().first);
+    breaks.push_back(region_nodes.back().second);
+  }
+  std::sort(breaks.begin(), breaks.end());
+  breaks.erase(std::unique(breaks.begin(), breaks.end()), breaks.end());
+
+  const Material vacuum;
+  for (std::size_t b = 0; b + 1 < breaks.size(); ++b) {
+    Segment segment = {breaks[b], breaks[b + 1], Real(1), Real(0), -1};
+    int k = static_cast<int>(regions_.size()) - 1;
+    for (; k >= 0; --k) {
+      if (region_nodes[k].first <= segment.begin &&
+          segment.begin < region_nodes[k].second) {
+        break;
+      }
+    }
+    if (k >= 0 && regions_[k].is_graded) {
+      segment.graded_offset =
+          static_cast<IntNumber>(graded_coefficient->size());
+      for (IntNumber i = segment.begin; i < segment.end; ++i) {
+        double x = x0_ + (static_cast<double>(grid_offset_ + i) +
+                          node_shift)*dx_;
+        Real decay, coefficient;
+        coefficients(GetMaterial(regions_[k], x), &decay, &coefficient);
+        if (graded_decay != nullptr) {
+          graded_decay->push_back(decay);
+        }
+        graded_coefficient->push_back(coefficient);
+      }
+    } else {
+      coefficients(k >= 0 ? regions_[k].begin : vacuum, &segment.decay,
+                   &segment.coefficient);
+    }
+    // the neighboring segments with the same coefficients are merged
+    if (!segments->empty() && segment.graded_offset < 0 &&
+        segments->back().graded_offset < 0 &&
+        segments->back().decay == segment.decay &&
+        segments->back().coefficient == segment.coefficient) {
+      segments->back().end = segment.end;
+    } else {
+      segments->push_back(segment);
+    }
+  }
+}
+
+template <typename Real>
+void MaterialMap<Real>::UpdateE(const YeeKernels<Real>& kernels, Real* e,
+                                const Real* h, const IntNumber ind_begin,
+                                const IntNumber ind_end,
+                                const int space_order) {
+  const Real near = static_cast<Real>(kFourthOrderNearWeight);
+  const Real far = static_cast<Real>(kFourthOrderFarWeight);
+  auto segment = std::upper_bound(
+      e_segments_.begin(), e_segments_.end(), ind_begin,
+      [](const IntNumber ind_x, const Segment& s) { return ind_x < s.end; });
+  for (; segment != e_segments_.end() && segment->begin < ind_end;
+       ++segment) {
+    IntNumber begin = std::max(ind_begin, segment->begin);
+    IntNumber end = std::min(ind_end, segment->end);
+    if (segment->graded_offset >= 0) {
+      const Real* decay = e_decay_.data() + segment->graded_offset -
+                          segment->begin;
+      const Real* coefficient = e_coefficient_.data() +
+                                segment->graded_offset - segment->begin;
+      if (space_order == 4) {
+        for (IntNumber i = begin; i < end; ++i) {
+          e[i] = e[i]*decay[i] - ((h[i] - h[i - 1])*near 
+                                  - (h[i + 1] - h[i - 2])*far)*coefficient[i];
+        }
+        continue;
+      }
+      for (IntNumber i = begin; i < end; ++i) {
+        e[i] = e[i]*decay[i] - (h[i] - h[i - 1])*coefficient[i];
+      }
+    } else if (space_order == 4 && segment->decay == Real(1)) {
+      kernels.update_e4(e, h, begin, end, 1, segment->coefficient*near,
+                        segment->coefficient*far);
+    } else if (space_order == 4) {
+      kernels.update_e4_lossy(e, h, begin, end, 1, segment->decay,
+                              segment->coefficient*near,
+                              segment->coefficient*far);
+    } else if (segment->decay == Real(1)) {
+      kernels.update_e(e, h, begin, end, 1, segment->coefficient);
+    } else {
+      kernels.update_e_lossy(e, h, begin, end, 1, segment->decay,
+                             segment->coefficient);
+    }
+  }
+}
+
+template <typename Real>
+void MaterialMap<Real>::UpdateH(const YeeKernels<Real>& kernels, Real* h,
+                                const Real* e, const IntNumber ind_begin,
+                                const IntNumber ind_end,
+                                const int space_order) {
+  const Real near = static_cast<Real>(kFourthOrderNearWeight);
+  const Real far = static_cast<Real>(kFourthOrderFarWeight);
+  auto segment = std::upper_bound(
+      h_segments_.begin(), h_segments_.end(), ind_begin,
+      [](const IntNumber ind_x, const Segment& s) { return ind_x < s.end; });
+  for (; segment != h_segments_.end() && segment->begin < ind_end;
+       ++segment) {
+    IntNumber begin = std::max(ind_begin, segment->begin);
+    IntNumber end = std::min(ind_end, segment->end);
+    if (segment->graded_offset >= 0) {
+      const Real* coefficient = h_coefficient_.data() +
+                                segment->graded_offset - segment->begin;
+      if (space_order == 4) {
+        for (IntNumber i = begin; i < end; ++i) {
+          h[i] -= ((e[i + 1] - e[i])*near 
+                   - (e[i + 2] - e[i - 1])*far)*coefficient[i];
+        }
+        continue;
+      }
+      for (IntNumber i = begin; i < end; ++i) {
+        h[i] -= (e[i + 1] - e[i])*coefficient[i];
+      }
+    } else if (space_order == 4) {
+      kernels.update_h4(h, e, begin, end, 1, segment->coefficient*near,
+                        segment->coefficient*far);
+    } else {
+      kernels.update_h(h, e, begin, end, 1, segment->coefficient);
+    }
+  }
+}
+
+template <typename Real>
+double MaterialMap<Real>::GetCurrentFactor(const IntNumber ind_x) {
+  double x = x0_ + static_cast<double>(grid_offset_ + ind_x)*dx_;
+  const IntNumber num_nodes = e_segments_.empty() ? 0 :
+                              e_segments_.back().end;
+  if (ind_x < 0 || ind_x >= num_nodes) {
+    return 1.0;
+  }
+  for (int k = static_cast<int>(regions_.size()) - 1; k >= 0; --k) {
+    if (GetFirstNode(regions_[k].x_begin, 0.0, num_nodes) <= ind_x &&
+        ind_x < GetFirstNode(regions_[k].x_end, 0.0, num_nodes)) {
+      Material material = GetMaterial(regions_[k], x);
+      double loss = material.sigma*dt_eps0_ / (2*material.epsilon_r);
+      return 1.0 / (material.epsilon_r*(1.0 + loss));
+    }
+  }
+  return 1.0;
+}
+
+template class MaterialMap<float>;
+template class MaterialMap<double>;
+
+}  // namespace fdtd1d
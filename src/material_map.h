@@ -0,0 +1,139 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_MATERIAL_MAP_H_
+#define FDTD_MATERIAL_MAP_H_
+
+// Describes inhomogeneous media by regions of the x axis with their relative
+// permittivity, relative permeability and electric conductivity. In a region
+// the updates become
+//
+//   e[i] = e[i]*decay - (h[i] - h[i - 1])*dt/(dx*epsilon)/(1 + loss)
+//   h[i] -= (e[i + 1] - e[i])*dt/(dx*mu)
+//
+// with loss = sigma*dt/(2*epsilon) and decay = (1 - loss)/(1 + loss).
+//
+// Layered structures are piecewise constant, so instead of coefficient arrays
+// over the whole grid (three more streams in a memory bound update) the map
+// keeps the sorted segments of nodes that share their coefficients, and each
+// segment is updated by the vectorized kernels with constant coefficients.
+// Only the nodes of graded regions, whose material varies from node to node,
+// have their own coefficients.
+
+#include <cstddef>        // std::size_t
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "number_types.h"
+#include "yee_kernels.h"
+
+namespace fdtd1d {
+
+struct Material {
+  double epsilon_r = 1.0;         // relative permittivity
+  double mu_r = 1.0;              // relative permeability
+  double sigma = 0.0;             // electric conductivity
+};
+
+// the nodes in [x_begin, x_end). The material of a graded region varies
+// linearly from begin at x_begin to end at x_end, otherwise it is begin.
+// Where the regions overlap the last one applies.
+struct MaterialRegion {
+  double x_begin = 0.0;
+  double x_end = 0.0;
+  Material begin;
+  Material end;
+  bool is_graded = false;
+};
+
+// converts a list of comma separated numbers. Returns false if an item is not
+// a number.
+bool ParseNumberList(const std::string& text, std::vector<double>* values);
+
+// converts "X0,X1,EPS_R[,MU_R[,SIGMA]]" to a region, or if is_graded
+// "X0,X1,EPS_R0,EPS_R1[,MU_R0,MU_R1[,SIGMA0,SIGMA1]]" to a graded region.
+// Returns false if the text is not recognized or the material is not valid.
+bool ParseMaterialRegion(const std::string& text, const bool is_graded,
+                         MaterialRegion* region);
+
+template <typename Real>
+class MaterialMap {
+  public:
+  // builds the segments of the nodes [grid_offset, grid_offset + num_local_x)
+  // of a grid starting at x0 with the spacing dx. dt_eps0 is dt/epsilon_0 and
+  // e_coefficient and h_coefficient are the vacuum coefficients
+  // dt/(dx*epsilon_0) and dt/(dx*mu_0). Returns false if a region is not
+  // valid.
+  bool Build(const std::vector<MaterialRegion>& regions,
+             const IntNumber grid_offset, const IntNumber num_local_x,
+             const double x0, const double dx, const double dt_eps0,
+             const double e_coefficient, const double h_coefficient);
+
+  bool is_enabled() { return !regions_.empty(); }
+  std::size_t get_num_regions() { return regions_.size(); }
+  std::size_t get_num_segments() {
+    return e_segments_.size() + h_segments_.size();
+  }
+  std::size_t get_num_graded_nodes() {
+    return e_decay_.size() + h_coefficient_.size();
+  }
+
+  // the E (H) update of the local nodes [ind_begin, ind_end) with the 
+  // differences of the order space_order (2 or 4, see yee_kernels.h). With 
+  // the fourth order the nodes should have two neighbors on each side.
+  void UpdateE(const YeeKernels<Real>& kernels, Real* e, const Real* h,
+               const IntNumber ind_begin, const IntNumber ind_end,
+               const int space_order = 2);
+  void UpdateH(const YeeKernels<Real>& kernels, Real* h, const Real* e,
+               const IntNumber ind_begin, const IntNumber ind_end,
+               const int space_order = 2);
+
+  // the factor 1/(epsilon_r*(1 + loss)) of the contribution of an electric
+  // current at the local E node ind_x. 1 in vacuum.
+  double GetCurrentFactor(const IntNumber ind_x);
+
+  private:
+  // the nodes [begin, end) with the coefficients decay and coefficient, or
+  // with the coefficients at graded_offset of the graded arrays if
+  // graded_offset is not -1
+  struct Segment {
+    IntNumber begin;
+    IntNumber end;
+    Real decay;
+    Real coefficient;
+    IntNumber graded_offset;
+  };
+
+  // the material of the region at x
+  static Material GetMaterial(const MaterialRegion& region, const double x);
+
+  // splits the local nodes [0, num_nodes) of a field whose node i is at
+  // x0_ + (grid_offset_ + i + node_shift)*dx_ into segments. coefficients
+  // gives the decay and the coefficient of a material.
+  template <typename Function>
+  void BuildSegments(const IntNumber num_nodes, const double node_shift,
+                     Function coefficients, std::vector<Segment>* segments,
+                     std::vector<Real>* graded_decay,
+                     std::vector<Real>* graded_coefficient);
+
+  // the local index of the first node at or after x
+  IntNumber GetFirstNode(const double x, const double node_shift,
+                         const IntNumber num_nodes);
+
+  std::vector<MaterialRegion> regions_;
+  IntNumber grid_offset_ = 0;
+  double x0_ = 0.0;
+  double dx_ = 1.0;
+  double dt_eps0_ = 0.0;
+
+  std::vector<Segment> e_segments_;
+  std::vector<Segment> h_segments_;
+  std::vector<Real> e_decay_;           // the graded nodes
+  std::vector<Real> e_coefficient_;
+  std::vector<Real> h_coefficient_;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_MATERIAL_MAP_H_
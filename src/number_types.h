@@ -4,25 +4,60 @@
 #ifndef FDTD_REALTYPE_H_
 #define FDTD_REALTYPE_H_
 
-// Defines floating point data type used in the FDTD algorithm
-// and the integer types that describe indices for large arrays.
+// Defines the integer types that describe indices for large arrays and the
+// floating point precisions available for the FDTD algorithm.
 // Since the size of the arrays may pass INT_MAX, int64_t is provided as the
 // int type.
-// "RealNumber = double" provides higher accuracy, while "RealNumber = float"
-// provides memory efficiency and it can be vectorized more efficiently.
+// The floating point type is a template parameter of the solver (see 
+// FDTD1D<Real, SourceReal>). "double" provides higher accuracy, while "float"
+// provides memory efficiency and it can be vectorized more efficiently. In the
+// mixed precision the fields are stored in float while the time, the grid 
+// parameters and the source contributions are calculated in double.
 
 #include <cstdint>    // std::int64_t
+#include <string>     // std::string
 
 
 namespace fdtd1d {
 
-using RealNumber = double;
 using IntNumber = std::int64_t;
 
+enum class Precision {
+  kDouble = 1,      // FDTD1D<double, double>
+  kFloat = 2,       // FDTD1D<float, float>
+  kMixed = 3,       // FDTD1D<float, double>
+};
+
+// converts "double", "float" and "mixed" to the corresponding Precision. 
+// Returns false if the name is not recognized.
+inline bool ParsePrecision(const std::string& name, Precision* precision) {
+  if (name == "double") {
+    *precision = Precision::kDouble;
+  } else if (name == "float") {
+    *precision = Precision::kFloat;
+  } else if (name == "mixed") {
+    *precision = Precision::kMixed;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char* GetPrecisionName(const Precision precision) {
+  switch (precision) {
+    case Precision::kDouble:
+      return "double";
+    case Precision::kFloat:
+      return "float";
+    case Precision::kMixed:
+      return "mixed";
+  }
+  return "unknown";
+}
+
 }  // namespace fdtd1d
 
 #endif  // FDTD_REALTYPE_H_
 
 
 
-
@@ -6,22 +6,28 @@
 
 #include <cmath>        // sqrt
 
-#include "number_types.h"
-
 namespace fdtd1d {
 
+template <typename Real>
 struct PhysicalConstants {
   // electric permittivity of vacuum (normalized units)
-  static constexpr RealNumber epsilon_0 = static_cast<RealNumber>(1.0);
+  static constexpr Real epsilon_0 = static_cast<Real>(1.0);
   
   // magnetic permeability of vacuum (normalized units)
-  static constexpr RealNumber mu_0 = static_cast<RealNumber>(1.0);
+  static constexpr Real mu_0 = static_cast<Real>(1.0);
   
   // the velocity of light in vacuum (normalized units)
-  static constexpr RealNumber c = 
-    static_cast<RealNumber>(1.0 / sqrt(epsilon_0*mu_0));
+  static constexpr Real c = 
+    static_cast<Real>(1.0 / sqrt(epsilon_0*mu_0));
 };
 
+template <typename Real>
+constexpr Real PhysicalConstants<Real>::epsilon_0;
+template <typename Real>
+constexpr Real PhysicalConstants<Real>::mu_0;
+template <typename Real>
+constexpr Real PhysicalConstants<Real>::c;
+
 }  // namespace fdtd1d
 
 #endif  // FDTD_CONSTANTS_H_
@@ -0,0 +1,214 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "subgrid.h"
+
+#include <algorithm>      // std::min, std::max, std::fill
+#include <cmath>          // std::lround
+#include <cstring>        // std::memcpy
+
+#include "physical_constants.h"
+
+namespace fdtd1d {
+
+bool ParseSubgridRegion(const std::string& text, SubgridRegion* region) {
+  std::vector<double> values;
+  if (!ParseNumberList(text, &values) || values.size() != 3) {
+    return false;
+  }
+  SubgridRegion parsed;
+  parsed.x_begin = values[0];
+  parsed.x_end = values[1];
+  parsed.ratio = static_cast<int>(values[2]);
+  if (static_cast<double>(parsed.ratio) != values[2] || parsed.ratio < 1 ||
+      parsed.x_end <= parsed.x_begin) {
+    return false;
+  }
+  *region = parsed;
+  return true;
+}
+
+template <typename Real, typename SourceReal>
+bool Subgrid<Real, SourceReal>::Initialize(
+    const IntNumber begin, const IntNumber end, const int ratio,
+    const double x_begin, const double dx, const double dt,
+    const std::vector<MaterialRegion>& materials,
+    const std::vector<DispersiveRegion>& dispersive_media) {
+  using Constants = PhysicalConstants<double>;
+  begin_ = begin;
+  end_ = end;
+  ratio_ = ratio;
+  num_cells_ = (end - begin)*ratio;
+  x_begin_ = x_begin;
+  dx_ = dx / ratio;
+  dt_ = dt;
+  const double fine_dt = dt / ratio;
+  source_coefficient_ = fine_dt / (dx_*Constants::epsilon_0);
+  e_coefficient_ = static_cast<Real>(source_coefficient_);
+  h_coefficient_ = static_cast<Real>(fine_dt / (dx_*Constants::mu_0));
+  restriction_weight_ = static_cast<Real>(1.0 / (ratio*ratio));
+  e_.assign(num_cells_ + 1, Real(0));
+  h_.assign(num_cells_, Real(0));
+  sources_.clear();
+  return materials_.Build(materials, 0, num_cells_ + 1, x_begin_, dx_,
+                          fine_dt / Constants::epsilon_0, source_coefficient_,
+                          fine_dt / (dx_*Constants::mu_0)) &&
+         dispersion_.Build(dispersive_media, 0, num_cells_ + 1, x_begin_, dx_,
+                           fine_dt, Constants::c*fine_dt / dx_,
+                           source_coefficient_);
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::ClearSources() {
+  sources_.clear();
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::AddPointSource(
+    PointSource<SourceReal>* source, const IntNumber ind_t_begin,
+    const IntNumber ind_t_end) {
+  double position = static_cast<double>(source->get_position());
+  IntNumber index_x = static_cast<IntNumber>(
+      std::lround((position - x_begin_) / dx_));
+  if (index_x <= 0 || index_x >= num_cells_) {
+    return;
+  }
+  double factor = 1.0;
+  if (!dispersion_.GetCurrentFactor(index_x, &factor) &&
+      materials_.is_enabled()) {
+    factor = materials_.GetCurrentFactor(index_x);
+  }
+  sources_.push_back({index_x, ind_t_begin, ind_t_end,
+                      static_cast<SourceReal>(source_coefficient_*factor),
+                      source});
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::Advance(const YeeKernels<Real>& kernels,
+                                        const Real* e, 
+                                        const IntNumber ind_t) {
+  Real* fine_e = e_.data();
+  // the boundary nodes hold the coarse nodes of the previous time step
+  const Real e_begin_old = fine_e[0];
+  const Real e_end_old = fine_e[num_cells_];
+  const Real e_begin_new = e[begin_];
+  const Real e_end_new = e[end_];
+  for (int m = 0; m < ratio_; ++m) {
+    UpdateE(kernels, 1, num_cells_);
+    const SourceReal t = static_cast<SourceReal>(
+        (static_cast<double>(ind_t) + static_cast<double>(m) / ratio_)*dt_);
+    for (const FineSource& source : sources_) {
+      if (ind_t >= source.ind_t_begin && ind_t < source.ind_t_end) {
+        fine_e[source.index_x] = static_cast<Real>(
+            fine_e[source.index_x] -
+            source.source->GetCurrentValue(t)*source.dt_dx_eps);
+      }
+    }
+    // the boundary nodes at the end of the sub-step, exactly the new coarse
+    // nodes after the last one
+    const Real w = static_cast<Real>(m + 1) / static_cast<Real>(ratio_);
+    fine_e[0] = e_begin_old*(1 - w) + e_begin_new*w;
+    fine_e[num_cells_] = e_end_old*(1 - w) + e_end_new*w;
+    UpdateH(kernels, 0, num_cells_);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::Restrict(Real* e) {
+  const Real* fine_e = e_.data();
+  // full weighting: the fine nodes of the two cells of the coarse node with
+  // the weights (ratio - |j|)/ratio^2
+  for (IntNumber i = begin_ + 1; i < end_; ++i) {
+    const Real* center = fine_e + (i - begin_)*ratio_;
+    Real value = center[0]*static_cast<Real>(ratio_);
+    for (int j = 1; j < ratio_; ++j) {
+      value += (center[-j] + center[j])*static_cast<Real>(ratio_ - j);
+    }
+    e[i] = value*restriction_weight_;
+  }
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::UpdateE(const YeeKernels<Real>& kernels,
+                                        const IntNumber ind_begin,
+                                        const IntNumber ind_end) {
+  // as FDTD1D::UpdateInteriorENodes
+  IntNumber i = ind_begin;
+  for (const auto& range : dispersion_.get_ranges()) {
+    if (range.second <= i) {
+      continue;
+    }
+    if (range.first >= ind_end) {
+      break;
+    }
+    if (i < range.first) {
+      UpdateNonDispersiveE(kernels, i, range.first);
+    }
+    IntNumber end = std::min(ind_end, range.second);
+    dispersion_.UpdateE(e_.data(), h_.data(), std::max(i, range.first), end);
+    i = end;
+  }
+  if (i < ind_end) {
+    UpdateNonDispersiveE(kernels, i, ind_end);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::UpdateNonDispersiveE(
+    const YeeKernels<Real>& kernels, const IntNumber ind_begin,
+    const IntNumber ind_end) {
+  if (materials_.is_enabled()) {
+    materials_.UpdateE(kernels, e_.data(), h_.data(), ind_begin, ind_end);
+  } else {
+    kernels.update_e(e_.data(), h_.data(), ind_begin, ind_end, 1,
+                     e_coefficient_);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::UpdateH(const YeeKernels<Real>& kernels,
+                                        const IntNumber ind_begin,
+                                        const IntNumber ind_end) {
+  if (materials_.is_enabled()) {
+    materials_.UpdateH(kernels, h_.data(), e_.data(), ind_begin, ind_end);
+  } else {
+    kernels.update_h(h_.data(), e_.data(), ind_begin, ind_end, 1,
+                     h_coefficient_);
+  }
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::Reset() {
+  std::fill(e_.begin(), e_.end(), Real(0));
+  std::fill(h_.begin(), h_.end(), Real(0));
+  dispersion_.Reset();
+}
+
+template <typename Real, typename SourceReal>
+std::size_t Subgrid<Real, SourceReal>::get_state_size() {
+  return (e_.size() + h_.size())*sizeof(Real) + dispersion_.get_state_size();
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::SaveState(char* data) {
+  std::memcpy(data, e_.data(), e_.size()*sizeof(Real));
+  data += e_.size()*sizeof(Real);
+  std::memcpy(data, h_.data(), h_.size()*sizeof(Real));
+  data += h_.size()*sizeof(Real);
+  dispersion_.SaveState(data);
+}
+
+template <typename Real, typename SourceReal>
+void Subgrid<Real, SourceReal>::LoadState(const char* data) {
+  std::memcpy(e_.data(), data, e_.size()*sizeof(Real));
+  data += e_.size()*sizeof(Real);
+  std::memcpy(h_.data(), data, h_.size()*sizeof(Real));
+  data += h_.size()*sizeof(Real);
+  dispersion_.LoadState(data);
+}
+
+template class Subgrid<double, double>;
+template class Subgrid<float, float>;
+template class Subgrid<float, double>;
+
+}  // namespace fdtd1d
@@ -0,0 +1,142 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_SUBGRID_H_
+#define FDTD_SUBGRID_H_
+
+// Local refinement in space and time. A subgrid replaces the coarse cells
+// between the coarse E nodes begin and end by ratio times more cells of
+// dx/ratio, advanced by ratio sub-steps of dt/ratio per coarse time step (the
+// Courant number of the fine grid is the one of the coarse grid). The two
+// grids overlap by one coarse cell at each end:
+//
+//   coarse E     begin      begin+1                   end-1       end
+//   fine E         0    ...   ratio   ...  ...  n-ratio   ...       n
+//                  ^ from the coarse grid      restricted on the coarse ^
+//
+// After the E update of the coarse grid at the time step n, the fine grid
+// is advanced from n to n + 1 with its boundary E nodes interpolated
+// linearly in time between the coarse E nodes begin and end at n and n + 1
+// (Advance). Then the coarse E nodes (begin, end) are replaced (Restrict)
+// by the weighted average of the fine E nodes of their two cells (full
+// weighting), and the coarse H update of the time step uses them: the coarse
+// H nodes next to begin and end see the fine solution. The coarse grid keeps
+// updating the whole domain with its kernels, the few coarse nodes under the
+// subgrid being overwritten.
+//
+// Copying the coinciding fine nodes instead of averaging them makes the 
+// coupling weakly unstable, the energy doubling in about 1e5 time steps. 
+// The averaging damps the shortest fine wavelengths, which the coarse grid 
+// can not carry anyway, and keeps the energy bounded over long runs. A well
+// resolved pulse is reflected by the interfaces at about 3e-3 of its 
+// amplitude and the transmitted pulse is off by about 7e-3.
+//
+// The materials and the dispersive media covering a subgrid are rebuilt at
+// the fine resolution, and the point sources inside of it are applied to
+// the fine grid at each sub-step.
+
+#include <cstddef>        // std::size_t
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "dispersive_media.h"
+#include "em_source.h"
+#include "material_map.h"
+#include "number_types.h"
+#include "yee_kernels.h"
+
+namespace fdtd1d {
+
+// the coarse cells from the E node nearest to x_begin to the E node nearest
+// to x_end are refined by the integer ratio
+struct SubgridRegion {
+  double x_begin = 0.0;
+  double x_end = 0.0;
+  int ratio = 1;
+};
+
+// converts "X0,X1,RATIO" to a subgrid region. Returns false if the text is
+// not recognized or the region is not valid.
+bool ParseSubgridRegion(const std::string& text, SubgridRegion* region);
+
+template <typename Real, typename SourceReal>
+class Subgrid {
+  public:
+  // sets up the fine grid between the local coarse E nodes begin (at
+  // x_begin) and end of a coarse grid with the spacing dx and the time step
+  // dt, and the media of materials and dispersive_media at the fine
+  // resolution. Returns false if the media are not valid.
+  bool Initialize(const IntNumber begin, const IntNumber end, const int ratio,
+                  const double x_begin, const double dx, const double dt,
+                  const std::vector<MaterialRegion>& materials,
+                  const std::vector<DispersiveRegion>& dispersive_media);
+
+  IntNumber get_begin() { return begin_; }
+  IntNumber get_end() { return end_; }
+  int get_ratio() { return ratio_; }
+  IntNumber get_num_fine_nodes() { return num_cells_ + 1; }
+
+  // the point sources at the coarse time steps [ind_t_begin, ind_t_end),
+  // applied to the fine E node nearest to their position
+  void ClearSources();
+  void AddPointSource(PointSource<SourceReal>* source,
+                      const IntNumber ind_t_begin, const IntNumber ind_t_end);
+
+  // advances the fine grid over the coarse time step ind_t, after the
+  // coarse E update of e. Only reads the coarse E nodes begin and end, so 
+  // that the subgrids can be advanced by different threads.
+  void Advance(const YeeKernels<Real>& kernels, const Real* e,
+               const IntNumber ind_t);
+  // copies the fine grid on the coarse E nodes (begin, end) of e
+  void Restrict(Real* e);
+
+  // zeroes the fine fields
+  void Reset();
+
+  // the fine fields and the auxiliary fields of their media, saved by the
+  // checkpoints
+  std::size_t get_state_size();   // bytes
+  void SaveState(char* data);
+  void LoadState(const char* data);
+
+  private:
+  struct FineSource {
+    IntNumber index_x;            // fine E node
+    IntNumber ind_t_begin;        // coarse time steps
+    IntNumber ind_t_end;
+    SourceReal dt_dx_eps;
+    PointSource<SourceReal>* source;
+  };
+
+  // the E (H) update of the fine nodes [ind_begin, ind_end)
+  void UpdateE(const YeeKernels<Real>& kernels, const IntNumber ind_begin,
+               const IntNumber ind_end);
+  void UpdateNonDispersiveE(const YeeKernels<Real>& kernels,
+                            const IntNumber ind_begin,
+                            const IntNumber ind_end);
+  void UpdateH(const YeeKernels<Real>& kernels, const IntNumber ind_begin,
+               const IntNumber ind_end);
+
+  IntNumber begin_ = 0;           // coarse E nodes
+  IntNumber end_ = 0;
+  int ratio_ = 1;
+  IntNumber num_cells_ = 0;       // fine E nodes [0, num_cells_]
+  double x_begin_ = 0.0;
+  double dx_ = 1.0;               // fine
+  double dt_ = 1.0;               // coarse
+  Real e_coefficient_ = 0;        // dt/(dx*epsilon_0) = fine dt/dx
+  Real h_coefficient_ = 0;
+  double source_coefficient_ = 0.0;
+  Real restriction_weight_ = 1;   // 1/ratio^2
+
+  std::vector<Real> e_;
+  std::vector<Real> h_;
+  MaterialMap<Real> materials_;
+  DispersiveMedia<Real> dispersion_;
+  std::vector<FineSource> sources_;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_SUBGRID_H_
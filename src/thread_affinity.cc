@@ -0,0 +1,234 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "thread_affinity.h"
+
+#include <pthread.h>      // pthread_setaffinity_np
+#include <sched.h>        // sched_getaffinity, cpu_set_t
+#include <dirent.h>       // opendir, readdir
+
+#include <algorithm>      // std::sort, std::max
+#include <cstdlib>        // std::strtol
+#include <cstring>        // std::strncmp
+#include <fstream>        // std::ifstream
+#include <tuple>          // std::tie
+
+namespace fdtd1d {
+
+namespace {
+
+// the location of a logical CPU in the machine
+struct CpuLocation {
+  int cpu;
+  int node;         // NUMA node, or the socket if the nodes are unknown
+  int core;         // physical core inside the socket
+  int smt_rank;     // rank of the CPU among the hyperthreads of its core
+};
+
+int ReadIntegerFile(const std::string& file_name, const int default_value) {
+  std::ifstream ifs(file_name);
+  int value;
+  if (ifs >> value) {
+    return value;
+  }
+  return default_value;
+}
+
+// returns the NUMA node of cpu from its nodeN entry in sysfs, or -1
+int FindNumaNode(const int cpu) {
+  std::string dir_name = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+  DIR* dir = opendir(dir_name.c_str());
+  if (dir == nullptr) {
+    return -1;
+  }
+  int node = -1;
+  while (dirent* entry = readdir(dir)) {
+    if (std::strncmp(entry->d_name, "node", 4) == 0 &&
+        entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+      node = std::atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+// the CPUs of the affinity mask of the process with their locations
+std::vector<CpuLocation> GetAvailableCpus() {
+  std::vector<CpuLocation> cpus;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+    return cpus;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &mask)) {
+      continue;
+    }
+    std::string topology = "/sys/devices/system/cpu/cpu" +
+                           std::to_string(cpu) + "/topology/";
+    int package = ReadIntegerFile(topology + "physical_package_id", 0);
+    int node = FindNumaNode(cpu);
+    CpuLocation location;
+    location.cpu = cpu;
+    location.node = (node >= 0) ? node : package;
+    location.core = ReadIntegerFile(topology + "core_id", cpu);
+    // core ids are only unique inside a package
+    location.core += package << 16;
+    location.smt_rank = 0;
+    cpus.push_back(location);
+  }
+  for (auto& a : cpus) {
+    for (auto& b : cpus) {
+      if (b.cpu < a.cpu && b.node == a.node && b.core == a.core) {
+        ++a.smt_rank;
+      }
+    }
+  }
+  return cpus;
+}
+
+// parses a list of CPUs such as "0,2,4-7"
+bool ParseCpuList(const std::string& list, std::vector<int>* cpus) {
+  cpus->clear();
+  const char* p = list.c_str();
+  while (*p != '\0') {
+    char* end;
+    long first = std::strtol(p, &end, 10);
+    if (end == p || first < 0) {
+      return false;
+    }
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      last = std::strtol(p, &end, 10);
+      if (end == p || last < first) {
+        return false;
+      }
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') {
+      ++p;
+    } else if (*p != '\0') {
+      return false;
+    }
+  }
+  return !cpus->empty();
+}
+
+}  // namespace
+
+bool ParseAffinityPolicy(const std::string& name, AffinityPolicy* policy,
+                         std::vector<int>* cpus) {
+  if (name == "none") {
+    *policy = AffinityPolicy::kNone;
+  } else if (name == "compact") {
+    *policy = AffinityPolicy::kCompact;
+  } else if (name == "scatter") {
+    *policy = AffinityPolicy::kScatter;
+  } else if (ParseCpuList(name, cpus)) {
+    *policy = AffinityPolicy::kExplicit;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetAffinityPolicyName(const AffinityPolicy policy) {
+  switch (policy) {
+    case AffinityPolicy::kNone:
+      return "none";
+    case AffinityPolicy::kCompact:
+      return "compact";
+    case AffinityPolicy::kScatter:
+      return "scatter";
+    case AffinityPolicy::kExplicit:
+      return "explicit";
+  }
+  return "unknown";
+}
+
+std::vector<int> GetThreadCpus(const AffinityPolicy policy,
+                               const int num_threads,
+                               const std::vector<int>& explicit_cpus) {
+  std::vector<int> thread_cpus;
+  if (policy == AffinityPolicy::kNone || num_threads <= 0) {
+    return thread_cpus;
+  }
+  if (policy == AffinityPolicy::kExplicit) {
+    for (int i = 0; i < num_threads && !explicit_cpus.empty(); ++i) {
+      thread_cpus.push_back(explicit_cpus[i % explicit_cpus.size()]);
+    }
+    return thread_cpus;
+  }
+
+  std::vector<CpuLocation> cpus = GetAvailableCpus();
+  if (cpus.empty()) {
+    return thread_cpus;
+  }
+  std::vector<int> order;
+  if (policy == AffinityPolicy::kCompact) {
+    std::sort(cpus.begin(), cpus.end(),
+              [](const CpuLocation& a, const CpuLocation& b) {
+      return std::tie(a.node, a.core, a.smt_rank) <
+             std::tie(b.node, b.core, b.smt_rank);
+    });
+    for (auto& location : cpus) {
+      order.push_back(location.cpu);
+    }
+  } else {
+    // inside each node the first hyperthread of every core comes first, then
+    // the nodes take turns
+    std::sort(cpus.begin(), cpus.end(),
+              [](const CpuLocation& a, const CpuLocation& b) {
+      return std::tie(a.node, a.smt_rank, a.core) <
+             std::tie(b.node, b.smt_rank, b.core);
+    });
+    std::vector<std::vector<int>> node_cpus;
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+      if (i == 0 || cpus[i].node != cpus[i - 1].node) {
+        node_cpus.emplace_back();
+      }
+      node_cpus.back().push_back(cpus[i].cpu);
+    }
+    std::size_t max_node_size = 0;
+    for (auto& node : node_cpus) {
+      max_node_size = std::max(max_node_size, node.size());
+    }
+    for (std::size_t k = 0; k < max_node_size; ++k) {
+      for (auto& node : node_cpus) {
+        if (k < node.size()) {
+          order.push_back(node[k]);
+        }
+      }
+    }
+  }
+
+  // the chunks of neighboring threads are neighbors in memory, so with more
+  // threads than CPUs consecutive threads share a CPU
+  const std::size_t num_cpus = order.size();
+  for (int i = 0; i < num_threads; ++i) {
+    std::size_t k = static_cast<std::size_t>(i);
+    if (static_cast<std::size_t>(num_threads) > num_cpus) {
+      k = k * num_cpus / num_threads;
+    }
+    thread_cpus.push_back(order[k]);
+  }
+  return thread_cpus;
+}
+
+bool PinCurrentThreadToCpu(const int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cpu, &mask);
+  return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+}
+
+}  // namespace fdtd1d
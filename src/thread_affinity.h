@@ -0,0 +1,56 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_THREAD_AFFINITY_H_
+#define FDTD_THREAD_AFFINITY_H_
+
+// Pins the worker threads to logical CPUs, so that a thread keeps running next
+// to the memory it touched first (see FDTD1D::SetNumaFirstTouch) and does not
+// migrate between the cores or the sockets during the simulation.
+//
+// Affinity policies:
+// kNone     ---> the threads are not pinned (the operating system decides)
+// kCompact  ---> thread i runs on the i-th CPU when the CPUs are ordered by
+//                socket, then by core. Neighboring chunks share a socket and
+//                the hyperthreads of a core are filled before the next core.
+// kScatter  ---> the threads are spread round robin over the sockets (or the
+//                NUMA nodes), and over the physical cores of each socket
+//                before their hyperthreads, which gives every thread as much
+//                memory bandwidth as possible.
+// kExplicit ---> thread i runs on cpus[i % cpus.size()] of a user given list
+//
+// Only the CPUs of the affinity mask of the process are used, e.g. those
+// given by taskset or numactl.
+
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+namespace fdtd1d {
+
+enum class AffinityPolicy {
+  kNone = 0,
+  kCompact = 1,
+  kScatter = 2,
+  kExplicit = 3,
+};
+
+// converts "none", "compact" and "scatter" to the corresponding policy. A list
+// of CPUs such as "0,2,4-7" gives kExplicit and is stored in cpus. Returns
+// false if the name is not recognized.
+bool ParseAffinityPolicy(const std::string& name, AffinityPolicy* policy,
+                         std::vector<int>* cpus);
+const char* GetAffinityPolicyName(const AffinityPolicy policy);
+
+// returns the CPU of each of the num_threads threads, or an empty vector for
+// AffinityPolicy::kNone. explicit_cpus is only used by kExplicit.
+std::vector<int> GetThreadCpus(const AffinityPolicy policy,
+                               const int num_threads,
+                               const std::vector<int>& explicit_cpus);
+
+// pins the calling thread to cpu. Returns false if it is not possible.
+bool PinCurrentThreadToCpu(const int cpu);
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_THREAD_AFFINITY_H_
@@ -0,0 +1,144 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "thread_barrier.h"
+
+#include <thread>         // std::this_thread::yield
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>    // _mm_pause
+#endif
+
+namespace fdtd1d {
+
+namespace {
+
+// tells the processor that the thread is in a spin loop
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+}  // namespace
+
+bool ParseBarrierMode(const std::string& name, BarrierMode* mode) {
+  if (name == "spin") {
+    *mode = BarrierMode::kSpin;
+  } else if (name == "hybrid") {
+    *mode = BarrierMode::kHybrid;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetBarrierModeName(const BarrierMode mode) {
+  switch (mode) {
+    case BarrierMode::kSpin:
+      return "spin";
+    case BarrierMode::kHybrid:
+      return "hybrid";
+  }
+  return "unknown";
+}
+
+ThreadBarrier::ThreadBarrier()
+    : num_arrived_(0), sense_(false), num_sleeping_(0) {
+  Reset(1, BarrierMode::kHybrid);
+}
+
+void ThreadBarrier::Reset(const int num_threads, const BarrierMode mode) {
+  num_threads_ = num_threads;
+  mode_ = mode;
+  num_arrived_ = 0;
+  num_sleeping_ = 0;
+  sense_ = false;
+  local_sense_ = AllocateAlignedObjectArray<PaddedFlag>(num_threads);
+
+  // when the threads outnumber the hardware threads a spinning thread only
+  // delays the threads it is waiting for, so the spin phase is skipped
+  int num_hardware_threads = std::thread::hardware_concurrency();
+  oversubscribed_ = num_hardware_threads > 0 && 
+                    num_threads > num_hardware_threads;
+}
+
+void ThreadBarrier::SetSpinAndYieldCounts(const int spin_count,
+                                          const int yield_count) {
+  spin_count_ = spin_count;
+  yield_count_ = yield_count;
+}
+
+BarrierMode ThreadBarrier::get_mode() {
+  return mode_;
+}
+
+int ThreadBarrier::get_num_threads() {
+  return num_threads_;
+}
+
+void ThreadBarrier::Wait(const int thread_index) {
+  if (Arrive()) {
+    Release(thread_index);
+  } else {
+    WaitForRelease(thread_index);
+  }
+}
+
+bool ThreadBarrier::Arrive() {
+  return num_arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+         num_threads_;
+}
+
+void ThreadBarrier::Release(const int thread_index) {
+  bool& local_sense = local_sense_[thread_index].value;
+  local_sense = !local_sense;
+
+  // the counter is reset before the sense is flipped, so that the released
+  // threads can arrive at the next barrier right away
+  num_arrived_.store(0, std::memory_order_relaxed);
+  sense_.store(local_sense, std::memory_order_seq_cst);
+
+  // wake up the sleeping threads. The mutex guarantees that a thread that
+  // has checked the sense but has not started waiting yet is not missed.
+  if (num_sleeping_.load(std::memory_order_seq_cst) > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    condition_.notify_all();
+  }
+}
+
+void ThreadBarrier::WaitForRelease(const int thread_index) {
+  bool& local_sense = local_sense_[thread_index].value;
+  local_sense = !local_sense;
+
+  if (mode_ == BarrierMode::kSpin) {
+    while (sense_.load(std::memory_order_acquire) != local_sense) {
+      CpuRelax();
+    }
+    return;
+  }
+
+  // kHybrid : spin ---> yield ---> sleep
+  int spin_count = oversubscribed_ ? 0 : spin_count_;
+  for (int i = 0; i < spin_count; ++i) {
+    if (sense_.load(std::memory_order_acquire) == local_sense) {
+      return;
+    }
+    CpuRelax();
+  }
+  for (int i = 0; i < yield_count_; ++i) {
+    if (sense_.load(std::memory_order_acquire) == local_sense) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_sleeping_.fetch_add(1, std::memory_order_seq_cst);
+  while (sense_.load(std::memory_order_seq_cst) != local_sense) {
+    condition_.wait(lock);
+  }
+  num_sleeping_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+}  // namespace fdtd1d
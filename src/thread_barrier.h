@@ -0,0 +1,120 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_THREAD_BARRIER_H_
+#define FDTD_THREAD_BARRIER_H_
+
+// Defines the synchronization point that the worker threads pass twice per
+// time step (after the E update and after the H update).
+//
+// The barrier is sense reversing: each thread keeps a local sense flag which is
+// flipped at every barrier, and the last arriving thread releases the others
+// by flipping the global sense. Therefore the barrier can be reused back to
+// back without any reset.
+//
+// Two waiting strategies are provided:
+// kSpin   ---> the waiting threads only spin on the global sense. This gives
+//              the lowest latency when each thread has a dedicated core, but
+//              it burns the core and collapses when the threads outnumber the
+//              cores.
+// kHybrid ---> the waiting threads spin for a short while, then yield their
+//              time slice and finally go to sleep on a condition variable.
+
+#include <atomic>               // std::atomic
+#include <mutex>                // std::mutex
+#include <condition_variable>   // std::condition_variable
+#include <string>               // std::string
+
+#include "aligned_memory.h"
+
+namespace fdtd1d {
+
+enum class BarrierMode {
+  kSpin = 1,
+  kHybrid = 2,
+};
+
+// converts "spin" and "hybrid" to the corresponding BarrierMode. Returns false
+// if the name is not recognized.
+bool ParseBarrierMode(const std::string& name, BarrierMode* mode);
+const char* GetBarrierModeName(const BarrierMode mode);
+
+// the size of the cache line used to pad the shared counters and flags so that
+// they do not share a cache line with each other (false sharing)
+constexpr int kCacheLineSize = 64;
+
+class ThreadBarrier {
+  public:
+  ThreadBarrier();
+
+  // prepares the barrier for num_threads threads. It should not be called
+  // while any thread is waiting at the barrier.
+  void Reset(const int num_threads, const BarrierMode mode);
+
+  // the number of spin iterations and yields before a waiting thread goes to
+  // sleep (only used in kHybrid mode). The spin iterations are skipped if the
+  // threads outnumber the hardware threads.
+  void SetSpinAndYieldCounts(const int spin_count, const int yield_count);
+
+  BarrierMode get_mode();
+  int get_num_threads();
+
+  // blocks until all the threads have called Wait().
+  void Wait(const int thread_index);
+
+  // similar to Wait(thread_index), except that the last arriving thread calls
+  // completion() before the other threads are released. completion() is
+  // therefore executed by exactly one thread while all the other threads are
+  // waiting.
+  template <typename Function>
+  void Wait(const int thread_index, Function&& completion);
+
+  private:
+  // returns true if this thread is the last one to arrive
+  bool Arrive();
+  void Release(const int thread_index);
+  void WaitForRelease(const int thread_index);
+
+  // flags and counters each occupy a full cache line
+  struct alignas(kCacheLineSize) PaddedFlag {
+    bool value = false;
+  };
+
+  // the number of threads that have arrived at the barrier
+  alignas(kCacheLineSize) std::atomic<int> num_arrived_;
+
+  // the global sense, flipped by the last arriving thread
+  alignas(kCacheLineSize) std::atomic<bool> sense_;
+
+  // the number of threads sleeping on the condition variable
+  alignas(kCacheLineSize) std::atomic<int> num_sleeping_;
+
+  // the local sense of each thread. Only accessed by its own thread.
+  AlignedObjectArray<PaddedFlag> local_sense_ = nullptr;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+
+  int num_threads_ = 1;
+  BarrierMode mode_ = BarrierMode::kHybrid;
+  int spin_count_ = 4000;
+  int yield_count_ = 64;
+
+  // true if there are more threads than hardware threads
+  bool oversubscribed_ = false;
+};
+
+template <typename Function>
+void ThreadBarrier::Wait(const int thread_index, Function&& completion) {
+  if (Arrive()) {
+    completion();
+    Release(thread_index);
+  } else {
+    WaitForRelease(thread_index);
+  }
+}
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_THREAD_BARRIER_H_
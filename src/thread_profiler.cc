@@ -0,0 +1,441 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "thread_profiler.h"
+
+#include <linux/perf_event.h>   // perf_event_attr, PERF_COUNT_HW_*
+#include <sys/ioctl.h>          // ioctl
+#include <sys/syscall.h>        // SYS_perf_event_open
+#include <unistd.h>             // syscall, read, close
+
+#include <algorithm>            // std::max
+#include <cstring>              // std::memset
+#include <fstream>              // std::ofstream
+#include <iostream>             // std::cout
+#include <iomanip>              // std::setprecision
+
+namespace fdtd1d {
+
+namespace {
+
+// the time stepping phases, without the setup before the first time step
+bool IsSteppingPhase(const ProfilePhase phase) {
+  return phase != ProfilePhase::kSetup && phase != ProfilePhase::kSetupWait;
+}
+
+double ToSeconds(const std::int64_t nanoseconds) {
+  return nanoseconds * 1.0e-9;
+}
+
+// opens a counter of the calling thread in user space. Returns -1 if the
+// counter is not available (e.g. no permission or no PMU in a VM).
+int OpenHardwareCounter(const HardwareCounter counter) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  switch (counter) {
+    case HardwareCounter::kCycles:
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case HardwareCounter::kInstructions:
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case HardwareCounter::kCacheReferences:
+      attr.config = PERF_COUNT_HW_CACHE_REFERENCES;
+      break;
+    case HardwareCounter::kCacheMisses:
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    default:
+      return -1;
+  }
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+}  // namespace
+
+const char* GetProfilePhaseName(const ProfilePhase phase) {
+  switch (phase) {
+    case ProfilePhase::kSetup:
+      return "setup";
+    case ProfilePhase::kEUpdate:
+      return "e-update";
+    case ProfilePhase::kSources:
+      return "sources";
+    case ProfilePhase::kHUpdate:
+      return "h-update";
+    case ProfilePhase::kTileUpdate:
+      return "tile-update";
+    case ProfilePhase::kOutput:
+      return "output";
+    case ProfilePhase::kSubgridUpdate:
+      return "subgrid-update";
+    case ProfilePhase::kSetupWait:
+      return "setup-wait";
+    case ProfilePhase::kEWait:
+      return "e-wait";
+    case ProfilePhase::kHWait:
+      return "h-wait";
+    case ProfilePhase::kTileWait:
+      return "tile-wait";
+    case ProfilePhase::kBlockWait:
+      return "block-wait";
+    case ProfilePhase::kHaloWait:
+      return "halo-wait";
+    case ProfilePhase::kTaskWait:
+      return "task-wait";
+    case ProfilePhase::kSubgridWait:
+      return "subgrid-wait";
+    case ProfilePhase::kNumPhases:
+      break;
+  }
+  return "unknown";
+}
+
+bool IsWaitPhase(const ProfilePhase phase) {
+  return phase >= ProfilePhase::kSetupWait &&
+         phase < ProfilePhase::kNumPhases;
+}
+
+bool ParseProfileReportFormat(const std::string& name,
+                              ProfileReportFormat* format) {
+  if (name == "json") {
+    *format = ProfileReportFormat::kJSON;
+  } else if (name == "csv") {
+    *format = ProfileReportFormat::kCSV;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetProfileReportFormatName(const ProfileReportFormat format) {
+  switch (format) {
+    case ProfileReportFormat::kJSON:
+      return "json";
+    case ProfileReportFormat::kCSV:
+      return "csv";
+  }
+  return "unknown";
+}
+
+const char* GetHardwareCounterName(const HardwareCounter counter) {
+  switch (counter) {
+    case HardwareCounter::kCycles:
+      return "cycles";
+    case HardwareCounter::kInstructions:
+      return "instructions";
+    case HardwareCounter::kCacheReferences:
+      return "cache-references";
+    case HardwareCounter::kCacheMisses:
+      return "cache-misses";
+    case HardwareCounter::kNumCounters:
+      break;
+  }
+  return "unknown";
+}
+
+ThreadProfiler::ThreadProfiler() {}
+
+ThreadProfiler::~ThreadProfiler() {}
+
+void ThreadProfiler::SetEnabled(const bool enabled,
+                                const bool use_hardware_counters) {
+  enabled_ = enabled;
+  use_hardware_counters_ = enabled && use_hardware_counters;
+}
+
+bool ThreadProfiler::is_enabled() {
+  return enabled_;
+}
+
+void ThreadProfiler::Reset(const int num_threads) {
+  num_threads_ = num_threads;
+  profiles_ = AllocateAlignedObjectArray<ThreadProfile>(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    ThreadProfile& profile = profiles_[i];
+    for (int k = 0; k < kNumProfilePhases; ++k) {
+      profile.phase_time[k] = 0;
+      profile.phase_count[k] = 0;
+    }
+    profile.num_e_nodes = 0;
+    profile.num_h_nodes = 0;
+    for (int k = 0; k < kNumHardwareCounters; ++k) {
+      profile.counter_values[k] = 0;
+      profile.counter_fds[k] = -1;
+    }
+    profile.has_counters = false;
+  }
+}
+
+void ThreadProfiler::StartHardwareCounters(const int thread_index) {
+  if (!use_hardware_counters_) {
+    return;
+  }
+  ThreadProfile& profile = profiles_[thread_index];
+  profile.has_counters = true;
+  for (int k = 0; k < kNumHardwareCounters; ++k) {
+    profile.counter_fds[k] =
+        OpenHardwareCounter(static_cast<HardwareCounter>(k));
+    profile.has_counters = profile.has_counters && profile.counter_fds[k] >= 0;
+  }
+  for (int k = 0; k < kNumHardwareCounters; ++k) {
+    if (profile.counter_fds[k] >= 0) {
+      ioctl(profile.counter_fds[k], PERF_EVENT_IOC_RESET, 0);
+      ioctl(profile.counter_fds[k], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void ThreadProfiler::StopHardwareCounters(const int thread_index) {
+  if (!use_hardware_counters_) {
+    return;
+  }
+  ThreadProfile& profile = profiles_[thread_index];
+  for (int k = 0; k < kNumHardwareCounters; ++k) {
+    int fd = profile.counter_fds[k];
+    if (fd < 0) {
+      continue;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    std::int64_t value = 0;
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+      profile.has_counters = false;
+    }
+    profile.counter_values[k] = value;
+    close(fd);
+    profile.counter_fds[k] = -1;
+  }
+}
+
+ThreadProfiler::Summary ThreadProfiler::Summarize(const ProfileRunInfo& info) {
+  Summary summary;
+  std::memset(&summary, 0, sizeof(summary));
+  summary.has_counters = use_hardware_counters_ && num_threads_ > 0;
+  std::int64_t stepping_time_max = 0;
+  std::int64_t work_time_max = 0;
+  std::int64_t work_time_total = 0;
+  std::int64_t wait_time_total = 0;
+  for (int i = 0; i < num_threads_; ++i) {
+    const ThreadProfile& profile = profiles_[i];
+    std::int64_t work_time = 0;
+    std::int64_t wait_time = 0;
+    for (int k = 0; k < kNumProfilePhases; ++k) {
+      ProfilePhase phase = static_cast<ProfilePhase>(k);
+      if (!IsSteppingPhase(phase)) {
+        continue;
+      }
+      if (IsWaitPhase(phase)) {
+        wait_time += profile.phase_time[k];
+      } else {
+        work_time += profile.phase_time[k];
+      }
+    }
+    stepping_time_max = std::max(stepping_time_max, work_time + wait_time);
+    work_time_max = std::max(work_time_max, work_time);
+    work_time_total += work_time;
+    wait_time_total += wait_time;
+    summary.num_e_nodes += profile.num_e_nodes;
+    summary.num_h_nodes += profile.num_h_nodes;
+    summary.has_counters = summary.has_counters && profile.has_counters;
+    for (int k = 0; k < kNumHardwareCounters; ++k) {
+      summary.counter_totals[k] += profile.counter_values[k];
+    }
+  }
+  if (num_threads_ == 0) {
+    return summary;
+  }
+  summary.stepping_time = ToSeconds(stepping_time_max);
+  summary.work_time_max = ToSeconds(work_time_max);
+  summary.work_time_mean = ToSeconds(work_time_total) / num_threads_;
+  summary.wait_time_mean = ToSeconds(wait_time_total) / num_threads_;
+  if (summary.work_time_mean > 0) {
+    summary.load_imbalance = summary.work_time_max / summary.work_time_mean -
+                             1.0;
+  }
+  if (work_time_total + wait_time_total > 0) {
+    summary.wait_fraction = static_cast<double>(wait_time_total) /
+                            (work_time_total + wait_time_total);
+  }
+  if (summary.stepping_time > 0) {
+    summary.node_updates_per_second = summary.num_e_nodes /
+                                      summary.stepping_time;
+    summary.bandwidth = 3.0 * info.real_size *
+                        (summary.num_e_nodes + summary.num_h_nodes) /
+                        summary.stepping_time;
+  }
+  return summary;
+}
+
+void ThreadProfiler::PrintSummary(const ProfileRunInfo& info) {
+  if (!enabled_) {
+    return;
+  }
+  Summary summary = Summarize(info);
+  std::cout << "\nProfile (seconds per thread): " << std::endl;
+  std::cout << "thread";
+  for (int k = 0; k < kNumProfilePhases; ++k) {
+    std::cout << ", " << GetProfilePhaseName(static_cast<ProfilePhase>(k));
+  }
+  std::cout << std::endl;
+  for (int i = 0; i < num_threads_; ++i) {
+    std::cout << i;
+    for (int k = 0; k < kNumProfilePhases; ++k) {
+      std::cout << ", " << ToSeconds(profiles_[i].phase_time[k]);
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "Time stepping : " << summary.stepping_time << " s" << std::endl;
+  std::cout << "Load imbalance : " << summary.load_imbalance*100 << " %"
+            << std::endl;
+  std::cout << "Waiting : " << summary.wait_fraction*100 << " %" << std::endl;
+  std::cout << "Node updates : " << summary.node_updates_per_second*1.0e-6
+            << " M/s" << std::endl;
+  std::cout << "Bandwidth : " << summary.bandwidth*1.0e-9 << " GB/s"
+            << std::endl;
+  if (use_hardware_counters_ && !summary.has_counters) {
+    std::cout << "Hardware counters : unavailable" << std::endl;
+  } else if (summary.has_counters) {
+    for (int k = 0; k < kNumHardwareCounters; ++k) {
+      std::cout << GetHardwareCounterName(static_cast<HardwareCounter>(k))
+                << " : " << summary.counter_totals[k] << std::endl;
+    }
+  }
+}
+
+bool ThreadProfiler::WriteReport(const std::string& file_name,
+                                 const ProfileReportFormat format,
+                                 const ProfileRunInfo& info) {
+  std::ofstream ofs(file_name);
+  if (!ofs) {
+    std::cout << "Can not open " << file_name << std::endl;
+    return false;
+  }
+  ofs << std::setprecision(9);
+  if (format == ProfileReportFormat::kJSON) {
+    WriteJSONReport(ofs, info);
+  } else {
+    WriteCSVReport(ofs, info);
+  }
+  return static_cast<bool>(ofs);
+}
+
+void ThreadProfiler::WriteJSONReport(std::ostream& os,
+                                     const ProfileRunInfo& info) {
+  Summary summary = Summarize(info);
+  os << "{\n";
+  os << "  \"num_threads\": " << num_threads_ << ",\n";
+  os << "  \"num_x\": " << info.num_x << ",\n";
+  os << "  \"num_t\": " << info.num_t << ",\n";
+  os << "  \"real_size\": " << info.real_size << ",\n";
+  os << "  \"wall_time\": " << info.wall_time << ",\n";
+  os << "  \"summary\": {\n";
+  os << "    \"stepping_time\": " << summary.stepping_time << ",\n";
+  os << "    \"work_time_max\": " << summary.work_time_max << ",\n";
+  os << "    \"work_time_mean\": " << summary.work_time_mean << ",\n";
+  os << "    \"wait_time_mean\": " << summary.wait_time_mean << ",\n";
+  os << "    \"load_imbalance\": " << summary.load_imbalance << ",\n";
+  os << "    \"wait_fraction\": " << summary.wait_fraction << ",\n";
+  os << "    \"num_e_nodes\": " << summary.num_e_nodes << ",\n";
+  os << "    \"num_h_nodes\": " << summary.num_h_nodes << ",\n";
+  os << "    \"node_updates_per_second\": "
+     << summary.node_updates_per_second << ",\n";
+  os << "    \"bandwidth\": " << summary.bandwidth << ",\n";
+  os << "    \"hardware_counters\": ";
+  if (summary.has_counters) {
+    os << "{";
+    for (int k = 0; k < kNumHardwareCounters; ++k) {
+      os << (k > 0 ? ", " : "") << "\""
+         << GetHardwareCounterName(static_cast<HardwareCounter>(k)) << "\": "
+         << summary.counter_totals[k];
+    }
+    os << "}\n";
+  } else {
+    os << "null\n";
+  }
+  os << "  },\n";
+  os << "  \"threads\": [\n";
+  for (int i = 0; i < num_threads_; ++i) {
+    const ThreadProfile& profile = profiles_[i];
+    os << "    {\"thread\": " << i
+       << ", \"num_e_nodes\": " << profile.num_e_nodes
+       << ", \"num_h_nodes\": " << profile.num_h_nodes << ",\n";
+    os << "     \"phases\": {";
+    for (int k = 0; k < kNumProfilePhases; ++k) {
+      os << (k > 0 ? ", " : "") << "\""
+         << GetProfilePhaseName(static_cast<ProfilePhase>(k))
+         << "\": {\"time\": " << ToSeconds(profile.phase_time[k])
+         << ", \"count\": " << profile.phase_count[k] << "}";
+    }
+    os << "},\n";
+    os << "     \"hardware_counters\": ";
+    if (profile.has_counters) {
+      os << "{";
+      for (int k = 0; k < kNumHardwareCounters; ++k) {
+        os << (k > 0 ? ", " : "") << "\""
+           << GetHardwareCounterName(static_cast<HardwareCounter>(k))
+           << "\": " << profile.counter_values[k];
+      }
+      os << "}";
+    } else {
+      os << "null";
+    }
+    os << "}" << (i + 1 < num_threads_ ? "," : "") << "\n";
+  }
+  os << "  ]\n";
+  os << "}\n";
+}
+
+// one line per value: thread, metric, value. The thread is "all" for the
+// values of the summary and the phase times are in seconds.
+void ThreadProfiler::WriteCSVReport(std::ostream& os,
+                                    const ProfileRunInfo& info) {
+  Summary summary = Summarize(info);
+  os << "thread,metric,value\n";
+  os << "all,num_threads," << num_threads_ << "\n";
+  os << "all,num_x," << info.num_x << "\n";
+  os << "all,num_t," << info.num_t << "\n";
+  os << "all,real_size," << info.real_size << "\n";
+  os << "all,wall_time," << info.wall_time << "\n";
+  os << "all,stepping_time," << summary.stepping_time << "\n";
+  os << "all,work_time_max," << summary.work_time_max << "\n";
+  os << "all,work_time_mean," << summary.work_time_mean << "\n";
+  os << "all,wait_time_mean," << summary.wait_time_mean << "\n";
+  os << "all,load_imbalance," << summary.load_imbalance << "\n";
+  os << "all,wait_fraction," << summary.wait_fraction << "\n";
+  os << "all,num_e_nodes," << summary.num_e_nodes << "\n";
+  os << "all,num_h_nodes," << summary.num_h_nodes << "\n";
+  os << "all,node_updates_per_second,"
+     << summary.node_updates_per_second << "\n";
+  os << "all,bandwidth," << summary.bandwidth << "\n";
+  if (summary.has_counters) {
+    for (int k = 0; k < kNumHardwareCounters; ++k) {
+      os << "all," << GetHardwareCounterName(static_cast<HardwareCounter>(k))
+         << "," << summary.counter_totals[k] << "\n";
+    }
+  }
+  for (int i = 0; i < num_threads_; ++i) {
+    const ThreadProfile& profile = profiles_[i];
+    os << i << ",num_e_nodes," << profile.num_e_nodes << "\n";
+    os << i << ",num_h_nodes," << profile.num_h_nodes << "\n";
+    for (int k = 0; k < kNumProfilePhases; ++k) {
+      const char* name = GetProfilePhaseName(static_cast<ProfilePhase>(k));
+      os << i << "," << name << ","
+         << ToSeconds(profile.phase_time[k]) << "\n";
+      os << i << "," << name << "_count," << profile.phase_count[k] << "\n";
+    }
+    if (profile.has_counters) {
+      for (int k = 0; k < kNumHardwareCounters; ++k) {
+        os << i << ","
+           << GetHardwareCounterName(static_cast<HardwareCounter>(k))
+           << "," << profile.counter_values[k] << "\n";
+      }
+    }
+  }
+}
+
+}  // namespace fdtd1d
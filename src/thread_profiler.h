@@ -0,0 +1,181 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_THREAD_PROFILER_H_
+#define FDTD_THREAD_PROFILER_H_
+
+// Records where the worker threads spend their time. Each thread accumulates
+// in its own ThreadProfile the time spent in each phase of the time stepping,
+// the time spent waiting at each synchronization point and the number of E
+// and H nodes it updated. Optionally the hardware counters of each thread
+// (cycles, instructions, cache references and misses) are read with
+// perf_event_open.
+//
+// The solver gets the profile of a thread with get_thread_profile(), which
+// returns nullptr when the profiler is disabled. The instrumentation is only
+// executed behind this null check, so a disabled profiler costs one predicted
+// branch per phase and no clock reads.
+//
+// After the run the profiles are aggregated into a summary with the load
+// imbalance between the threads and the achieved memory bandwidth, printed
+// and optionally written as a JSON or CSV report.
+
+#include <chrono>         // std::chrono::steady_clock
+#include <cstdint>        // std::int64_t
+#include <iosfwd>         // std::ostream
+#include <string>         // std::string
+
+#include "aligned_memory.h"
+#include "number_types.h"
+#include "thread_barrier.h"
+
+namespace fdtd1d {
+
+// the phases of the time stepping. The k*Wait phases are the times spent at
+// the synchronization points (including the barrier completions).
+enum class ProfilePhase {
+  kSetup = 0,         // first touch of the fields and source tabulation
+  kEUpdate = 1,       // E nodes of the per-step engine
+  kSources = 2,       // point sources of the per-step engine
+  kHUpdate = 3,       // H nodes of the per-step engine
+  kTileUpdate = 4,    // E, H and sources of the temporal blocking and the
+                      // task graph engines
+  kOutput = 5,        // copy of the fields to the snapshots, monitors
+  kSubgridUpdate = 6, // fine grids of the subgrids
+  kSetupWait = 7,     // before the first time step
+  kEWait = 8,         // after the E update
+  kHWait = 9,         // after the H update
+  kTileWait = 10,     // between the two phases of a temporal block
+  kBlockWait = 11,    // after a temporal block
+  kHaloWait = 12,     // for the halos of the neighboring ranks
+  kTaskWait = 13,     // for a ready tile of the task graph engine
+  kSubgridWait = 14,  // after the update of the subgrids
+  kNumPhases = 15,
+};
+
+constexpr int kNumProfilePhases = static_cast<int>(ProfilePhase::kNumPhases);
+
+const char* GetProfilePhaseName(const ProfilePhase phase);
+bool IsWaitPhase(const ProfilePhase phase);
+
+enum class ProfileReportFormat {
+  kJSON = 1,
+  kCSV = 2,
+};
+
+// converts "json" and "csv" to the corresponding format. Returns false if the
+// name is not recognized.
+bool ParseProfileReportFormat(const std::string& name,
+                              ProfileReportFormat* format);
+const char* GetProfileReportFormatName(const ProfileReportFormat format);
+
+// the hardware counters read by the profiler
+enum class HardwareCounter {
+  kCycles = 0,
+  kInstructions = 1,
+  kCacheReferences = 2,
+  kCacheMisses = 3,
+  kNumCounters = 4,
+};
+
+constexpr int kNumHardwareCounters =
+    static_cast<int>(HardwareCounter::kNumCounters);
+
+const char* GetHardwareCounterName(const HardwareCounter counter);
+
+// nanoseconds from an arbitrary origin
+inline std::int64_t ProfileNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the measurements of one thread. Each profile occupies its own cache lines,
+// so that the threads do not share cache lines while recording.
+struct alignas(kCacheLineSize) ThreadProfile {
+  std::int64_t phase_time[kNumProfilePhases];     // nanoseconds
+  std::int64_t phase_count[kNumProfilePhases];    // number of intervals
+  IntNumber num_e_nodes;                          // E nodes updated
+  IntNumber num_h_nodes;                          // H nodes updated
+  std::int64_t counter_values[kNumHardwareCounters];
+  int counter_fds[kNumHardwareCounters];          // -1 if not opened
+  bool has_counters;
+
+  // adds the interval [t_begin, now) to phase and returns now
+  std::int64_t Record(const ProfilePhase phase, const std::int64_t t_begin) {
+    std::int64_t t_end = ProfileNow();
+    phase_time[static_cast<int>(phase)] += t_end - t_begin;
+    ++phase_count[static_cast<int>(phase)];
+    return t_end;
+  }
+};
+
+// describes the profiled run
+struct ProfileRunInfo {
+  IntNumber num_x;
+  IntNumber num_t;
+  int real_size;        // sizeof the floating point type of the fields
+  double wall_time;     // seconds from the start to the end of the threads
+};
+
+class ThreadProfiler {
+  public:
+  ThreadProfiler();
+  ~ThreadProfiler();
+
+  void SetEnabled(const bool enabled, const bool use_hardware_counters);
+  bool is_enabled();
+
+  // clears the profiles of num_threads threads. It should be called before
+  // the threads start.
+  void Reset(const int num_threads);
+
+  // returns the profile of the thread, or nullptr if the profiler is disabled
+  ThreadProfile* get_thread_profile(const int thread_index) {
+    return enabled_ ? &profiles_[thread_index] : nullptr;
+  }
+
+  // start and stop the hardware counters of the calling thread, which is the
+  // thread thread_index. They do nothing if the counters are disabled.
+  void StartHardwareCounters(const int thread_index);
+  void StopHardwareCounters(const int thread_index);
+
+  void PrintSummary(const ProfileRunInfo& info);
+  // returns false if the file can not be written
+  bool WriteReport(const std::string& file_name,
+                   const ProfileReportFormat format,
+                   const ProfileRunInfo& info);
+
+  private:
+  // the aggregated figures of all the threads
+  struct Summary {
+    double stepping_time;         // seconds, the time stepping of the
+                                  // slowest thread (without the setup)
+    double work_time_max;         // seconds, the busiest thread
+    double work_time_mean;
+    double wait_time_mean;
+    double load_imbalance;        // work_time_max / work_time_mean - 1
+    double wait_fraction;         // wait / (work + wait), all threads
+    IntNumber num_e_nodes;
+    IntNumber num_h_nodes;
+    double node_updates_per_second;   // E node updates over stepping_time
+    // the minimum traffic of the updates over stepping_time. Each E (or H)
+    // node update loads the E and H nodes and stores the E (or H) node.
+    double bandwidth;                 // bytes per second
+    bool has_counters;            // every thread read its counters
+    std::int64_t counter_totals[kNumHardwareCounters];
+  };
+  Summary Summarize(const ProfileRunInfo& info);
+
+  void WriteJSONReport(std::ostream& os, const ProfileRunInfo& info);
+  void WriteCSVReport(std::ostream& os, const ProfileRunInfo& info);
+
+  bool enabled_ = false;
+  bool use_hardware_counters_ = false;
+  int num_threads_ = 0;
+  AlignedObjectArray<ThreadProfile> profiles_ = nullptr;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_THREAD_PROFILER_H_
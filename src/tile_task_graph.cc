@@ -0,0 +1,183 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "tile_task_graph.h"
+
+#include <thread>         // std::this_thread::yield
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>    // _mm_pause
+#endif
+
+namespace fdtd1d {
+
+namespace {
+
+// tells the processor that the thread is in a spin loop
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#endif
+}
+
+// the failed attempts to find a task before a waiting worker starts yielding
+// its time slice
+constexpr int kSpinCount = 2000;
+
+}  // namespace
+
+void WorkStealingDeque::Reset(const int capacity) {
+  std::int64_t size = 1;
+  while (size < capacity) {
+    size *= 2;
+  }
+  if (size != mask_ + 1 || tasks_ == nullptr) {
+    tasks_.reset(new std::atomic<int>[size]);
+    mask_ = size - 1;
+  }
+  top_.store(0, std::memory_order_relaxed);
+  bottom_.store(0, std::memory_order_relaxed);
+}
+
+void WorkStealingDeque::Push(const int task) {
+  const std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+  tasks_[bottom & mask_].store(task, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+}
+
+bool WorkStealingDeque::Pop(int* task) {
+  const std::int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+  bottom_.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  std::int64_t top = top_.load(std::memory_order_relaxed);
+  if (top > bottom) {
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  *task = tasks_[bottom & mask_].load(std::memory_order_relaxed);
+  if (top < bottom) {
+    return true;
+  }
+  // the last task, a thief may be taking it at the same time
+  const bool taken = top_.compare_exchange_strong(
+      top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  bottom_.store(bottom + 1, std::memory_order_relaxed);
+  return taken;
+}
+
+bool WorkStealingDeque::Steal(int* task) {
+  std::int64_t top = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const std::int64_t bottom = bottom_.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return false;
+  }
+  *task = tasks_[top & mask_].load(std::memory_order_relaxed);
+  return top_.compare_exchange_strong(
+      top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+void TileTaskGraph::Reset(const int num_tiles, const IntNumber ind_t_begin,
+                          const IntNumber ind_t_end, const int num_workers) {
+  if (num_tiles != num_tiles_) {
+    steps_ = AllocateAlignedObjectArray<PaddedCounter>(num_tiles);
+    scheduled_ = AllocateAlignedObjectArray<PaddedCounter>(num_tiles);
+  }
+  if (num_workers != num_workers_ || num_tiles != num_tiles_) {
+    deques_ = AllocateAlignedObjectArray<WorkStealingDeque>(num_workers);
+    num_steals_ = AllocateAlignedObjectArray<PaddedCounter>(num_workers);
+  }
+  num_tiles_ = num_tiles;
+  num_workers_ = num_workers;
+  ind_t_end_ = ind_t_end;
+  for (int i = 0; i < num_tiles; ++i) {
+    steps_[i].value.store(ind_t_begin, std::memory_order_relaxed);
+    scheduled_[i].value.store(ind_t_begin, std::memory_order_relaxed);
+  }
+  for (int i = 0; i < num_workers; ++i) {
+    deques_[i].Reset(num_tiles);
+    num_steals_[i].value.store(0, std::memory_order_relaxed);
+  }
+  num_remaining_tasks_.store(
+      static_cast<std::int64_t>(num_tiles)*(ind_t_end - ind_t_begin),
+      std::memory_order_relaxed);
+  // at the start only the first tile is ready, the wavefront then spreads to
+  // the right
+  if (ind_t_begin < ind_t_end && num_tiles > 0) {
+    TrySchedule(0, 0);
+  }
+}
+
+bool TileTaskGraph::Acquire(const int worker, int* tile, IntNumber* ind_t) {
+  int num_attempts = 0;
+  while (true) {
+    int task = -1;
+    bool found = deques_[worker].Pop(&task);
+    for (int i = 1; !found && i < num_workers_; ++i) {
+      found = deques_[(worker + i) % num_workers_].Steal(&task);
+      if (found) {
+        num_steals_[worker].value.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (found) {
+      *tile = task;
+      // the counter of a scheduled tile only changes once its task completes
+      *ind_t = steps_[task].value.load(std::memory_order_acquire);
+      return true;
+    }
+    if (num_remaining_tasks_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
+    if (++num_attempts < kSpinCount) {
+      CpuRelax();
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void TileTaskGraph::Complete(const int worker, const int tile) {
+  // the counters are sequentially consistent, so that of two workers
+  // completing the last two dependencies of a task at least one sees both
+  steps_[tile].value.fetch_add(1, std::memory_order_seq_cst);
+  num_remaining_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+  if (tile > 0) {
+    TrySchedule(worker, tile - 1);
+  }
+  if (tile + 1 < num_tiles_) {
+    TrySchedule(worker, tile + 1);
+  }
+  // pushed last, hence popped first while the tile is in the cache
+  TrySchedule(worker, tile);
+}
+
+std::int64_t TileTaskGraph::get_num_steals() {
+  std::int64_t num_steals = 0;
+  for (int i = 0; i < num_workers_; ++i) {
+    num_steals += num_steals_[i].value.load(std::memory_order_relaxed);
+  }
+  return num_steals;
+}
+
+void TileTaskGraph::TrySchedule(const int worker, const int tile) {
+  IntNumber ind_t = steps_[tile].value.load(std::memory_order_seq_cst);
+  if (ind_t >= ind_t_end_) {
+    return;
+  }
+  if (tile > 0 &&
+      steps_[tile - 1].value.load(std::memory_order_seq_cst) < ind_t + 1) {
+    return;
+  }
+  if (tile + 1 < num_tiles_ &&
+      steps_[tile + 1].value.load(std::memory_order_seq_cst) < ind_t) {
+    return;
+  }
+  // a stale ind_t is below the scheduled step and fails
+  if (scheduled_[tile].value.compare_exchange_strong(
+          ind_t, ind_t + 1, std::memory_order_acq_rel)) {
+    deques_[worker].Push(tile);
+  }
+}
+
+}  // namespace fdtd1d
@@ -0,0 +1,109 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_TILE_TASK_GRAPH_H_
+#define FDTD_TILE_TASK_GRAPH_H_
+
+// The scheduling of the kTaskGraph engine. The grid is split in many more
+// tiles than threads, and the update of a tile over one time step is a task
+// that only waits for the tiles next to it, instead of a global barrier.
+//
+// The task T(i, n) of the tile i with the E nodes [a, b) updates the E nodes
+// [a, b) to the time step n, then the H nodes [a - 1, b - 1) (the H nodes on
+// the left of its E nodes). It reads
+//   - H[b - 1], updated by T(i + 1, n - 1),
+//   - E[a - 1], updated by T(i - 1, n),
+// and overwrites the E and H values that T(i - 1, n) and T(i + 1, n - 1)
+// read. Therefore T(i, n) is ready once
+//
+//   steps[i] == n,   steps[i - 1] >= n + 1   and   steps[i + 1] >= n
+//
+// where steps[j] is the number of time steps completed by the tile j (the
+// missing neighbors of the first and last tiles count as done). The tiles
+// form a wavefront: a tile may run up to one step ahead of the tile on its
+// right, so a delayed thread only holds back the tiles next to its own
+// instead of every thread.
+//
+// The counters are atomic. The thread completing a task checks the three
+// tasks it may have made ready (the next step of its tile and of the two
+// neighbors) and the first thread to see one ready claims it with a
+// compare-and-swap and pushes it on its own work-stealing deque. A thread
+// pops its own deque first (the most recent task, whose tile is still in its
+// cache) and steals the oldest task of another deque when it is empty.
+
+#include <atomic>         // std::atomic
+#include <cstdint>        // std::int64_t
+#include <memory>         // std::unique_ptr
+
+#include "aligned_memory.h"
+#include "number_types.h"
+#include "thread_barrier.h"
+
+namespace fdtd1d {
+
+// A Chase-Lev deque of tile indices: the owner pushes and pops at the
+// bottom without locks, the other threads steal at the top. The capacity is
+// fixed, which is enough here since a tile has at most one pending task.
+class WorkStealingDeque {
+  public:
+  // empties the deque and makes room for capacity tasks. Not thread safe.
+  void Reset(const int capacity);
+
+  // owner only
+  void Push(const int task);
+  bool Pop(int* task);
+
+  // any thread. Returns false if the deque is empty or another thread took
+  // the task first.
+  bool Steal(int* task);
+
+  private:
+  alignas(kCacheLineSize) std::atomic<std::int64_t> top_{0};
+  alignas(kCacheLineSize) std::atomic<std::int64_t> bottom_{0};
+  alignas(kCacheLineSize) std::unique_ptr<std::atomic<int>[]> tasks_;
+  std::int64_t mask_ = 0;
+};
+
+class TileTaskGraph {
+  public:
+  // prepares the tasks of num_tiles tiles from the time step ind_t_begin to
+  // ind_t_end for num_workers workers. Not thread safe.
+  void Reset(const int num_tiles, const IntNumber ind_t_begin,
+             const IntNumber ind_t_end, const int num_workers);
+
+  // gets a ready task for the worker, waiting for one if needed. Returns
+  // false once all the tasks are completed.
+  bool Acquire(const int worker, int* tile, IntNumber* ind_t);
+
+  // marks the task of the tile acquired by the worker as completed and
+  // schedules the tasks it made ready
+  void Complete(const int worker, const int tile);
+
+  // the tasks taken from the deque of another worker since Reset
+  std::int64_t get_num_steals();
+
+  private:
+  // pushes the next task of the tile to the deque of the worker if it is
+  // ready and no other worker claimed it
+  void TrySchedule(const int worker, const int tile);
+
+  struct alignas(kCacheLineSize) PaddedCounter {
+    std::atomic<IntNumber> value{0};
+  };
+
+  int num_tiles_ = 0;
+  int num_workers_ = 0;
+  IntNumber ind_t_end_ = 0;
+  // the completed time steps and the next time step not yet scheduled of
+  // each tile
+  AlignedObjectArray<PaddedCounter> steps_;
+  AlignedObjectArray<PaddedCounter> scheduled_;
+  AlignedObjectArray<WorkStealingDeque> deques_;
+  AlignedObjectArray<PaddedCounter> num_steals_;
+  alignas(kCacheLineSize) std::atomic<std::int64_t> num_remaining_tasks_{0};
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_TILE_TASK_GRAPH_H_
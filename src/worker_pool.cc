@@ -0,0 +1,83 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "worker_pool.h"
+
+#include "thread_affinity.h"
+
+namespace fdtd1d {
+
+WorkerPool::~WorkerPool() {
+  Stop();
+}
+
+void WorkerPool::Start(const int num_threads, const std::vector<int>& cpus) {
+  if (!threads_.empty() && get_num_threads() == num_threads &&
+      cpus_ == cpus) {
+    return;
+  }
+  Stop();
+  cpus_ = cpus;
+  num_unpinned_threads_ = 0;
+  ++num_starts_;
+  // the workers report once they are pinned, so that the pinning is done
+  // before the first job
+  num_busy_threads_ = num_threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&WorkerPool::WorkerLoop, this, i);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_done_.wait(lock, [this] { return num_busy_threads_ == 0; });
+}
+
+void WorkerPool::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_ready_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+  stopping_ = false;
+}
+
+void WorkerPool::Run(const std::function<void(const int)>& job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_ = &job;
+  num_busy_threads_ = get_num_threads();
+  ++job_generation_;
+  job_ready_.notify_all();
+  job_done_.wait(lock, [this] { return num_busy_threads_ == 0; });
+  job_ = nullptr;
+}
+
+void WorkerPool::WorkerLoop(const int thread_index) {
+  const bool is_pinned = cpus_.empty() ||
+                         PinCurrentThreadToCpu(cpus_[thread_index]);
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_unpinned_threads_ += is_pinned ? 0 : 1;
+  unsigned long generation = job_generation_;
+  if (--num_busy_threads_ == 0) {
+    job_done_.notify_one();
+  }
+  while (true) {
+    job_ready_.wait(lock, [this, generation] {
+      return stopping_ || job_generation_ != generation;
+    });
+    if (stopping_) {
+      return;
+    }
+    generation = job_generation_;
+    const std::function<void(const int)>* job = job_;
+    lock.unlock();
+    (*job)(thread_index);
+    lock.lock();
+    if (--num_busy_threads_ == 0) {
+      job_done_.notify_one();
+    }
+  }
+}
+
+}  // namespace fdtd1d
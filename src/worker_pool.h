@@ -0,0 +1,76 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_WORKER_POOL_H_
+#define FDTD_WORKER_POOL_H_
+
+// Long-lived worker threads shared by the runs of a solver. Creating and
+// joining the threads, and pinning them to their CPUs, costs tens to
+// hundreds of microseconds per run, which dominates short runs. The pool
+// starts the threads once, pins each of them once, and then hands them one
+// job after another:
+//
+//   pool.Start(num_threads, cpus);          // no-op if already running so
+//   pool.Run([](const int i) { ... });      // job(i) on worker i, blocks
+//   pool.Run([](const int i) { ... });      // same threads, same CPUs
+//
+// Between jobs the workers sleep on a condition variable, so an idle pool
+// does not use the CPUs.
+
+#include <condition_variable>   // std::condition_variable
+#include <functional>           // std::function
+#include <mutex>                // std::mutex
+#include <thread>               // std::thread
+#include <vector>               // std::vector
+
+namespace fdtd1d {
+
+class WorkerPool {
+  public:
+  WorkerPool() = default;
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+  ~WorkerPool();
+
+  // makes sure that num_threads workers are running, worker i pinned to
+  // cpus[i] (not pinned if cpus is empty). The running workers are kept if
+  // their number and CPUs are unchanged, otherwise they are replaced.
+  void Start(const int num_threads, const std::vector<int>& cpus);
+
+  // stops and joins the workers
+  void Stop();
+
+  // calls job(i) on the worker i for all the workers and returns once all
+  // the calls returned. Should not be called concurrently.
+  void Run(const std::function<void(const int)>& job);
+
+  int get_num_threads() { return static_cast<int>(threads_.size()); }
+  // the workers that could not be pinned to their CPU
+  int get_num_unpinned_threads() { return num_unpinned_threads_; }
+  // the number of times the workers were (re)started
+  int get_num_starts() { return num_starts_; }
+
+  private:
+  void WorkerLoop(const int thread_index);
+
+  std::vector<std::thread> threads_;
+  std::vector<int> cpus_;
+
+  // a job is published by incrementing job_generation_; the workers run it
+  // and the last one to finish wakes up Run
+  std::mutex mutex_;
+  std::condition_variable job_ready_;
+  std::condition_variable job_done_;
+  const std::function<void(const int)>* job_ = nullptr;
+  unsigned long job_generation_ = 0;
+  int num_busy_threads_ = 0;
+  bool stopping_ = false;
+
+  int num_unpinned_threads_ = 0;
+  int num_starts_ = 0;
+};
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_WORKER_POOL_H_
@@ -0,0 +1,385 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+#include "yee_kernels.h"
+
+#include <cstdint>        // std::uintptr_t
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FDTD_X86_KERNELS
+#include <immintrin.h>    // SSE2, AVX2 and AVX-512 intrinsics
+#endif
+
+namespace fdtd1d {
+
+namespace {
+
+inline bool IsAligned(const void* pointer, const std::uintptr_t alignment) {
+  return (reinterpret_cast<std::uintptr_t>(pointer) & (alignment - 1)) == 0;
+}
+
+template <typename Real>
+void UpdateEScalar(Real* e, const Real* h,
+                   const IntNumber ind_begin, const IntNumber ind_end,
+                   const IntNumber stride, const Real coefficient) {
+  for (IntNumber i = ind_begin; i < ind_end; ++i) {
+    e[i] -= (h[i] - h[i - stride])*coefficient;
+  }
+}
+
+template <typename Real>
+void UpdateELossyScalar(Real* e, const Real* h,
+                        const IntNumber ind_begin, const IntNumber ind_end,
+                        const IntNumber stride, const Real decay,
+                        const Real coefficient) {
+  for (IntNumber i = ind_begin; i < ind_end; ++i) {
+    e[i] = e[i]*decay - (h[i] - h[i - stride])*coefficient;
+  }
+}
+
+template <typename Real>
+void UpdateHScalar(Real* h, const Real* e,
+                   const IntNumber ind_begin, const IntNumber ind_end,
+                   const IntNumber stride, const Real coefficient) {
+  for (IntNumber i = ind_begin; i < ind_end; ++i) {
+    h[i] -= (e[i + stride] - e[i])*coefficient;
+  }
+}
+
+template <typename Real>
+void UpdateE4Scalar(Real* e, const Real* h,
+                    const IntNumber ind_begin, const IntNumber ind_end,
+                    const IntNumber stride, const Real near, const Real far) {
+  for (IntNumber i = ind_begin; i < ind_end; ++i) {
+    e[i] -= (h[i] - h[i - stride])*near - (h[i + stride] - h[i - 2*stride])*far;
+  }
+}
+
+template <typename Real>
+void UpdateE4LossyScalar(Real* e, const Real* h,
+                         const IntNumber ind_begin, const IntNumber ind_end,
+                         const IntNumber stride, const Real decay,
+                         const Real near, const Real far) {
+  for (IntNumber i = ind_begin; i < ind_end; ++i) {
+    e[i] = e[i]*decay - ((h[i] - h[i - stride])*near
+                         - (h[i + stride] - h[i - 2*stride])*far);
+  }
+}
+
+template <typename Real>
+void UpdateH4Scalar(Real* h, const Real* e,
+                    const IntNumber ind_begin, const IntNumber ind_end,
+                    const IntNumber stride, const Real near, const Real far) {
+  for (IntNumber i = ind_begin; i < ind_end; ++i) {
+    h[i] -= (e[i + stride] - e[i])*near - (e[i + 2*stride] - e[i - stride])*far;
+  }
+}
+
+#ifdef FDTD_X86_KERNELS
+
+// defines the functions UpdateE<NAME>, UpdateH<NAME> and UpdateELossy<NAME>
+// and their fourth order versions UpdateE4<NAME>, UpdateH4<NAME> and
+// UpdateE4Lossy<NAME> for the instruction
+// set TARGET. VECTOR is the vector type holding WIDTH values of type REAL and
+// PREFIX/SUFFIX compose the names of the intrinsics, e.g. _mm256 and pd give
+// _mm256_loadu_pd.
+#define FDTD_DEFINE_VECTOR_KERNELS(NAME, TARGET, REAL, VECTOR, WIDTH,         \
+                                   PREFIX, SUFFIX)                            \
+__attribute__((target(TARGET)))                                               \
+void UpdateE##NAME(REAL* e, const REAL* h,                                    \
+                   const IntNumber ind_begin, const IntNumber ind_end,        \
+                   const IntNumber stride, const REAL coefficient) {          \
+  IntNumber i = ind_begin;                                                    \
+  for (; i < ind_end && !IsAligned(e + i, sizeof(VECTOR)); ++i) {             \
+    e[i] -= (h[i] - h[i - stride])*coefficient;                               \
+  }                                                                           \
+  const VECTOR c = PREFIX##_set1_##SUFFIX(coefficient);                       \
+  for (; i + WIDTH <= ind_end; i += WIDTH) {                                  \
+    VECTOR curl = PREFIX##_sub_##SUFFIX(PREFIX##_loadu_##SUFFIX(h + i),       \
+                                   PREFIX##_loadu_##SUFFIX(h + i - stride));  \
+    PREFIX##_store_##SUFFIX(e + i, PREFIX##_sub_##SUFFIX(                     \
+        PREFIX##_load_##SUFFIX(e + i), PREFIX##_mul_##SUFFIX(curl, c)));      \
+  }                                                                           \
+  UpdateEScalar(e, h, i, ind_end, stride, coefficient);                       \
+}                                                                             \
+                                                                              \
+__attribute__((target(TARGET)))                                               \
+void UpdateH##NAME(REAL* h, const REAL* e,                                    \
+                   const IntNumber ind_begin, const IntNumber ind_end,        \
+                   const IntNumber stride, const REAL coefficient) {          \
+  IntNumber i = ind_begin;                                                    \
+  for (; i < ind_end && !IsAligned(h + i, sizeof(VECTOR)); ++i) {             \
+    h[i] -= (e[i + stride] - e[i])*coefficient;                               \
+  }                                                                           \
+  const VECTOR c = PREFIX##_set1_##SUFFIX(coefficient);                       \
+  for (; i + WIDTH <= ind_end; i += WIDTH) {                                  \
+    VECTOR curl = PREFIX##_sub_##SUFFIX(                                      \
+        PREFIX##_loadu_##SUFFIX(e + i + stride),                              \
+        PREFIX##_loadu_##SUFFIX(e + i));                                      \
+    PREFIX##_store_##SUFFIX(h + i, PREFIX##_sub_##SUFFIX(                     \
+        PREFIX##_load_##SUFFIX(h + i), PREFIX##_mul_##SUFFIX(curl, c)));      \
+  }                                                                           \
+  UpdateHScalar(h, e, i, ind_end, stride, coefficient);                       \
+}                                                                             \
+                                                                              \
+__attribute__((target(TARGET)))                                               \
+void UpdateELossy##NAME(REAL* e, const REAL* h,                               \
+                        const IntNumber ind_begin, const IntNumber ind_end,   \
+                        const IntNumber stride, const REAL decay,             \
+                        const REAL coefficient) {                             \
+  IntNumber i = ind_begin;                                                    \
+  for (; i < ind_end && !IsAligned(e + i, sizeof(VECTOR)); ++i) {             \
+    e[i] = e[i]*decay - (h[i] - h[i - stride])*coefficient;                   \
+  }                                                                           \
+  const VECTOR d = PREFIX##_set1_##SUFFIX(decay);                             \
+  const VECTOR c = PREFIX##_set1_##SUFFIX(coefficient);                       \
+  for (; i + WIDTH <= ind_end; i += WIDTH) {                                  \
+    VECTOR curl = PREFIX##_sub_##SUFFIX(PREFIX##_loadu_##SUFFIX(h + i),       \
+                                   PREFIX##_loadu_##SUFFIX(h + i - stride));  \
+    PREFIX##_store_##SUFFIX(e + i, PREFIX##_sub_##SUFFIX(                     \
+        PREFIX##_mul_##SUFFIX(PREFIX##_load_##SUFFIX(e + i), d),              \
+        PREFIX##_mul_##SUFFIX(curl, c)));                                     \
+  }                                                                           \
+  UpdateELossyScalar(e, h, i, ind_end, stride, decay, coefficient);           \
+}                                                                             \
+                                                                              \
+__attribute__((target(TARGET)))                                               \
+void UpdateE4##NAME(REAL* e, const REAL* h,                                   \
+                    const IntNumber ind_begin, const IntNumber ind_end,       \
+                    const IntNumber stride, const REAL near, const REAL far) {\
+  IntNumber i = ind_begin;                                                    \
+  for (; i < ind_end && !IsAligned(e + i, sizeof(VECTOR)); ++i) {             \
+    e[i] -= (h[i] - h[i - stride])*near                                       \
+            - (h[i + stride] - h[i - 2*stride])*far;                          \
+  }                                                                           \
+  const VECTOR cn = PREFIX##_set1_##SUFFIX(near);                             \
+  const VECTOR cf = PREFIX##_set1_##SUFFIX(far);                              \
+  for (; i + WIDTH <= ind_end; i += WIDTH) {                                  \
+    VECTOR curl_near = PREFIX##_sub_##SUFFIX(                                 \
+        PREFIX##_loadu_##SUFFIX(h + i),                                       \
+        PREFIX##_loadu_##SUFFIX(h + i - stride));                             \
+    VECTOR curl_far = PREFIX##_sub_##SUFFIX(                                  \
+        PREFIX##_loadu_##SUFFIX(h + i + stride),                              \
+        PREFIX##_loadu_##SUFFIX(h + i - 2*stride));                           \
+    VECTOR curl = PREFIX##_sub_##SUFFIX(PREFIX##_mul_##SUFFIX(curl_near, cn), \
+                                        PREFIX##_mul_##SUFFIX(curl_far, cf)); \
+    PREFIX##_store_##SUFFIX(e + i, PREFIX##_sub_##SUFFIX(                     \
+        PREFIX##_load_##SUFFIX(e + i), curl));                                \
+  }                                                                           \
+  UpdateE4Scalar(e, h, i, ind_end, stride, near, far);                        \
+}                                                                             \
+                                                                              \
+__attribute__((target(TARGET)))                                               \
+void UpdateH4##NAME(REAL* h, const REAL* e,                                   \
+                    const IntNumber ind_begin, const IntNumber ind_end,       \
+                    const IntNumber stride, const REAL near, const REAL far) {\
+  IntNumber i = ind_begin;                                                    \
+  for (; i < ind_end && !IsAligned(h + i, sizeof(VECTOR)); ++i) {             \
+    h[i] -= (e[i + stride] - e[i])*near                                       \
+            - (e[i + 2*stride] - e[i - stride])*far;                          \
+  }                                                                           \
+  const VECTOR cn = PREFIX##_set1_##SUFFIX(near);                             \
+  const VECTOR cf = PREFIX##_set1_##SUFFIX(far);                              \
+  for (; i + WIDTH <= ind_end; i += WIDTH) {                                  \
+    VECTOR curl_near = PREFIX##_sub_##SUFFIX(                                 \
+        PREFIX##_loadu_##SUFFIX(e + i + stride),                              \
+        PREFIX##_loadu_##SUFFIX(e + i));                                      \
+    VECTOR curl_far = PREFIX##_sub_##SUFFIX(                                  \
+        PREFIX##_loadu_##SUFFIX(e + i + 2*stride),                            \
+        PREFIX##_loadu_##SUFFIX(e + i - stride));                             \
+    VECTOR curl = PREFIX##_sub_##SUFFIX(PREFIX##_mul_##SUFFIX(curl_near, cn), \
+                                        PREFIX##_mul_##SUFFIX(curl_far, cf)); \
+    PREFIX##_store_##SUFFIX(h + i, PREFIX##_sub_##SUFFIX(                     \
+        PREFIX##_load_##SUFFIX(h + i), curl));                                \
+  }                                                                           \
+  UpdateH4Scalar(h, e, i, ind_end, stride, near, far);                        \
+}                                                                             \
+                                                                              \
+__attribute__((target(TARGET)))                                               \
+void UpdateE4Lossy##NAME(REAL* e, const REAL* h,                              \
+                         const IntNumber ind_begin, const IntNumber ind_end,  \
+                         const IntNumber stride, const REAL decay,            \
+                         const REAL near, const REAL far) {                   \
+  IntNumber i = ind_begin;                                                    \
+  for (; i < ind_end && !IsAligned(e + i, sizeof(VECTOR)); ++i) {             \
+    e[i] = e[i]*decay - ((h[i] - h[i - stride])*near                          \
+                         - (h[i + stride] - h[i - 2*stride])*far);            \
+  }                                                                           \
+  const VECTOR d = PREFIX##_set1_##SUFFIX(decay);                             \
+  const VECTOR cn = PREFIX##_set1_##SUFFIX(near);                             \
+  const VECTOR cf = PREFIX##_set1_##SUFFIX(far);                              \
+  for (; i + WIDTH <= ind_end; i += WIDTH) {                                  \
+    VECTOR curl_near = PREFIX##_sub_##SUFFIX(                                 \
+        PREFIX##_loadu_##SUFFIX(h + i),                                       \
+        PREFIX##_loadu_##SUFFIX(h + i - stride));                             \
+    VECTOR curl_far = PREFIX##_sub_##SUFFIX(                                  \
+        PREFIX##_loadu_##SUFFIX(h + i + stride),                              \
+        PREFIX##_loadu_##SUFFIX(h + i - 2*stride));                           \
+    VECTOR curl = PREFIX##_sub_##SUFFIX(PREFIX##_mul_##SUFFIX(curl_near, cn), \
+                                        PREFIX##_mul_##SUFFIX(curl_far, cf)); \
+    PREFIX##_store_##SUFFIX(e + i, PREFIX##_sub_##SUFFIX(                     \
+        PREFIX##_mul_##SUFFIX(PREFIX##_load_##SUFFIX(e + i), d), curl));      \
+  }                                                                           \
+  UpdateE4LossyScalar(e, h, i, ind_end, stride, decay, near, far);            \
+}
+
+FDTD_DEFINE_VECTOR_KERNELS(SSE2Double, "sse2", double, __m128d, 2, _mm, pd)
+FDTD_DEFINE_VECTOR_KERNELS(SSE2Float, "sse2", float, __m128, 4, _mm, ps)
+FDTD_DEFINE_VECTOR_KERNELS(AVX2Double, "avx2", double, __m256d, 4, _mm256, pd)
+FDTD_DEFINE_VECTOR_KERNELS(AVX2Float, "avx2", float, __m256, 8, _mm256, ps)
+FDTD_DEFINE_VECTOR_KERNELS(AVX512Double, "avx512f", double, __m512d, 8, 
+                           _mm512, pd)
+FDTD_DEFINE_VECTOR_KERNELS(AVX512Float, "avx512f", float, __m512, 16, 
+                           _mm512, ps)
+
+#undef FDTD_DEFINE_VECTOR_KERNELS
+
+#endif  // FDTD_X86_KERNELS
+
+// the kernels for each precision. The kernels that are not available are
+// replaced by the scalar kernels.
+template <typename Real>
+struct KernelTable {
+  static const YeeKernels<Real> kScalar;
+  static const YeeKernels<Real> kSSE2;
+  static const YeeKernels<Real> kAVX2;
+  static const YeeKernels<Real> kAVX512;
+};
+
+template <typename Real>
+const YeeKernels<Real> KernelTable<Real>::kScalar =
+    {KernelType::kScalar, UpdateEScalar<Real>, UpdateHScalar<Real>,
+     UpdateELossyScalar<Real>, UpdateE4Scalar<Real>, UpdateH4Scalar<Real>,
+     UpdateE4LossyScalar<Real>};
+
+#ifdef FDTD_X86_KERNELS
+template <>
+const YeeKernels<double> KernelTable<double>::kSSE2 =
+    {KernelType::kSSE2, UpdateESSE2Double, UpdateHSSE2Double,
+     UpdateELossySSE2Double, UpdateE4SSE2Double, UpdateH4SSE2Double,
+     UpdateE4LossySSE2Double};
+template <>
+const YeeKernels<float> KernelTable<float>::kSSE2 =
+    {KernelType::kSSE2, UpdateESSE2Float, UpdateHSSE2Float,
+     UpdateELossySSE2Float, UpdateE4SSE2Float, UpdateH4SSE2Float,
+     UpdateE4LossySSE2Float};
+template <>
+const YeeKernels<double> KernelTable<double>::kAVX2 =
+    {KernelType::kAVX2, UpdateEAVX2Double, UpdateHAVX2Double,
+     UpdateELossyAVX2Double, UpdateE4AVX2Double, UpdateH4AVX2Double,
+     UpdateE4LossyAVX2Double};
+template <>
+const YeeKernels<float> KernelTable<float>::kAVX2 =
+    {KernelType::kAVX2, UpdateEAVX2Float, UpdateHAVX2Float,
+     UpdateELossyAVX2Float, UpdateE4AVX2Float, UpdateH4AVX2Float,
+     UpdateE4LossyAVX2Float};
+template <>
+const YeeKernels<double> KernelTable<double>::kAVX512 =
+    {KernelType::kAVX512, UpdateEAVX512Double, UpdateHAVX512Double,
+     UpdateELossyAVX512Double, UpdateE4AVX512Double, UpdateH4AVX512Double,
+     UpdateE4LossyAVX512Double};
+template <>
+const YeeKernels<float> KernelTable<float>::kAVX512 =
+    {KernelType::kAVX512, UpdateEAVX512Float, UpdateHAVX512Float,
+     UpdateELossyAVX512Float, UpdateE4AVX512Float, UpdateH4AVX512Float,
+     UpdateE4LossyAVX512Float};
+#else
+template <typename Real>
+const YeeKernels<Real> KernelTable<Real>::kSSE2 = KernelTable<Real>::kScalar;
+template <typename Real>
+const YeeKernels<Real> KernelTable<Real>::kAVX2 = KernelTable<Real>::kScalar;
+template <typename Real>
+const YeeKernels<Real> KernelTable<Real>::kAVX512 = 
+    KernelTable<Real>::kScalar;
+#endif  // FDTD_X86_KERNELS
+
+}  // namespace
+
+bool ParseKernelType(const std::string& name, KernelType* kernel_type) {
+  if (name == "auto") {
+    *kernel_type = KernelType::kAuto;
+  } else if (name == "scalar") {
+    *kernel_type = KernelType::kScalar;
+  } else if (name == "sse2") {
+    *kernel_type = KernelType::kSSE2;
+  } else if (name == "avx2") {
+    *kernel_type = KernelType::kAVX2;
+  } else if (name == "avx512") {
+    *kernel_type = KernelType::kAVX512;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetKernelTypeName(const KernelType kernel_type) {
+  switch (kernel_type) {
+    case KernelType::kAuto:
+      return "auto";
+    case KernelType::kScalar:
+      return "scalar";
+    case KernelType::kSSE2:
+      return "sse2";
+    case KernelType::kAVX2:
+      return "avx2";
+    case KernelType::kAVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+bool IsKernelSupported(const KernelType kernel_type) {
+  switch (kernel_type) {
+    case KernelType::kAuto:
+    case KernelType::kScalar:
+      return true;
+#ifdef FDTD_X86_KERNELS
+    case KernelType::kSSE2:
+      return __builtin_cpu_supports("sse2");
+    case KernelType::kAVX2:
+      return __builtin_cpu_supports("avx2");
+    case KernelType::kAVX512:
+      return __builtin_cpu_supports("avx512f");
+#else
+    default:
+      return false;
+#endif
+  }
+  return false;
+}
+
+KernelType GetBestSupportedKernel() {
+  for (auto kernel_type : {KernelType::kAVX512, KernelType::kAVX2,
+                           KernelType::kSSE2}) {
+    if (IsKernelSupported(kernel_type)) {
+      return kernel_type;
+    }
+  }
+  return KernelType::kScalar;
+}
+
+template <typename Real>
+const YeeKernels<Real>& GetYeeKernels(const KernelType kernel_type) {
+  KernelType selected_type = kernel_type;
+  if (selected_type == KernelType::kAuto ||
+      !IsKernelSupported(selected_type)) {
+    selected_type = GetBestSupportedKernel();
+  }
+  switch (selected_type) {
+    case KernelType::kSSE2:
+      return KernelTable<Real>::kSSE2;
+    case KernelType::kAVX2:
+      return KernelTable<Real>::kAVX2;
+    case KernelType::kAVX512:
+      return KernelTable<Real>::kAVX512;
+    default:
+      return KernelTable<Real>::kScalar;
+  }
+}
+
+template const YeeKernels<float>& GetYeeKernels<float>(
+    const KernelType kernel_type);
+template const YeeKernels<double>& GetYeeKernels<double>(
+    const KernelType kernel_type);
+
+}  // namespace fdtd1d
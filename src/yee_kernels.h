@@ -0,0 +1,101 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_YEE_KERNELS_H_
+#define FDTD_YEE_KERNELS_H_
+
+// Defines the vectorized kernels of the Yee updates:
+//
+// E update : e[i] -= (h[i] - h[i - stride])*coefficient
+// H update : h[i] -= (e[i + stride] - e[i])*coefficient
+// lossy E update : e[i] = e[i]*decay - (h[i] - h[i - stride])*coefficient
+//
+// and of their fourth order counterparts (FDTD(2,4)), whose differences also
+// take the second neighbors:
+//
+// E update : e[i] -= (h[i] - h[i - stride])*near
+//                    - (h[i + stride] - h[i - 2*stride])*far
+// H update : h[i] -= (e[i + stride] - e[i])*near
+//                    - (e[i + 2*stride] - e[i - stride])*far
+// lossy E update : e[i] = e[i]*decay - ((h[i] - h[i - stride])*near
+//                                      - (h[i + stride] - h[i - 2*stride])*far)
+//
+// with near = coefficient*9/8 and far = coefficient/24 (see
+// kFourthOrderNearWeight), for i in [ind_begin, ind_end). stride is the
+// distance between the values of two neighboring grid points: 1 for a single
+// simulation and the number of interleaved simulations for an ensemble (see
+// fdtd1d_ensemble.h). Kernels are provided for SSE2, AVX2 and AVX-512 in
+// single (float) and double precision, and the best kernel supported by the
+// processor is selected at run time, so that the same executable can run on
+// different machines.
+// The vector loops perform the same floating point operations as the scalar
+// loop (no fused multiply-add), hence all the kernels give identical results.
+// Each kernel peels the head of the range until the stored array is aligned to
+// the vector size and handles the remaining tail with the scalar loop.
+
+#include <string>         // std::string
+
+#include "number_types.h"
+
+namespace fdtd1d {
+
+enum class KernelType {
+  kAuto = 0,        // the best kernel supported by the processor
+  kScalar = 1,
+  kSSE2 = 2,
+  kAVX2 = 3,
+  kAVX512 = 4,
+};
+
+// converts "auto", "scalar", "sse2", "avx2" and "avx512" to the corresponding
+// KernelType. Returns false if the name is not recognized.
+bool ParseKernelType(const std::string& name, KernelType* kernel_type);
+const char* GetKernelTypeName(const KernelType kernel_type);
+
+// the weights of the fourth order central difference on a staggered grid,
+//   f'(x) = ((f(x + dx/2) - f(x - dx/2))*9/8 
+//            - (f(x + 3dx/2) - f(x - 3dx/2))/24)/dx + O(dx^4)
+constexpr double kFourthOrderNearWeight = 9.0 / 8.0;
+constexpr double kFourthOrderFarWeight = 1.0 / 24.0;
+
+template <typename Real>
+struct YeeKernels {
+  KernelType type;
+  void (*update_e)(Real* e, const Real* h,
+                   const IntNumber ind_begin, const IntNumber ind_end,
+                   const IntNumber stride, const Real coefficient);
+  void (*update_h)(Real* h, const Real* e,
+                   const IntNumber ind_begin, const IntNumber ind_end,
+                   const IntNumber stride, const Real coefficient);
+  void (*update_e_lossy)(Real* e, const Real* h,
+                         const IntNumber ind_begin, const IntNumber ind_end,
+                         const IntNumber stride, const Real decay,
+                         const Real coefficient);
+  void (*update_e4)(Real* e, const Real* h,
+                    const IntNumber ind_begin, const IntNumber ind_end,
+                    const IntNumber stride, const Real near, const Real far);
+  void (*update_h4)(Real* h, const Real* e,
+                    const IntNumber ind_begin, const IntNumber ind_end,
+                    const IntNumber stride, const Real near, const Real far);
+  void (*update_e4_lossy)(Real* e, const Real* h,
+                          const IntNumber ind_begin, const IntNumber ind_end,
+                          const IntNumber stride, const Real decay,
+                          const Real near, const Real far);
+};
+
+// returns true if the processor (and the compiler) supports kernel_type
+bool IsKernelSupported(const KernelType kernel_type);
+
+// returns the best kernel supported by the processor
+KernelType GetBestSupportedKernel();
+
+// returns the kernels of the given type. kAuto and the types that are not
+// supported by the processor are replaced by GetBestSupportedKernel().
+// Real is float or double.
+template <typename Real>
+const YeeKernels<Real>& GetYeeKernels(const KernelType kernel_type);
+
+}  // namespace fdtd1d
+
+#endif  // FDTD_YEE_KERNELS_H_
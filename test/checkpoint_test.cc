@@ -0,0 +1,157 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Checks that a run resumed from a checkpoint (see checkpoint.h) ends with
+// the same E field and the same monitors, bit for bit, as the run that was
+// not interrupted. The problem has absorbing layers, a material, a Drude
+// medium, a subgrid and monitors, whose state is part of the checkpoint.
+
+#include <cstdio>         // std::remove
+#include <fstream>        // std::ifstream
+#include <sstream>        // std::ostringstream
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "fdtd1d.h"
+#include "test_check.h"
+
+namespace {
+
+using fdtd1d::IntNumber;
+using fdtd1d::TimeSteppingEngine;
+using fdtd1d::test::Check;
+
+const char kCheckpointFileName[] = "checkpoint_test.chk";
+const char kMonitorPrefix[] = "checkpoint_test_monitors";
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file(file_name, std::ifstream::binary);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// sets up the problem without the sources, which a resumed run takes from
+// the checkpoint
+template <typename Real, typename SourceReal>
+bool SetUp(const TimeSteppingEngine engine, const bool with_subgrid,
+           fdtd1d::FDTD1D<Real, SourceReal>* fdtd) {
+  fdtd->SetXAxisRangeAndGridSpacing(SourceReal(-10), SourceReal(10),
+                                    SourceReal(0.02));
+  fdtd->InitializeAndResetEMFieldArrays();
+  fdtd->SetStabilityFactorAndTimeResolution(SourceReal(0.99));
+  fdtd->SetSimulationTime(SourceReal(12));
+  fdtd->SetNumberOfThreads(3);
+  fdtd->SetTimeSteppingEngine(engine);
+
+  fdtd1d::CPMLParameters cpml;
+  cpml.thickness = 20;
+  fdtd1d::MaterialRegion material;
+  fdtd1d::DispersiveRegion drude;
+  fdtd1d::SubgridRegion subgrid;
+  fdtd1d::DFTMonitorRegion dft;
+  std::vector<fdtd1d::SubgridRegion> subgrids;
+  if (!fdtd1d::ParseMaterialRegion("-3,-1,4,1,0.1", false, &material) ||
+      !fdtd1d::ParseDrudeRegion("4,6,1,5,0.5", &drude) ||
+      !fdtd1d::ParseSubgridRegion("1,2,3", &subgrid) ||
+      !fdtd1d::ParseDFTMonitorRegion("-5,5,0.5,2,4", &dft)) {
+    return false;
+  }
+  if (with_subgrid) {
+    subgrids.push_back(subgrid);
+  }
+  return fdtd->SetAbsorbingBoundaries(cpml) &&
+         fdtd->SetMaterials({material}) &&
+         fdtd->SetDispersiveMedia({drude}) &&
+         fdtd->SetSubgrids(subgrids) &&
+         fdtd->SetMonitors({-2.0, 3.0}, {dft});
+}
+
+template <typename Real, typename SourceReal>
+void InsertSources(fdtd1d::FDTD1D<Real, SourceReal>* fdtd) {
+  fdtd->InsertGaussianPointSource(SourceReal(-6), SourceReal(1),
+                                  SourceReal(1), SourceReal(0.2));
+  fdtd->InsertModulatedGaussianPointSource(SourceReal(0), SourceReal(0.5),
+                                           SourceReal(4), SourceReal(0.4),
+                                           SourceReal(2), SourceReal(0.3));
+  fdtd->InsertSinusoidalPointSource(SourceReal(7), SourceReal(0.25),
+                                    SourceReal(1), SourceReal(0),
+                                    SourceReal(2));
+}
+
+template <typename Real, typename SourceReal>
+void TestResume(const std::string& precision,
+                const TimeSteppingEngine engine, const bool with_subgrid) {
+  const std::string name = precision + ", " +
+      fdtd1d::GetTimeSteppingEngineName(engine) + " engine" +
+      (with_subgrid ? ", subgrid: " : ": ");
+  const IntNumber checkpoint_interval = 100;
+  const IntNumber num_steps_before_stop = 250;
+
+  // the run that is not interrupted
+  std::vector<Real> reference;
+  std::string reference_monitors;
+  {
+    fdtd1d::FDTD1D<Real, SourceReal> fdtd;
+    if (!Check(SetUp(engine, with_subgrid, &fdtd), name + "set up failed")) {
+      return;
+    }
+    InsertSources(&fdtd);
+    fdtd.RunUntil(SourceReal(12));
+    fdtd.GatherEFieldValues(&reference);
+    fdtd.WriteMonitors(kMonitorPrefix);
+    reference_monitors = ReadFile(std::string(kMonitorPrefix) +
+                                  "_probes.csv") +
+                         ReadFile(std::string(kMonitorPrefix) + "_dft.csv");
+  }
+
+  // the run that stops after writing checkpoints. The checkpoint is
+  // complete once the solver is destroyed.
+  {
+    fdtd1d::FDTD1D<Real, SourceReal> fdtd;
+    SetUp(engine, with_subgrid, &fdtd);
+    InsertSources(&fdtd);
+    fdtd.SetCheckpointing(kCheckpointFileName, checkpoint_interval);
+    fdtd.Step(num_steps_before_stop);
+  }
+
+  fdtd1d::FDTD1D<Real, SourceReal> fdtd;
+  SetUp(engine, with_subgrid, &fdtd);
+  if (!Check(fdtd.RestoreCheckpoint(kCheckpointFileName),
+             name + "the checkpoint is not restored")) {
+    return;
+  }
+  // the temporal blocking engine writes the checkpoint at the end of the
+  // block crossing the interval
+  Check(fdtd.get_ind_t() >= checkpoint_interval && 
+        fdtd.get_ind_t() <= num_steps_before_stop,
+        name + "no checkpoint was written before the stop");
+  fdtd.RunUntil(SourceReal(12));
+  std::vector<Real> resumed;
+  fdtd.GatherEFieldValues(&resumed);
+  Check(resumed == reference,
+        name + "the resumed E field differs from the uninterrupted run");
+  fdtd.WriteMonitors(kMonitorPrefix);
+  Check(ReadFile(std::string(kMonitorPrefix) + "_probes.csv") +
+        ReadFile(std::string(kMonitorPrefix) + "_dft.csv") ==
+        reference_monitors,
+        name + "the resumed monitors differ from the uninterrupted run");
+}
+
+}  // namespace
+
+int main() {
+  const TimeSteppingEngine engines[] = {
+      TimeSteppingEngine::kPerStep, TimeSteppingEngine::kTemporalBlocking,
+      TimeSteppingEngine::kTaskGraph};
+  for (TimeSteppingEngine engine : engines) {
+    TestResume<double, double>("double", engine, false);
+    TestResume<float, double>("mixed", engine, false);
+  }
+  TestResume<double, double>("double", TimeSteppingEngine::kPerStep, true);
+  TestResume<float, float>("float", TimeSteppingEngine::kPerStep, true);
+
+  std::remove(kCheckpointFileName);
+  std::remove((std::string(kMonitorPrefix) + "_probes.csv").c_str());
+  std::remove((std::string(kMonitorPrefix) + "_dft.csv").c_str());
+  return fdtd1d::test::Finish();
+}
@@ -0,0 +1,162 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Checks that every time stepping engine and every kernel supported by the
+// processor give the same E field, bit for bit, as the per-step engine with
+// the scalar kernels sweeping the whole grid, in the three precisions and
+// with both spatial orders. The runs skip the nodes the fields did not reach
+// yet (the active region, see FDTD1D::SetActiveRegionTracking) unless they
+// sweep the whole grid too. The runs advanced by many calls of Step and the
+// runs with load balancing are checked the same way. The ranks are not
+// covered, they need the processes of the halo transport.
+
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "fdtd1d.h"
+#include "test_check.h"
+
+namespace {
+
+using fdtd1d::IntNumber;
+using fdtd1d::KernelType;
+using fdtd1d::TimeSteppingEngine;
+using fdtd1d::test::Check;
+
+struct RunParameters {
+  TimeSteppingEngine engine = TimeSteppingEngine::kPerStep;
+  KernelType kernel_type = KernelType::kScalar;
+  int space_order = 2;
+  int num_threads = 3;
+  bool load_balancing = false;
+  bool track_active_region = true;
+  IntNumber steps_per_call = 0;     // 0: one call of RunUntil
+};
+
+std::string Describe(const RunParameters& parameters) {
+  std::string description =
+      std::string(fdtd1d::GetTimeSteppingEngineName(parameters.engine)) +
+      " engine, " + fdtd1d::GetKernelTypeName(parameters.kernel_type) +
+      " kernels, order " + std::to_string(parameters.space_order) + ", " +
+      std::to_string(parameters.num_threads) + " threads";
+  if (parameters.load_balancing) {
+    description += ", load balancing";
+  }
+  if (!parameters.track_active_region) {
+    description += ", whole grid";
+  }
+  if (parameters.steps_per_call > 0) {
+    description += ", Step(" + std::to_string(parameters.steps_per_call) +
+                   ")";
+  }
+  return description;
+}
+
+// a small version of the problem of main.cc with one source of each kind,
+// so that the sources start and stop at different time steps
+template <typename Real, typename SourceReal>
+std::vector<Real> Run(const RunParameters& parameters) {
+  fdtd1d::FDTD1D<Real, SourceReal> fdtd;
+  fdtd.SetXAxisRangeAndGridSpacing(SourceReal(-10), SourceReal(10),
+                                   SourceReal(0.02));
+  fdtd.SetSpatialOrder(parameters.space_order);
+  fdtd.InitializeAndResetEMFieldArrays();
+  fdtd.SetStabilityFactorAndTimeResolution(SourceReal(0.99));
+  fdtd.SetSimulationTime(SourceReal(12));
+  fdtd.SetNumberOfThreads(parameters.num_threads);
+  fdtd.SetTimeSteppingEngine(parameters.engine);
+  fdtd.SetTemporalBlockingParameters(8, 64);
+  fdtd.SetKernelType(parameters.kernel_type);
+  fdtd.SetLoadBalancing(parameters.load_balancing, 16, 0.0);
+  fdtd.SetActiveRegionTracking(parameters.track_active_region);
+  fdtd.InsertGaussianPointSource(SourceReal(-6), SourceReal(1), SourceReal(1),
+                                 SourceReal(0.2));
+  fdtd.InsertModulatedGaussianPointSource(SourceReal(1.5), SourceReal(0.5),
+                                          SourceReal(3), SourceReal(0.4),
+                                          SourceReal(2), SourceReal(0.3));
+  fdtd.InsertSinusoidalPointSource(SourceReal(7), SourceReal(0.25),
+                                   SourceReal(1), SourceReal(0),
+                                   SourceReal(5));
+  if (parameters.steps_per_call > 0) {
+    while (fdtd.Step(parameters.steps_per_call) > 0) {
+    }
+  } else {
+    fdtd.RunUntil(SourceReal(12));
+  }
+  std::vector<Real> e_field;
+  fdtd.GatherEFieldValues(&e_field);
+  return e_field;
+}
+
+template <typename Real, typename SourceReal>
+void TestEngines(const std::string& precision) {
+  const TimeSteppingEngine engines[] = {
+      TimeSteppingEngine::kPerStep, TimeSteppingEngine::kTemporalBlocking,
+      TimeSteppingEngine::kTaskGraph};
+  const KernelType kernel_types[] = {
+      KernelType::kScalar, KernelType::kSSE2, KernelType::kAVX2,
+      KernelType::kAVX512};
+  for (int space_order : {2, 4}) {
+    RunParameters reference_parameters;
+    reference_parameters.space_order = space_order;
+    reference_parameters.track_active_region = false;
+    const std::vector<Real> reference =
+        Run<Real, SourceReal>(reference_parameters);
+
+    // the reference has to have seen the sources
+    bool is_nonzero = false;
+    for (Real value : reference) {
+      is_nonzero = is_nonzero || value != 0;
+    }
+    Check(is_nonzero, precision + ", order " + std::to_string(space_order) +
+                      ": the reference field is zero");
+
+    std::vector<RunParameters> runs;
+    for (TimeSteppingEngine engine : engines) {
+      for (KernelType kernel_type : kernel_types) {
+        // the kernels the processor does not support
+        if (fdtd1d::GetYeeKernels<Real>(kernel_type).type != kernel_type) {
+          continue;
+        }
+        RunParameters parameters = reference_parameters;
+        parameters.engine = engine;
+        parameters.kernel_type = kernel_type;
+        parameters.track_active_region = true;
+        runs.push_back(parameters);
+      }
+      // the whole grid with the other engines
+      RunParameters parameters = reference_parameters;
+      parameters.engine = engine;
+      if (engine != TimeSteppingEngine::kPerStep) {
+        runs.push_back(parameters);
+      }
+      parameters.track_active_region = true;
+      parameters.num_threads = 1;
+      runs.push_back(parameters);
+      parameters.num_threads = 4;
+      parameters.steps_per_call = 37;
+      runs.push_back(parameters);
+      parameters.steps_per_call = 1;
+      runs.push_back(parameters);
+    }
+    RunParameters parameters = reference_parameters;
+    parameters.load_balancing = true;
+    parameters.track_active_region = true;
+    runs.push_back(parameters);
+
+    for (const RunParameters& run : runs) {
+      Check(Run<Real, SourceReal>(run) == reference,
+            precision + ", " + Describe(run) +
+            ": the E field differs from the per-step scalar run over the "
+            "whole grid");
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestEngines<double, double>("double");
+  TestEngines<float, float>("float");
+  TestEngines<float, double>("mixed");
+  return fdtd1d::test::Finish();
+}
@@ -0,0 +1,114 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Checks that each instance of an FDTD1DEnsemble gives the same E field, bit
+// for bit, as an FDTD1D run with the same parameters and source (see
+// fdtd1d_ensemble.h). It covers the blocks advanced independently and
+// advanced by all the threads together, a partial last block, the kernels
+// supported by the processor and the three precisions.
+
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "fdtd1d.h"
+#include "fdtd1d_ensemble.h"
+#include "test_check.h"
+
+namespace {
+
+using fdtd1d::KernelType;
+using fdtd1d::test::Check;
+
+// the source of the instance n, as the sweep of main.cc
+template <typename SourceReal>
+void GetSource(const int n, SourceReal* position, SourceReal* amplitude,
+               SourceReal* t_center) {
+  *position = SourceReal(-2) + SourceReal(0.3)*n;
+  *amplitude = SourceReal(1) + SourceReal(0.1)*n;
+  *t_center = SourceReal(1) + SourceReal(0.05)*n;
+}
+
+template <typename Real, typename SourceReal>
+std::vector<Real> RunSingle(const int n) {
+  fdtd1d::FDTD1D<Real, SourceReal> fdtd;
+  fdtd.SetXAxisRangeAndGridSpacing(SourceReal(-10), SourceReal(10),
+                                   SourceReal(0.02));
+  fdtd.InitializeAndResetEMFieldArrays();
+  fdtd.SetStabilityFactorAndTimeResolution(SourceReal(0.99));
+  fdtd.SetSimulationTime(SourceReal(8));
+  fdtd.SetNumberOfThreads(1);
+  fdtd.SetKernelType(KernelType::kScalar);
+  SourceReal position, amplitude, t_center;
+  GetSource(n, &position, &amplitude, &t_center);
+  fdtd.InsertGaussianPointSource(position, amplitude, t_center,
+                                 SourceReal(0.2));
+  fdtd.RunUntil(SourceReal(8));
+  std::vector<Real> e_field;
+  fdtd.GatherEFieldValues(&e_field);
+  return e_field;
+}
+
+template <typename Real, typename SourceReal>
+void TestEnsemble(const std::string& precision) {
+  const int num_instances = 11;
+  std::vector<std::vector<Real>> references;
+  for (int n = 0; n < num_instances; ++n) {
+    references.push_back(RunSingle<Real, SourceReal>(n));
+  }
+
+  const KernelType kernel_types[] = {
+      KernelType::kScalar, KernelType::kSSE2, KernelType::kAVX2,
+      KernelType::kAVX512};
+  for (KernelType kernel_type : kernel_types) {
+    if (fdtd1d::GetYeeKernels<Real>(kernel_type).type != kernel_type) {
+      continue;
+    }
+    // one thread advances whole blocks, eight threads share the points of
+    // the blocks
+    for (int num_threads : {1, 8}) {
+      fdtd1d::FDTD1DEnsemble<Real, SourceReal> ensemble;
+      ensemble.SetXAxisRangeAndGridSpacing(SourceReal(-10), SourceReal(10),
+                                           SourceReal(0.02));
+      ensemble.SetNumberOfInstances(num_instances);
+      ensemble.InitializeAndResetEMFieldArrays();
+      ensemble.SetStabilityFactorAndTimeResolution(SourceReal(0.99));
+      ensemble.SetSimulationTime(SourceReal(8));
+      ensemble.SetNumberOfThreads(num_threads);
+      ensemble.SetKernelType(kernel_type);
+      for (int n = 0; n < num_instances; ++n) {
+        SourceReal position, amplitude, t_center;
+        GetSource(n, &position, &amplitude, &t_center);
+        ensemble.InsertGaussianPointSource(n, position, amplitude, t_center,
+                                           SourceReal(0.2));
+      }
+      const std::string name = precision + ", " +
+          fdtd1d::GetKernelTypeName(kernel_type) + " kernels, " +
+          std::to_string(num_threads) + " threads";
+      Check(!ensemble.InsertGaussianPointSource(
+                -1, SourceReal(0), SourceReal(1), SourceReal(1),
+                SourceReal(0.2)),
+            name + ": a source is added to the instance -1");
+      Check(!ensemble.InsertGaussianPointSource(
+                num_instances, SourceReal(0), SourceReal(1), SourceReal(1),
+                SourceReal(0.2)),
+            name + ": a source is added to an instance past the ensemble");
+      ensemble.CreateThreadsAndRun();
+
+      for (int n = 0; n < num_instances; ++n) {
+        std::vector<Real> e_field;
+        ensemble.GetEFieldValues(n, &e_field);
+        Check(e_field == references[n],
+              name + ": the instance " + std::to_string(n) +
+              " differs from FDTD1D");
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestEnsemble<double, double>("double");
+  TestEnsemble<float, float>("float");
+  TestEnsemble<float, double>("mixed");
+  return fdtd1d::test::Finish();
+}
@@ -0,0 +1,121 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Checks that DecodeFieldChunk restores the snapshots given to
+// EncodeFieldChunk bit for bit (see field_chunk_codec.h), for float and
+// double words, sparse and dense byte planes and the special values, and
+// that it rejects truncated and corrupted chunks.
+
+#include <cmath>          // std::sin, std::exp
+#include <cstring>        // std::memcmp
+#include <limits>         // std::numeric_limits
+#include <string>         // std::string
+#include <vector>         // std::vector
+
+#include "field_chunk_codec.h"
+#include "test_check.h"
+
+namespace {
+
+using fdtd1d::IntNumber;
+using fdtd1d::test::Check;
+
+// a pulse travelling over a grid that is zero ahead of it, with a few
+// special values in the first snapshot
+template <typename Real>
+std::vector<Real> MakeSnapshots(const IntNumber num_frames,
+                                const IntNumber num_values) {
+  std::vector<Real> frames(num_frames*num_values, Real(0));
+  for (IntNumber n = 0; n < num_frames; ++n) {
+    for (IntNumber i = 0; i < num_values && i < 8*(n + 1); ++i) {
+      double x = static_cast<double>(i - 4*n);
+      frames[n*num_values + i] = static_cast<Real>(
+          std::exp(-x*x / 50.0)*std::sin(0.3*x));
+    }
+  }
+  if (num_frames > 0 && num_values >= 6) {
+    frames[0] = Real(-0.0);
+    frames[1] = std::numeric_limits<Real>::denorm_min();
+    frames[2] = std::numeric_limits<Real>::infinity();
+    frames[3] = -std::numeric_limits<Real>::max();
+    frames[4] = std::numeric_limits<Real>::quiet_NaN();
+    frames[5] = std::numeric_limits<Real>::lowest();
+  }
+  return frames;
+}
+
+template <typename Real>
+void TestRoundTrip(const IntNumber num_frames, const IntNumber num_values) {
+  const std::string name = std::to_string(sizeof(Real)) + " byte words, " +
+                           std::to_string(num_frames) + " frames of " +
+                           std::to_string(num_values) + " values: ";
+  std::vector<Real> frames = MakeSnapshots<Real>(num_frames, num_values);
+  std::vector<unsigned char> encoded;
+  fdtd1d::EncodeFieldChunk(frames.data(), num_frames, num_values,
+                           sizeof(Real), &encoded);
+
+  IntNumber decoded_num_frames = -1;
+  IntNumber decoded_num_values = -1;
+  int word_size = 0;
+  std::vector<unsigned char> decoded;
+  bool is_decoded = fdtd1d::DecodeFieldChunk(
+      encoded.data(), encoded.size(), &decoded_num_frames,
+      &decoded_num_values, &word_size, &decoded);
+  Check(is_decoded, name + "the chunk is not decoded");
+  Check(decoded_num_frames == num_frames &&
+        decoded_num_values == num_values &&
+        word_size == static_cast<int>(sizeof(Real)),
+        name + "the shape of the chunk changed");
+  Check(decoded.size() == frames.size()*sizeof(Real) &&
+        std::memcmp(decoded.data(), frames.data(), decoded.size()) == 0,
+        name + "the snapshots changed");
+
+  // the truncations of the chunk are detected (a sample of them in the 
+  // large chunks)
+  bool rejects_truncation = true;
+  const std::size_t step = 1 + encoded.size() / 500;
+  for (std::size_t size = 0; size < encoded.size(); 
+       size += (size + 64 < encoded.size()) ? step : 1) {
+    rejects_truncation = rejects_truncation &&
+        !fdtd1d::DecodeFieldChunk(encoded.data(), size, &decoded_num_frames,
+                                  &decoded_num_values, &word_size, &decoded);
+  }
+  Check(rejects_truncation, name + "a truncated chunk is decoded");
+}
+
+// a plane encoding that does not exist and a word size that is not
+// supported are rejected
+void TestCorruptedChunk() {
+  std::vector<double> frames = MakeSnapshots<double>(4, 64);
+  std::vector<unsigned char> encoded;
+  fdtd1d::EncodeFieldChunk(frames.data(), 4, 64, sizeof(double), &encoded);
+  IntNumber num_frames = 0;
+  IntNumber num_values = 0;
+  int word_size = 0;
+  std::vector<unsigned char> decoded;
+
+  std::vector<unsigned char> corrupted = encoded;
+  corrupted[3*8] = 7;     // the encoding of the first plane
+  Check(!fdtd1d::DecodeFieldChunk(corrupted.data(), corrupted.size(),
+                                  &num_frames, &num_values, &word_size,
+                                  &decoded),
+        "a chunk with an unknown plane encoding is decoded");
+  corrupted = encoded;
+  corrupted[2*8] = 2;     // the word size
+  Check(!fdtd1d::DecodeFieldChunk(corrupted.data(), corrupted.size(),
+                                  &num_frames, &num_values, &word_size,
+                                  &decoded),
+        "a chunk of 2 byte words is decoded");
+}
+
+}  // namespace
+
+int main() {
+  for (IntNumber num_frames : {0, 1, 2, 17}) {
+    for (IntNumber num_values : {1, 7, 300}) {
+      TestRoundTrip<float>(num_frames, num_values);
+      TestRoundTrip<double>(num_frames, num_values);
+    }
+  }
+  TestCorruptedChunk();
+  return fdtd1d::test::Finish();
+}
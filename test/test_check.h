@@ -0,0 +1,44 @@
+
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+
+#ifndef FDTD_TEST_CHECK_H_
+#define FDTD_TEST_CHECK_H_
+
+// The checks of the test programs run by ctest. A test program calls Check
+// for each expectation and returns Finish() from main, which is 0 if all the
+// checks passed.
+
+#include <iostream>       // std::cout
+#include <string>         // std::string
+
+namespace fdtd1d {
+namespace test {
+
+inline int& GetNumFailedChecks() {
+  static int num_failed_checks = 0;
+  return num_failed_checks;
+}
+
+// prints description if condition is false
+inline bool Check(const bool condition, const std::string& description) {
+  if (!condition) {
+    std::cout << "FAILED: " << description << std::endl;
+    ++GetNumFailedChecks();
+  }
+  return condition;
+}
+
+inline int Finish() {
+  if (GetNumFailedChecks() > 0) {
+    std::cout << GetNumFailedChecks() << " checks failed." << std::endl;
+    return 1;
+  }
+  std::cout << "All the checks passed." << std::endl;
+  return 0;
+}
+
+}  // namespace test
+}  // namespace fdtd1d
+
+#endif  // FDTD_TEST_CHECK_H_
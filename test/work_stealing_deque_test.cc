@@ -0,0 +1,137 @@
+// Use of this source code is governed by the GNU General Public License v3.0.
+
+// Checks that the WorkStealingDeque of the task graph engine (see
+// tile_task_graph.h) hands out every task exactly once while the owner
+// pushes and pops and several thieves steal at the same time.
+
+#include <atomic>         // std::atomic
+#include <cstdint>        // std::int64_t
+#include <random>         // std::mt19937
+#include <string>         // std::to_string
+#include <thread>         // std::thread
+#include <vector>         // std::vector
+
+#include "test_check.h"
+#include "tile_task_graph.h"
+
+namespace {
+
+using fdtd1d::test::Check;
+
+// the owner pushes the tasks 0 ... num_tasks - 1 in bursts of random length,
+// popping some of them in between, while num_thieves threads steal.
+// Returns the number of times each task was taken.
+std::vector<int> RunContendedDeque(const int num_tasks, const int capacity,
+                                   const int num_thieves,
+                                   const unsigned seed) {
+  fdtd1d::WorkStealingDeque deque;
+  deque.Reset(capacity);
+  std::vector<std::atomic<int>> num_takes(num_tasks);
+  for (auto& count : num_takes) {
+    count.store(0);
+  }
+  std::atomic<std::int64_t> num_stolen{0};
+  std::atomic<bool> done{false};
+
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < num_thieves; ++i) {
+    thieves.emplace_back([&] {
+      int task = -1;
+      while (!done.load(std::memory_order_acquire)) {
+        if (deque.Steal(&task)) {
+          num_takes[task].fetch_add(1);
+          num_stolen.fetch_add(1);
+        }
+      }
+    });
+  }
+
+  // the owner never has more than capacity tasks in the deque. The tasks
+  // stolen but not counted yet make the estimate too large, never too small.
+  std::mt19937 random(seed);
+  std::int64_t num_pushed = 0;
+  std::int64_t num_popped = 0;
+  int next_task = 0;
+  int task = -1;
+  while (next_task < num_tasks) {
+    int burst = 1 + static_cast<int>(random() % 8);
+    for (int k = 0; k < burst && next_task < num_tasks; ++k) {
+      if (num_pushed - num_popped - num_stolen.load() >= capacity) {
+        break;
+      }
+      deque.Push(next_task++);
+      ++num_pushed;
+    }
+    int num_pops = static_cast<int>(random() % 6);
+    for (int k = 0; k < num_pops; ++k) {
+      if (deque.Pop(&task)) {
+        num_takes[task].fetch_add(1);
+        ++num_popped;
+      }
+    }
+  }
+  while (deque.Pop(&task)) {
+    num_takes[task].fetch_add(1);
+  }
+  done.store(true, std::memory_order_release);
+  for (auto& thief : thieves) {
+    thief.join();
+  }
+
+  std::vector<int> counts(num_tasks);
+  for (int i = 0; i < num_tasks; ++i) {
+    counts[i] = num_takes[i].load();
+  }
+  return counts;
+}
+
+void TestContendedDeque(const int capacity, const int num_thieves) {
+  const int num_tasks = 200000;
+  std::vector<int> counts = RunContendedDeque(num_tasks, capacity,
+                                              num_thieves, 12345u + capacity);
+  int num_lost = 0;
+  int num_duplicated = 0;
+  for (int count : counts) {
+    num_lost += (count == 0);
+    num_duplicated += (count > 1);
+  }
+  const std::string name = "capacity " + std::to_string(capacity) + ", " +
+                           std::to_string(num_thieves) + " thieves: ";
+  Check(num_lost == 0, name + std::to_string(num_lost) + " tasks lost");
+  Check(num_duplicated == 0,
+        name + std::to_string(num_duplicated) + " tasks taken twice");
+}
+
+// without thieves the owner pops the tasks in the reverse order of the
+// pushes
+void TestOwnerOnly() {
+  fdtd1d::WorkStealingDeque deque;
+  deque.Reset(5);
+  for (int task = 0; task < 8; ++task) {
+    deque.Push(task);
+  }
+  int task = -1;
+  bool is_lifo = true;
+  for (int expected = 7; expected >= 0; --expected) {
+    is_lifo = is_lifo && deque.Pop(&task) && task == expected;
+  }
+  Check(is_lifo, "the owner pops the last pushed task first");
+  Check(!deque.Pop(&task), "an empty deque has no task to pop");
+  Check(!deque.Steal(&task), "an empty deque has no task to steal");
+
+  deque.Push(1);
+  deque.Push(2);
+  Check(deque.Steal(&task) && task == 1, "a thief steals the oldest task");
+}
+
+}  // namespace
+
+int main() {
+  TestOwnerOnly();
+  for (int capacity : {1, 2, 16, 256}) {
+    for (int num_thieves : {1, 3}) {
+      TestContendedDeque(capacity, num_thieves);
+    }
+  }
+  return fdtd1d::test::Finish();
+}